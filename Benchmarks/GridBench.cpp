@@ -0,0 +1,590 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+/*
+    grid-bench: times the plugin's per-block and per-frame hot paths on
+    synthetic data and prints the results as JSON, so builds and machines
+    can be compared.
+ */
+
+#include "HeadlessNode.h"
+#include "HeatmapImage.h"
+
+#include "ActivityPyramid.h"
+#include "ColourMaps.h"
+#include "ColourScaler.h"
+#include "CpuFeatures.h"
+#include "ElectrodeLayout.h"
+#include "FrameHistory.h"
+#include "ProcessLatency.h"
+#include "ReductionKernels.h"
+#include "StreamActivity.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GridViewer;
+
+namespace {
+
+const float SAMPLE_RATE = 30000.0f;
+const float SNAPSHOT_RATE = 50.0f; // as in GridViewerNode
+
+// streams the node_process channels are split over, as from several probes
+const int NODE_STREAMS = 4;
+
+// distinct frames cycled through by the per-frame benchmarks, so nothing settles into a steady state
+const int NUM_TEST_FRAMES = 16;
+
+const char* USAGE =
+    "usage: grid-bench [options]\n"
+    "\n"
+    "  --channels LIST      channel counts (default 64,256,1024,4096,16384)\n"
+    "  --blocks LIST        samples per block at 30 kHz (default 256,1024)\n"
+    "  --seconds S          minimum time spent on each case (default 0.25)\n"
+    "  --threads N          worker threads for the pooled cases (default: one per extra core)\n"
+    "  --only NAME          run only benchmarks whose name contains NAME\n"
+    "  --output FILE        write the JSON there instead of to standard output\n";
+
+struct Options
+{
+    std::vector<int> channelCounts { 64, 256, 1024, 4096, 16384 };
+    std::vector<int> blockSizes { 256, 1024 };
+    double seconds = 0.25;
+    int numThreads = -1;
+    std::string only;
+    std::string output;
+};
+
+/** Timings of one benchmark case */
+struct Result
+{
+    std::string name;
+    int channels;
+    int blockSize;          // 0 for per-frame benchmarks
+    int64_t itemsPerCall;   // channel-samples, or values for per-frame benchmarks
+    std::vector<double> callNanoseconds;
+};
+
+bool parseList(const std::string& text, std::vector<int>& values)
+{
+    values.clear();
+
+    std::stringstream stream(text);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        const int value = std::atoi(item.c_str());
+
+        if (value <= 0)
+            return false;
+
+        values.push_back(value);
+    }
+
+    return ! values.empty();
+}
+
+bool parseArguments(int argc, char** argv, Options& options, std::string& error)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            error = argument + " needs a value";
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        bool valid = true;
+
+        if (argument == "--channels")
+            valid = parseList(value, options.channelCounts);
+        else if (argument == "--blocks")
+            valid = parseList(value, options.blockSizes);
+        else if (argument == "--seconds")
+            valid = (options.seconds = std::atof(value.c_str())) > 0.0;
+        else if (argument == "--threads")
+            valid = (options.numThreads = std::atoi(value.c_str())) >= 0;
+        else if (argument == "--only")
+            options.only = value;
+        else if (argument == "--output")
+            options.output = value;
+        else
+        {
+            error = "unknown option " + argument;
+            return false;
+        }
+
+        if (! valid)
+        {
+            error = "invalid value for " + argument + ": " + value;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Calls a function until the time budget and a minimum call count are both used up, timing every call */
+std::vector<double> timeCalls(const std::function<void()>& call, double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // warm caches, branch predictors and lazily allocated state
+    for (int i = 0; i < 8; i++)
+        call();
+
+    std::vector<double> nanoseconds;
+    const auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+    while (Clock::now() < end || nanoseconds.size() < 20)
+    {
+        const auto start = Clock::now();
+        call();
+        nanoseconds.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    return nanoseconds;
+}
+
+/** Broadband noise of about 10 uV with a -100 uV spike now and then, channel-major */
+std::vector<float> makeSignal(int numChannels, int numSamples)
+{
+    std::mt19937 random(12345);
+    std::normal_distribution<float> noise(0.0f, 10.0f);
+
+    std::vector<float> signal((size_t) numChannels * (size_t) numSamples);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        float* x = signal.data() + (size_t) c * (size_t) numSamples;
+
+        for (int i = 0; i < numSamples; i++)
+            x[i] = noise(random) + ((i + c * 37) % 997 == 0 ? -100.0f : 0.0f);
+    }
+
+    return signal;
+}
+
+/** Per-frame peak-to-peak values that drift from frame to frame */
+std::vector<float> makeFrames(int numChannels)
+{
+    std::mt19937 random(54321);
+    std::uniform_real_distribution<float> value(0.0f, 200.0f);
+
+    std::vector<float> frames((size_t) numChannels * NUM_TEST_FRAMES);
+
+    for (auto& v : frames)
+        v = value(random);
+
+    return frames;
+}
+
+/** StreamActivity::processBlock, the whole of GridViewerNode::process for one stream */
+Result benchmarkProcess(const std::string& name, int numChannels, int blockSize, FilterBand band, WorkerPool* pool, double seconds)
+{
+    std::vector<int> channels((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        channels[(size_t) c] = c;
+
+    StreamActivity stream(0, numChannels, SAMPLE_RATE, SNAPSHOT_RATE, ChannelSpan::fromBufferChannels(channels));
+    stream.setFilterBand(band);
+
+    const std::vector<float> signal = makeSignal(numChannels, blockSize);
+    std::vector<const float*> buffer((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        buffer[(size_t) c] = signal.data() + (size_t) c * (size_t) blockSize;
+
+    int64_t timestamp = 0;
+
+    Result result { name, numChannels, blockSize, (int64_t) numChannels * blockSize, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        stream.processBlock(buffer.data(), blockSize, timestamp, pool);
+        timestamp += blockSize;
+    }, seconds);
+
+    return result;
+}
+
+/**
+    GridViewerNode::process through the mock processor: the channels split
+    over NODE_STREAMS streams, spike band, with the frame history kept as in
+    a default plugin, and the raw history too if keepRaw is set (as the
+    editor's "Raw" toggle does)
+ */
+Result benchmarkNode(const char* name, int numChannels, int blockSize, int numThreads, bool keepRaw, double seconds)
+{
+    HeadlessNode node;
+
+    for (int s = 0; s < NODE_STREAMS; s++)
+        node.addStream(100, (uint16_t) s, numChannels / NODE_STREAMS + (s < numChannels % NODE_STREAMS ? 1 : 0), SAMPLE_RATE);
+
+    node.setParameter(1, (float) numThreads);
+    node.setParameter(4, (float) FilterBand::SPIKE);
+
+    if (keepRaw)
+        node.setParameter(7, (float) ActivityEngine::defaultRawHistoryMb);
+
+    node.enable();
+
+    const double blockSeconds = (double) blockSize / (double) SAMPLE_RATE;
+    node.generateBlock(blockSeconds);
+
+    Result result { name, numChannels, blockSize, (int64_t) numChannels * blockSize, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        node.processBlock();
+        node.repeatBlock(blockSeconds);
+    }, seconds);
+
+    return result;
+}
+
+/** The timing GridViewerNode::process adds per block: two clock reads and ProcessLatency::record, 1000 times */
+Result benchmarkLatencyRecord(double seconds)
+{
+    const int numRecords = 1000;
+
+    ProcessLatency latency;
+
+    Result result { "latency_record", 1, 0, numRecords, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        for (int i = 0; i < numRecords; i++)
+        {
+            const uint64_t start = ProcessLatency::now();
+            latency.record(start, ProcessLatency::now(), 1024.0e9 / SAMPLE_RATE);
+        }
+    }, seconds);
+
+    return result;
+}
+
+/** ColourMaps::mapValues, the table lookup behind ColourScheme */
+Result benchmarkColourLookup(int numChannels, double seconds)
+{
+    const std::vector<float> frames = makeFrames(numChannels);
+    std::vector<uint32_t> colours((size_t) numChannels);
+    int frame = 0;
+
+    Result result { "colour_lookup", numChannels, 0, numChannels, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        ColourMaps::mapValues(frames.data() + (size_t) frame * (size_t) numChannels, colours.data(), numChannels,
+                              ColourSchemeId::INFERNO, 1.0f / 200.0f);
+        frame = (frame + 1) % NUM_TEST_FRAMES;
+    }, seconds);
+
+    return result;
+}
+
+/** FrameHistory::write for every frame, as the audio thread does per recorded frame: range selection and quantization of every metric */
+Result benchmarkHistoryWrite(int numChannels, double seconds)
+{
+    const std::vector<float> frames = makeFrames(numChannels);
+
+    // a different test frame in each metric; write() copies what it selects from, so reusing them costs the same
+    ActivitySnapshot frame;
+    frame.allocate(numChannels);
+
+    for (int m = 0; m < numActivityMetrics; m++)
+    {
+        const float* values = frames.data() + (size_t) (m % NUM_TEST_FRAMES) * (size_t) numChannels;
+        std::copy(values, values + numChannels, frame.getValues((ActivityMetric) m));
+    }
+
+    // a small ring, so the timing is of the writes rather than of committing fresh pages
+    FrameHistory history(numChannels, 64, 1, 50.0f);
+    uint64_t frameCounter = 0;
+
+    Result result { "history_write", numChannels, 0, numChannels, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        frameCounter++;
+        history.write(frame, frameCounter, (int64_t) frameCounter * 600);
+    }, seconds);
+
+    return result;
+}
+
+/** What the canvas does per new frame when zoomed in: scale, map to colours and fill the cells */
+Result benchmarkCanvasFrame(int numChannels, double seconds)
+{
+    const ElectrodeLayout layout(numChannels);
+    HeatmapImage image(layout, 4);
+    ColourScaler scaler;
+    scaler.setMode(ColourScaling::PERCENTILE);
+
+    const std::vector<float> frames = makeFrames(numChannels);
+    uint64_t frameCounter = 0;
+
+    Result result { "canvas_frame", numChannels, 0, numChannels, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        const float* frame = frames.data() + (size_t) (frameCounter % NUM_TEST_FRAMES) * (size_t) numChannels;
+        const float* values = scaler.process(frame, numChannels, 0.0f, 200.0f, ++frameCounter);
+
+        image.draw(values, numChannels, scaler.getMinimum(), scaler.getMaximum(), ColourSchemeId::INFERNO);
+    }, seconds);
+
+    return result;
+}
+
+/** What the canvas does per new frame when zoomed out: scale and update the pooled pyramid */
+Result benchmarkCanvasPyramid(int numChannels, double seconds)
+{
+    const ElectrodeLayout layout(numChannels);
+    ActivityPyramid pyramid(layout);
+    ColourScaler scaler;
+    scaler.setMode(ColourScaling::PERCENTILE);
+
+    const std::vector<float> frames = makeFrames(numChannels);
+    uint64_t frameCounter = 0;
+
+    Result result { "canvas_pyramid", numChannels, 0, numChannels, {} };
+    result.callNanoseconds = timeCalls([&]
+    {
+        const float* frame = frames.data() + (size_t) (frameCounter % NUM_TEST_FRAMES) * (size_t) numChannels;
+        const float* values = scaler.process(frame, numChannels, 0.0f, 200.0f, ++frameCounter);
+
+        const float scale = 1.0f / (scaler.getMaximum() - scaler.getMinimum());
+        pyramid.update(values, numChannels, scale, -scaler.getMinimum() * scale);
+    }, seconds);
+
+    return result;
+}
+
+double getPercentile(const std::vector<double>& sorted, double percentile)
+{
+    const size_t index = (size_t) std::min((double) sorted.size() - 1.0, std::floor(percentile / 100.0 * (double) sorted.size()));
+    return sorted[index];
+}
+
+std::string getCompilerName()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+std::string escape(const std::string& text)
+{
+    std::string escaped;
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results, int numThreads)
+{
+    char number[64];
+
+    auto format = [&number](double value) -> const char*
+    {
+        std::snprintf(number, sizeof(number), "%.6g", value);
+        return number;
+    };
+
+    out << "{\n"
+        << "  \"schema\": 1,\n"
+        << "  \"simd\": \"" << CpuFeatures::getSimdLevelName(ReductionKernels::getActiveSimdLevel()) << "\",\n"
+        << "  \"compiler\": \"" << escape(getCompilerName()) << "\",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"worker_threads\": " << numThreads << ",\n"
+        << "  \"sample_rate\": " << SAMPLE_RATE << ",\n"
+        << "  \"results\": [";
+
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const Result& result = results[r];
+
+        std::vector<double> sorted = result.callNanoseconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0.0;
+
+        for (double ns : sorted)
+            total += ns;
+
+        const double mean = total / (double) sorted.size();
+        const double perItem = mean / (double) result.itemsPerCall;
+
+        out << (r > 0 ? "," : "") << "\n    {"
+            << "\"benchmark\": \"" << result.name << "\", "
+            << "\"channels\": " << result.channels << ", "
+            << "\"block_size\": " << result.blockSize << ", "
+            << "\"calls\": " << sorted.size() << ", "
+            << "\"mean_us\": " << format(mean / 1000.0) << ", "
+            << "\"p50_us\": " << format(getPercentile(sorted, 50.0) / 1000.0) << ", "
+            << "\"p90_us\": " << format(getPercentile(sorted, 90.0) / 1000.0) << ", "
+            << "\"p99_us\": " << format(getPercentile(sorted, 99.0) / 1000.0) << ", "
+            << "\"max_us\": " << format(sorted.back() / 1000.0) << ", ";
+
+        if (result.blockSize > 0)
+        {
+            // channels that could be processed in real time at this rate, on this thread budget
+            out << "\"ns_per_sample\": " << format(perItem) << ", "
+                << "\"channel_samples_per_s\": " << format(1.0e9 / perItem) << ", "
+                << "\"realtime_channels\": " << format(1.0e9 / (perItem * SAMPLE_RATE));
+        }
+        else
+        {
+            out << "\"ns_per_value\": " << format(perItem) << ", "
+                << "\"frames_per_s\": " << format(1.0e9 / mean);
+        }
+
+        out << "}";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string error;
+
+    if (! parseArguments(argc, argv, options, error))
+    {
+        std::cerr << "grid-bench: " << error << "\n\n" << USAGE;
+        return 2;
+    }
+
+    const int numThreads = options.numThreads >= 0 ? options.numThreads
+                                                   : (int) std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    std::unique_ptr<WorkerPool> pool;
+
+    if (numThreads > 0)
+        pool = std::make_unique<WorkerPool>(numThreads);
+
+    auto selected = [&options](const std::string& name)
+    {
+        return options.only.empty() || name.find(options.only) != std::string::npos;
+    };
+
+    std::vector<Result> results;
+
+    auto report = [&results](const Result& result)
+    {
+        double total = 0.0;
+
+        for (double ns : result.callNanoseconds)
+            total += ns;
+
+        std::cerr << "  " << result.name << " " << result.channels << " ch"
+                  << (result.blockSize > 0 ? " x " + std::to_string(result.blockSize) : std::string())
+                  << ": " << total / (double) result.callNanoseconds.size() / 1000.0 << " us per call" << std::endl;
+
+        results.push_back(result);
+    };
+
+    for (int channels : options.channelCounts)
+    {
+        for (int blockSize : options.blockSizes)
+        {
+            if (selected("process_broadband"))
+                report(benchmarkProcess("process_broadband", channels, blockSize, FilterBand::BROADBAND, nullptr, options.seconds));
+
+            if (selected("process_spike"))
+                report(benchmarkProcess("process_spike", channels, blockSize, FilterBand::SPIKE, nullptr, options.seconds));
+
+            if (pool != nullptr && selected("process_spike_pool"))
+                report(benchmarkProcess("process_spike_pool", channels, blockSize, FilterBand::SPIKE, pool.get(), options.seconds));
+
+            if (selected("node_process"))
+                report(benchmarkNode("node_process", channels, blockSize, numThreads, false, options.seconds));
+
+            if (selected("node_process_raw"))
+                report(benchmarkNode("node_process_raw", channels, blockSize, numThreads, true, options.seconds));
+        }
+
+        if (selected("colour_lookup"))
+            report(benchmarkColourLookup(channels, options.seconds));
+
+        if (selected("history_write"))
+            report(benchmarkHistoryWrite(channels, options.seconds));
+
+        if (selected("canvas_frame"))
+            report(benchmarkCanvasFrame(channels, options.seconds));
+
+        if (selected("canvas_pyramid"))
+            report(benchmarkCanvasPyramid(channels, options.seconds));
+    }
+
+    if (selected("latency_record"))
+        report(benchmarkLatencyRecord(options.seconds));
+
+    if (options.output.empty())
+    {
+        writeJson(std::cout, results, numThreads);
+        return 0;
+    }
+
+    std::ofstream file(options.output);
+    writeJson(file, results, numThreads);
+
+    if (! file)
+    {
+        std::cerr << "grid-bench: could not write " << options.output << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __HEADLESSNODE_H__
+#define __HEADLESSNODE_H__
+
+#include "MockProcessor.h"
+
+#include "ActivityEngine.h"
+
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    GridViewerNode on the mock processor: the same stream setup, parameters
+    and per-block work through ActivityEngine, without the editor, canvas or
+    saved state. Benchmarks and tests drive this in place of the plugin.
+ */
+class HeadlessNode : public Mock::GenericProcessor
+{
+public:
+    HeadlessNode() : engine(50.0f), acquiring(false) { }
+
+    /** Same indices and acquisition rules as GridViewerNode::setParameter; returns false if refused */
+    bool setParameter(int index, float value)
+    {
+        return engine.setParameter(index, value, acquiring);
+    }
+
+    void updateSettings() override
+    {
+        std::vector<ActivityEngine::ChannelSource> bufferChannels;
+
+        for (int i = 0; i < getTotalDataChannels(); i++)
+        {
+            const Mock::DataChannel* channel = getDataChannel(i);
+
+            bufferChannels.push_back({ getProcessorFullId(channel->getSourceNodeID(), channel->getSubProcessorIdx()),
+                                       channel->getSampleRate() });
+        }
+
+        engine.configure(bufferChannels);
+    }
+
+    void process(Mock::SampleBuffer& buffer) override
+    {
+        engine.processBuffer(buffer.getArrayOfReadPointers(),
+                             [this] (int channel) { return getNumSamples(channel); },
+                             [this] (int channel) { return getTimestamp(channel); });
+    }
+
+    /** Starts acquisition, as GridViewerNode::enable does */
+    void enable()
+    {
+        engine.reset();
+        acquiring = true;
+    }
+
+    /** Stops acquisition */
+    void disable() { acquiring = false; }
+
+    ActivityEngine& getEngine() { return engine; }
+    ProcessLatency& getProcessLatency() { return engine.getProcessLatency(); }
+
+private:
+    ActivityEngine engine;
+    bool acquiring;
+};
+
+}
+
+#endif /* __HEADLESSNODE_H__ */
@@ -0,0 +1,203 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __MOCKPROCESSOR_H__
+#define __MOCKPROCESSOR_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace GridViewer {
+namespace Mock {
+
+/** Stand-in for the GUI's DataChannel: where one buffer channel comes from */
+class DataChannel
+{
+public:
+    DataChannel(uint16_t sourceNodeId_, uint16_t subProcessorIdx_, float sampleRate_)
+        : sourceNodeId(sourceNodeId_), subProcessorIdx(subProcessorIdx_), sampleRate(sampleRate_) { }
+
+    uint16_t getSourceNodeID() const { return sourceNodeId; }
+    uint16_t getSubProcessorIdx() const { return subProcessorIdx; }
+    float getSampleRate() const { return sampleRate; }
+
+private:
+    uint16_t sourceNodeId;
+    uint16_t subProcessorIdx;
+    float sampleRate;
+};
+
+/** Stand-in for AudioSampleBuffer: channel-major samples with a fixed capacity */
+class SampleBuffer
+{
+public:
+    void setSize(int numChannels_, int capacity_)
+    {
+        numChannels = numChannels_;
+        capacity = capacity_;
+
+        samples.assign((size_t) numChannels * (size_t) capacity, 0.0f);
+        pointers.resize((size_t) numChannels);
+
+        for (int c = 0; c < numChannels; c++)
+            pointers[(size_t) c] = samples.data() + (size_t) c * (size_t) capacity;
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return capacity; }
+
+    float* getWritePointer(int channel) { return samples.data() + (size_t) channel * (size_t) capacity; }
+    const float* const* getArrayOfReadPointers() const { return pointers.data(); }
+
+private:
+    int numChannels = 0;
+    int capacity = 0;
+
+    std::vector<float> samples;
+    std::vector<const float*> pointers;
+};
+
+/**
+    Stand-in for GenericProcessor with synthetic input streams, so processing
+    code written against the GUI's accessors runs without JUCE.
+
+    Streams are added while stopped; generateBlock() then fills the buffer
+    with the next block of every stream, each with its own sample count and
+    timestamp as the GUI delivers them.
+ */
+class GenericProcessor
+{
+public:
+    virtual ~GenericProcessor() = default;
+
+    virtual void updateSettings() { }
+
+    virtual void process(SampleBuffer& buffer) = 0;
+
+    /** Same packing as GenericProcessor::getProcessorFullId in the GUI */
+    static uint32_t getProcessorFullId(uint16_t sourceNodeId, uint16_t subProcessorIdx)
+    {
+        return ((uint32_t) sourceNodeId << 16) + subProcessorIdx;
+    }
+
+    /** Appends a stream's channels to the buffer, then calls updateSettings() */
+    void addStream(uint16_t sourceNodeId, uint16_t subProcessorIdx, int numChannels, float sampleRate)
+    {
+        Stream stream;
+        stream.firstChannel = (int) channels.size();
+        stream.numChannels = numChannels;
+        stream.sampleRate = sampleRate;
+
+        for (int c = 0; c < numChannels; c++)
+            channels.emplace_back(sourceNodeId, subProcessorIdx, sampleRate);
+
+        streams.push_back(stream);
+        channelStreams.resize(channels.size(), (int) streams.size() - 1);
+
+        updateSettings();
+    }
+
+    int getTotalDataChannels() const { return (int) channels.size(); }
+
+    const DataChannel* getDataChannel(int index) const { return &channels[(size_t) index]; }
+
+    /** Sample count of a channel's stream in the current block */
+    int getNumSamples(int channel) const { return streams[(size_t) channelStreams[(size_t) channel]].numSamples; }
+
+    /** Timestamp of the first sample of a channel's stream in the current block */
+    uint64_t getTimestamp(int channel) const { return streams[(size_t) channelStreams[(size_t) channel]].timestamp; }
+
+    /**
+     *  Fills the buffer with the next block of every stream: about 10 uV of
+     *  noise with a -100 uV spike now and then. Each stream gets as many
+     *  samples as it records in the given time.
+     */
+    void generateBlock(double seconds)
+    {
+        prepareBuffer(seconds);
+
+        std::normal_distribution<float> noise(0.0f, 10.0f);
+
+        for (auto& stream : streams)
+        {
+            for (int c = 0; c < stream.numChannels; c++)
+            {
+                float* x = buffer.getWritePointer(stream.firstChannel + c);
+
+                for (int i = 0; i < stream.numSamples; i++)
+                    x[i] = noise(random) + ((stream.timestamp + (uint64_t) i + (uint64_t) c * 37) % 997 == 0 ? -100.0f : 0.0f);
+            }
+        }
+    }
+
+    /** Moves every stream on by one block without drawing new samples, for timing loops */
+    void repeatBlock(double seconds)
+    {
+        prepareBuffer(seconds);
+    }
+
+    /** Calls process() with the current block */
+    void processBlock() { process(buffer); }
+
+private:
+    struct Stream
+    {
+        int firstChannel = 0;
+        int numChannels = 0;
+        float sampleRate = 0.0f;
+        int numSamples = 0;
+        uint64_t timestamp = 0;
+    };
+
+    std::vector<DataChannel> channels;
+    std::vector<int> channelStreams; // stream index of each channel
+    std::vector<Stream> streams;
+
+    SampleBuffer buffer;
+    std::mt19937 random { 12345 };
+
+    /** Advances timestamps past the previous block and sizes the buffer for the next */
+    void prepareBuffer(double seconds)
+    {
+        int capacity = 0;
+
+        for (auto& stream : streams)
+        {
+            stream.timestamp += (uint64_t) stream.numSamples;
+            stream.numSamples = (int) std::lround(seconds * (double) stream.sampleRate);
+            capacity = std::max(capacity, stream.numSamples);
+        }
+
+        if (buffer.getNumChannels() != (int) channels.size() || buffer.getNumSamples() < capacity)
+            buffer.setSize((int) channels.size(), capacity);
+    }
+};
+
+}
+}
+
+#endif /* __MOCKPROCESSOR_H__ */
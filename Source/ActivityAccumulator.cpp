@@ -0,0 +1,157 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ActivityAccumulator.h"
+
+#include <cmath>
+
+using namespace GridViewer;
+
+ActivityAccumulator::ActivityAccumulator(int numChannels_, float sampleRate_, int updateInterval_)
+    : numChannels(numChannels_ > 0 ? numChannels_ : 0),
+      sampleRate(sampleRate_),
+      updateInterval(updateInterval_ > 0 ? updateInterval_ : 1),
+      counter(0),
+      fixedThreshold(-50.0f),
+      thresholdMultiplier(0.0f),
+      statistics(numChannels),
+      thresholds(numChannels),
+      centres(numChannels),
+      // about 1000 noise samples per second per channel
+      noise(numChannels, (int) (sampleRate_ / 1000.0f))
+{
+    reset();
+}
+
+void ActivityAccumulator::addBlock(int channel, const float* samples, int numSamples)
+{
+    ReductionKernels::statistics(samples, numSamples, thresholds[channel], statistics[channel]);
+
+    if (thresholdMultiplier > 0.0f)
+        noise.addBlock(channel, samples, numSamples, centres[channel]);
+}
+
+void ActivityAccumulator::addBlocks(int firstChannel, const float* const* channelData, int count, int numSamples)
+{
+    for (int i = 0; i < count; i++)
+        addBlock(firstChannel + i, channelData[i], numSamples);
+}
+
+bool ActivityAccumulator::endBlock(int numSamples)
+{
+    counter += numSamples;
+
+    return counter >= updateInterval;
+}
+
+void ActivityAccumulator::writeSnapshot(ActivitySnapshot& frame)
+{
+    const int n = frame.numChannels < numChannels ? frame.numChannels : numChannels;
+
+    float* peakToPeak = frame.getValues(ActivityMetric::PEAK_TO_PEAK);
+    float* rms = frame.getValues(ActivityMetric::RMS);
+    float* mean = frame.getValues(ActivityMetric::MEAN);
+    float* lineLength = frame.getValues(ActivityMetric::LINE_LENGTH);
+    float* crossingRate = frame.getValues(ActivityMetric::CROSSING_RATE);
+
+    const float perSample = counter > 0 ? 1.0f / (float) counter : 0.0f;
+
+    frame.numSamples = counter;
+
+    for (int i = 0; i < n; i++)
+    {
+        const ChannelStatistics& s = statistics[i];
+
+        // channels that received no samples keep a peak-to-peak of zero
+        const float range = s.maximum - s.minimum;
+        peakToPeak[i] = range > 0.0f ? range : 0.0f;
+
+        rms[i] = std::sqrt(s.sumOfSquares * perSample);
+        mean[i] = s.sum * perSample;
+        lineLength[i] = s.lineLength * perSample;
+        crossingRate[i] = (float) s.crossings * perSample * sampleRate;
+    }
+
+    if (counter > 0)
+    {
+        for (int i = 0; i < n; i++)
+            centres[i] = mean[i];
+    }
+
+    if (thresholdMultiplier > 0.0f)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            const float sigma = noise.getNoise(i);
+            thresholds[i] = sigma > 0.0f ? centres[i] - thresholdMultiplier * sigma : fixedThreshold;
+        }
+    }
+
+    clearInterval();
+}
+
+void ActivityAccumulator::setThreshold(float threshold)
+{
+    fixedThreshold = threshold;
+
+    if (thresholdMultiplier <= 0.0f)
+        thresholds.fill(fixedThreshold);
+}
+
+void ActivityAccumulator::setThresholdMultiplier(float multiplier)
+{
+    thresholdMultiplier = multiplier > 0.0f ? multiplier : 0.0f;
+
+    // estimates start afresh, so channels fall back to the fixed threshold until they are ready
+    thresholds.fill(fixedThreshold);
+    noise.reset();
+}
+
+void ActivityAccumulator::reset()
+{
+    clearInterval();
+
+    for (int i = 0; i < numChannels; i++)
+        statistics[i].hasLastSample = 0;
+
+    thresholds.fill(fixedThreshold);
+    centres.fill(0.0f);
+    noise.reset();
+}
+
+void ActivityAccumulator::clearInterval()
+{
+    // the carried sample survives, so line length and crossings span frames
+    for (int i = 0; i < numChannels; i++)
+    {
+        ChannelStatistics& s = statistics[i];
+        s.minimum = 999999.9f;
+        s.maximum = -999999.9f;
+        s.sum = 0.0f;
+        s.sumOfSquares = 0.0f;
+        s.lineLength = 0.0f;
+        s.crossings = 0;
+    }
+
+    counter = 0;
+}
@@ -0,0 +1,98 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __ACTIVITYACCUMULATOR_H__
+#define __ACTIVITYACCUMULATOR_H__
+
+#include "ActivitySnapshot.h"
+#include "NoiseEstimator.h"
+#include "ReductionKernels.h"
+
+namespace GridViewer {
+
+/**
+    Accumulates per-channel statistics over an update interval and turns them
+    into the metrics of an ActivitySnapshot.
+
+    Each block of a channel is read exactly once, by the fused statistics
+    kernel; all storage is owned by the audio thread and nothing on the hot
+    path takes a lock. Channels are fed one whole block at a time, followed
+    by a single call to endBlock().
+ */
+class ActivityAccumulator
+{
+public:
+    /** Constructor. updateInterval is measured in samples */
+    ActivityAccumulator(int numChannels, float sampleRate, int updateInterval);
+
+    /** Returns the number of channels */
+    int getNumChannels() const { return numChannels; }
+
+    /** Adds one channel's block of samples */
+    void addBlock(int channel, const float* samples, int numSamples);
+
+    /** Adds a block for each of a span of consecutive channels, given one data pointer per channel */
+    void addBlocks(int firstChannel, const float* const* channelData, int count, int numSamples);
+
+    /** Advances the interval counter; returns true once the update interval is complete */
+    bool endBlock(int numSamples);
+
+    /** Writes the current interval's metrics into a snapshot and starts a new interval */
+    void writeSnapshot(ActivitySnapshot& frame);
+
+    /** Sets the level (in uV, usually negative) whose downward crossings are counted */
+    void setThreshold(float threshold);
+
+    /**
+     *  Sets each channel's threshold to multiplier times its estimated noise
+     *  level below its mean, or to the fixed threshold if multiplier is 0.
+     *  Channels use the fixed threshold until their noise estimate is ready.
+     */
+    void setThresholdMultiplier(float multiplier);
+
+    float getThresholdMultiplier() const { return thresholdMultiplier; }
+
+    /** Discards the current interval and the carried samples */
+    void reset();
+
+    /** Discards the current interval, keeping the carried samples and thresholds */
+    void clearInterval();
+
+private:
+    int numChannels;
+    float sampleRate;
+    int updateInterval;
+    int counter;
+    float fixedThreshold;
+    float thresholdMultiplier;
+
+    AlignedBuffer<ChannelStatistics> statistics;
+    AlignedBuffer<float> thresholds;    // per channel
+    AlignedBuffer<float> centres;       // mean of the previous interval, for the noise estimate
+
+    NoiseEstimator noise;
+};
+
+}
+
+#endif /* __ACTIVITYACCUMULATOR_H__ */
@@ -0,0 +1,287 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "ActivityEngine.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace GridViewer;
+
+namespace {
+    /**
+     *  Clamps a parameter value in float before it is cast, since casting a
+     *  float outside the integer's range (or NaN, which gives the minimum
+     *  here) is undefined
+     */
+    int toClampedInt(float value, int minimum, int maximum)
+    {
+        if (! (value > (float) minimum))
+            return minimum;
+
+        return value < (float) maximum ? (int) value : maximum;
+    }
+}
+
+ActivityEngine::ActivityEngine(float snapshotRate_)
+    : snapshotRate(snapshotRate_),
+      numWorkerThreads(0),
+      parallelThreshold(4096),
+      crossingThreshold(-50.0f),
+      filterBand(FilterBand::BROADBAND),
+      thresholdMultiplier(0.0f),
+      historyBudgetMb(defaultHistoryMb),
+      rawBudgetMb(0),
+      selectedStream(0)
+{
+}
+
+ActivityEngine::~ActivityEngine()
+{
+    // the raw history's compressor and the pool's workers stop before the streams go
+    rawHistory.reset();
+    workerPool.reset();
+}
+
+void ActivityEngine::configure(const std::vector<ChannelSource>& bufferChannels)
+{
+    std::map<uint32_t, std::vector<int>> streamBufferChannels;
+    std::map<uint32_t, float> sampleRates;
+
+    for (int i = 0; i < (int) bufferChannels.size(); i++)
+    {
+        const ChannelSource& source = bufferChannels[(size_t) i];
+
+        streamBufferChannels[source.streamId].push_back(i);
+
+        // a stream's rate is that of its first channel
+        sampleRates.emplace(source.streamId, source.sampleRate);
+    }
+
+    streams.clear();
+
+    for (auto& stream : streamBufferChannels)
+    {
+        const uint32_t streamId = stream.first;
+
+        streams.push_back(std::make_unique<StreamActivity>(streamId,
+                                                           (int) stream.second.size(),
+                                                           sampleRates[streamId],
+                                                           snapshotRate,
+                                                           ChannelSpan::fromBufferChannels(stream.second)));
+
+        streams.back()->setThreshold(crossingThreshold);
+        streams.back()->setFilterBand(filterBand);
+        streams.back()->setThresholdMultiplier(thresholdMultiplier);
+    }
+
+    blockSizes.assign(streams.size(), 0);
+    blockTimestamps.assign(streams.size(), 0);
+
+    prepareHistories();
+    prepareRawHistory();
+}
+
+StreamActivity* ActivityEngine::findStream(uint32_t streamId)
+{
+    for (auto& stream : streams)
+        if (stream->getStreamId() == streamId)
+            return stream.get();
+
+    return nullptr;
+}
+
+const StreamActivity* ActivityEngine::findStream(uint32_t streamId) const
+{
+    for (auto& stream : streams)
+        if (stream->getStreamId() == streamId)
+            return stream.get();
+
+    return nullptr;
+}
+
+void ActivityEngine::process(const float* const* bufferChannels, const int* blockSizes, const int64_t* blockTimestamps)
+{
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        StreamActivity& stream = *streams[i];
+
+        // small streams are not worth waking the workers for
+        WorkerPool* pool = stream.getNumChannels() >= parallelThreshold ? workerPool.get() : nullptr;
+
+        stream.processBlock(bufferChannels, blockSizes[i], blockTimestamps[i], pool);
+
+        // only the selected stream is kept raw; a full queue drops the block rather than wait
+        if (rawHistory != nullptr && stream.getStreamId() == rawHistory->getRequestedStream())
+            rawHistory->push(stream.getStreamId(),
+                             stream.getSampleRate(),
+                             bufferChannels,
+                             stream.getBufferChannelIndices(),
+                             stream.getNumChannels(),
+                             blockSizes[i],
+                             blockTimestamps[i]);
+    }
+}
+
+void ActivityEngine::recordLatency(uint64_t processStart)
+{
+    // the next callback is due one block of signal later
+    const double blockBudget = ! streams.empty()
+        ? (double) blockSizes[0] * 1.0e9 / (double) streams[0]->getSampleRate()
+        : 0.0;
+
+    processLatency.record(processStart, ProcessLatency::now(), blockBudget);
+}
+
+void ActivityEngine::reset()
+{
+    for (auto& stream : streams)
+        stream->reset();
+
+    processLatency.clear();
+}
+
+bool ActivityEngine::setParameter(int index, float value, bool acquiring)
+{
+    switch (index)
+    {
+        case 0:
+            selectStream(value > 0.0f ? (uint32_t) std::min((double) value, 4294967295.0) : 0);
+            return true;
+
+        case 4:
+            // band changes only swap coefficients, so they are safe during acquisition
+            setFilterBand((FilterBand) toClampedInt(value, 0, numFilterBands - 1));
+            return true;
+
+        case 5:
+            // read by the audio thread at the start of the next block
+            setThresholdMultiplier(std::max(0.0f, std::min(value, 20.0f)));
+            return true;
+
+        default:
+            break;
+    }
+
+    // the audio thread may be inside the pool, the accumulators or the histories
+    if (acquiring)
+        return false;
+
+    switch (index)
+    {
+        case 1: setNumWorkerThreads(toClampedInt(value, 0, 64)); return true;
+        case 2: setParallelThreshold(toClampedInt(value, 1, 1 << 24)); return true;
+        case 3: setCrossingThreshold(value); return true;
+        case 6: setHistoryBudget(toClampedInt(value, 0, 65536)); return true;
+        case 7: setRawHistoryBudget(toClampedInt(value, 0, 65536)); return true;
+        default: return false;
+    }
+}
+
+void ActivityEngine::setNumWorkerThreads(int numThreads)
+{
+    numWorkerThreads = std::max(0, std::min(numThreads, 64));
+
+    workerPool.reset();
+
+    if (numWorkerThreads > 0)
+        workerPool = std::make_unique<WorkerPool>(numWorkerThreads);
+}
+
+void ActivityEngine::setCrossingThreshold(float threshold)
+{
+    crossingThreshold = threshold;
+
+    for (auto& stream : streams)
+        stream->setThreshold(crossingThreshold);
+}
+
+void ActivityEngine::setFilterBand(FilterBand band)
+{
+    filterBand = band;
+
+    for (auto& stream : streams)
+        stream->setFilterBand(filterBand);
+}
+
+void ActivityEngine::setThresholdMultiplier(float multiplier)
+{
+    thresholdMultiplier = multiplier;
+
+    for (auto& stream : streams)
+        stream->setThresholdMultiplier(thresholdMultiplier);
+}
+
+void ActivityEngine::setHistoryBudget(int megabytes)
+{
+    historyBudgetMb = std::max(0, megabytes);
+
+    prepareHistories();
+}
+
+void ActivityEngine::setRawHistoryBudget(int megabytes)
+{
+    rawBudgetMb = std::max(0, megabytes);
+
+    prepareRawHistory();
+}
+
+void ActivityEngine::selectStream(uint32_t streamId)
+{
+    selectedStream = streamId;
+
+    if (rawHistory != nullptr)
+        rawHistory->setStream(selectedStream);
+}
+
+void ActivityEngine::prepareHistories()
+{
+    int totalChannels = 0;
+
+    for (auto& stream : streams)
+        totalChannels += stream->getNumChannels();
+
+    // the budget is shared in proportion to channel count, so every stream covers the same time
+    for (auto& stream : streams)
+    {
+        const double share = totalChannels > 0 ? (double) stream->getNumChannels() / (double) totalChannels : 0.0;
+        stream->prepareHistory((size_t) (share * (double) historyBudgetMb * 1024.0 * 1024.0));
+    }
+}
+
+void ActivityEngine::prepareRawHistory()
+{
+    int maxChannels = 0;
+
+    for (auto& stream : streams)
+        maxChannels = std::max(maxChannels, stream->getNumChannels());
+
+    rawHistory.reset();
+
+    if (rawBudgetMb > 0 && maxChannels > 0)
+    {
+        rawHistory = std::make_unique<RawHistory>(maxChannels, (size_t) rawBudgetMb * 1024 * 1024);
+        rawHistory->setStream(selectedStream);
+    }
+}
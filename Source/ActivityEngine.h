@@ -0,0 +1,219 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __ACTIVITYENGINE_H__
+#define __ACTIVITYENGINE_H__
+
+#include "ProcessLatency.h"
+#include "RawHistory.h"
+#include "StreamActivity.h"
+#include "WorkerPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    The processing behind GridViewerNode, without JUCE: one StreamActivity per
+    input stream, the worker pool they share, the frame and raw histories, and
+    the settings exposed as node parameters.
+
+    The node translates its channel list into plain channel sources and
+    forwards its parameters and blocks, so the same code runs inside the GUI
+    and in headless harnesses, tests and benchmarks.
+ */
+class ActivityEngine
+{
+public:
+    /** Where one channel of the processor's buffer comes from */
+    struct ChannelSource
+    {
+        uint32_t streamId;
+        float sampleRate;
+    };
+
+    /** snapshotRate is the number of frames published per second */
+    explicit ActivityEngine(float snapshotRate = 50.0f);
+
+    ~ActivityEngine();
+
+    /**
+     *  Rebuilds every stream from the source of each buffer channel, with
+     *  streams in ascending order of ID and channels in buffer order (only
+     *  while acquisition is stopped).
+     */
+    void configure(const std::vector<ChannelSource>& bufferChannels);
+
+    int getNumStreams() const { return (int) streams.size(); }
+
+    StreamActivity& getStream(int index) { return *streams[(size_t) index]; }
+    const StreamActivity& getStream(int index) const { return *streams[(size_t) index]; }
+
+    /** Returns a stream by ID, or nullptr */
+    StreamActivity* findStream(uint32_t streamId);
+    const StreamActivity* findStream(uint32_t streamId) const;
+
+    /**
+     *  Reduces one block of every stream; blockSizes and blockTimestamps hold
+     *  each stream's sample count and first timestamp, by stream index
+     *  (audio thread).
+     */
+    void process(const float* const* bufferChannels, const int* blockSizes, const int64_t* blockTimestamps);
+
+    /**
+     *  The node's work for one buffer (audio thread): reads each stream's
+     *  sample count and first timestamp from its first buffer channel through
+     *  getNumSamples(channel) and getTimestamp(channel), reduces the block and
+     *  records how long that took against the block's duration.
+     */
+    template <typename SampleCountFunction, typename TimestampFunction>
+    void processBuffer(const float* const* bufferChannels,
+                       SampleCountFunction getNumSamples,
+                       TimestampFunction getTimestamp)
+    {
+        const uint64_t processStart = ProcessLatency::now();
+
+        // all channels of a stream share the block's sample count and timestamp
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            const int firstChannel = streams[i]->getFirstBufferChannel();
+
+            blockSizes[i] = (int) getNumSamples(firstChannel);
+            blockTimestamps[i] = (int64_t) getTimestamp(firstChannel);
+        }
+
+        process(bufferChannels, blockSizes.data(), blockTimestamps.data());
+
+        recordLatency(processStart);
+    }
+
+    /** Returns the time processBuffer() takes per block */
+    ProcessLatency& getProcessLatency() { return processLatency; }
+
+    /** Discards every stream's filter state and interval in progress, and the latency record (while acquisition is stopped) */
+    void reset();
+
+    /**
+     *  Applies one of GridViewerNode's parameters, clamped to its valid range:
+     *
+     *  0: stream whose raw samples are kept
+     *  1: number of worker threads, 0 to 64
+     *  2: parallel threshold in channels, at least 1
+     *  3: fixed crossing threshold in uV
+     *  4: FilterBand
+     *  5: threshold multiplier, 0 to 20
+     *  6: frame history budget in MB, 0 to 65536
+     *  7: raw history budget in MB, 0 to 65536
+     *
+     *  1 to 3, 6 and 7 rebuild state or change values the audio thread reads
+     *  unsynchronised, so they are refused while acquiring. Returns false if
+     *  the parameter was refused or the index is unknown.
+     */
+    bool setParameter(int index, float value, bool acquiring);
+
+    /** 0 reduces on the calling thread only (only while acquisition is stopped) */
+    void setNumWorkerThreads(int numThreads);
+    int getNumWorkerThreads() const { return numWorkerThreads; }
+
+    /** Minimum channel count of a stream before its reduction is split across the workers */
+    void setParallelThreshold(int numChannels) { parallelThreshold = numChannels > 0 ? numChannels : 1; }
+    int getParallelThreshold() const { return parallelThreshold; }
+
+    /** Fixed crossing threshold in uV (only while acquisition is stopped) */
+    void setCrossingThreshold(float threshold);
+    float getCrossingThreshold() const { return crossingThreshold; }
+
+    /** Takes effect at each stream's next block (any thread) */
+    void setFilterBand(FilterBand band);
+    FilterBand getFilterBand() const { return filterBand; }
+
+    /** Adaptive thresholds, or 0 for the fixed one; takes effect at each stream's next block (any thread) */
+    void setThresholdMultiplier(float multiplier);
+    float getThresholdMultiplier() const { return thresholdMultiplier; }
+
+    /** Frame history budget by default: about 2 minutes of 4096 channels, or 20 of 384 */
+    static constexpr int defaultHistoryMb = 64;
+
+    /** Memory in MB shared by the frame histories, in proportion to channel count (only while acquisition is stopped) */
+    void setHistoryBudget(int megabytes);
+    int getHistoryBudget() const { return historyBudgetMb; }
+
+    /** Raw history budget the editor offers; raw history is off by default */
+    static constexpr int defaultRawHistoryMb = 256;
+
+    /** Memory in MB for compressed raw samples of the selected stream, or 0 for none (only while acquisition is stopped) */
+    void setRawHistoryBudget(int megabytes);
+    int getRawHistoryBudget() const { return rawBudgetMb; }
+
+    /** Selects the stream whose raw samples are kept (any thread) */
+    void selectStream(uint32_t streamId);
+
+    const RawHistory* getRawHistory() const { return rawHistory.get(); }
+    RawHistory* getRawHistory() { return rawHistory.get(); }
+
+    float getSnapshotRate() const { return snapshotRate; }
+
+private:
+    const float snapshotRate;
+
+    std::vector<std::unique_ptr<StreamActivity>> streams;
+
+    std::unique_ptr<WorkerPool> workerPool; // null when the reduction runs on the calling thread only
+    int numWorkerThreads;
+    int parallelThreshold;
+
+    float crossingThreshold;
+    FilterBand filterBand;
+    float thresholdMultiplier;
+
+    int historyBudgetMb;
+
+    std::unique_ptr<RawHistory> rawHistory;
+    int rawBudgetMb;
+    uint32_t selectedStream;
+
+    // each stream's sample count and timestamp in the current block, by stream index
+    std::vector<int> blockSizes;
+    std::vector<int64_t> blockTimestamps;
+
+    ProcessLatency processLatency;
+
+    /** Records one processBuffer() call against the duration of the first stream's block */
+    void recordLatency(uint64_t processStart);
+
+    /** Shares the history budget between the streams and reallocates their histories */
+    void prepareHistories();
+
+    /** Recreates the raw history for the current streams and budget */
+    void prepareRawHistory();
+
+    ActivityEngine(const ActivityEngine&) = delete;
+    ActivityEngine& operator=(const ActivityEngine&) = delete;
+};
+
+}
+
+#endif /* __ACTIVITYENGINE_H__ */
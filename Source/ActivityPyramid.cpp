@@ -0,0 +1,234 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ActivityPyramid.h"
+
+#include "ColourMaps.h"
+
+#include <algorithm>
+
+using namespace GridViewer;
+
+ActivityPyramid::ActivityPyramid(const ElectrodeLayout& layout_)
+    : layout(layout_),
+      needsFullRebuild(true)
+{
+    int numColumns = layout.getNumColumns();
+    int numRows = layout.getNumRows();
+
+    for (;;)
+    {
+        Level level;
+        level.numColumns = numColumns;
+        level.numRows = numRows;
+        level.tileColumns = (numColumns + tileSize - 1) / tileSize;
+        level.tileRows = (numRows + tileSize - 1) / tileSize;
+
+        const size_t numCells = (size_t) numColumns * (size_t) numRows;
+
+        level.states.assign(numCells, BACKGROUND);
+        level.maxIndices.assign(numCells, 0);
+        level.meanIndices.assign(numCells, 0);
+        level.sums.assign(numCells, 0);
+        level.counts.assign(numCells, 0);
+        level.dirtyTiles.assign((size_t) (level.tileColumns * level.tileRows), 0);
+
+        levels.push_back(std::move(level));
+
+        if (numColumns == 1 && numRows == 1)
+            break;
+
+        numColumns = (numColumns + 1) / 2;
+        numRows = (numRows + 1) / 2;
+    }
+
+    // cell states and electrode counts depend only on the layout
+    Level& base = levels[0];
+    const int* cellChannels = layout.getCellChannels();
+    const bool drawEmptyCells = ! layout.isFromChannelMap();
+
+    for (size_t cell = 0; cell < base.states.size(); cell++)
+    {
+        if (cellChannels[cell] >= 0)
+        {
+            base.states[cell] = ELECTRODE;
+            base.counts[cell] = 1;
+        }
+        else if (cellChannels[cell] == ElectrodeLayout::disabledCell || drawEmptyCells)
+        {
+            base.states[cell] = UNUSED;
+        }
+    }
+
+    for (size_t l = 1; l < levels.size(); l++)
+    {
+        const Level& below = levels[l - 1];
+        Level& level = levels[l];
+
+        for (int row = 0; row < below.numRows; row++)
+        {
+            for (int column = 0; column < below.numColumns; column++)
+            {
+                const size_t source = (size_t) (row * below.numColumns + column);
+                const size_t target = (size_t) ((row / 2) * level.numColumns + column / 2);
+
+                level.states[target] = std::max(level.states[target], below.states[source]);
+                level.counts[target] += below.counts[source];
+            }
+        }
+    }
+
+    const int numElectrodes = layout.getNumElectrodes();
+
+    electrodeValues.assign((size_t) numElectrodes, 0.0f);
+    electrodeIndices.assign((size_t) numElectrodes, 0);
+}
+
+int ActivityPyramid::getNumLevels(int numColumns, int numRows)
+{
+    int numLevels = 1;
+
+    while (numColumns > 1 || numRows > 1)
+    {
+        numColumns = (numColumns + 1) / 2;
+        numRows = (numRows + 1) / 2;
+        numLevels++;
+    }
+
+    return numLevels;
+}
+
+const uint8_t* ActivityPyramid::getColourIndices(int level, Pooling pooling) const
+{
+    const Level& l = levels[(size_t) level];
+
+    return pooling == Pooling::MAX ? l.maxIndices.data() : l.meanIndices.data();
+}
+
+int ActivityPyramid::update(const float* channelValues, int numValues, float scale, float offset)
+{
+    const int numElectrodes = layout.getNumElectrodes();
+    const int* cells = layout.getElectrodeCells();
+    const int* channels = layout.getElectrodeChannels();
+
+    for (int i = 0; i < numElectrodes; i++)
+        electrodeValues[(size_t) i] = channels[i] < numValues ? channelValues[channels[i]] : 0.0f;
+
+    ColourMaps::mapIndices(electrodeValues.data(), electrodeIndices.data(), numElectrodes, scale, offset);
+
+    Level& base = levels[0];
+    const bool rebuildAll = needsFullRebuild;
+
+    for (int i = 0; i < numElectrodes; i++)
+    {
+        const size_t cell = (size_t) cells[i];
+        const uint8_t index = electrodeIndices[(size_t) i];
+
+        if (index == base.maxIndices[cell] && ! rebuildAll)
+            continue;
+
+        base.maxIndices[cell] = index;
+        base.meanIndices[cell] = index;
+        base.sums[cell] = index;
+
+        const int column = cells[i] % base.numColumns;
+        const int row = cells[i] / base.numColumns;
+
+        base.dirtyTiles[(size_t) ((row / tileSize) * base.tileColumns + column / tileSize)] = 1;
+    }
+
+    needsFullRebuild = false;
+
+    int tilesRebuilt = 0;
+
+    for (size_t l = 1; l < levels.size(); l++)
+    {
+        Level& below = levels[l - 1];
+        Level& level = levels[l];
+
+        // a tile's cells pool the 2x2 tiles below it
+        for (int tileRow = 0; tileRow < level.tileRows; tileRow++)
+        {
+            for (int tileColumn = 0; tileColumn < level.tileColumns; tileColumn++)
+            {
+                bool dirty = rebuildAll;
+
+                for (int r = 2 * tileRow; r < std::min(2 * tileRow + 2, below.tileRows); r++)
+                    for (int c = 2 * tileColumn; c < std::min(2 * tileColumn + 2, below.tileColumns); c++)
+                        dirty = dirty || below.dirtyTiles[(size_t) (r * below.tileColumns + c)] != 0;
+
+                if (! dirty)
+                    continue;
+
+                rebuildTile((int) l, tileColumn, tileRow);
+                level.dirtyTiles[(size_t) (tileRow * level.tileColumns + tileColumn)] = 1;
+                tilesRebuilt++;
+            }
+        }
+
+        std::fill(below.dirtyTiles.begin(), below.dirtyTiles.end(), 0);
+    }
+
+    std::fill(levels.back().dirtyTiles.begin(), levels.back().dirtyTiles.end(), 0);
+
+    return tilesRebuilt;
+}
+
+void ActivityPyramid::rebuildTile(int levelIndex, int tileColumn, int tileRow)
+{
+    const Level& below = levels[(size_t) levelIndex - 1];
+    Level& level = levels[(size_t) levelIndex];
+
+    const int firstRow = tileRow * tileSize;
+    const int lastRow = std::min(firstRow + tileSize, level.numRows);
+    const int firstColumn = tileColumn * tileSize;
+    const int lastColumn = std::min(firstColumn + tileSize, level.numColumns);
+
+    for (int row = firstRow; row < lastRow; row++)
+    {
+        for (int column = firstColumn; column < lastColumn; column++)
+        {
+            uint8_t maxIndex = 0;
+            uint32_t sum = 0;
+
+            // cells without electrodes hold zero, so they never raise the max or the sum
+            for (int r = 2 * row; r < std::min(2 * row + 2, below.numRows); r++)
+            {
+                for (int c = 2 * column; c < std::min(2 * column + 2, below.numColumns); c++)
+                {
+                    const size_t source = (size_t) (r * below.numColumns + c);
+
+                    maxIndex = std::max(maxIndex, below.maxIndices[source]);
+                    sum += below.sums[source];
+                }
+            }
+
+            const size_t cell = (size_t) (row * level.numColumns + column);
+            const uint32_t count = level.counts[cell];
+
+            level.maxIndices[cell] = maxIndex;
+            level.sums[cell] = sum;
+            level.meanIndices[cell] = count > 0 ? (uint8_t) ((sum + count / 2) / count) : 0;
+        }
+    }
+}
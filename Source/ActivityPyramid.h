@@ -0,0 +1,125 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __ACTIVITYPYRAMID_H__
+#define __ACTIVITYPYRAMID_H__
+
+#include "ElectrodeLayout.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    Max- and mean-pooled pyramid of colour table indices over a layout's cells,
+    used to draw arrays that are zoomed out beyond one cell per pixel.
+
+    Level 0 holds one cell per layout cell; each further level pools 2x2 cells
+    of the level below, until a single cell remains. The levels are split into
+    square tiles, and an update only rebuilds the tiles whose source cells
+    changed colour, so a quiet array costs little more than the level-0 compare.
+
+    Pooling works on colour indices rather than values: the colour map is
+    monotonic, so the max of indices is the index of the max, and the mean of
+    indices is the mean of the clipped values.
+ */
+class ActivityPyramid
+{
+public:
+    enum class Pooling
+    {
+        MAX,
+        MEAN
+    };
+
+    /** What a cell shows when drawn */
+    enum CellState : uint8_t
+    {
+        BACKGROUND = 0, // no electrodes, left as background
+        UNUSED,         // only disabled or unmapped electrodes
+        ELECTRODE       // at least one drawn electrode
+    };
+
+    /** Cells per side of a tile */
+    static constexpr int tileSize = 16;
+
+    /** The layout must outlive the pyramid */
+    explicit ActivityPyramid(const ElectrodeLayout& layout);
+
+    /** Returns the number of levels a pyramid over a grid of this size has */
+    static int getNumLevels(int numColumns, int numRows);
+
+    int getNumLevels() const { return (int) levels.size(); }
+
+    int getNumColumns(int level) const { return levels[(size_t) level].numColumns; }
+    int getNumRows(int level) const { return levels[(size_t) level].numRows; }
+
+    /** Returns the CellState of each cell of a level, in row-major order */
+    const uint8_t* getCellStates(int level) const { return levels[(size_t) level].states.data(); }
+
+    /** Returns the pooled colour table index of each cell of a level, in row-major order */
+    const uint8_t* getColourIndices(int level, Pooling pooling) const;
+
+    /**
+     *  Maps per-channel values (x * scale + offset) to level 0 and rebuilds
+     *  every tile whose sources changed. Returns the number of tiles rebuilt
+     *  above level 0.
+     */
+    int update(const float* channelValues, int numValues, float scale, float offset = 0.0f);
+
+    /** Makes the next update rebuild every tile */
+    void invalidate() { needsFullRebuild = true; }
+
+private:
+    struct Level
+    {
+        int numColumns;
+        int numRows;
+        int tileColumns;
+        int tileRows;
+
+        std::vector<uint8_t> states;
+        std::vector<uint8_t> maxIndices;
+        std::vector<uint8_t> meanIndices;
+        std::vector<uint32_t> sums;     // sum of level-0 indices under each cell
+        std::vector<uint32_t> counts;   // number of level-0 electrodes under each cell
+        std::vector<uint8_t> dirtyTiles;
+    };
+
+    /** Rebuilds one tile of a level from the level below */
+    void rebuildTile(int level, int tileColumn, int tileRow);
+
+    const ElectrodeLayout& layout;
+
+    std::vector<Level> levels;
+
+    std::vector<float> electrodeValues;
+    std::vector<uint8_t> electrodeIndices;
+
+    bool needsFullRebuild;
+};
+
+}
+
+#endif /* __ACTIVITYPYRAMID_H__ */
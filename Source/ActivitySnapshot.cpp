@@ -0,0 +1,90 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ActivitySnapshot.h"
+
+using namespace GridViewer;
+
+namespace {
+    // indexed by ActivityMetric
+    const MetricRange METRIC_RANGES[numActivityMetrics] = {
+        { "Peak-to-peak", 0.0f, 200.0f },
+        { "RMS", 0.0f, 50.0f },
+        { "Mean", -100.0f, 100.0f },
+        { "Line length", 0.0f, 20.0f },
+        { "Spike rate", 0.0f, 50.0f }
+    };
+}
+
+const MetricRange& GridViewer::getMetricRange(ActivityMetric metric)
+{
+    return METRIC_RANGES[(int) metric];
+}
+
+void ActivitySnapshot::allocate(int numChannels_)
+{
+    frameCounter = 0;
+    sampleTimestamp = 0;
+    numSamples = 0;
+    numChannels = numChannels_;
+
+    for (auto& values : metrics)
+        values.allocate(numChannels);
+}
+
+SnapshotBuffer::SnapshotBuffer()
+    : middleState(1),
+      backIndex(0),
+      frontIndex(2),
+      nextFrameCounter(1)
+{
+}
+
+void SnapshotBuffer::prepare(int numChannels)
+{
+    for (auto& frame : frames)
+        frame.allocate(numChannels);
+
+    middleState.store(1);
+    backIndex = 0;
+    frontIndex = 2;
+    nextFrameCounter = 1;
+}
+
+void SnapshotBuffer::publish(int64_t sampleTimestamp)
+{
+    ActivitySnapshot& frame = frames[backIndex];
+    frame.frameCounter = nextFrameCounter++;
+    frame.sampleTimestamp = sampleTimestamp;
+
+    // hand the finished frame over and take back whichever one was in the middle
+    backIndex = middleState.exchange(backIndex | newFrameFlag, std::memory_order_acq_rel) & indexMask;
+}
+
+const ActivitySnapshot& SnapshotBuffer::getLatestFrame()
+{
+    if (middleState.load(std::memory_order_relaxed) & newFrameFlag)
+        frontIndex = middleState.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+
+    return frames[frontIndex];
+}
@@ -0,0 +1,128 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __ACTIVITYSNAPSHOT_H__
+#define __ACTIVITYSNAPSHOT_H__
+
+#include "AlignedBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace GridViewer {
+
+/** Per-channel quantities computed for every frame */
+enum class ActivityMetric
+{
+    PEAK_TO_PEAK,   // max - min
+    RMS,            // root mean square
+    MEAN,           // mean (DC offset)
+    LINE_LENGTH,    // mean |x[i] - x[i-1]| per sample
+    CROSSING_RATE   // downward threshold crossings per second (spike rate)
+};
+
+static constexpr int numActivityMetrics = 5;
+
+/** Name of a metric and the default range spread over the colour scale */
+struct MetricRange
+{
+    const char* name;
+    float minimum;
+    float maximum;
+};
+
+/** Returns the default colour range of a metric; amplitudes in uV, rates in Hz */
+const MetricRange& getMetricRange(ActivityMetric metric);
+
+/**
+    One completed frame of per-channel statistics.
+ */
+struct ActivitySnapshot
+{
+    /** Incremented on every publish; 0 means nothing has been published yet */
+    uint64_t frameCounter = 0;
+
+    /** Timestamp of the sample following the last one in this frame */
+    int64_t sampleTimestamp = 0;
+
+    /** Number of samples the frame covers, ending at sampleTimestamp */
+    int numSamples = 0;
+
+    int numChannels = 0;
+
+    /** Sizes every metric for a number of channels and clears the frame */
+    void allocate(int numChannels);
+
+    /** Returns the per-channel values of one metric */
+    float* getValues(ActivityMetric metric) { return metrics[(int) metric].get(); }
+    const float* getValues(ActivityMetric metric) const { return metrics[(int) metric].get(); }
+
+    AlignedBuffer<float> metrics[numActivityMetrics];
+};
+
+/**
+    Triple buffer that hands completed snapshots from the audio thread to the
+    message thread.
+
+    The writer always owns one frame and the reader another; the third frame
+    is exchanged with a single atomic swap, so neither side ever waits or
+    sees a partially written frame. There must be exactly one writer and one
+    reader.
+ */
+class SnapshotBuffer
+{
+public:
+    SnapshotBuffer();
+
+    /** Sizes all frames and clears them. Must not be called while either side is active. */
+    void prepare(int numChannels);
+
+    /** Returns the frame the writer may fill (writer side) */
+    ActivitySnapshot& getWriteFrame() { return frames[backIndex]; }
+
+    /** Returns the counter the next published frame will carry (writer side) */
+    uint64_t getNextFrameCounter() const { return nextFrameCounter; }
+
+    /** Stamps and publishes the write frame (writer side) */
+    void publish(int64_t sampleTimestamp);
+
+    /** Returns the newest published frame, or the previous one if nothing new arrived (reader side) */
+    const ActivitySnapshot& getLatestFrame();
+
+private:
+    static constexpr int indexMask = 0x3;
+    static constexpr int newFrameFlag = 0x4;
+
+    ActivitySnapshot frames[3];
+
+    std::atomic<int> middleState;
+
+    int backIndex;
+    int frontIndex;
+
+    uint64_t nextFrameCounter;
+};
+
+}
+
+#endif /* __ACTIVITYSNAPSHOT_H__ */
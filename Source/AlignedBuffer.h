@@ -0,0 +1,113 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __ALIGNEDBUFFER_H__
+#define __ALIGNEDBUFFER_H__
+
+#include <cstddef>
+#include <new>
+#include <algorithm>
+
+namespace GridViewer {
+
+/**
+    Fixed-size heap array aligned to a cache line.
+
+    Used for the per-channel structure-of-arrays storage on the audio thread,
+    so that vector loads never straddle a cache line and two arrays never
+    share one.
+ */
+template <typename T, std::size_t Alignment = 64>
+class AlignedBuffer
+{
+public:
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(std::size_t numElements) { allocate(numElements); }
+
+    ~AlignedBuffer() { release(); }
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : data(other.data), numElements(other.numElements)
+    {
+        other.data = nullptr;
+        other.numElements = 0;
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            data = other.data;
+            numElements = other.numElements;
+            other.data = nullptr;
+            other.numElements = 0;
+        }
+        return *this;
+    }
+
+    /** Reallocates the buffer; previous contents are discarded */
+    void allocate(std::size_t newNumElements)
+    {
+        release();
+
+        if (newNumElements > 0)
+        {
+            data = static_cast<T*>(::operator new(newNumElements * sizeof(T), std::align_val_t(Alignment)));
+            numElements = newNumElements;
+            std::fill(data, data + numElements, T());
+        }
+    }
+
+    /** Sets every element to the given value */
+    void fill(T value) { std::fill(data, data + numElements, value); }
+
+    T* get() noexcept { return data; }
+    const T* get() const noexcept { return data; }
+
+    T& operator[](std::size_t i) noexcept { return data[i]; }
+    const T& operator[](std::size_t i) const noexcept { return data[i]; }
+
+    std::size_t size() const noexcept { return numElements; }
+
+private:
+    void release()
+    {
+        if (data != nullptr)
+            ::operator delete(data, std::align_val_t(Alignment));
+
+        data = nullptr;
+        numElements = 0;
+    }
+
+    T* data = nullptr;
+    std::size_t numElements = 0;
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+};
+
+}
+
+#endif /* __ALIGNEDBUFFER_H__ */
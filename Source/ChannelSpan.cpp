@@ -0,0 +1,53 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ChannelSpan.h"
+
+#include <cstddef>
+
+using namespace GridViewer;
+
+std::vector<ChannelSpan> ChannelSpan::fromBufferChannels(const std::vector<int>& bufferChannels)
+{
+    std::vector<ChannelSpan> spans;
+
+    for (int localChannel = 0; localChannel < (int) bufferChannels.size(); localChannel++)
+    {
+        const int bufferChannel = bufferChannels[(size_t) localChannel];
+
+        if (! spans.empty())
+        {
+            ChannelSpan& last = spans.back();
+
+            if (bufferChannel == last.firstBufferChannel + last.numChannels)
+            {
+                last.numChannels++;
+                continue;
+            }
+        }
+
+        spans.push_back({ bufferChannel, localChannel, 1 });
+    }
+
+    return spans;
+}
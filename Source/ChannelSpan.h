@@ -0,0 +1,52 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __CHANNELSPAN_H__
+#define __CHANNELSPAN_H__
+
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    A run of consecutive buffer channels that belong to one stream and have
+    consecutive indices within it. Built when the settings change, so the
+    audio thread walks a short list of spans instead of resolving channel
+    metadata on every block.
+ */
+struct ChannelSpan
+{
+    int firstBufferChannel;  // index of the first channel in the processor's buffer
+    int firstLocalChannel;   // index of the first channel within its stream
+    int numChannels;
+
+    /**
+     *  Collapses the buffer indices of a stream's channels, in stream order,
+     *  into spans of consecutive indices.
+     */
+    static std::vector<ChannelSpan> fromBufferChannels(const std::vector<int>& bufferChannels);
+};
+
+}
+
+#endif /* __CHANNELSPAN_H__ */
@@ -0,0 +1,384 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ColourMaps.h"
+
+#include "CpuFeatures.h"
+
+#if GRIDVIEWER_X86
+ #include <immintrin.h>
+#endif
+
+using namespace GridViewer;
+
+#pragma mark - Colour tables -
+namespace {
+
+// the 256-entry matplotlib maps, as 0xAARRGGBB
+
+const uint32_t infernoTable[ColourMaps::tableSize] =
+{
+    0xff000004, 0xff010005, 0xff010106, 0xff010108, 0xff02010a, 0xff02020c, 0xff02020e, 0xff030210,
+    0xff040312, 0xff040314, 0xff050417, 0xff060419, 0xff07051b, 0xff08051d, 0xff09061f, 0xff0a0722,
+    0xff0b0724, 0xff0c0826, 0xff0d0829, 0xff0e092b, 0xff10092d, 0xff110a30, 0xff120a32, 0xff140b34,
+    0xff150b37, 0xff160b39, 0xff180c3c, 0xff190c3e, 0xff1b0c41, 0xff1c0c43, 0xff1e0c45, 0xff1f0c48,
+    0xff210c4a, 0xff230c4c, 0xff240c4f, 0xff260c51, 0xff280b53, 0xff290b55, 0xff2b0b57, 0xff2d0b59,
+    0xff2f0a5b, 0xff310a5c, 0xff320a5e, 0xff340a5f, 0xff360961, 0xff380962, 0xff390963, 0xff3b0964,
+    0xff3d0965, 0xff3e0966, 0xff400a67, 0xff420a68, 0xff440a68, 0xff450a69, 0xff470b6a, 0xff490b6a,
+    0xff4a0c6b, 0xff4c0c6b, 0xff4d0d6c, 0xff4f0d6c, 0xff510e6c, 0xff520e6d, 0xff540f6d, 0xff550f6d,
+    0xff57106e, 0xff59106e, 0xff5a116e, 0xff5c126e, 0xff5d126e, 0xff5f136e, 0xff61136e, 0xff62146e,
+    0xff64156e, 0xff65156e, 0xff67166e, 0xff69166e, 0xff6a176e, 0xff6c186e, 0xff6d186e, 0xff6f196e,
+    0xff71196e, 0xff721a6e, 0xff741a6e, 0xff751b6e, 0xff771c6d, 0xff781c6d, 0xff7a1d6d, 0xff7c1d6d,
+    0xff7d1e6d, 0xff7f1e6c, 0xff801f6c, 0xff82206c, 0xff84206b, 0xff85216b, 0xff87216b, 0xff88226a,
+    0xff8a226a, 0xff8c2369, 0xff8d2369, 0xff8f2469, 0xff902568, 0xff922568, 0xff932667, 0xff952667,
+    0xff972766, 0xff982766, 0xff9a2865, 0xff9b2964, 0xff9d2964, 0xff9f2a63, 0xffa02a63, 0xffa22b62,
+    0xffa32c61, 0xffa52c60, 0xffa62d60, 0xffa82e5f, 0xffa92e5e, 0xffab2f5e, 0xffad305d, 0xffae305c,
+    0xffb0315b, 0xffb1325a, 0xffb3325a, 0xffb43359, 0xffb63458, 0xffb73557, 0xffb93556, 0xffba3655,
+    0xffbc3754, 0xffbd3853, 0xffbf3952, 0xffc03a51, 0xffc13a50, 0xffc33b4f, 0xffc43c4e, 0xffc63d4d,
+    0xffc73e4c, 0xffc83f4b, 0xffca404a, 0xffcb4149, 0xffcc4248, 0xffce4347, 0xffcf4446, 0xffd04545,
+    0xffd24644, 0xffd34743, 0xffd44842, 0xffd54a41, 0xffd74b3f, 0xffd84c3e, 0xffd94d3d, 0xffda4e3c,
+    0xffdb503b, 0xffdd513a, 0xffde5238, 0xffdf5337, 0xffe05536, 0xffe15635, 0xffe25734, 0xffe35933,
+    0xffe45a31, 0xffe55c30, 0xffe65d2f, 0xffe75e2e, 0xffe8602d, 0xffe9612b, 0xffea632a, 0xffeb6429,
+    0xffeb6628, 0xffec6726, 0xffed6925, 0xffee6a24, 0xffef6c23, 0xffef6e21, 0xfff06f20, 0xfff1711f,
+    0xfff1731d, 0xfff2741c, 0xfff3761b, 0xfff37819, 0xfff47918, 0xfff57b17, 0xfff57d15, 0xfff67e14,
+    0xfff68013, 0xfff78212, 0xfff78410, 0xfff8850f, 0xfff8870e, 0xfff8890c, 0xfff98b0b, 0xfff98c0a,
+    0xfff98e09, 0xfffa9008, 0xfffa9207, 0xfffa9407, 0xfffb9606, 0xfffb9706, 0xfffb9906, 0xfffb9b06,
+    0xfffb9d07, 0xfffc9f07, 0xfffca108, 0xfffca309, 0xfffca50a, 0xfffca60c, 0xfffca80d, 0xfffcaa0f,
+    0xfffcac11, 0xfffcae12, 0xfffcb014, 0xfffcb216, 0xfffcb418, 0xfffbb61a, 0xfffbb81d, 0xfffbba1f,
+    0xfffbbc21, 0xfffbbe23, 0xfffac026, 0xfffac228, 0xfffac42a, 0xfffac62d, 0xfff9c72f, 0xfff9c932,
+    0xfff9cb35, 0xfff8cd37, 0xfff8cf3a, 0xfff7d13d, 0xfff7d340, 0xfff6d543, 0xfff6d746, 0xfff5d949,
+    0xfff5db4c, 0xfff4dd4f, 0xfff4df53, 0xfff4e156, 0xfff3e35a, 0xfff3e55d, 0xfff2e661, 0xfff2e865,
+    0xfff2ea69, 0xfff1ec6d, 0xfff1ed71, 0xfff1ef75, 0xfff1f179, 0xfff2f27d, 0xfff2f482, 0xfff3f586,
+    0xfff3f68a, 0xfff4f88e, 0xfff5f992, 0xfff6fa96, 0xfff8fb9a, 0xfff9fc9d, 0xfffafda1, 0xfffcffa4
+};
+
+const uint32_t magmaTable[ColourMaps::tableSize] =
+{
+    0xff000004, 0xff010005, 0xff010106, 0xff010108, 0xff020109, 0xff02020b, 0xff02020d, 0xff03030f,
+    0xff030312, 0xff040414, 0xff050416, 0xff060518, 0xff06051a, 0xff07061c, 0xff08071e, 0xff090720,
+    0xff0a0822, 0xff0b0924, 0xff0c0926, 0xff0d0a29, 0xff0e0b2b, 0xff100b2d, 0xff110c2f, 0xff120d31,
+    0xff130d34, 0xff140e36, 0xff150e38, 0xff160f3b, 0xff180f3d, 0xff19103f, 0xff1a1042, 0xff1c1044,
+    0xff1d1147, 0xff1e1149, 0xff20114b, 0xff21114e, 0xff221150, 0xff241253, 0xff251255, 0xff271258,
+    0xff29115a, 0xff2a115c, 0xff2c115f, 0xff2d1161, 0xff2f1163, 0xff311165, 0xff331067, 0xff341069,
+    0xff36106b, 0xff38106c, 0xff390f6e, 0xff3b0f70, 0xff3d0f71, 0xff3f0f72, 0xff400f74, 0xff420f75,
+    0xff440f76, 0xff451077, 0xff471078, 0xff491078, 0xff4a1079, 0xff4c117a, 0xff4e117b, 0xff4f127b,
+    0xff51127c, 0xff52137c, 0xff54137d, 0xff56147d, 0xff57157e, 0xff59157e, 0xff5a167e, 0xff5c167f,
+    0xff5d177f, 0xff5f187f, 0xff601880, 0xff621980, 0xff641a80, 0xff651a80, 0xff671b80, 0xff681c81,
+    0xff6a1c81, 0xff6b1d81, 0xff6d1d81, 0xff6e1e81, 0xff701f81, 0xff721f81, 0xff732081, 0xff752181,
+    0xff762181, 0xff782281, 0xff792282, 0xff7b2382, 0xff7c2382, 0xff7e2482, 0xff802582, 0xff812581,
+    0xff832681, 0xff842681, 0xff862781, 0xff882781, 0xff892881, 0xff8b2981, 0xff8c2981, 0xff8e2a81,
+    0xff902a81, 0xff912b81, 0xff932b80, 0xff942c80, 0xff962c80, 0xff982d80, 0xff992d80, 0xff9b2e7f,
+    0xff9c2e7f, 0xff9e2f7f, 0xffa02f7f, 0xffa1307e, 0xffa3307e, 0xffa5317e, 0xffa6317d, 0xffa8327d,
+    0xffaa337d, 0xffab337c, 0xffad347c, 0xffae347b, 0xffb0357b, 0xffb2357b, 0xffb3367a, 0xffb5367a,
+    0xffb73779, 0xffb83779, 0xffba3878, 0xffbc3978, 0xffbd3977, 0xffbf3a77, 0xffc03a76, 0xffc23b75,
+    0xffc43c75, 0xffc53c74, 0xffc73d73, 0xffc83e73, 0xffca3e72, 0xffcc3f71, 0xffcd4071, 0xffcf4070,
+    0xffd0416f, 0xffd2426f, 0xffd3436e, 0xffd5446d, 0xffd6456c, 0xffd8456c, 0xffd9466b, 0xffdb476a,
+    0xffdc4869, 0xffde4968, 0xffdf4a68, 0xffe04c67, 0xffe24d66, 0xffe34e65, 0xffe44f64, 0xffe55064,
+    0xffe75263, 0xffe85362, 0xffe95462, 0xffea5661, 0xffeb5760, 0xffec5860, 0xffed5a5f, 0xffee5b5e,
+    0xffef5d5e, 0xfff05f5e, 0xfff1605d, 0xfff2625d, 0xfff2645c, 0xfff3655c, 0xfff4675c, 0xfff4695c,
+    0xfff56b5c, 0xfff66c5c, 0xfff66e5c, 0xfff7705c, 0xfff7725c, 0xfff8745c, 0xfff8765c, 0xfff9785d,
+    0xfff9795d, 0xfff97b5d, 0xfffa7d5e, 0xfffa7f5e, 0xfffa815f, 0xfffb835f, 0xfffb8560, 0xfffb8761,
+    0xfffc8961, 0xfffc8a62, 0xfffc8c63, 0xfffc8e64, 0xfffc9065, 0xfffd9266, 0xfffd9467, 0xfffd9668,
+    0xfffd9869, 0xfffd9a6a, 0xfffd9b6b, 0xfffe9d6c, 0xfffe9f6d, 0xfffea16e, 0xfffea36f, 0xfffea571,
+    0xfffea772, 0xfffea973, 0xfffeaa74, 0xfffeac76, 0xfffeae77, 0xfffeb078, 0xfffeb27a, 0xfffeb47b,
+    0xfffeb67c, 0xfffeb77e, 0xfffeb97f, 0xfffebb81, 0xfffebd82, 0xfffebf84, 0xfffec185, 0xfffec287,
+    0xfffec488, 0xfffec68a, 0xfffec88c, 0xfffeca8d, 0xfffecc8f, 0xfffecd90, 0xfffecf92, 0xfffed194,
+    0xfffed395, 0xfffed597, 0xfffed799, 0xfffed89a, 0xfffdda9c, 0xfffddc9e, 0xfffddea0, 0xfffde0a1,
+    0xfffde2a3, 0xfffde3a5, 0xfffde5a7, 0xfffde7a9, 0xfffde9aa, 0xfffdebac, 0xfffcecae, 0xfffceeb0,
+    0xfffcf0b2, 0xfffcf2b4, 0xfffcf4b6, 0xfffcf6b8, 0xfffcf7b9, 0xfffcf9bb, 0xfffcfbbd, 0xfffcfdbf
+};
+
+const uint32_t plasmaTable[ColourMaps::tableSize] =
+{
+    0xff0d0887, 0xff100788, 0xff130789, 0xff16078a, 0xff19068c, 0xff1b068d, 0xff1d068e, 0xff20068f,
+    0xff220690, 0xff240691, 0xff260591, 0xff280592, 0xff2a0593, 0xff2c0594, 0xff2e0595, 0xff2f0596,
+    0xff310597, 0xff330597, 0xff350498, 0xff370499, 0xff38049a, 0xff3a049a, 0xff3c049b, 0xff3e049c,
+    0xff3f049c, 0xff41049d, 0xff43039e, 0xff44039e, 0xff46039f, 0xff48039f, 0xff4903a0, 0xff4b03a1,
+    0xff4c02a1, 0xff4e02a2, 0xff5002a2, 0xff5102a3, 0xff5302a3, 0xff5502a4, 0xff5601a4, 0xff5801a4,
+    0xff5901a5, 0xff5b01a5, 0xff5c01a6, 0xff5e01a6, 0xff6001a6, 0xff6100a7, 0xff6300a7, 0xff6400a7,
+    0xff6600a7, 0xff6700a8, 0xff6900a8, 0xff6a00a8, 0xff6c00a8, 0xff6e00a8, 0xff6f00a8, 0xff7100a8,
+    0xff7201a8, 0xff7401a8, 0xff7501a8, 0xff7701a8, 0xff7801a8, 0xff7a02a8, 0xff7b02a8, 0xff7d03a8,
+    0xff7e03a8, 0xff8004a8, 0xff8104a7, 0xff8305a7, 0xff8405a7, 0xff8606a6, 0xff8707a6, 0xff8808a6,
+    0xff8a09a5, 0xff8b0aa5, 0xff8d0ba5, 0xff8e0ca4, 0xff8f0da4, 0xff910ea3, 0xff920fa3, 0xff9410a2,
+    0xff9511a1, 0xff9613a1, 0xff9814a0, 0xff99159f, 0xff9a169f, 0xff9c179e, 0xff9d189d, 0xff9e199d,
+    0xffa01a9c, 0xffa11b9b, 0xffa21d9a, 0xffa31e9a, 0xffa51f99, 0xffa62098, 0xffa72197, 0xffa82296,
+    0xffaa2395, 0xffab2494, 0xffac2694, 0xffad2793, 0xffae2892, 0xffb02991, 0xffb12a90, 0xffb22b8f,
+    0xffb32c8e, 0xffb42e8d, 0xffb52f8c, 0xffb6308b, 0xffb7318a, 0xffb83289, 0xffba3388, 0xffbb3488,
+    0xffbc3587, 0xffbd3786, 0xffbe3885, 0xffbf3984, 0xffc03a83, 0xffc13b82, 0xffc23c81, 0xffc33d80,
+    0xffc43e7f, 0xffc5407e, 0xffc6417d, 0xffc7427c, 0xffc8437b, 0xffc9447a, 0xffca457a, 0xffcb4679,
+    0xffcc4778, 0xffcc4977, 0xffcd4a76, 0xffce4b75, 0xffcf4c74, 0xffd04d73, 0xffd14e72, 0xffd24f71,
+    0xffd35171, 0xffd45270, 0xffd5536f, 0xffd5546e, 0xffd6556d, 0xffd7566c, 0xffd8576b, 0xffd9586a,
+    0xffda5a6a, 0xffda5b69, 0xffdb5c68, 0xffdc5d67, 0xffdd5e66, 0xffde5f65, 0xffde6164, 0xffdf6263,
+    0xffe06363, 0xffe16462, 0xffe26561, 0xffe26660, 0xffe3685f, 0xffe4695e, 0xffe56a5d, 0xffe56b5d,
+    0xffe66c5c, 0xffe76e5b, 0xffe76f5a, 0xffe87059, 0xffe97158, 0xffe97257, 0xffea7457, 0xffeb7556,
+    0xffeb7655, 0xffec7754, 0xffed7953, 0xffed7a52, 0xffee7b51, 0xffef7c51, 0xffef7e50, 0xfff07f4f,
+    0xfff0804e, 0xfff1814d, 0xfff1834c, 0xfff2844b, 0xfff3854b, 0xfff3874a, 0xfff48849, 0xfff48948,
+    0xfff58b47, 0xfff58c46, 0xfff68d45, 0xfff68f44, 0xfff79044, 0xfff79143, 0xfff79342, 0xfff89441,
+    0xfff89540, 0xfff9973f, 0xfff9983e, 0xfff99a3e, 0xfffa9b3d, 0xfffa9c3c, 0xfffa9e3b, 0xfffb9f3a,
+    0xfffba139, 0xfffba238, 0xfffca338, 0xfffca537, 0xfffca636, 0xfffca835, 0xfffca934, 0xfffdab33,
+    0xfffdac33, 0xfffdae32, 0xfffdaf31, 0xfffdb130, 0xfffdb22f, 0xfffdb42f, 0xfffdb52e, 0xfffeb72d,
+    0xfffeb82c, 0xfffeba2c, 0xfffebb2b, 0xfffebd2a, 0xfffebe2a, 0xfffec029, 0xfffdc229, 0xfffdc328,
+    0xfffdc527, 0xfffdc627, 0xfffdc827, 0xfffdca26, 0xfffdcb26, 0xfffccd25, 0xfffcce25, 0xfffcd025,
+    0xfffcd225, 0xfffbd324, 0xfffbd524, 0xfffbd724, 0xfffad824, 0xfffada24, 0xfff9dc24, 0xfff9dd25,
+    0xfff8df25, 0xfff8e125, 0xfff7e225, 0xfff7e425, 0xfff6e626, 0xfff6e826, 0xfff5e926, 0xfff5eb27,
+    0xfff4ed27, 0xfff3ee27, 0xfff3f027, 0xfff2f227, 0xfff1f426, 0xfff1f525, 0xfff0f724, 0xfff0f921
+};
+
+const uint32_t viridisTable[ColourMaps::tableSize] =
+{
+    0xff440154, 0xff440256, 0xff450457, 0xff450559, 0xff46075a, 0xff46085c, 0xff460a5d, 0xff460b5e,
+    0xff470d60, 0xff470e61, 0xff471063, 0xff471164, 0xff471365, 0xff481467, 0xff481668, 0xff481769,
+    0xff48186a, 0xff481a6c, 0xff481b6d, 0xff481c6e, 0xff481d6f, 0xff481f70, 0xff482071, 0xff482173,
+    0xff482374, 0xff482475, 0xff482576, 0xff482677, 0xff482878, 0xff482979, 0xff472a7a, 0xff472c7a,
+    0xff472d7b, 0xff472e7c, 0xff472f7d, 0xff46307e, 0xff46327e, 0xff46337f, 0xff463480, 0xff453581,
+    0xff453781, 0xff453882, 0xff443983, 0xff443a83, 0xff443b84, 0xff433d84, 0xff433e85, 0xff423f85,
+    0xff424086, 0xff424186, 0xff414287, 0xff414487, 0xff404588, 0xff404688, 0xff3f4788, 0xff3f4889,
+    0xff3e4989, 0xff3e4a89, 0xff3e4c8a, 0xff3d4d8a, 0xff3d4e8a, 0xff3c4f8a, 0xff3c508b, 0xff3b518b,
+    0xff3b528b, 0xff3a538b, 0xff3a548c, 0xff39558c, 0xff39568c, 0xff38588c, 0xff38598c, 0xff375a8c,
+    0xff375b8d, 0xff365c8d, 0xff365d8d, 0xff355e8d, 0xff355f8d, 0xff34608d, 0xff34618d, 0xff33628d,
+    0xff33638d, 0xff32648e, 0xff32658e, 0xff31668e, 0xff31678e, 0xff31688e, 0xff30698e, 0xff306a8e,
+    0xff2f6b8e, 0xff2f6c8e, 0xff2e6d8e, 0xff2e6e8e, 0xff2e6f8e, 0xff2d708e, 0xff2d718e, 0xff2c718e,
+    0xff2c728e, 0xff2c738e, 0xff2b748e, 0xff2b758e, 0xff2a768e, 0xff2a778e, 0xff2a788e, 0xff29798e,
+    0xff297a8e, 0xff297b8e, 0xff287c8e, 0xff287d8e, 0xff277e8e, 0xff277f8e, 0xff27808e, 0xff26818e,
+    0xff26828e, 0xff26828e, 0xff25838e, 0xff25848e, 0xff25858e, 0xff24868e, 0xff24878e, 0xff23888e,
+    0xff23898e, 0xff238a8d, 0xff228b8d, 0xff228c8d, 0xff228d8d, 0xff218e8d, 0xff218f8d, 0xff21908d,
+    0xff21918c, 0xff20928c, 0xff20928c, 0xff20938c, 0xff1f948c, 0xff1f958b, 0xff1f968b, 0xff1f978b,
+    0xff1f988b, 0xff1f998a, 0xff1f9a8a, 0xff1e9b8a, 0xff1e9c89, 0xff1e9d89, 0xff1f9e89, 0xff1f9f88,
+    0xff1fa088, 0xff1fa188, 0xff1fa187, 0xff1fa287, 0xff20a386, 0xff20a486, 0xff21a585, 0xff21a685,
+    0xff22a785, 0xff22a884, 0xff23a983, 0xff24aa83, 0xff25ab82, 0xff25ac82, 0xff26ad81, 0xff27ad81,
+    0xff28ae80, 0xff29af7f, 0xff2ab07f, 0xff2cb17e, 0xff2db27d, 0xff2eb37c, 0xff2fb47c, 0xff31b57b,
+    0xff32b67a, 0xff34b679, 0xff35b779, 0xff37b878, 0xff38b977, 0xff3aba76, 0xff3bbb75, 0xff3dbc74,
+    0xff3fbc73, 0xff40bd72, 0xff42be71, 0xff44bf70, 0xff46c06f, 0xff48c16e, 0xff4ac16d, 0xff4cc26c,
+    0xff4ec36b, 0xff50c46a, 0xff52c569, 0xff54c568, 0xff56c667, 0xff58c765, 0xff5ac864, 0xff5cc863,
+    0xff5ec962, 0xff60ca60, 0xff63cb5f, 0xff65cb5e, 0xff67cc5c, 0xff69cd5b, 0xff6ccd5a, 0xff6ece58,
+    0xff70cf57, 0xff73d056, 0xff75d054, 0xff77d153, 0xff7ad151, 0xff7cd250, 0xff7fd34e, 0xff81d34d,
+    0xff84d44b, 0xff86d549, 0xff89d548, 0xff8bd646, 0xff8ed645, 0xff90d743, 0xff93d741, 0xff95d840,
+    0xff98d83e, 0xff9bd93c, 0xff9dd93b, 0xffa0da39, 0xffa2da37, 0xffa5db36, 0xffa8db34, 0xffaadc32,
+    0xffaddc30, 0xffb0dd2f, 0xffb2dd2d, 0xffb5de2b, 0xffb8de29, 0xffbade28, 0xffbddf26, 0xffc0df25,
+    0xffc2df23, 0xffc5e021, 0xffc8e020, 0xffcae11f, 0xffcde11d, 0xffd0e11c, 0xffd2e21b, 0xffd5e21a,
+    0xffd8e219, 0xffdae319, 0xffdde318, 0xffdfe318, 0xffe2e418, 0xffe5e419, 0xffe7e419, 0xffeae51a,
+    0xffece51b, 0xffefe51c, 0xfff1e51d, 0xfff4e61e, 0xfff6e620, 0xfff8e621, 0xfffbe723, 0xfffde725
+};
+
+const uint32_t jetTable[ColourMaps::tableSize] =
+{
+    0xff000080, 0xff000084, 0xff000089, 0xff00008d, 0xff000092, 0xff000096, 0xff00009b, 0xff00009f,
+    0xff0000a4, 0xff0000a8, 0xff0000ad, 0xff0000b2, 0xff0000b6, 0xff0000bb, 0xff0000bf, 0xff0000c4,
+    0xff0000c8, 0xff0000cd, 0xff0000d1, 0xff0000d6, 0xff0000da, 0xff0000df, 0xff0000e3, 0xff0000e8,
+    0xff0000ed, 0xff0000f1, 0xff0000f6, 0xff0000fa, 0xff0000ff, 0xff0000ff, 0xff0000ff, 0xff0000ff,
+    0xff0000ff, 0xff0004ff, 0xff0008ff, 0xff000cff, 0xff0010ff, 0xff0014ff, 0xff0018ff, 0xff001cff,
+    0xff0020ff, 0xff0024ff, 0xff0028ff, 0xff002cff, 0xff0030ff, 0xff0034ff, 0xff0038ff, 0xff003cff,
+    0xff0040ff, 0xff0044ff, 0xff0048ff, 0xff004cff, 0xff0050ff, 0xff0054ff, 0xff0058ff, 0xff005cff,
+    0xff0060ff, 0xff0064ff, 0xff0068ff, 0xff006cff, 0xff0070ff, 0xff0074ff, 0xff0078ff, 0xff007cff,
+    0xff0080ff, 0xff0084ff, 0xff0088ff, 0xff008cff, 0xff0090ff, 0xff0094ff, 0xff0098ff, 0xff009cff,
+    0xff00a0ff, 0xff00a4ff, 0xff00a8ff, 0xff00acff, 0xff00b0ff, 0xff00b4ff, 0xff00b8ff, 0xff00bcff,
+    0xff00c0ff, 0xff00c4ff, 0xff00c8ff, 0xff00ccff, 0xff00d0ff, 0xff00d4ff, 0xff00d8ff, 0xff00dcfe,
+    0xff00e0fb, 0xff00e4f8, 0xff02e8f4, 0xff06ecf1, 0xff09f0ee, 0xff0cf4eb, 0xff0ff8e7, 0xff13fce4,
+    0xff16ffe1, 0xff19ffde, 0xff1cffdb, 0xff1fffd7, 0xff23ffd4, 0xff26ffd1, 0xff29ffce, 0xff2cffca,
+    0xff30ffc7, 0xff33ffc4, 0xff36ffc1, 0xff39ffbe, 0xff3cffba, 0xff40ffb7, 0xff43ffb4, 0xff46ffb1,
+    0xff49ffad, 0xff4dffaa, 0xff50ffa7, 0xff53ffa4, 0xff56ffa0, 0xff5aff9d, 0xff5dff9a, 0xff60ff97,
+    0xff63ff94, 0xff66ff90, 0xff6aff8d, 0xff6dff8a, 0xff70ff87, 0xff73ff83, 0xff77ff80, 0xff7aff7d,
+    0xff7dff7a, 0xff80ff77, 0xff83ff73, 0xff87ff70, 0xff8aff6d, 0xff8dff6a, 0xff90ff66, 0xff94ff63,
+    0xff97ff60, 0xff9aff5d, 0xff9dff5a, 0xffa0ff56, 0xffa4ff53, 0xffa7ff50, 0xffaaff4d, 0xffadff49,
+    0xffb1ff46, 0xffb4ff43, 0xffb7ff40, 0xffbaff3c, 0xffbeff39, 0xffc1ff36, 0xffc4ff33, 0xffc7ff30,
+    0xffcaff2c, 0xffceff29, 0xffd1ff26, 0xffd4ff23, 0xffd7ff1f, 0xffdbff1c, 0xffdeff19, 0xffe1ff16,
+    0xffe4ff13, 0xffe7ff0f, 0xffebff0c, 0xffeeff09, 0xfff1fc06, 0xfff4f802, 0xfff8f500, 0xfffbf100,
+    0xfffeed00, 0xffffea00, 0xffffe600, 0xffffe200, 0xffffde00, 0xffffdb00, 0xffffd700, 0xffffd300,
+    0xffffd000, 0xffffcc00, 0xffffc800, 0xffffc400, 0xffffc100, 0xffffbd00, 0xffffb900, 0xffffb600,
+    0xffffb200, 0xffffae00, 0xffffab00, 0xffffa700, 0xffffa300, 0xffff9f00, 0xffff9c00, 0xffff9800,
+    0xffff9400, 0xffff9100, 0xffff8d00, 0xffff8900, 0xffff8600, 0xffff8200, 0xffff7e00, 0xffff7a00,
+    0xffff7700, 0xffff7300, 0xffff6f00, 0xffff6c00, 0xffff6800, 0xffff6400, 0xffff6000, 0xffff5d00,
+    0xffff5900, 0xffff5500, 0xffff5200, 0xffff4e00, 0xffff4a00, 0xffff4700, 0xffff4300, 0xffff3f00,
+    0xffff3b00, 0xffff3800, 0xffff3400, 0xffff3000, 0xffff2d00, 0xffff2900, 0xffff2500, 0xffff2200,
+    0xffff1e00, 0xffff1a00, 0xffff1600, 0xffff1300, 0xfffa0f00, 0xfff60b00, 0xfff10800, 0xffed0400,
+    0xffe80000, 0xffe40000, 0xffdf0000, 0xffda0000, 0xffd60000, 0xffd10000, 0xffcd0000, 0xffc80000,
+    0xffc40000, 0xffbf0000, 0xffbb0000, 0xffb60000, 0xffb20000, 0xffad0000, 0xffa80000, 0xffa40000,
+    0xff9f0000, 0xff9b0000, 0xff960000, 0xff920000, 0xff8d0000, 0xff890000, 0xff840000, 0xff800000
+};
+
+#pragma mark - Batch mapping kernels -
+typedef void (*MapIndicesFunction)(const float*, uint8_t*, int, float, float);
+typedef void (*MapValuesFunction)(const float*, uint32_t*, int, const uint32_t*, float);
+
+void mapIndicesScalar(const float* in, uint8_t* out, int n, float scale, float offset)
+{
+    const float tableScale = scale * (float) ColourMaps::tableSize;
+    const float tableOffset = offset * (float) ColourMaps::tableSize;
+
+    for (int i = 0; i < n; i++)
+        out[i] = (uint8_t) ColourMaps::getIndexForTablePosition(in[i] * tableScale + tableOffset);
+}
+
+void mapValuesScalar(const float* in, uint32_t* out, int n, const uint32_t* table, float scale)
+{
+    const float tableScale = scale * (float) ColourMaps::tableSize;
+
+    for (int i = 0; i < n; i++)
+        out[i] = table[ColourMaps::getIndexForTablePosition(in[i] * tableScale)];
+}
+
+#if GRIDVIEWER_X86
+
+/** Scales and offsets four values to table positions; NaN and negative positions land on 0 */
+__m128i indicesSse2(const float* in, __m128 scale, __m128 offset)
+{
+    const __m128 scaled = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in), scale), offset);
+
+    // max(NaN, 0) returns the second operand, so NaN maps to the first entry
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()),
+                                      _mm_set1_ps((float) (ColourMaps::tableSize - 1)));
+
+    return _mm_cvttps_epi32(clamped);
+}
+
+void mapIndicesSse2(const float* in, uint8_t* out, int n, float scale, float offset)
+{
+    const __m128 tableScale = _mm_set1_ps(scale * (float) ColourMaps::tableSize);
+    const __m128 tableOffset = _mm_set1_ps(offset * (float) ColourMaps::tableSize);
+
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i a = indicesSse2(in + i, tableScale, tableOffset);
+        const __m128i b = indicesSse2(in + i + 4, tableScale, tableOffset);
+        const __m128i c = indicesSse2(in + i + 8, tableScale, tableOffset);
+        const __m128i d = indicesSse2(in + i + 12, tableScale, tableOffset);
+
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i*) (out + i), packed);
+    }
+
+    mapIndicesScalar(in + i, out + i, n - i, scale, offset);
+}
+
+void mapValuesSse2(const float* in, uint32_t* out, int n, const uint32_t* table, float scale)
+{
+    const __m128 tableScale = _mm_set1_ps(scale * (float) ColourMaps::tableSize);
+
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        alignas(16) int32_t index[4];
+        _mm_store_si128((__m128i*) index, indicesSse2(in + i, tableScale, _mm_setzero_ps()));
+
+        out[i] = table[index[0]];
+        out[i + 1] = table[index[1]];
+        out[i + 2] = table[index[2]];
+        out[i + 3] = table[index[3]];
+    }
+
+    mapValuesScalar(in + i, out + i, n - i, table, scale);
+}
+
+GRIDVIEWER_TARGET("avx2")
+void mapValuesAvx2(const float* in, uint32_t* out, int n, const uint32_t* table, float scale)
+{
+    const __m256 tableScale = _mm256_set1_ps(scale * (float) ColourMaps::tableSize);
+    const __m256 lastEntry = _mm256_set1_ps((float) (ColourMaps::tableSize - 1));
+
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 scaled = _mm256_mul_ps(_mm256_loadu_ps(in + i), tableScale);
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), lastEntry);
+        const __m256i index = _mm256_cvttps_epi32(clamped);
+
+        const __m256i colours = _mm256_i32gather_epi32((const int*) table, index, 4);
+        _mm256_storeu_si256((__m256i*) (out + i), colours);
+    }
+
+    mapValuesScalar(in + i, out + i, n - i, table, scale);
+}
+
+#endif
+
+struct Dispatch
+{
+    Dispatch()
+    {
+        mapIndices = mapIndicesScalar;
+        mapValues = mapValuesScalar;
+
+#if GRIDVIEWER_X86
+        const SimdLevel level = CpuFeatures::getSimdLevel();
+
+        if (level >= SimdLevel::SSE2)
+        {
+            mapIndices = mapIndicesSse2;
+            mapValues = mapValuesSse2;
+        }
+
+        if (level >= SimdLevel::AVX2)
+            mapValues = mapValuesAvx2;
+#endif
+    }
+
+    MapIndicesFunction mapIndices;
+    MapValuesFunction mapValues;
+};
+
+Dispatch& getDispatch()
+{
+    static Dispatch dispatch;
+
+    return dispatch;
+}
+
+}
+
+#pragma mark - ColourMaps interface methods -
+const uint32_t* ColourMaps::getTable(ColourSchemeId colourScheme)
+{
+    switch (colourScheme)
+    {
+        case ColourSchemeId::INFERNO:
+            return infernoTable;
+
+        case ColourSchemeId::MAGMA:
+            return magmaTable;
+
+        case ColourSchemeId::PLASMA:
+            return plasmaTable;
+
+        case ColourSchemeId::VIRIDIS:
+            return viridisTable;
+
+        case ColourSchemeId::JET:
+            return jetTable;
+    }
+
+    return infernoTable;
+}
+
+void ColourMaps::mapIndices(const float* in, uint8_t* out, int n, float scale, float offset)
+{
+    getDispatch().mapIndices(in, out, n, scale, offset);
+}
+
+void ColourMaps::mapValues(const float* in, uint32_t* out, int n, ColourSchemeId colourScheme, float scale)
+{
+    getDispatch().mapValues(in, out, n, getTable(colourScheme), scale);
+}
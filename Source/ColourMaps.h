@@ -0,0 +1,80 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __COLOURMAPS_H__
+#define __COLOURMAPS_H__
+
+#include <cstdint>
+
+/**
+ *  Color mapping enumeration describing a predefined set of colors for values
+ *  0-1. The maps used and described by these values are derived from libmatplot.
+ */
+enum class ColourSchemeId : int
+{
+    INFERNO,
+    VIRIDIS,
+    PLASMA,
+    MAGMA,
+    JET
+};
+
+/**
+ *  Lookup tables behind ColourScheme, without any dependency on JUCE.
+ *  Every scheme is a 256-entry table of 0xAARRGGBB colours; a normalized
+ *  value in [k/256, (k+1)/256) selects entry k, clipping at the bounds.
+ */
+namespace ColourMaps
+{
+    /** Number of entries in each colour table */
+    constexpr int tableSize = 256;
+
+    /** Returns the colour table for a scheme */
+    const uint32_t* getTable(ColourSchemeId colourScheme);
+
+    /** Returns the table index for a value already multiplied by tableSize */
+    inline int getIndexForTablePosition(float position)
+    {
+        if (! (position > 0.0f)) // also catches NaN
+            return 0;
+
+        if (position >= (float) (tableSize - 1))
+            return tableSize - 1;
+
+        return (int) position;
+    }
+
+    /** Returns the table index for a value normalized to [0,1) */
+    inline int getIndexForNormalizedValue(float val)
+    {
+        return getIndexForTablePosition(val * (float) tableSize);
+    }
+
+    /** Converts n values to table indices, each mapped to the normalized value in * scale + offset */
+    void mapIndices(const float* in, uint8_t* out, int n, float scale = 1.0f, float offset = 0.0f);
+
+    /** Converts n values, each multiplied by scale, straight to 0xAARRGGBB colours */
+    void mapValues(const float* in, uint32_t* out, int n, ColourSchemeId colourScheme, float scale = 1.0f);
+}
+
+#endif /* __COLOURMAPS_H__ */
@@ -0,0 +1,169 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "ColourScaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace GridViewer;
+
+namespace {
+    // seconds the smoothed range and the channel baselines take to follow a change
+    const float RANGE_TIME_CONSTANT = 0.4f;
+    const float BASELINE_TIME_CONSTANT = 20.0f;
+
+    // the node's snapshot rate, for callers that process every frame
+    const float DEFAULT_UPDATE_RATE = 50.0f;
+
+    /** Weight of each new frame in an exponential average with a time constant in seconds */
+    float getSmoothingWeight(float timeConstant, float framesPerSecond)
+    {
+        return 1.0f - std::exp(-1.0f / (timeConstant * framesPerSecond));
+    }
+
+    // smallest span of the colour scale, so a flat frame does not divide by zero
+    const float MIN_SPAN = 1.0e-3f;
+}
+
+ColourScaler::ColourScaler()
+    : mode(ColourScaling::FIXED),
+      lowPercentile(2.0f),
+      highPercentile(98.0f),
+      rangeSmoothing(getSmoothingWeight(RANGE_TIME_CONSTANT, DEFAULT_UPDATE_RATE)),
+      baselineSmoothing(getSmoothingWeight(BASELINE_TIME_CONSTANT, DEFAULT_UPDATE_RATE)),
+      baselinesHeld(false),
+      minimum(0.0f),
+      maximum(1.0f),
+      hasRange(false),
+      lastFrame(0)
+{
+}
+
+void ColourScaler::setMode(ColourScaling newMode)
+{
+    mode = newMode;
+    reset();
+}
+
+void ColourScaler::setPercentiles(float low, float high)
+{
+    lowPercentile = std::max(0.0f, std::min(low, 100.0f));
+    highPercentile = std::max(lowPercentile, std::min(high, 100.0f));
+    reset();
+}
+
+void ColourScaler::setUpdateRate(float framesPerSecond)
+{
+    framesPerSecond = std::max(framesPerSecond, 1.0f);
+
+    rangeSmoothing = getSmoothingWeight(RANGE_TIME_CONSTANT, framesPerSecond);
+    baselineSmoothing = getSmoothingWeight(BASELINE_TIME_CONSTANT, framesPerSecond);
+}
+
+const float* ColourScaler::process(const float* values,
+                                   int numValues,
+                                   float fixedMinimum,
+                                   float fixedMaximum,
+                                   uint64_t frameCounter)
+{
+    if (mode == ColourScaling::FIXED || numValues <= 0)
+    {
+        minimum = fixedMinimum;
+        maximum = fixedMaximum;
+        return values;
+    }
+
+    const bool newFrame = frameCounter == 0 || frameCounter != lastFrame;
+    lastFrame = frameCounter;
+
+    if (mode == ColourScaling::PERCENTILE)
+    {
+        if (newFrame)
+            updateRange(values, numValues);
+
+        return values;
+    }
+
+    if ((int) baselines.size() != numValues)
+    {
+        // the first frame seeds every baseline
+        baselines.assign(values, values + numValues);
+        differences.assign((size_t) numValues, 0.0f);
+    }
+    else if (! newFrame)
+    {
+        return differences.data();
+    }
+
+    const float weight = baselinesHeld ? 0.0f : baselineSmoothing;
+
+    for (int i = 0; i < numValues; i++)
+    {
+        baselines[(size_t) i] += weight * (values[i] - baselines[(size_t) i]);
+        differences[(size_t) i] = values[i] - baselines[(size_t) i];
+    }
+
+    updateRange(differences.data(), numValues);
+
+    return differences.data();
+}
+
+void ColourScaler::updateRange(const float* values, int numValues)
+{
+    selection.assign(values, values + numValues);
+
+    const int last = numValues - 1;
+    const int lowIndex = (int) ((float) last * lowPercentile / 100.0f + 0.5f);
+    const int highIndex = (int) ((float) last * highPercentile / 100.0f + 0.5f);
+
+    // the second selection only has to search above the first
+    std::nth_element(selection.begin(), selection.begin() + lowIndex, selection.end());
+    const float low = selection[(size_t) lowIndex];
+
+    std::nth_element(selection.begin() + lowIndex, selection.begin() + highIndex, selection.end());
+    const float high = selection[(size_t) highIndex];
+
+    if (! hasRange)
+    {
+        minimum = low;
+        maximum = high;
+        hasRange = true;
+    }
+    else
+    {
+        minimum += rangeSmoothing * (low - minimum);
+        maximum += rangeSmoothing * (high - maximum);
+    }
+
+    if (maximum - minimum < MIN_SPAN)
+        maximum = minimum + MIN_SPAN;
+}
+
+void ColourScaler::reset()
+{
+    hasRange = false;
+    lastFrame = 0;
+    baselines.clear();
+}
@@ -0,0 +1,111 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __COLOURSCALER_H__
+#define __COLOURSCALER_H__
+
+#include <cstdint>
+#include <vector>
+
+namespace GridViewer {
+
+/** How a stream's values are spread over the colour scale */
+enum class ColourScaling
+{
+    FIXED,      // the metric's fixed range
+    PERCENTILE, // smoothed low and high percentiles of each frame
+    BASELINE    // each channel's difference from its running baseline, then as PERCENTILE
+};
+
+/**
+    Chooses the range of values a stream's colour scale covers.
+
+    Percentiles are found with two nth_element selections on a copy of the
+    frame, so the cost is linear in the channel count. Frame-to-frame
+    changes are smoothed exponentially so the scale does not flicker; the
+    time constants are in seconds and are converted to per-frame weights
+    with the rate at which new frames arrive.
+ */
+class ColourScaler
+{
+public:
+    ColourScaler();
+
+    void setMode(ColourScaling mode);
+    ColourScaling getMode() const { return mode; }
+
+    /** Sets the percentiles (0-100) mapped to the bottom and top of the colour scale */
+    void setPercentiles(float low, float high);
+
+    /** Sets how many new frames process() sees per second (50 by default) */
+    void setUpdateRate(float framesPerSecond);
+
+    /**
+     *  While held, BASELINE mode compares frames with the baselines as they
+     *  are instead of updating them, e.g. for frames from the history.
+     */
+    void setBaselinesHeld(bool shouldHold) { baselinesHeld = shouldHold; }
+
+    /**
+     *  Updates the range from a frame and returns the values to draw: the
+     *  frame itself, or the per-channel differences in BASELINE mode. A frame
+     *  is only taken into account once, however often it is drawn.
+     */
+    const float* process(const float* values, int numValues, float fixedMinimum, float fixedMaximum, uint64_t frameCounter);
+
+    /** Bottom of the colour scale after the last process() call */
+    float getMinimum() const { return minimum; }
+
+    /** Top of the colour scale after the last process() call */
+    float getMaximum() const { return maximum; }
+
+    /** Forgets the smoothed range and the baselines */
+    void reset();
+
+private:
+    void updateRange(const float* values, int numValues);
+
+    ColourScaling mode;
+
+    float lowPercentile;
+    float highPercentile;
+
+    float rangeSmoothing;       // weight of a new frame in the smoothed range
+    float baselineSmoothing;    // weight of a new frame in a channel's baseline
+    bool baselinesHeld;
+
+    float minimum;
+    float maximum;
+    bool hasRange;
+
+    uint64_t lastFrame;
+
+    std::vector<float> selection;   // scratch copy reordered by nth_element
+    std::vector<float> baselines;
+    std::vector<float> differences;
+};
+
+}
+
+#endif /* __COLOURSCALER_H__ */
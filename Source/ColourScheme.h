@@ -11,18 +11,7 @@
 
 #include <VisualizerEditorHeaders.h>
 
-/**
- *  Color mapping enumeration describing a predefined set of colors for values
- *  0-1. The maps used and described by these values are derived from libmatplot.
- */
-enum class ColourSchemeId : int
-{
-    INFERNO,
-    VIRIDIS,
-    PLASMA,
-    MAGMA,
-    JET
-};
+#include "ColourMaps.h"
 
 namespace ColourScheme
 {
@@ -46,6 +35,24 @@ namespace ColourScheme
      *  set by a user is ColourSchemeId::INFERNO.
      */
     void setColourScheme(ColourSchemeId colourScheme);
+
+    /**
+     *  Get the globally selected color scheme.
+     */
+    ColourSchemeId getColourScheme();
+
+    /**
+     *  Map n values to pixels in one pass, using the lookup table of the given
+     *  ColourSchemeId. Each value is multiplied by scale before being treated
+     *  as normalized [0,1).
+     */
+    void mapValues(const float* in, PixelARGB* out, int n, ColourSchemeId colourScheme, float scale = 1.0f);
+
+    /**
+     *  Get the lookup table of a ColourSchemeId as ColourMaps::tableSize pixels,
+     *  for use with indices from ColourMaps::mapIndices.
+     */
+    const PixelARGB* getPixelTable(ColourSchemeId colourScheme);
 };
 
 
@@ -0,0 +1,116 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "CpuFeatures.h"
+
+#if GRIDVIEWER_X86 && defined(_MSC_VER)
+ #include <intrin.h>
+ #include <immintrin.h>
+#endif
+
+using namespace GridViewer;
+
+namespace {
+
+SimdLevel detectSimdLevel()
+{
+#if ! GRIDVIEWER_X86
+    return SimdLevel::SCALAR;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool hasSse2 = (info[3] & (1 << 26)) != 0;
+    const bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+    const bool hasAvx = (info[2] & (1 << 28)) != 0;
+    const bool hasFma = (info[2] & (1 << 12)) != 0;
+
+    if (! hasSse2)
+        return SimdLevel::SCALAR;
+
+    if (! (hasOsxsave && hasAvx && maxLeaf >= 7))
+        return SimdLevel::SSE2;
+
+    // the OS must save the YMM (and for AVX-512, the ZMM/opmask) registers
+    const unsigned long long xcr0 = _xgetbv(0);
+
+    if ((xcr0 & 0x6) != 0x6)
+        return SimdLevel::SSE2;
+
+    __cpuidex(info, 7, 0);
+    const bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+    const bool hasAvx512f = (info[1] & (1 << 16)) != 0;
+
+    if (hasAvx512f && (xcr0 & 0xe6) == 0xe6)
+        return SimdLevel::AVX512;
+
+    if (hasAvx2 && hasFma)
+        return SimdLevel::AVX2;
+
+    return SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::AVX2;
+
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+
+    return SimdLevel::SCALAR;
+#endif
+}
+
+}
+
+SimdLevel CpuFeatures::getSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+
+    return level;
+}
+
+const char* CpuFeatures::getSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::SCALAR:
+            return "scalar";
+
+        case SimdLevel::SSE2:
+            return "sse2";
+
+        case SimdLevel::AVX2:
+            return "avx2";
+
+        case SimdLevel::AVX512:
+            return "avx512";
+    }
+
+    return "unknown";
+}
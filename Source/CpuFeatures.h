@@ -0,0 +1,62 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __CPUFEATURES_H__
+#define __CPUFEATURES_H__
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define GRIDVIEWER_X86 1
+#else
+ #define GRIDVIEWER_X86 0
+#endif
+
+/** Lets a single function be compiled for a wider instruction set than the rest of the file */
+#if GRIDVIEWER_X86 && (defined(__GNUC__) || defined(__clang__))
+ #define GRIDVIEWER_TARGET(isa) __attribute__((target(isa)))
+#else
+ #define GRIDVIEWER_TARGET(isa)
+#endif
+
+namespace GridViewer {
+
+/** Instruction set levels the SIMD kernels are compiled for, in increasing order */
+enum class SimdLevel : int
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+namespace CpuFeatures
+{
+    /** Returns the widest instruction set supported by both the CPU and the OS (detected once) */
+    SimdLevel getSimdLevel();
+
+    /** Returns a short name for an instruction set level, e.g. "avx2" */
+    const char* getSimdLevelName(SimdLevel level);
+}
+
+}
+
+#endif /* __CPUFEATURES_H__ */
@@ -0,0 +1,425 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ElectrodeLayout.h"
+
+#include "JsonReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace GridViewer;
+
+#pragma mark - ChannelMap -
+namespace {
+
+std::string toLowerCase(std::string s)
+{
+    for (auto& c : s)
+        c = (char) std::tolower((unsigned char) c);
+
+    return s;
+}
+
+bool parseNumber(const std::string& field, double& value)
+{
+    const char* start = field.c_str();
+    char* end = nullptr;
+    value = std::strtod(start, &end);
+
+    if (end == start)
+        return false;
+
+    while (*end == ' ' || *end == '\t' || *end == '\r')
+        end++;
+
+    return *end == 0;
+}
+
+/** True if a channel number fits an int and a position is a finite float */
+bool isInRange(double channel, double x, double y)
+{
+    const double largestPosition = (double) std::numeric_limits<float>::max();
+
+    // also false for NaN
+    return std::abs(channel) <= (double) std::numeric_limits<int>::max()
+        && std::abs(x) <= largestPosition
+        && std::abs(y) <= largestPosition;
+}
+
+bool parseEnabled(const std::string& field)
+{
+    const std::string lower = toLowerCase(field);
+
+    return ! (lower == "0" || lower == "false" || lower == "no" || lower == "off");
+}
+
+std::string trim(const std::string& s)
+{
+    const size_t first = s.find_first_not_of(" \t\r");
+
+    if (first == std::string::npos)
+        return std::string();
+
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+}
+
+/** Splits on commas, semicolons or tabs, or on spaces if the line has none of those */
+std::vector<std::string> splitFields(const std::string& line)
+{
+    const bool delimited = line.find_first_of(",;\t") != std::string::npos;
+    const char* separators = delimited ? ",;\t" : " ";
+
+    std::vector<std::string> fields;
+    size_t start = 0;
+
+    for (;;)
+    {
+        const size_t end = line.find_first_of(separators, start);
+        const std::string field = trim(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+
+        if (delimited || ! field.empty())
+            fields.push_back(field);
+
+        if (end == std::string::npos)
+            break;
+
+        start = end + 1;
+    }
+
+    // a blank line yields a single empty field
+    if (fields.size() == 1 && fields[0].empty())
+        fields.clear();
+
+    return fields;
+}
+
+}
+
+bool ChannelMap::readFile(const std::string& path, std::vector<ChannelMapEntry>& entries, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (! file)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    const std::string text = contents.str();
+    const std::string lowerPath = toLowerCase(path);
+
+    if (lowerPath.size() >= 5 && lowerPath.compare(lowerPath.size() - 5, 5, ".json") == 0)
+        return parseJson(text, entries, error);
+
+    return parseCsv(text, entries, error);
+}
+
+bool ChannelMap::parseCsv(const std::string& text, std::vector<ChannelMapEntry>& entries, std::string& error)
+{
+    entries.clear();
+
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(lines, line))
+    {
+        lineNumber++;
+
+        const std::vector<std::string> fields = splitFields(line);
+
+        if (fields.empty() || (! fields[0].empty() && fields[0][0] == '#'))
+            continue;
+
+        double channel, x, y;
+
+        if (! parseNumber(fields[0], channel))
+        {
+            // only the first non-comment line may be a header
+            if (entries.empty())
+                continue;
+
+            error = "invalid channel on line " + std::to_string(lineNumber);
+            return false;
+        }
+
+        if (fields.size() < 3 || ! parseNumber(fields[1], x) || ! parseNumber(fields[2], y))
+        {
+            error = "expected channel, x, y on line " + std::to_string(lineNumber);
+            return false;
+        }
+
+        if (! isInRange(channel, x, y))
+        {
+            error = "channel or position out of range on line " + std::to_string(lineNumber);
+            return false;
+        }
+
+        ChannelMapEntry entry;
+        entry.channel = (int) channel;
+        entry.x = (float) x;
+        entry.y = (float) y;
+        entry.enabled = fields.size() < 4 || parseEnabled(fields[3]);
+
+        entries.push_back(entry);
+    }
+
+    if (entries.empty())
+    {
+        error = "no channels found";
+        return false;
+    }
+
+    return true;
+}
+
+bool ChannelMap::parseJson(const std::string& text, std::vector<ChannelMapEntry>& entries, std::string& error)
+{
+    entries.clear();
+
+    JsonValue document;
+
+    if (! JsonValue::parse(text, document, error))
+        return false;
+
+    const JsonValue& list = document.isArray() ? document : document["channels"];
+
+    if (! list.isArray())
+    {
+        error = "expected an array of channels";
+        return false;
+    }
+
+    for (int i = 0; i < list.size(); i++)
+    {
+        const JsonValue& item = list[i];
+
+        if (! (item["channel"].isNumber() && item["x"].isNumber() && item["y"].isNumber()))
+        {
+            error = "channel entry " + std::to_string(i) + " needs numeric channel, x and y";
+            return false;
+        }
+
+        if (! isInRange(item["channel"].getNumber(), item["x"].getNumber(), item["y"].getNumber()))
+        {
+            error = "channel entry " + std::to_string(i) + " is out of range";
+            return false;
+        }
+
+        ChannelMapEntry entry;
+        entry.channel = (int) item["channel"].getNumber();
+        entry.x = (float) item["x"].getNumber();
+        entry.y = (float) item["y"].getNumber();
+        entry.enabled = item["enabled"].getBool(true);
+
+        entries.push_back(entry);
+    }
+
+    if (entries.empty())
+    {
+        error = "no channels found";
+        return false;
+    }
+
+    return true;
+}
+
+#pragma mark - ElectrodeLayout -
+namespace {
+
+// a grid may have this many cells per mapped channel (or MIN_GRID_CELLS) before placement gets coarser
+const size_t MAX_CELLS_PER_CHANNEL = 16;
+const size_t MIN_GRID_CELLS = 4096;
+
+/**
+    Converts coordinates along one axis to grid indices. Positions are snapped
+    to the smallest spacing between distinct values, which keeps gaps in the
+    array visible; if that would make the grid unreasonably sparse, or if
+    snapping is not allowed, each distinct value gets its own index instead.
+ */
+std::vector<int> quantizeAxis(const std::vector<float>& coords, bool allowSnapping, int& numIndices)
+{
+    std::vector<float> distinct(coords);
+    std::sort(distinct.begin(), distinct.end());
+
+    // in double, so the span of extreme float coordinates cannot overflow
+    const double range = (double) distinct.back() - (double) distinct.front();
+    const float tolerance = (float) (range * 1.0e-4);
+
+    distinct.erase(std::unique(distinct.begin(), distinct.end(),
+                               [tolerance](float a, float b) { return b - a <= tolerance; }),
+                   distinct.end());
+
+    std::vector<int> indices(coords.size(), 0);
+
+    if (distinct.size() < 2)
+    {
+        numIndices = 1;
+        return indices;
+    }
+
+    double pitch = range;
+
+    for (size_t i = 1; i < distinct.size(); i++)
+        pitch = std::min(pitch, (double) distinct[i] - (double) distinct[i - 1]);
+
+    const double snappedCount = std::round(range / pitch) + 1.0;
+
+    if (allowSnapping && snappedCount <= (double) distinct.size() * 4.0)
+    {
+        for (size_t i = 0; i < coords.size(); i++)
+            indices[i] = (int) std::lround(((double) coords[i] - (double) distinct.front()) / pitch);
+
+        numIndices = (int) snappedCount;
+        return indices;
+    }
+
+    for (size_t i = 0; i < coords.size(); i++)
+    {
+        auto it = std::lower_bound(distinct.begin(), distinct.end(), coords[i] - tolerance);
+        indices[i] = (int) (it - distinct.begin());
+    }
+
+    numIndices = (int) distinct.size();
+    return indices;
+}
+
+}
+
+ElectrodeLayout::ElectrodeLayout(int numChannels_)
+    : numChannels(std::max(numChannels_, 0)),
+      numColumns(8),
+      fromChannelMap(false)
+{
+    while (numColumns * numColumns < numChannels)
+        numColumns *= 2;
+
+    numRows = numColumns;
+
+    cellChannels.assign((size_t) numColumns * (size_t) numRows, emptyCell);
+
+    for (int i = 0; i < numChannels; i++)
+        cellChannels[(size_t) i] = i;
+
+    buildElectrodeList();
+}
+
+ElectrodeLayout::ElectrodeLayout(int numChannels_, const std::vector<ChannelMapEntry>& channelMap)
+    : numChannels(std::max(numChannels_, 0)),
+      numColumns(1),
+      numRows(1),
+      fromChannelMap(true)
+{
+    std::vector<ChannelMapEntry> entries;
+
+    for (auto& entry : channelMap)
+        if (entry.channel >= 0 && entry.channel < numChannels)
+            entries.push_back(entry);
+
+    if (entries.empty())
+    {
+        cellChannels.assign(1, emptyCell);
+        return;
+    }
+
+    std::vector<float> xs, ys;
+
+    for (auto& entry : entries)
+    {
+        xs.push_back(entry.x);
+        ys.push_back(entry.y);
+    }
+
+    const size_t maxCells = std::max(entries.size() * MAX_CELLS_PER_CHANNEL, MIN_GRID_CELLS);
+
+    std::vector<int> columns = quantizeAxis(xs, true, numColumns);
+    std::vector<int> rows = quantizeAxis(ys, true, numRows);
+
+    // jittered positions snap to a sparse grid; give each distinct position its own index
+    if ((size_t) numColumns * (size_t) numRows > maxCells)
+    {
+        columns = quantizeAxis(xs, false, numColumns);
+        rows = quantizeAxis(ys, false, numRows);
+    }
+
+    // on a diagonal every channel has its own row and column; place them in
+    // raster order of their positions on a square grid instead
+    if ((size_t) numColumns * (size_t) numRows > maxCells)
+    {
+        std::vector<size_t> order(entries.size());
+
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+
+        std::stable_sort(order.begin(), order.end(), [&rows, &columns](size_t a, size_t b)
+        {
+            return rows[a] != rows[b] ? rows[a] < rows[b] : columns[a] < columns[b];
+        });
+
+        numColumns = (int) std::ceil(std::sqrt((double) entries.size()));
+        numRows = (int) ((entries.size() + (size_t) numColumns - 1) / (size_t) numColumns);
+
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            columns[order[k]] = (int) (k % (size_t) numColumns);
+            rows[order[k]] = (int) (k / (size_t) numColumns);
+        }
+    }
+
+    cellChannels.assign((size_t) numColumns * (size_t) numRows, emptyCell);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        int& cell = cellChannels[(size_t) rows[i] * (size_t) numColumns + (size_t) columns[i]];
+
+        // the first channel mapped to a cell keeps it
+        if (cell == emptyCell)
+            cell = entries[i].enabled ? entries[i].channel : disabledCell;
+    }
+
+    buildElectrodeList();
+}
+
+void ElectrodeLayout::buildElectrodeList()
+{
+    electrodeCells.clear();
+    electrodeChannels.clear();
+
+    for (int cell = 0; cell < (int) cellChannels.size(); cell++)
+    {
+        if (cellChannels[(size_t) cell] >= 0)
+        {
+            electrodeCells.push_back(cell);
+            electrodeChannels.push_back(cellChannels[(size_t) cell]);
+        }
+    }
+}
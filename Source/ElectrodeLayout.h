@@ -0,0 +1,121 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __ELECTRODELAYOUT_H__
+#define __ELECTRODELAYOUT_H__
+
+#include <string>
+#include <vector>
+
+namespace GridViewer {
+
+/** One line of a channel map: where a channel sits, and whether to draw it */
+struct ChannelMapEntry
+{
+    int channel;
+    float x;
+    float y;
+    bool enabled;
+};
+
+namespace ChannelMap
+{
+    /**
+     *  Reads a channel map from a .json or .csv file.
+     *
+     *  CSV files hold one "channel, x, y[, enabled]" line per channel; a header
+     *  line and lines starting with '#' are skipped. JSON files hold an array of
+     *  {"channel", "x", "y", "enabled"} objects, either at the top level or in a
+     *  "channels" property. Positions may be grid indices or probe coordinates
+     *  (e.g. in um); y grows downwards on screen.
+     */
+    bool readFile(const std::string& path, std::vector<ChannelMapEntry>& entries, std::string& error);
+
+    /** Parses channel map text in CSV form */
+    bool parseCsv(const std::string& text, std::vector<ChannelMapEntry>& entries, std::string& error);
+
+    /** Parses channel map text in JSON form */
+    bool parseJson(const std::string& text, std::vector<ChannelMapEntry>& entries, std::string& error);
+}
+
+/**
+    Raster index of a stream's electrodes on a grid of cells.
+
+    A layout is compiled once from either the channel count (a square grid in
+    channel order) or a channel map, so the canvas can draw a frame with a
+    plain indexed loop and no geometry calculations.
+ */
+class ElectrodeLayout
+{
+public:
+    /** Value in the cell table for cells without a channel */
+    static constexpr int emptyCell = -1;
+
+    /** Value in the cell table for channels disabled in the channel map */
+    static constexpr int disabledCell = -2;
+
+    /** Square grid with channel i at row-major position i */
+    explicit ElectrodeLayout(int numChannels);
+
+    /**
+     *  Grid compiled from channel map positions; channels missing from the map
+     *  are not drawn. Maps that would need more than 16 cells per channel are
+     *  placed by rank along each axis, or failing that in raster order.
+     */
+    ElectrodeLayout(int numChannels, const std::vector<ChannelMapEntry>& channelMap);
+
+    int getNumChannels() const { return numChannels; }
+    int getNumColumns() const { return numColumns; }
+    int getNumRows() const { return numRows; }
+
+    /** Returns true if the layout came from a channel map */
+    bool isFromChannelMap() const { return fromChannelMap; }
+
+    /** Returns the number of electrodes that are drawn */
+    int getNumElectrodes() const { return (int) electrodeCells.size(); }
+
+    /** Cell (row * numColumns + column) of each drawn electrode, in raster order */
+    const int* getElectrodeCells() const { return electrodeCells.data(); }
+
+    /** Channel of each drawn electrode, parallel to getElectrodeCells() */
+    const int* getElectrodeChannels() const { return electrodeChannels.data(); }
+
+    /** Channel in each cell, or emptyCell / disabledCell */
+    const int* getCellChannels() const { return cellChannels.data(); }
+
+private:
+    void buildElectrodeList();
+
+    int numChannels;
+    int numColumns;
+    int numRows;
+    bool fromChannelMap;
+
+    std::vector<int> cellChannels;
+    std::vector<int> electrodeCells;
+    std::vector<int> electrodeChannels;
+};
+
+}
+
+#endif /* __ELECTRODELAYOUT_H__ */
@@ -0,0 +1,584 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "FilterBank.h"
+
+#include "ReductionKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if GRIDVIEWER_X86
+ #include <immintrin.h>
+#endif
+
+using namespace GridViewer;
+
+namespace {
+
+const int LANES = FilterBank::channelsPerGroup;
+const int STAGES = FilterBank::numStages;
+
+// floats of state per group: z1 and z2 for every lane of every stage
+const int GROUP_STATE_SIZE = STAGES * 2 * LANES;
+
+// band edges in Hz
+const double SPIKE_LOW = 300.0;
+const double SPIKE_HIGH = 6000.0;
+const double LFP_LOW = 1.0;
+const double LFP_HIGH = 300.0;
+
+// what is left of a step once a band counts as settled
+const double SETTLED_RESIDUAL = 1.0e-4;
+
+/*
+    Every kernel runs the transposed direct form II recursion
+
+        y  = b0 x + z1
+        z1 = b1 x - a1 y + z2
+        z2 = b2 x - a2 y
+
+    for each stage in turn, with the state of lane c of stage s at
+    state[s * 2 * LANES + c] (z1) and state[s * 2 * LANES + LANES + c] (z2).
+ */
+
+void filterGroupScalar(const BiquadCoefficients* stages, float* state,
+                       const float* const* inputs, float* const* outputs, int numSamples)
+{
+    for (int c = 0; c < LANES; c++)
+    {
+        const float* x = inputs[c];
+        float* y = outputs[c];
+
+        float z1[STAGES], z2[STAGES];
+
+        for (int s = 0; s < STAGES; s++)
+        {
+            z1[s] = state[s * 2 * LANES + c];
+            z2[s] = state[s * 2 * LANES + LANES + c];
+        }
+
+        for (int t = 0; t < numSamples; t++)
+        {
+            float v = x[t];
+
+            for (int s = 0; s < STAGES; s++)
+            {
+                const BiquadCoefficients& k = stages[s];
+                const float out = k.b0 * v + z1[s];
+                z1[s] = k.b1 * v - k.a1 * out + z2[s];
+                z2[s] = k.b2 * v - k.a2 * out;
+                v = out;
+            }
+
+            y[t] = v;
+        }
+
+        for (int s = 0; s < STAGES; s++)
+        {
+            state[s * 2 * LANES + c] = z1[s];
+            state[s * 2 * LANES + LANES + c] = z2[s];
+        }
+    }
+}
+
+/**
+    The same recursion for a single stage, in double precision. Lanes are
+    interleaved so that their independent recursions overlap.
+ */
+void filterGroupPrecise(const PreciseBiquadCoefficients& k, double* state,
+                        const float* const* inputs, float* const* outputs, int numSamples)
+{
+    const float* x[LANES];
+    float* y[LANES];
+    double z1[LANES], z2[LANES];
+
+    for (int c = 0; c < LANES; c++)
+    {
+        x[c] = inputs[c];
+        y[c] = outputs[c];
+        z1[c] = state[c];
+        z2[c] = state[LANES + c];
+    }
+
+    for (int t = 0; t < numSamples; t++)
+    {
+        for (int c = 0; c < LANES; c++)
+        {
+            const double v = x[c][t];
+            const double out = k.b0 * v + z1[c];
+            z1[c] = k.b1 * v - k.a1 * out + z2[c];
+            z2[c] = k.b2 * v - k.a2 * out;
+            y[c][t] = (float) out;
+        }
+    }
+
+    for (int c = 0; c < LANES; c++)
+    {
+        state[c] = z1[c];
+        state[LANES + c] = z2[c];
+    }
+}
+
+#if GRIDVIEWER_X86
+
+/** Runs one sample of four lanes through every stage */
+inline __m128 stepSse2(const BiquadCoefficients* stages, __m128* z1, __m128* z2, __m128 v)
+{
+    for (int s = 0; s < STAGES; s++)
+    {
+        const BiquadCoefficients& k = stages[s];
+        const __m128 out = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(k.b0), v), z1[s]);
+        z1[s] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k.b1), v), _mm_mul_ps(_mm_set1_ps(k.a1), out)), z2[s]);
+        z2[s] = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k.b2), v), _mm_mul_ps(_mm_set1_ps(k.a2), out));
+        v = out;
+    }
+
+    return v;
+}
+
+void filterGroupSse2(const BiquadCoefficients* stages, float* state,
+                     const float* const* inputs, float* const* outputs, int numSamples)
+{
+    // the group is filtered as two halves of four lanes
+    for (int half = 0; half < LANES; half += 4)
+    {
+        const float* const* x = inputs + half;
+        float* const* y = outputs + half;
+
+        __m128 z1[STAGES], z2[STAGES];
+
+        for (int s = 0; s < STAGES; s++)
+        {
+            z1[s] = _mm_loadu_ps(state + s * 2 * LANES + half);
+            z2[s] = _mm_loadu_ps(state + s * 2 * LANES + LANES + half);
+        }
+
+        int t = 0;
+
+        for (; t + 4 <= numSamples; t += 4)
+        {
+            // rows are channels on load; after the transpose each row is one sample of all four
+            __m128 r0 = _mm_loadu_ps(x[0] + t);
+            __m128 r1 = _mm_loadu_ps(x[1] + t);
+            __m128 r2 = _mm_loadu_ps(x[2] + t);
+            __m128 r3 = _mm_loadu_ps(x[3] + t);
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            r0 = stepSse2(stages, z1, z2, r0);
+            r1 = stepSse2(stages, z1, z2, r1);
+            r2 = stepSse2(stages, z1, z2, r2);
+            r3 = stepSse2(stages, z1, z2, r3);
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            _mm_storeu_ps(y[0] + t, r0);
+            _mm_storeu_ps(y[1] + t, r1);
+            _mm_storeu_ps(y[2] + t, r2);
+            _mm_storeu_ps(y[3] + t, r3);
+        }
+
+        for (; t < numSamples; t++)
+        {
+            alignas(16) float v[4] = { x[0][t], x[1][t], x[2][t], x[3][t] };
+            _mm_store_ps(v, stepSse2(stages, z1, z2, _mm_load_ps(v)));
+
+            for (int c = 0; c < 4; c++)
+                y[c][t] = v[c];
+        }
+
+        for (int s = 0; s < STAGES; s++)
+        {
+            _mm_storeu_ps(state + s * 2 * LANES + half, z1[s]);
+            _mm_storeu_ps(state + s * 2 * LANES + LANES + half, z2[s]);
+        }
+    }
+}
+
+GRIDVIEWER_TARGET("avx2")
+void transpose8(__m256* r)
+{
+    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+/** Runs one sample of eight lanes through every stage */
+GRIDVIEWER_TARGET("avx2")
+inline __m256 stepAvx2(const BiquadCoefficients* stages, __m256* z1, __m256* z2, __m256 v)
+{
+    for (int s = 0; s < STAGES; s++)
+    {
+        const BiquadCoefficients& k = stages[s];
+        const __m256 out = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(k.b0), v), z1[s]);
+        z1[s] = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(k.b1), v), _mm256_mul_ps(_mm256_set1_ps(k.a1), out)), z2[s]);
+        z2[s] = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(k.b2), v), _mm256_mul_ps(_mm256_set1_ps(k.a2), out));
+        v = out;
+    }
+
+    return v;
+}
+
+GRIDVIEWER_TARGET("avx2")
+void filterGroupAvx2(const BiquadCoefficients* stages, float* state,
+                     const float* const* inputs, float* const* outputs, int numSamples)
+{
+    __m256 z1[STAGES], z2[STAGES];
+
+    for (int s = 0; s < STAGES; s++)
+    {
+        z1[s] = _mm256_loadu_ps(state + s * 2 * LANES);
+        z2[s] = _mm256_loadu_ps(state + s * 2 * LANES + LANES);
+    }
+
+    int t = 0;
+
+    for (; t + 8 <= numSamples; t += 8)
+    {
+        __m256 r[LANES];
+
+        for (int c = 0; c < LANES; c++)
+            r[c] = _mm256_loadu_ps(inputs[c] + t);
+
+        transpose8(r);
+
+        for (int i = 0; i < LANES; i++)
+            r[i] = stepAvx2(stages, z1, z2, r[i]);
+
+        transpose8(r);
+
+        for (int c = 0; c < LANES; c++)
+            _mm256_storeu_ps(outputs[c] + t, r[c]);
+    }
+
+    for (; t < numSamples; t++)
+    {
+        alignas(32) float v[LANES];
+
+        for (int c = 0; c < LANES; c++)
+            v[c] = inputs[c][t];
+
+        _mm256_store_ps(v, stepAvx2(stages, z1, z2, _mm256_load_ps(v)));
+
+        for (int c = 0; c < LANES; c++)
+            outputs[c][t] = v[c];
+    }
+
+    for (int s = 0; s < STAGES; s++)
+    {
+        _mm256_storeu_ps(state + s * 2 * LANES, z1[s]);
+        _mm256_storeu_ps(state + s * 2 * LANES + LANES, z2[s]);
+    }
+}
+
+/** Runs one sample of four lanes through a double precision stage */
+GRIDVIEWER_TARGET("avx2")
+inline __m128 stepPreciseAvx2(const PreciseBiquadCoefficients& k, __m256d& z1, __m256d& z2, __m128 x)
+{
+    const __m256d v = _mm256_cvtps_pd(x);
+    const __m256d out = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(k.b0), v), z1);
+    z1 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(k.b1), v), _mm256_mul_pd(_mm256_set1_pd(k.a1), out)), z2);
+    z2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(k.b2), v), _mm256_mul_pd(_mm256_set1_pd(k.a2), out));
+
+    return _mm256_cvtpd_ps(out);
+}
+
+/** filterGroupPrecise with the lanes split over two registers of four doubles */
+GRIDVIEWER_TARGET("avx2")
+void filterGroupPreciseAvx2(const PreciseBiquadCoefficients& k, double* state,
+                            const float* const* inputs, float* const* outputs, int numSamples)
+{
+    __m256d z1Low = _mm256_loadu_pd(state);
+    __m256d z1High = _mm256_loadu_pd(state + 4);
+    __m256d z2Low = _mm256_loadu_pd(state + LANES);
+    __m256d z2High = _mm256_loadu_pd(state + LANES + 4);
+
+    int t = 0;
+
+    for (; t + 8 <= numSamples; t += 8)
+    {
+        __m256 r[LANES];
+
+        for (int c = 0; c < LANES; c++)
+            r[c] = _mm256_loadu_ps(inputs[c] + t);
+
+        transpose8(r);
+
+        for (int i = 0; i < LANES; i++)
+        {
+            const __m128 low = stepPreciseAvx2(k, z1Low, z2Low, _mm256_castps256_ps128(r[i]));
+            const __m128 high = stepPreciseAvx2(k, z1High, z2High, _mm256_extractf128_ps(r[i], 1));
+            r[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+        }
+
+        transpose8(r);
+
+        for (int c = 0; c < LANES; c++)
+            _mm256_storeu_ps(outputs[c] + t, r[c]);
+    }
+
+    for (; t < numSamples; t++)
+    {
+        alignas(16) float v[LANES];
+
+        for (int c = 0; c < LANES; c++)
+            v[c] = inputs[c][t];
+
+        _mm_store_ps(v, stepPreciseAvx2(k, z1Low, z2Low, _mm_load_ps(v)));
+        _mm_store_ps(v + 4, stepPreciseAvx2(k, z1High, z2High, _mm_load_ps(v + 4)));
+
+        for (int c = 0; c < LANES; c++)
+            outputs[c][t] = v[c];
+    }
+
+    _mm256_storeu_pd(state, z1Low);
+    _mm256_storeu_pd(state + 4, z1High);
+    _mm256_storeu_pd(state + LANES, z2Low);
+    _mm256_storeu_pd(state + LANES + 4, z2High);
+}
+
+#endif
+
+FilterBank::GroupFunction selectGroupFunction(SimdLevel level)
+{
+#if GRIDVIEWER_X86
+    switch (level)
+    {
+        // a group is exactly one AVX2 register wide
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            return filterGroupAvx2;
+
+        case SimdLevel::SSE2:
+            return filterGroupSse2;
+
+        case SimdLevel::SCALAR:
+            break;
+    }
+#endif
+
+    return filterGroupScalar;
+}
+
+FilterBank::PreciseGroupFunction selectPreciseGroupFunction(SimdLevel level)
+{
+#if GRIDVIEWER_X86
+    if (level == SimdLevel::AVX2 || level == SimdLevel::AVX512)
+        return filterGroupPreciseAvx2;
+#endif
+
+    return filterGroupPrecise;
+}
+
+/** Second-order Butterworth section (RBJ cookbook with Q = 1/sqrt(2)) */
+PreciseBiquadCoefficients butterworthPrecise(bool highPass, double frequency, double sampleRate)
+{
+    // a cutoff at or above Nyquist leaves the signal as it is
+    if (frequency <= 0.0 || frequency >= 0.45 * sampleRate)
+        return { 1.0, 0.0, 0.0, 0.0, 0.0 };
+
+    const double w0 = 2.0 * 3.141592653589793 * frequency / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * 0.7071067811865476);
+    const double a0 = 1.0 + alpha;
+
+    const double b1 = highPass ? -(1.0 + cosW0) : 1.0 - cosW0;
+    const double b0 = highPass ? -b1 / 2.0 : b1 / 2.0;
+
+    return { b0 / a0, b1 / a0, b0 / a0, -2.0 * cosW0 / a0, (1.0 - alpha) / a0 };
+}
+
+/** Sets a section's state to its steady state on a constant input, and returns its output */
+template <typename Coefficients>
+double settleOn(const Coefficients& k, double x, double& z1, double& z2)
+{
+    const double denominator = 1.0 + k.a1 + k.a2;
+    const double y = denominator != 0.0 ? x * (k.b0 + k.b1 + k.b2) / denominator : 0.0;
+
+    z2 = k.b2 * x - k.a2 * y;
+    z1 = k.b1 * x - k.a1 * y + z2;
+
+    return y;
+}
+
+BiquadCoefficients butterworth(bool highPass, double frequency, double sampleRate)
+{
+    const PreciseBiquadCoefficients k = butterworthPrecise(highPass, frequency, sampleRate);
+
+    return { (float) k.b0, (float) k.b1, (float) k.b2, (float) k.a1, (float) k.a2 };
+}
+
+}
+
+FilterBank::FilterBank(int numChannels_, float sampleRate_)
+    : numChannels(numChannels_ > 0 ? numChannels_ : 0),
+      sampleRate(sampleRate_),
+      numGroups((numChannels + channelsPerGroup - 1) / channelsPerGroup),
+      requestedBand((int) FilterBand::BROADBAND),
+      activeBand((int) FilterBand::BROADBAND),
+      state((size_t) numGroups * GROUP_STATE_SIZE),
+      preciseState((size_t) numGroups * 2 * LANES),
+      silence(maxBlockSize),
+      discard(maxBlockSize),
+      processGroup(selectGroupFunction(ReductionKernels::getActiveSimdLevel())),
+      processPreciseGroup(selectPreciseGroupFunction(ReductionKernels::getActiveSimdLevel()))
+{
+    designBands();
+}
+
+void FilterBank::designBands()
+{
+    const BiquadCoefficients passThrough = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int band = 0; band < numFilterBands; band++)
+    {
+        preciseStages[band] = { 1.0, 0.0, 0.0, 0.0, 0.0 };
+        hasPreciseStage[band] = false;
+    }
+
+    coefficients[(int) FilterBand::BROADBAND][0] = passThrough;
+    coefficients[(int) FilterBand::BROADBAND][1] = passThrough;
+
+    coefficients[(int) FilterBand::SPIKE][0] = butterworth(true, SPIKE_LOW, sampleRate);
+    coefficients[(int) FilterBand::SPIKE][1] = butterworth(false, SPIKE_HIGH, sampleRate);
+
+    // the 1 Hz high-pass is too close to DC for float state (see the class comment)
+    preciseStages[(int) FilterBand::LFP] = butterworthPrecise(true, LFP_LOW, sampleRate);
+    hasPreciseStage[(int) FilterBand::LFP] = true;
+
+    coefficients[(int) FilterBand::LFP][0] = butterworth(false, LFP_HIGH, sampleRate);
+    coefficients[(int) FilterBand::LFP][1] = passThrough;
+}
+
+int FilterBank::getSettlingSamples(FilterBand band, float sampleRate)
+{
+    if (band == FilterBand::BROADBAND)
+        return 0;
+
+    // the lowest edge rings longest; a Butterworth pair decays as exp(-w0 t / sqrt(2))
+    const double lowest = band == FilterBand::SPIKE ? SPIKE_LOW : LFP_LOW;
+    const double seconds = -std::log(SETTLED_RESIDUAL) * 1.4142135623730951 / (2.0 * 3.141592653589793 * lowest);
+
+    return (int) std::ceil(seconds * sampleRate);
+}
+
+void FilterBank::setBand(FilterBand band)
+{
+    requestedBand.store((int) band, std::memory_order_relaxed);
+}
+
+bool FilterBank::beginBlock()
+{
+    const int band = requestedBand.load(std::memory_order_relaxed);
+
+    if (band != activeBand)
+    {
+        activeBand = band;
+        reset();
+    }
+
+    return activeBand != (int) FilterBand::BROADBAND;
+}
+
+void FilterBank::process(int firstChannel, const float* const* inputs, float* const* outputs, int count, int numSamples)
+{
+    const int group = firstChannel / channelsPerGroup;
+    float* groupState = state.get() + (size_t) group * GROUP_STATE_SIZE;
+
+    const float* groupInputs[channelsPerGroup];
+    float* groupOutputs[channelsPerGroup];
+
+    // only the last group can be partial, so the stand-in buffers are never shared
+    for (int c = 0; c < channelsPerGroup; c++)
+    {
+        groupInputs[c] = c < count ? inputs[c] : silence.get();
+        groupOutputs[c] = c < count ? outputs[c] : discard.get();
+    }
+
+    if (hasPreciseStage[activeBand])
+    {
+        // the rest of the cascade then filters the outputs in place
+        processPreciseGroup(preciseStages[activeBand], preciseState.get() + (size_t) group * 2 * LANES,
+                            groupInputs, groupOutputs, numSamples);
+
+        processGroup(coefficients[activeBand], groupState, groupOutputs, groupOutputs, numSamples);
+        return;
+    }
+
+    processGroup(coefficients[activeBand], groupState, groupInputs, groupOutputs, numSamples);
+}
+
+void FilterBank::prime(int firstChannel, const float* values, int count)
+{
+    const int group = firstChannel / channelsPerGroup;
+    float* groupState = state.get() + (size_t) group * GROUP_STATE_SIZE;
+    double* groupPreciseState = preciseState.get() + (size_t) group * 2 * LANES;
+
+    for (int c = 0; c < std::min(count, (int) channelsPerGroup); c++)
+    {
+        double x = values[c];
+
+        if (hasPreciseStage[activeBand])
+            x = settleOn(preciseStages[activeBand], x, groupPreciseState[c], groupPreciseState[LANES + c]);
+
+        for (int s = 0; s < STAGES; s++)
+        {
+            double z1, z2;
+            x = settleOn(coefficients[activeBand][s], x, z1, z2);
+
+            groupState[s * 2 * LANES + c] = (float) z1;
+            groupState[s * 2 * LANES + LANES + c] = (float) z2;
+        }
+    }
+}
+
+void FilterBank::reset()
+{
+    state.fill(0.0f);
+    preciseState.fill(0.0);
+}
@@ -0,0 +1,170 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __FILTERBANK_H__
+#define __FILTERBANK_H__
+
+#include "AlignedBuffer.h"
+
+#include <atomic>
+
+namespace GridViewer {
+
+/** Frequency band the activity metrics are computed on */
+enum class FilterBand
+{
+    BROADBAND,  // unfiltered
+    SPIKE,      // 300 - 6000 Hz band-pass
+    LFP         // 1 - 300 Hz band-pass
+};
+
+static constexpr int numFilterBands = 3;
+
+/** Normalised coefficients of one biquad section (a0 == 1) */
+struct BiquadCoefficients
+{
+    float b0, b1, b2;
+    float a1, a2;
+};
+
+/** A biquad section kept in double precision (a0 == 1) */
+struct PreciseBiquadCoefficients
+{
+    double b0, b1, b2;
+    double a1, a2;
+};
+
+/**
+    Cascade of two Butterworth biquads applied to every channel of a stream.
+
+    Filter state is stored structure-of-arrays in groups of eight channels,
+    so one vector register holds the same state variable of eight channels
+    and a group is filtered with plain vertical arithmetic. Blocks are
+    transposed in 8x8 (or 4x4) tiles on the way in and out.
+
+    A band's high-pass may instead run in double precision ahead of the
+    cascade. The LFP band needs this: at 30 kHz the poles of a 1 Hz section
+    sit so close to z = 1 that float rounding of the state, on the
+    millivolts of DC offset electrodes carry, is amplified to tens of uV
+    across the whole band.
+
+    The state for every band is the same size, so changing the band only
+    swaps coefficients and clears the state; nothing is reallocated.
+ */
+class FilterBank
+{
+public:
+    static constexpr int channelsPerGroup = 8;
+    static constexpr int numStages = 2;
+
+    /** Largest number of samples process() takes per call */
+    static constexpr int maxBlockSize = 256;
+
+    FilterBank(int numChannels, float sampleRate);
+
+    /** Requests a band; it takes effect at the next beginBlock() (any thread) */
+    void setBand(FilterBand band);
+
+    FilterBand getBand() const { return (FilterBand) requestedBand.load(std::memory_order_relaxed); }
+
+    /**
+     *  Applies a pending band change, clearing the filter state if the band
+     *  changed. Returns false when the band is broadband and process() need
+     *  not be called (audio thread, once per block).
+     */
+    bool beginBlock();
+
+    /**
+     *  Filters numSamples (at most maxBlockSize) samples of the count (at
+     *  most channelsPerGroup) channels starting at firstChannel, which must
+     *  be the first channel of a group. Different groups may be processed
+     *  concurrently.
+     */
+    void process(int firstChannel, const float* const* inputs, float* const* outputs, int count, int numSamples);
+
+    /** Clears the filter state */
+    void reset();
+
+    /**
+     *  Sets the state of the count channels starting at firstChannel (the
+     *  first channel of a group) to where a constant input of each channel's
+     *  value would have left it, so a DC offset does not ring through the
+     *  band as a step from rest (after beginBlock(), between blocks).
+     */
+    void prime(int firstChannel, const float* values, int count);
+
+    /**
+     *  Returns how many samples a band takes to settle from rest: by then
+     *  the response to a step (a DC offset at the first sample) has decayed
+     *  to 1e-4 of the step.
+     */
+    static int getSettlingSamples(FilterBand band, float sampleRate);
+
+    /** Signature of the per-group kernels */
+    typedef void (*GroupFunction)(const BiquadCoefficients* stages,
+                                  float* state,
+                                  const float* const* inputs,
+                                  float* const* outputs,
+                                  int numSamples);
+
+    /** Signature of the double precision single-stage kernels */
+    typedef void (*PreciseGroupFunction)(const PreciseBiquadCoefficients& stage,
+                                         double* state,
+                                         const float* const* inputs,
+                                         float* const* outputs,
+                                         int numSamples);
+
+private:
+    void designBands();
+
+    const int numChannels;
+    const float sampleRate;
+    const int numGroups;
+
+    BiquadCoefficients coefficients[numFilterBands][numStages];
+
+    // high-pass run in double before the cascade, for bands with hasPreciseStage
+    PreciseBiquadCoefficients preciseStages[numFilterBands];
+    bool hasPreciseStage[numFilterBands];
+
+    std::atomic<int> requestedBand;
+    int activeBand;
+
+    // per group: for each stage, z1 of all eight lanes followed by z2
+    AlignedBuffer<float> state;
+
+    // per group: z1 of all eight lanes followed by z2, of the double precision stage
+    AlignedBuffer<double> preciseState;
+
+    // stand-ins for the missing channels of a partial last group
+    AlignedBuffer<float> silence;
+    AlignedBuffer<float> discard;
+
+    GroupFunction processGroup;
+    PreciseGroupFunction processPreciseGroup;
+};
+
+}
+
+#endif /* __FILTERBANK_H__ */
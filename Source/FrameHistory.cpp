@@ -0,0 +1,187 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "FrameHistory.h"
+
+#include <algorithm>
+
+using namespace GridViewer;
+
+namespace {
+    // channels the percentiles are selected from; larger frames are sampled at a stride,
+    // which keeps the selection's cost on the audio thread independent of the channel count
+    const int MAX_SELECTED_CHANNELS = 512;
+}
+
+FrameHistory::FrameHistory(int numChannels_, int capacity_, int decimation_, float frameRate_)
+    : numChannels(numChannels_ > 0 ? numChannels_ : 0),
+      capacity(capacity_ > 1 ? capacity_ : 2),
+      decimation(decimation_ > 0 ? decimation_ : 1),
+      frameRate(frameRate_),
+      framesUntilRecord(0),
+      slots(new Slot[(size_t) capacity]),
+      data(new uint8_t[(size_t) capacity * (size_t) numChannels * numActivityMetrics]),
+      scratch(new float[(size_t) std::max(std::min(numChannels, MAX_SELECTED_CHANNELS), 1)]),
+      newestRecord(0)
+{
+}
+
+int FrameHistory::getCapacityForBudget(int numChannels, size_t budgetBytes)
+{
+    const size_t bytesPerRecord = sizeof(Slot) + (size_t) std::max(numChannels, 1) * numActivityMetrics;
+
+    return (int) std::min(budgetBytes / bytesPerRecord, (size_t) 1 << 30);
+}
+
+void FrameHistory::getCodeRange(const float* values, int n, float& lo, float& hi)
+{
+    lo = hi = n > 0 ? values[0] : 0.0f;
+
+    if (n <= 0)
+        return;
+
+    // every stride-th channel; the 1% rank of 512 samples is within about half a percent of the true one
+    const int stride = (n + MAX_SELECTED_CHANNELS - 1) / MAX_SELECTED_CHANNELS;
+    const int numSelected = (n + stride - 1) / stride;
+
+    float* sorted = scratch.get();
+
+    for (int i = 0; i < numSelected; i++)
+        sorted[i] = values[i * stride];
+
+    // nearest-rank percentiles; below 100 channels these are the minimum and maximum
+    const int lowRank = numSelected / 100;
+    const int highRank = numSelected - 1 - numSelected / 100;
+
+    std::nth_element(sorted, sorted + lowRank, sorted + numSelected);
+    lo = sorted[lowRank];
+
+    if (highRank > lowRank)
+    {
+        // everything above the low rank is already past it
+        std::nth_element(sorted + lowRank + 1, sorted + highRank, sorted + numSelected);
+        hi = sorted[highRank];
+    }
+
+    if (hi > lo)
+        return;
+
+    for (int i = 0; i < n; i++)
+    {
+        lo = values[i] < lo ? values[i] : lo;
+        hi = values[i] > hi ? values[i] : hi;
+    }
+}
+
+void FrameHistory::write(const ActivitySnapshot& frame, uint64_t frameCounter, int64_t sampleTimestamp)
+{
+    if (framesUntilRecord-- > 0)
+        return;
+
+    framesUntilRecord = decimation - 1;
+
+    const uint64_t record = newestRecord.load(std::memory_order_relaxed) + 1;
+    Slot& slot = slots[(size_t) ((record - 1) % (uint64_t) capacity)];
+    uint8_t* codes = data.get() + (size_t) ((record - 1) % (uint64_t) capacity) * (size_t) numChannels * numActivityMetrics;
+
+    const uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.record = record;
+    slot.frameCounter = frameCounter;
+    slot.sampleTimestamp = sampleTimestamp;
+    slot.numSamples = frame.numSamples;
+
+    const int n = std::min(frame.numChannels, numChannels);
+
+    for (int m = 0; m < numActivityMetrics; m++)
+    {
+        const float* values = frame.getValues((ActivityMetric) m);
+        uint8_t* metricCodes = codes + (size_t) m * (size_t) numChannels;
+
+        float lo, hi;
+        getCodeRange(values, n, lo, hi);
+
+        const float step = (hi - lo) / 255.0f;
+        const float inverseStep = step > 0.0f ? 1.0f / step : 0.0f;
+
+        // clamped in float and converted through int, which the compiler vectorizes
+        for (int i = 0; i < n; i++)
+        {
+            const float code = std::min(std::max((values[i] - lo) * inverseStep + 0.5f, 0.0f), 255.0f);
+            metricCodes[i] = (uint8_t) (int) code;
+        }
+
+        slot.minimum[m] = lo;
+        slot.step[m] = step;
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    newestRecord.store(record, std::memory_order_release);
+}
+
+uint64_t FrameHistory::getOldestRecord() const
+{
+    const uint64_t newest = getNewestRecord();
+
+    // the slot after the newest may already be half overwritten
+    return newest + 2 > (uint64_t) capacity ? newest + 2 - (uint64_t) capacity : 1;
+}
+
+bool FrameHistory::read(uint64_t record, ActivitySnapshot& frame) const
+{
+    if (record == 0 || record > getNewestRecord())
+        return false;
+
+    const Slot& slot = slots[(size_t) ((record - 1) % (uint64_t) capacity)];
+    const uint8_t* codes = data.get() + (size_t) ((record - 1) % (uint64_t) capacity) * (size_t) numChannels * numActivityMetrics;
+
+    const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+
+    if (before & 1)
+        return false;
+
+    const uint64_t storedRecord = slot.record;
+    const int n = std::min(frame.numChannels, numChannels);
+
+    for (int m = 0; m < numActivityMetrics; m++)
+    {
+        float* values = frame.getValues((ActivityMetric) m);
+        const uint8_t* metricCodes = codes + (size_t) m * (size_t) numChannels;
+        const float lo = slot.minimum[m];
+        const float step = slot.step[m];
+
+        for (int i = 0; i < n; i++)
+            values[i] = lo + step * (float) metricCodes[i];
+    }
+
+    frame.frameCounter = slot.frameCounter;
+    frame.sampleTimestamp = slot.sampleTimestamp;
+    frame.numSamples = slot.numSamples;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return storedRecord == record && slot.sequence.load(std::memory_order_relaxed) == before;
+}
@@ -0,0 +1,119 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __FRAMEHISTORY_H__
+#define __FRAMEHISTORY_H__
+
+#include "ActivitySnapshot.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace GridViewer {
+
+/**
+    Fixed-capacity ring of past frames, so the view can be paused and
+    scrubbed back while acquisition continues.
+
+    Every metric of a recorded frame is quantized to 8 bits between that
+    frame's 1st and 99th percentile across channels, which keeps a frame to
+    one byte per channel and metric. The few channels outside the range are
+    clamped to its ends, so one outlier cannot squeeze every other channel
+    into a handful of codes; when the percentiles coincide the full range
+    is used instead. Above 512 channels the percentiles are selected from a
+    strided sample, so the writer's cost beyond the quantization itself does
+    not grow with the channel count. Each slot is guarded by a sequence lock: the writer
+    never waits, and a reader that overlaps a write to the slot it is
+    copying sees the sequence change and reports the frame as gone.
+    Records are numbered from 1, so record r is always in slot
+    (r - 1) % capacity and reading one is O(1).
+ */
+class FrameHistory
+{
+public:
+    /** Records one frame in every `decimation` written; frameRate is the resulting records per second */
+    FrameHistory(int numChannels, int capacity, int decimation, float frameRate);
+
+    /** Returns the number of records needed to fit a memory budget */
+    static int getCapacityForBudget(int numChannels, size_t budgetBytes);
+
+    int getCapacity() const { return capacity; }
+    float getFrameRate() const { return frameRate; }
+
+    /** Offers a completed frame to the history (writer side, never blocks) */
+    void write(const ActivitySnapshot& frame, uint64_t frameCounter, int64_t sampleTimestamp);
+
+    /** Returns the newest record, or 0 if nothing has been recorded (reader side) */
+    uint64_t getNewestRecord() const { return newestRecord.load(std::memory_order_acquire); }
+
+    /** Returns the oldest record that can still be read (reader side) */
+    uint64_t getOldestRecord() const;
+
+    /**
+     *  Copies a record into a snapshot sized for the stream's channels.
+     *  Returns false if the record has not been written yet or has been
+     *  overwritten (reader side).
+     */
+    bool read(uint64_t record, ActivitySnapshot& frame) const;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> sequence { 0 };   // odd while the slot is being written
+
+        uint64_t record = 0;
+        uint64_t frameCounter = 0;
+        int64_t sampleTimestamp = 0;
+        int numSamples = 0;
+
+        float minimum[numActivityMetrics];
+        float step[numActivityMetrics];
+    };
+
+    /** Finds the range a metric is quantized over, reordering scratch */
+    void getCodeRange(const float* values, int n, float& lo, float& hi);
+
+    const int numChannels;
+    const int capacity;
+    const int decimation;
+    const float frameRate;
+
+    int framesUntilRecord;
+
+    std::unique_ptr<Slot[]> slots;
+
+    // not value-initialised, so pages are only committed once the ring reaches them
+    std::unique_ptr<uint8_t[]> data;
+
+    // the writer's copy of a metric, for finding its percentiles
+    std::unique_ptr<float[]> scratch;
+
+    std::atomic<uint64_t> newestRecord;
+};
+
+}
+
+#endif /* __FRAMEHISTORY_H__ */
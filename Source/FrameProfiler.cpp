@@ -0,0 +1,130 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace GridViewer;
+
+const char* GridViewer::getFrameStageName(FrameStage stage)
+{
+    switch (stage)
+    {
+        case FrameStage::FETCH:      return "Fetch";
+        case FrameStage::SCALE:      return "Scale";
+        case FrameStage::COLOUR_MAP: return "Colour map";
+        case FrameStage::FILL:       return "Fill cells";
+        case FrameStage::PAINT:      return "Paint";
+    }
+
+    return "";
+}
+
+FrameProfiler::FrameProfiler(double refreshInterval_, int numFramesKept)
+    : refreshInterval(refreshInterval_),
+      enabled(false),
+      frames((size_t) std::max(numFramesKept, 1)),
+      newestFrame(-1),
+      numFrames(0)
+{
+}
+
+void FrameProfiler::setEnabled(bool shouldBeEnabled)
+{
+    enabled = shouldBeEnabled;
+
+    current = Frame();
+    newestFrame = -1;
+    numFrames = 0;
+}
+
+void FrameProfiler::beginFrame()
+{
+    if (! enabled)
+        return;
+
+    const uint64_t time = now();
+
+    // the first refresh only starts a frame
+    if (current.start != 0)
+    {
+        current.interval = time - current.start;
+
+        newestFrame = (newestFrame + 1) % (int) frames.size();
+        frames[(size_t) newestFrame] = current;
+        numFrames = std::min(numFrames + 1, (int) frames.size());
+    }
+
+    current = Frame();
+    current.start = time;
+}
+
+FrameStats FrameProfiler::getStats() const
+{
+    FrameStats stats;
+    stats.numFrames = numFrames;
+
+    if (numFrames == 0)
+        return stats;
+
+    uint64_t totalInterval = 0;
+    uint64_t totalBusy = 0;
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        const Frame& frame = frames[(size_t) i];
+
+        uint64_t busy = 0;
+
+        for (int s = 0; s < numFrameStages; s++)
+        {
+            busy += frame.stageNanoseconds[s];
+            stats.stageMs[s] += (double) frame.stageNanoseconds[s] * 1.0e-6;
+        }
+
+        // a frame that took two intervals or more stands for the ticks skipped in between
+        const double ticks = (double) frame.interval * 1.0e-9 / refreshInterval;
+        stats.droppedFrames += std::max(0, (int) std::lround(ticks) - 1);
+
+        stats.maxFrameMs = std::max(stats.maxFrameMs, (double) busy * 1.0e-6);
+
+        totalInterval += frame.interval;
+        totalBusy += busy;
+    }
+
+    for (double& ms : stats.stageMs)
+        ms /= (double) numFrames;
+
+    stats.meanFrameMs = (double) totalBusy * 1.0e-6 / (double) numFrames;
+
+    if (totalInterval > 0)
+    {
+        stats.framesPerSecond = (double) numFrames / ((double) totalInterval * 1.0e-9);
+        stats.messageThreadShare = (double) totalBusy / (double) totalInterval;
+    }
+
+    return stats;
+}
@@ -0,0 +1,141 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __FRAMEPROFILER_H__
+#define __FRAMEPROFILER_H__
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace GridViewer {
+
+/** Parts of the canvas's work on a frame, from the published values to the screen */
+enum class FrameStage
+{
+    FETCH,      // latest snapshot, or a history record and its recomputation from raw
+    SCALE,      // ColourScaler
+    COLOUR_MAP, // values to colour indices, through the pyramid when zoomed out
+    FILL,       // changed cells into the image, and the repaint areas
+    PAINT       // JUCE painting of the grids
+};
+
+static constexpr int numFrameStages = 5;
+
+/** Returns a short name for a stage */
+const char* getFrameStageName(FrameStage stage);
+
+/** Rolling statistics over the most recent frames */
+struct FrameStats
+{
+    int numFrames = 0;
+    double framesPerSecond = 0.0;
+    int droppedFrames = 0;          // refresh ticks that never came
+    double meanFrameMs = 0.0;       // all stages of a frame, including its painting
+    double maxFrameMs = 0.0;
+    double stageMs[numFrameStages] = {};   // mean per frame
+    double messageThreadShare = 0.0;       // fraction of wall time spent in the stages
+};
+
+/**
+    Times the stages of the canvas's refresh-to-paint pipeline on the
+    message thread.
+
+    A frame runs from one refresh() to the next, so the painting JUCE does
+    in between is counted with the frame that caused it. Frames that
+    arrive late show up as dropped: if the Grid Viewer's own stages take
+    little of the wall time while ticks are being dropped, the message
+    thread is busy with something else.
+ */
+class FrameProfiler
+{
+public:
+    /** refreshInterval is the time the refresh timer is set to, in seconds */
+    FrameProfiler(double refreshInterval, int numFramesKept);
+
+    /** Monotonic clock in nanoseconds */
+    static uint64_t now()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Starts or stops timing; stopping discards the frames kept so far */
+    void setEnabled(bool shouldBeEnabled);
+
+    bool isEnabled() const { return enabled; }
+
+    /** Ends the current frame and starts the next one; called at each refresh */
+    void beginFrame();
+
+    /** Adds time spent in a stage to the current frame */
+    void addStageTime(FrameStage stage, uint64_t nanoseconds)
+    {
+        current.stageNanoseconds[(int) stage] += nanoseconds;
+    }
+
+    /** Returns statistics over the frames kept */
+    FrameStats getStats() const;
+
+    /** Times the enclosing scope as part of a stage, if the profiler is enabled */
+    class ScopedStage
+    {
+    public:
+        ScopedStage(FrameProfiler& profiler_, FrameStage stage_)
+            : profiler(profiler_), stage(stage_), start(profiler_.enabled ? now() : 0) { }
+
+        ~ScopedStage()
+        {
+            if (start != 0)
+                profiler.addStageTime(stage, now() - start);
+        }
+
+    private:
+        FrameProfiler& profiler;
+        const FrameStage stage;
+        const uint64_t start;
+    };
+
+private:
+    struct Frame
+    {
+        uint64_t start = 0;
+        uint64_t interval = 0; // until the next frame started
+        uint64_t stageNanoseconds[numFrameStages] = {};
+    };
+
+    const double refreshInterval;
+
+    bool enabled;
+
+    Frame current;
+
+    std::vector<Frame> frames; // ring of completed frames
+    int newestFrame;
+    int numFrames;
+};
+
+}
+
+#endif /* __FRAMEPROFILER_H__ */
@@ -31,28 +31,609 @@
 #include "GridViewerEditor.h"
 
 #include "ColourScheme.h"
+#include "TraceRecorder.h"
 
 using namespace GridViewer;
 
-void Electrode::setColour(Colour c_)
+namespace {
+    // margin around the grid
+    const int MARGIN = 20;
+
+    // frames the canvas asks for per second, and how many of them the profiler overlay covers
+    const int REFRESH_RATE = 30;
+    const int PROFILED_FRAMES = 60;
+
+    // the overlay text changes twice a second, so it stays readable and adds little painting of its own
+    const int OVERLAY_UPDATE_FRAMES = 15;
+
+    // height of the options bar below the grids: display options, then the history controls
+    const int OPTIONS_HEIGHT = 60;
+
+    // the scrub position has to rest this long before a frame is recomputed from raw samples,
+    // which then is checked for this often until it is done
+    const int RECOMPUTE_DELAY_MS = 200;
+    const int RECOMPUTE_POLL_MS = 50;
+
+    // height of the stream name above each grid, and the gap between tiled grids
+    const int PANE_HEADER_HEIGHT = 20;
+    const int PANE_GAP = 10;
+
+    // crossing threshold choices: 0 is the node's fixed threshold, otherwise a multiple of the noise level
+    const float THRESHOLD_MULTIPLIERS[] = { 0.0f, 3.5f, 4.0f, 4.5f, 5.0f, 6.0f };
+    const int NUM_THRESHOLD_MULTIPLIERS = (int) (sizeof(THRESHOLD_MULTIPLIERS) / sizeof(THRESHOLD_MULTIPLIERS[0]));
+
+    // cell sizes in pixels for zoom levels from 0 up; spacing between cells is a quarter of the size.
+    // Negative zoom level -k draws pyramid level k at one pixel per pooled cell.
+    const int CELL_SIZES[] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32 };
+    const int NUM_ZOOM_LEVELS = (int) (sizeof(CELL_SIZES) / sizeof(CELL_SIZES[0]));
+    const int DEFAULT_ZOOM_LEVEL = 5;
+
+    int getCellSizeForZoomLevel(int level)
+    {
+        return level >= 0 ? CELL_SIZES[level] : 1;
+    }
+
+    int getPitchForZoomLevel(int level)
+    {
+        return getCellSizeForZoomLevel(level) + getCellSizeForZoomLevel(level) / 4;
+    }
+
+    /** Pixels per layout cell at a zoom level */
+    double getScaleForZoomLevel(int level)
+    {
+        return level >= 0 ? (double) getPitchForZoomLevel(level) : 1.0 / (double) (1 << -level);
+    }
+
+    // beyond this many dirty rectangles a single repaint of the visible area is cheaper
+    const int MAX_DIRTY_RECTANGLES = 64;
+}
+
+#pragma mark - StreamDisplay -
+
+StreamDisplay::StreamDisplay(GridViewerCanvas* canvas,
+                             uint32 streamId_,
+                             int numChannels_,
+                             const std::vector<ChannelMapEntry>* channelMap)
+    : streamId(streamId_),
+      numChannels(numChannels_),
+      layout(channelMap != nullptr ? ElectrodeLayout(numChannels_, *channelMap)
+                                   : ElectrodeLayout(numChannels_)),
+      lastFrameDrawn(0),
+      pausedRecord(0),
+      recomputePending(false)
+{
+    view = std::make_unique<HeatmapView>(canvas, *this);
+
+    viewport = std::make_unique<GridViewerViewport>(canvas, *this);
+    viewport->setViewedComponent(view.get(), false);
+    viewport->setScrollBarsShown(true, true);
+}
+
+StreamDisplay::~StreamDisplay()
+{
+    // the viewport refers to the view, so it goes first
+    viewport.reset();
+    view.reset();
+}
+
+#pragma mark - HeatmapView -
+
+HeatmapView::HeatmapView(GridViewerCanvas* canvas_, StreamDisplay& display_)
+    : canvas(canvas_), display(display_),
+      zoomLevel(DEFAULT_ZOOM_LEVEL), pooling(ActivityPyramid::Pooling::MAX),
+      pyramidLevel(0), gridColumns(0), gridRows(0),
+      needsFullRedraw(true)
+{
+    setOpaque(true);
+
+    updateSize();
+}
+
+void HeatmapView::setVisibleArea(const Rectangle<int>& area)
+{
+    if (area == visibleArea)
+        return;
+
+    visibleArea = area;
+
+    updateVisibleCells();
+    needsFullRedraw = true;
+}
+
+void HeatmapView::setZoomLevel(int level, Point<int> anchor)
+{
+    level = jlimit(getMinZoomLevel(), NUM_ZOOM_LEVELS - 1, level);
+
+    if (level == zoomLevel)
+        return;
+
+    const Point<int> anchorInView = anchor - visibleArea.getPosition();
+    const double scale = getScaleForZoomLevel(level) / getScaleForZoomLevel(zoomLevel);
+
+    zoomLevel = level;
+
+    updateSize();
+
+    // the grid position under the anchor stays where it was on screen
+    const Point<int> scaledAnchor(MARGIN + roundToInt((anchor.x - MARGIN) * scale),
+                                  MARGIN + roundToInt((anchor.y - MARGIN) * scale));
+
+    if (auto* viewport = findParentComponentOfClass<Viewport>())
+        viewport->setViewPosition(scaledAnchor - anchorInView);
+
+    updateVisibleCells();
+    needsFullRedraw = true;
+
+    canvas->redrawLatestFrame(display);
+}
+
+void HeatmapView::setPooling(ActivityPyramid::Pooling newPooling)
+{
+    if (newPooling == pooling)
+        return;
+
+    pooling = newPooling;
+
+    if (pyramidLevel > 0)
+    {
+        needsFullRedraw = true;
+        canvas->redrawLatestFrame(display);
+    }
+}
+
+void HeatmapView::updateSize()
+{
+    zoomLevel = jlimit(getMinZoomLevel(), NUM_ZOOM_LEVELS - 1, zoomLevel);
+    pyramidLevel = jmax(0, -zoomLevel);
+
+    if (pyramidLevel > 0)
+    {
+        if (display.pyramid == nullptr)
+            display.pyramid = std::make_unique<ActivityPyramid>(display.layout);
+
+        gridColumns = display.pyramid->getNumColumns(pyramidLevel);
+        gridRows = display.pyramid->getNumRows(pyramidLevel);
+    }
+    else
+    {
+        gridColumns = display.layout.getNumColumns();
+        gridRows = display.layout.getNumRows();
+    }
+
+    const int pitch = getCellPitch();
+
+    setSize(2 * MARGIN + gridColumns * pitch,
+            2 * MARGIN + gridRows * pitch);
+}
+
+void HeatmapView::updateVisibleCells()
+{
+    visibleCells.clear();
+    visibleChannels.clear();
+    visibleColumns = Range<int>();
+    visibleRows = Range<int>();
+
+    if (visibleArea.isEmpty())
+    {
+        heatmap = Image();
+        return;
+    }
+
+    // a software image guarantees direct access to packed PixelARGB memory
+    if (heatmap.getWidth() != visibleArea.getWidth() || heatmap.getHeight() != visibleArea.getHeight())
+        heatmap = Image(Image::ARGB, visibleArea.getWidth(), visibleArea.getHeight(), false, SoftwareImageType());
+
+    const int pitch = getCellPitch();
+
+    visibleColumns = Range<int>(jmax(0, (visibleArea.getX() - MARGIN) / pitch),
+                                jlimit(0, gridColumns, (visibleArea.getRight() - MARGIN + pitch - 1) / pitch));
+    visibleRows = Range<int>(jmax(0, (visibleArea.getY() - MARGIN) / pitch),
+                             jlimit(0, gridRows, (visibleArea.getBottom() - MARGIN + pitch - 1) / pitch));
+
+    const int* cellChannels = display.layout.getCellChannels();
+    const uint8* cellStates = pyramidLevel > 0 ? display.pyramid->getCellStates(pyramidLevel) : nullptr;
+
+    for (int row = visibleRows.getStart(); row < visibleRows.getEnd(); row++)
+    {
+        for (int column = visibleColumns.getStart(); column < visibleColumns.getEnd(); column++)
+        {
+            const int cell = row * gridColumns + column;
+
+            if (cellStates != nullptr)
+            {
+                if (cellStates[cell] == ActivityPyramid::ELECTRODE)
+                    visibleCells.push_back(cell);
+            }
+            else if (cellChannels[cell] >= 0)
+            {
+                visibleCells.push_back(cell);
+                visibleChannels.push_back(cellChannels[cell]);
+            }
+        }
+    }
+
+    const size_t numVisible = visibleCells.size();
+
+    electrodeValues.resize(numVisible);
+    colourIndices.resize(numVisible);
+    drawnColourIndices.resize(numVisible);
+}
+
+void HeatmapView::drawFrame(const float* values, int numValues, float minimum, float maximum, ColourSchemeId colourScheme)
+{
+    if (heatmap.isNull())
+        return;
+
+    GRIDVIEWER_TRACE_SCOPE("HeatmapView::drawFrame");
+
+    const ElectrodeLayout& layout = display.layout;
+    const int numColumns = gridColumns;
+    const int numVisible = (int) visibleCells.size();
+    const int* cells = visibleCells.data();
+
+    uint8* indices = colourIndices.data();
+    uint8* drawnIndices = drawnColourIndices.data();
+
+    // before the first frame arrives every connected electrode is drawn grey
+    const bool hasData = values != nullptr;
+
+    const float scale = 1.0f / (maximum - minimum);
+    const float offset = -minimum * scale;
+
+    FrameProfiler& profiler = canvas->getFrameProfiler();
+
+    if (hasData)
+    {
+        FrameProfiler::ScopedStage stage(profiler, FrameStage::COLOUR_MAP);
+
+        if (pyramidLevel > 0)
+        {
+            ActivityPyramid& pyramid = *display.pyramid;
+            pyramid.update(values, numValues, scale, offset);
+
+            const uint8* pooled = pyramid.getColourIndices(pyramidLevel, pooling);
+
+            for (int i = 0; i < numVisible; i++)
+                indices[i] = pooled[cells[i]];
+        }
+        else
+        {
+            const int* channels = visibleChannels.data();
+            float* visibleValues = electrodeValues.data();
+
+            for (int i = 0; i < numVisible; i++)
+                visibleValues[i] = channels[i] < numValues ? values[channels[i]] : 0.0f;
+
+            ColourMaps::mapIndices(visibleValues, indices, numVisible, scale, offset);
+        }
+    }
+
+    // from here on: the changed cells and the areas to repaint
+    FrameProfiler::ScopedStage stage(profiler, FrameStage::FILL);
+
+    const PixelARGB* colours = ColourScheme::getPixelTable(colourScheme);
+    const PixelARGB connected = Colours::grey.getPixelARGB();
+    const bool redrawAll = needsFullRedraw || ! hasData;
+
+    RectangleList<int> dirtyArea;
+    bool repaintAll = redrawAll;
+
+    if (redrawAll)
+        heatmap.clear(heatmap.getBounds(), Colours::darkgrey);
+
+    {
+        Image::BitmapData pixels(heatmap, Image::BitmapData::writeOnly);
+
+        if (redrawAll)
+        {
+            // cells left empty by a channel map show the background, so the array's shape is visible
+            const PixelARGB unused = Colours::black.getPixelARGB();
+            const bool drawEmptyCells = ! layout.isFromChannelMap();
+            const int* cellChannels = layout.getCellChannels();
+            const uint8* cellStates = pyramidLevel > 0 ? display.pyramid->getCellStates(pyramidLevel) : nullptr;
+
+            for (int row = visibleRows.getStart(); row < visibleRows.getEnd(); row++)
+            {
+                for (int column = visibleColumns.getStart(); column < visibleColumns.getEnd(); column++)
+                {
+                    const int cell = row * numColumns + column;
+
+                    const bool isUnused = cellStates != nullptr
+                        ? cellStates[cell] == ActivityPyramid::UNUSED
+                        : (cellChannels[cell] == ElectrodeLayout::disabledCell
+                           || (cellChannels[cell] == ElectrodeLayout::emptyCell && drawEmptyCells));
+
+                    if (isUnused)
+                        fillCell(pixels, cell, unused);
+                }
+            }
+        }
+
+        // changed electrodes in neighbouring cells of a row become one rectangle
+        int runStart = -1;
+
+        for (int i = 0; i <= numVisible; i++)
+        {
+            const bool changed = i < numVisible && (redrawAll || indices[i] != drawnIndices[i]);
+
+            const bool continuesRun = changed && runStart >= 0
+                                      && cells[i] == cells[i - 1] + 1
+                                      && cells[i] % numColumns != 0;
+
+            if (runStart >= 0 && ! continuesRun)
+            {
+                if (! repaintAll)
+                    dirtyArea.addWithoutMerging(getCellBounds(cells[runStart])
+                                                    .getUnion(getCellBounds(cells[i - 1])));
+
+                repaintAll = repaintAll || dirtyArea.getNumRectangles() > MAX_DIRTY_RECTANGLES;
+                runStart = -1;
+            }
+
+            if (changed)
+            {
+                if (hasData)
+                {
+                    drawnIndices[i] = indices[i];
+                    fillCell(pixels, cells[i], colours[indices[i]]);
+                }
+                else
+                {
+                    fillCell(pixels, cells[i], connected);
+                }
+
+                if (runStart < 0)
+                    runStart = i;
+            }
+        }
+    }
+
+    // the grey placeholder has no colour indices, so the first real frame redraws everything
+    needsFullRedraw = ! hasData;
+
+    if (repaintAll)
+    {
+        repaint(visibleArea);
+        return;
+    }
+
+    dirtyArea.consolidate();
+
+    for (auto& area : dirtyArea)
+        repaint(area);
+}
+
+void HeatmapView::fillCell(Image::BitmapData& pixels, int cell, PixelARGB colour) const
+{
+    const Rectangle<int> area = getCellBounds(cell)
+                                    .translated(-visibleArea.getX(), -visibleArea.getY())
+                                    .getIntersection(heatmap.getBounds());
+
+    for (int y = area.getY(); y < area.getBottom(); y++)
+    {
+        PixelARGB* line = reinterpret_cast<PixelARGB*>(pixels.getPixelPointer(area.getX(), y));
+
+        for (int x = 0; x < area.getWidth(); x++)
+            line[x] = colour;
+    }
+}
+
+Rectangle<int> HeatmapView::getCellBounds(int cell) const
+{
+    const int column = cell % gridColumns;
+    const int row = cell / gridColumns;
+    const int pitch = getCellPitch();
+
+    return Rectangle<int>(MARGIN + column * pitch,
+                          MARGIN + row * pitch,
+                          getCellSize(),
+                          getCellSize());
+}
+
+int HeatmapView::getCellSize() const
+{
+    return getCellSizeForZoomLevel(zoomLevel);
+}
+
+int HeatmapView::getCellPitch() const
+{
+    return getPitchForZoomLevel(zoomLevel);
+}
+
+int HeatmapView::getMinZoomLevel() const
 {
-    c = c_;
-    //repaint();
+    return 1 - ActivityPyramid::getNumLevels(display.layout.getNumColumns(), display.layout.getNumRows());
 }
 
-void Electrode::paint(Graphics& g)
+void HeatmapView::paint(Graphics& g)
 {
-    g.fillAll(c);
+    GRIDVIEWER_TRACE_SCOPE("HeatmapView::paint");
+    FrameProfiler::ScopedStage stage(canvas->getFrameProfiler(), FrameStage::PAINT);
+
+    g.fillAll(Colours::darkgrey);
+
+    if (heatmap.isValid())
+        g.drawImageAt(heatmap, visibleArea.getX(), visibleArea.getY());
+}
+
+void HeatmapView::mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel)
+{
+    // ctrl/cmd + wheel zooms around the pointer; a plain wheel scrolls the viewport
+    if (event.mods.isCommandDown())
+    {
+        if (wheel.deltaY != 0)
+            setZoomLevel(zoomLevel + (wheel.deltaY > 0 ? 1 : -1), event.getPosition());
+
+        return;
+    }
+
+    Component::mouseWheelMove(event, wheel);
+}
+
+void HeatmapView::mouseDown(const MouseEvent&)
+{
+    if (auto* viewport = findParentComponentOfClass<Viewport>())
+        dragStartPosition = viewport->getViewPosition();
+}
+
+void HeatmapView::mouseDrag(const MouseEvent& event)
+{
+    if (auto* viewport = findParentComponentOfClass<Viewport>())
+        viewport->setViewPosition(dragStartPosition - event.getOffsetFromDragStart());
 }
 
 #pragma mark - GridViewerCanvas -
 
 GridViewerCanvas::GridViewerCanvas(GridViewerNode * node_)
-    : node(node_), numChannels(0)
+    : node(node_),
+      frameProfiler(1.0 / REFRESH_RATE, PROFILED_FRAMES),
+      framesSinceOverlayUpdate(0),
+      selectedStream(0), showAllStreams(false),
+      metric(ActivityMetric::PEAK_TO_PEAK),
+      colourScaling(ColourScaling::FIXED),
+      paused(false),
+      drawnColourScheme(ColourScheme::getColourScheme()),
+      recomputeTimer(*this)
 {
-    refreshRate = 30;
+    refreshRate = REFRESH_RATE;
+
+    poolingLabel = std::make_unique<Label>("Pooling Label", "Zoomed out:");
+    addAndMakeVisible(poolingLabel.get());
+
+    poolingSelection = std::make_unique<ComboBox>("Pooling Selection");
+    poolingSelection->addItem("Max", 1);
+    poolingSelection->addItem("Mean", 2);
+    poolingSelection->setSelectedId(1, dontSendNotification);
+    poolingSelection->onChange = [this]
+    {
+        const auto pooling = poolingSelection->getSelectedId() == 2 ? ActivityPyramid::Pooling::MEAN
+                                                                    : ActivityPyramid::Pooling::MAX;
+
+        for (auto* streamDisplay : streamDisplays)
+            streamDisplay->view->setPooling(pooling);
+    };
+    addAndMakeVisible(poolingSelection.get());
+
+    streamLayoutLabel = std::make_unique<Label>("Stream Layout Label", "Streams:");
+    addAndMakeVisible(streamLayoutLabel.get());
+
+    streamLayoutSelection = std::make_unique<ComboBox>("Stream Layout Selection");
+    streamLayoutSelection->addItem("Selected", 1);
+    streamLayoutSelection->addItem("All", 2);
+    streamLayoutSelection->setSelectedId(1, dontSendNotification);
+    streamLayoutSelection->onChange = [this]
+    {
+        showAllStreams = streamLayoutSelection->getSelectedId() == 2;
+        layoutStreams();
+    };
+    addAndMakeVisible(streamLayoutSelection.get());
+
+    metricLabel = std::make_unique<Label>("Metric Label", "Colour:");
+    addAndMakeVisible(metricLabel.get());
+
+    metricSelection = std::make_unique<ComboBox>("Metric Selection");
+
+    for (int i = 0; i < numActivityMetrics; i++)
+        metricSelection->addItem(getMetricRange((ActivityMetric) i).name, i + 1);
+
+    metricSelection->setSelectedId(1, dontSendNotification);
+    metricSelection->onChange = [this]
+    {
+        metric = (ActivityMetric) (metricSelection->getSelectedId() - 1);
+
+        // every metric is in each frame already, so switching redraws at once
+        for (auto* streamDisplay : streamDisplays)
+        {
+            streamDisplay->scaler.reset();
+            streamDisplay->historyScaler.reset();
+            streamDisplay->lastFrameDrawn = 0;
+            redrawLatestFrame(*streamDisplay);
+        }
+    };
+    addAndMakeVisible(metricSelection.get());
+
+    thresholdLabel = std::make_unique<Label>("Threshold Label", "Threshold:");
+    addAndMakeVisible(thresholdLabel.get());
+
+    thresholdSelection = std::make_unique<ComboBox>("Threshold Selection");
+    thresholdSelection->addItem(String(node->getCrossingThreshold()) + " uV", 1);
+
+    for (int i = 1; i < NUM_THRESHOLD_MULTIPLIERS; i++)
+    {
+        thresholdSelection->addItem(String(THRESHOLD_MULTIPLIERS[i]) + " x MAD", i + 1);
+
+        if (THRESHOLD_MULTIPLIERS[i] == node->getThresholdMultiplier())
+            thresholdSelection->setSelectedId(i + 1, dontSendNotification);
+    }
+
+    if (thresholdSelection->getSelectedId() == 0)
+        thresholdSelection->setSelectedId(1, dontSendNotification);
+
+    thresholdSelection->onChange = [this]
+    {
+        node->setParameter(5, THRESHOLD_MULTIPLIERS[thresholdSelection->getSelectedId() - 1]);
+    };
+    addAndMakeVisible(thresholdSelection.get());
+
+    scalingLabel = std::make_unique<Label>("Scaling Label", "Scale:");
+    addAndMakeVisible(scalingLabel.get());
+
+    // item IDs are the ColourScaling value plus one
+    scalingSelection = std::make_unique<ComboBox>("Scaling Selection");
+    scalingSelection->addItem("Fixed", 1);
+    scalingSelection->addItem("Auto (2-98%)", 2);
+    scalingSelection->addItem("Per channel", 3);
+    scalingSelection->setSelectedId(1, dontSendNotification);
+    scalingSelection->onChange = [this]
+    {
+        colourScaling = (ColourScaling) (scalingSelection->getSelectedId() - 1);
+
+        for (auto* streamDisplay : streamDisplays)
+        {
+            streamDisplay->scaler.setMode(colourScaling);
+            streamDisplay->historyScaler.setMode(colourScaling);
+            streamDisplay->lastFrameDrawn = 0;
+            redrawLatestFrame(*streamDisplay);
+        }
+    };
+    addAndMakeVisible(scalingSelection.get());
 
-    updateElectrodeGrid(64);
+    pauseButton = std::make_unique<TextButton>("Pause");
+    pauseButton->setClickingTogglesState(true);
+    pauseButton->onClick = [this] { setPaused(pauseButton->getToggleState()); };
+    addAndMakeVisible(pauseButton.get());
+
+    scrubSlider = std::make_unique<Slider>(Slider::LinearHorizontal, Slider::TextBoxRight);
+    scrubSlider->setRange(-1.0, 0.0, 0.04);
+    scrubSlider->setValue(0.0, dontSendNotification);
+    scrubSlider->setTextValueSuffix(" s");
+    scrubSlider->setEnabled(false);
+    scrubSlider->onValueChange = [this]
+    {
+        for (auto* streamDisplay : streamDisplays)
+            drawHistoryFrame(*streamDisplay);
+    };
+    addAndMakeVisible(scrubSlider.get());
+
+    historySourceLabel = std::make_unique<Label>("History Source Label", "");
+    addAndMakeVisible(historySourceLabel.get());
+
+    profilerOverlay = std::make_unique<FrameProfilerOverlay>();
+    addChildComponent(profilerOverlay.get());
+
+    profileButton = std::make_unique<TextButton>("Profile");
+    profileButton->setClickingTogglesState(true);
+    profileButton->onClick = [this]
+    {
+        const bool profiling = profileButton->getToggleState();
+
+        frameProfiler.setEnabled(profiling);
+        framesSinceOverlayUpdate = 0;
+
+        profilerOverlay->setStats(FrameStats());
+        profilerOverlay->setVisible(profiling);
+    };
+    addAndMakeVisible(profileButton.get());
 }
 
 GridViewerCanvas::~GridViewerCanvas()
@@ -65,7 +646,35 @@ void GridViewerCanvas::refreshState()
 
 void GridViewerCanvas::update()
 {
+    const Array<uint32> streamIds = node->getStreamIds();
+
+    // keep the displays of streams that still exist with the same channel count
+    OwnedArray<StreamDisplay> updated;
+
+    for (uint32 subProcId : streamIds)
+    {
+        StreamDisplay* existing = nullptr;
+
+        for (int i = 0; i < streamDisplays.size(); i++)
+        {
+            if (streamDisplays[i]->streamId == subProcId
+                && streamDisplays[i]->numChannels == node->getSubprocessorChanCount(subProcId))
+            {
+                existing = streamDisplays.removeAndReturn(i);
+                break;
+            }
+        }
 
+        updated.add(existing != nullptr ? existing : createStreamDisplay(subProcId));
+    }
+
+    // displays left behind are deleted with the old array
+    streamDisplays.swapWith(updated);
+
+    if (! streamIds.contains(selectedStream) && ! streamIds.isEmpty())
+        selectedStream = streamIds.getFirst();
+
+    layoutStreams();
 }
 
 void GridViewerCanvas::setParameter(int, float)
@@ -81,16 +690,289 @@ void GridViewerCanvas::setParameter(int, int, int, float)
 
 void GridViewerCanvas::refresh()
 {
-    const float* peakToPeakValues = node->getLatestValues();
+    GRIDVIEWER_TRACE_THREAD("Message");
+    GRIDVIEWER_TRACE_SCOPE("GridViewerCanvas::refresh");
 
-    //std::cout << "Refresh." << std::endl;
+    if (frameProfiler.isEnabled())
+    {
+        frameProfiler.beginFrame();
 
-    for (int i = 0; i < numChannels; i++)
+        if (++framesSinceOverlayUpdate >= OVERLAY_UPDATE_FRAMES)
+        {
+            framesSinceOverlayUpdate = 0;
+            profilerOverlay->setStats(frameProfiler.getStats());
+        }
+    }
+
+    const ColourSchemeId colourScheme = ColourScheme::getColourScheme();
+
+    if (colourScheme != drawnColourScheme)
     {
-        electrodes[i]->setColour(ColourScheme::getColourForNormalizedValue(peakToPeakValues[i] / 200));
+        drawnColourScheme = colourScheme;
+
+        // hidden streams are redrawn in full when they are shown again
+        for (auto* streamDisplay : streamDisplays)
+        {
+            streamDisplay->view->invalidate();
+            streamDisplay->lastFrameDrawn = 0;
+
+            if (paused)
+                drawHistoryFrame(*streamDisplay);
+        }
     }
 
-    repaint();
+    // the history keeps recording while the view is paused
+    if (paused)
+        return;
+
+    for (auto* streamDisplay : streamDisplays)
+    {
+        if (! isShown(*streamDisplay))
+            continue;
+
+        const ActivitySnapshot* frame;
+
+        {
+            FrameProfiler::ScopedStage stage(frameProfiler, FrameStage::FETCH);
+            frame = node->getLatestSnapshot(streamDisplay->streamId);
+        }
+
+        // nothing new has been published since the last refresh
+        if (frame == nullptr || frame->frameCounter == streamDisplay->lastFrameDrawn)
+            continue;
+
+        drawSnapshot(*streamDisplay, *frame);
+    }
+}
+
+void GridViewerCanvas::redrawLatestFrame(StreamDisplay& streamDisplay)
+{
+    if (! isShown(streamDisplay))
+        return;
+
+    if (paused)
+    {
+        drawHistoryFrame(streamDisplay);
+        return;
+    }
+
+    const ActivitySnapshot* frame = node->getLatestSnapshot(streamDisplay.streamId);
+
+    // frame counters start at 1, so 0 means nothing has been published yet
+    if (frame == nullptr || frame->frameCounter == 0)
+    {
+        streamDisplay.view->drawFrame(nullptr, 0, 0.0f, 1.0f, drawnColourScheme);
+        return;
+    }
+
+    drawSnapshot(streamDisplay, *frame);
+}
+
+void GridViewerCanvas::setPaused(bool shouldPause)
+{
+    paused = shouldPause;
+
+    double historyLength = 0.0;
+
+    for (auto* streamDisplay : streamDisplays)
+    {
+        const FrameHistory* history = node->getFrameHistory(streamDisplay->streamId);
+
+        streamDisplay->pausedRecord = history != nullptr ? history->getNewestRecord() : 0;
+        streamDisplay->lastFrameDrawn = 0;
+
+        // history frames are compared with the baselines as they were at the moment of pausing
+        if (paused)
+        {
+            streamDisplay->historyScaler = streamDisplay->scaler;
+            streamDisplay->historyScaler.setBaselinesHeld(true);
+        }
+
+        if (history != nullptr && streamDisplay->pausedRecord > 0)
+        {
+            const uint64 available = streamDisplay->pausedRecord - history->getOldestRecord();
+            historyLength = jmax(historyLength, (double) available / (double) history->getFrameRate());
+        }
+    }
+
+    // recomputes asked for while paused are no longer wanted
+    for (auto* streamDisplay : streamDisplays)
+        streamDisplay->recomputePending = false;
+
+    recomputeTimer.stopTimer();
+
+    scrubSlider->setEnabled(paused && historyLength > 0.0);
+    scrubSlider->setRange(-jmax(historyLength, 1.0), 0.0, 0.04);
+    scrubSlider->setValue(0.0, dontSendNotification);
+    historySourceLabel->setText("", dontSendNotification);
+
+    // live frames are picked up again by the next refresh
+    for (auto* streamDisplay : streamDisplays)
+        redrawLatestFrame(*streamDisplay);
+}
+
+void GridViewerCanvas::drawHistoryFrame(StreamDisplay& streamDisplay)
+{
+    GRIDVIEWER_TRACE_SCOPE("GridViewerCanvas::drawHistoryFrame");
+
+    if (! isShown(streamDisplay))
+        return;
+
+    const FrameHistory* history = node->getFrameHistory(streamDisplay.streamId);
+
+    if (history == nullptr || streamDisplay.pausedRecord == 0)
+    {
+        streamDisplay.view->drawFrame(nullptr, 0, 0.0f, 1.0f, drawnColourScheme);
+        return;
+    }
+
+    const uint64 back = (uint64) roundToInt(-scrubSlider->getValue() * history->getFrameRate());
+    uint64 record = streamDisplay.pausedRecord > back ? streamDisplay.pausedRecord - back : 1;
+
+    if (streamDisplay.historyFrame.numChannels != streamDisplay.numChannels)
+        streamDisplay.historyFrame.allocate(streamDisplay.numChannels);
+
+    bool found = false;
+    bool exact = false;
+
+    RawHistory::AnalysisRequest request;
+    RawHistory* raw = nullptr;
+
+    {
+        FrameProfiler::ScopedStage stage(frameProfiler, FrameStage::FETCH);
+
+        // records overwritten since pausing are gone; show the oldest one left
+        for (int attempt = 0; attempt < 4 && ! found; attempt++)
+        {
+            record = jmax(record, history->getOldestRecord());
+            found = history->read(record, streamDisplay.historyFrame);
+        }
+
+        // a recompute already done for this frame is shown straight away
+        if (found)
+        {
+            raw = getRawRequest(streamDisplay, request);
+            exact = raw != nullptr && takeRecompute(streamDisplay, *raw, request) == RawHistory::AnalysisStatus::READY;
+        }
+    }
+
+    if (! found)
+        return;
+
+    // others are asked for once the scrub position rests, while the 8-bit frame is shown
+    streamDisplay.recomputePending = raw != nullptr && ! exact;
+
+    if (streamDisplay.recomputePending)
+        recomputeTimer.startTimer(RECOMPUTE_DELAY_MS);
+
+    // drawn outside the fetch, so the scale and colour stages are not counted twice
+    historySourceLabel->setText(exact ? "Recomputed from raw" : "8-bit history", dontSendNotification);
+    drawSnapshot(streamDisplay, streamDisplay.historyFrame);
+}
+
+RawHistory* GridViewerCanvas::getRawRequest(const StreamDisplay& streamDisplay, RawHistory::AnalysisRequest& request)
+{
+    RawHistory* raw = node->getRawHistory();
+
+    if (raw == nullptr || raw->getStreamId() != streamDisplay.streamId || raw->getNumChannels() != streamDisplay.numChannels)
+        return nullptr;
+
+    // adaptive thresholds depend on noise estimates that are not kept
+    if (metric == ActivityMetric::CROSSING_RATE && node->getThresholdMultiplier() > 0.0f)
+        return nullptr;
+
+    const ActivitySnapshot& frame = streamDisplay.historyFrame;
+
+    if (frame.numSamples <= 0)
+        return nullptr;
+
+    // a frame's timestamp is the end of its interval, which covers whole blocks
+    request.end = frame.sampleTimestamp;
+    request.start = frame.sampleTimestamp - frame.numSamples;
+    request.band = node->getFilterBand();
+    request.threshold = node->getCrossingThreshold();
+
+    return raw;
+}
+
+RawHistory::AnalysisStatus GridViewerCanvas::takeRecompute(StreamDisplay& streamDisplay,
+                                                           const RawHistory& raw,
+                                                           const RawHistory::AnalysisRequest& request)
+{
+    // the record keeps its own frame counter, so the scaler sees the same frame
+    const uint64 frameCounter = streamDisplay.historyFrame.frameCounter;
+    const RawHistory::AnalysisStatus status = raw.getAnalysis(request, streamDisplay.historyFrame);
+
+    streamDisplay.historyFrame.frameCounter = frameCounter;
+
+    return status;
+}
+
+void GridViewerCanvas::updateRecomputes()
+{
+    GRIDVIEWER_TRACE_SCOPE("GridViewerCanvas::updateRecomputes");
+
+    bool waiting = false;
+
+    for (auto* streamDisplay : streamDisplays)
+    {
+        if (! streamDisplay->recomputePending)
+            continue;
+
+        RawHistory::AnalysisRequest request;
+        RawHistory* raw = paused ? getRawRequest(*streamDisplay, request) : nullptr;
+
+        if (raw == nullptr)
+        {
+            streamDisplay->recomputePending = false;
+            continue;
+        }
+
+        raw->requestAnalysis(request);
+
+        const RawHistory::AnalysisStatus status = takeRecompute(*streamDisplay, *raw, request);
+
+        if (status == RawHistory::AnalysisStatus::PENDING)
+        {
+            waiting = true;
+            continue;
+        }
+
+        streamDisplay->recomputePending = false;
+
+        if (status == RawHistory::AnalysisStatus::READY && isShown(*streamDisplay))
+        {
+            historySourceLabel->setText("Recomputed from raw", dontSendNotification);
+            drawSnapshot(*streamDisplay, streamDisplay->historyFrame);
+        }
+    }
+
+    if (waiting)
+        recomputeTimer.startTimer(RECOMPUTE_POLL_MS);
+    else
+        recomputeTimer.stopTimer();
+}
+
+void GridViewerCanvas::drawSnapshot(StreamDisplay& streamDisplay, const ActivitySnapshot& frame)
+{
+    GRIDVIEWER_TRACE_SCOPE("GridViewerCanvas::drawSnapshot");
+
+    const MetricRange& range = getMetricRange(metric);
+
+    // everything drawn while paused comes from the history
+    ColourScaler& scaler = paused ? streamDisplay.historyScaler : streamDisplay.scaler;
+
+    const float* values;
+
+    {
+        FrameProfiler::ScopedStage stage(frameProfiler, FrameStage::SCALE);
+        values = scaler.process(frame.getValues(metric), frame.numChannels,
+                                range.minimum, range.maximum, frame.frameCounter);
+    }
+
+    streamDisplay.lastFrameDrawn = frame.frameCounter;
+    streamDisplay.view->drawFrame(values, frame.numChannels,
+                                  scaler.getMinimum(), scaler.getMaximum(), drawnColourScheme);
 }
 
 void GridViewerCanvas::beginAnimation()
@@ -109,91 +991,213 @@ void GridViewerCanvas::endAnimation()
 
 void GridViewerCanvas::updateCanvasSubprocessor(uint32 subProcId)
 {
-    numChannels = node->getSubprocessorChanCount(subProcId);
+    selectedStream = subProcId;
 
-    std::cout << "Canvas subprocessor: " << subProcId << ", num of channels: " << numChannels << std::endl;
+    std::cout << "Canvas subprocessor: " << subProcId << std::endl;
 
-    int numColumns = 0;
+    // every stream already has its display, so this only changes which one is visible
+    if (! showAllStreams)
+        layoutStreams();
+}
 
-    if(numChannels <= 64)
-        numColumns = 8;
-    else if(numChannels > 64 && numChannels <= 256)
-        numColumns = 16;
-    else if(numChannels > 256 && numChannels <= 1024)
-        numColumns = 32;
-    else if(numChannels > 1024 && numChannels <= 4096)
-        numColumns = 64;
-    else
+void GridViewerCanvas::channelMapChanged(uint32 subProcId)
+{
+    for (int i = 0; i < streamDisplays.size(); i++)
     {
-        numColumns = 64;
-        numChannels = 4096;
+        if (streamDisplays[i]->streamId == subProcId)
+        {
+            streamDisplays.set(i, createStreamDisplay(subProcId), true);
+            break;
+        }
     }
 
-    updateElectrodeGrid(numColumns);
+    layoutStreams();
+}
 
-    for (int i = 0; i < electrodes.size(); i++)
-    {
-        if (i < numChannels)
-            electrodes[i]->setColour(Colours::grey);
-        else
-            electrodes[i]->setColour(Colours::black);
-    }
-        
+void GridViewerCanvas::visibleAreaChanged(StreamDisplay& streamDisplay, const Rectangle<int>& newVisibleArea)
+{
+    streamDisplay.view->setVisibleArea(newVisibleArea);
 
-    repaint();
+    redrawLatestFrame(streamDisplay);
+}
+
+StreamDisplay* GridViewerCanvas::createStreamDisplay(uint32 subProcId)
+{
+    const int numChannels = node->getSubprocessorChanCount(subProcId);
+
+    auto* streamDisplay = new StreamDisplay(this, subProcId, numChannels, node->getChannelMap(subProcId));
+
+    streamDisplay->view->setPooling(poolingSelection->getSelectedId() == 2 ? ActivityPyramid::Pooling::MEAN
+                                                                           : ActivityPyramid::Pooling::MAX);
+
+    streamDisplay->scaler.setMode(colourScaling);
+    streamDisplay->historyScaler.setMode(colourScaling);
+
+    // a frame reaches the scaler at most once per refresh, however fast the node publishes
+    streamDisplay->scaler.setUpdateRate(jmin((float) REFRESH_RATE, node->getSnapshotRate()));
+
+    addChildComponent(streamDisplay->viewport.get());
+
+    std::cout << "Canvas stream " << subProcId << ", num of channels: " << numChannels
+              << ", grid: " << streamDisplay->layout.getNumColumns() << "x" << streamDisplay->layout.getNumRows() << std::endl;
+
+    return streamDisplay;
+}
+
+bool GridViewerCanvas::isShown(const StreamDisplay& streamDisplay) const
+{
+    return showAllStreams || streamDisplay.streamId == selectedStream;
 }
 
-void GridViewerCanvas::updateElectrodeGrid(int numCols)
+void GridViewerCanvas::layoutStreams()
 {
-    const int totalPixels = numCols * numCols; 
+    const Rectangle<int> area = getStreamArea();
 
-    const int LEFT_BOUND = 20;
-    const int TOP_BOUND = 20;
-    const int SPACING = 2;
-    const int NUM_COLUMNS = numCols;
-    const int HEIGHT = 8;
-    const int WIDTH = 8;
+    int numShown = 0;
 
-    electrodes.clear();
+    for (auto* streamDisplay : streamDisplays)
+        if (isShown(*streamDisplay))
+            numShown++;
 
-    for (int i = 0; i < totalPixels; i++)
+    const int paneWidth = numShown > 0 ? (area.getWidth() - (numShown - 1) * PANE_GAP) / numShown : 0;
+
+    int x = area.getX();
+
+    for (auto* streamDisplay : streamDisplays)
     {
-        Electrode* e = new Electrode();
+        const bool shown = isShown(*streamDisplay);
 
-        int column = i % NUM_COLUMNS;
-        int row = i / NUM_COLUMNS;
-        int L = LEFT_BOUND + column * (WIDTH + SPACING);
-        int T = TOP_BOUND + row * (HEIGHT + SPACING);
+        if (shown)
+        {
+            streamDisplay->viewport->setBounds(x, area.getY() + PANE_HEADER_HEIGHT,
+                                               paneWidth, area.getHeight() - PANE_HEADER_HEIGHT);
+            x += paneWidth + PANE_GAP;
+        }
 
-        e->setBounds(L,
-            T,
-            WIDTH,
-            HEIGHT);
+        streamDisplay->viewport->setVisible(shown);
 
-        addAndMakeVisible(e);
-        electrodes.add(e);
+        if (shown)
+            redrawLatestFrame(*streamDisplay);
     }
+
+    // viewports of new streams are added above it
+    profilerOverlay->toFront(false);
+
+    repaint();
+}
+
+Rectangle<int> GridViewerCanvas::getStreamArea() const
+{
+    return getLocalBounds().withTrimmedBottom(OPTIONS_HEIGHT);
 }
 
 void GridViewerCanvas::paint(Graphics &g)
 {
+    GRIDVIEWER_TRACE_SCOPE("GridViewerCanvas::paint");
+    FrameProfiler::ScopedStage stage(frameProfiler, FrameStage::PAINT);
 
     g.fillAll(Colours::darkgrey);
+
+    g.setColour(Colours::white);
+    g.setFont(14.0f);
+
+    for (auto* streamDisplay : streamDisplays)
+    {
+        if (! streamDisplay->viewport->isVisible())
+            continue;
+
+        const Rectangle<int> pane = streamDisplay->viewport->getBounds();
+
+        g.drawText(node->getSubprocessorNameForId(streamDisplay->streamId)
+                       + " (" + String(streamDisplay->numChannels) + " channels)",
+                   pane.getX() + 5, pane.getY() - PANE_HEADER_HEIGHT, pane.getWidth() - 10, PANE_HEADER_HEIGHT,
+                   Justification::centredLeft);
+    }
+
 }
 
 void GridViewerCanvas::resized()
 {
-    //viewport->setBounds(0,
-    //                    0,
-     //                   getWidth(),
-     //                   getHeight());
+    layoutStreams();
+
+    poolingLabel->setBounds(10, getHeight() - OPTIONS_HEIGHT + 3, 80, 24);
+    poolingSelection->setBounds(90, getHeight() - OPTIONS_HEIGHT + 5, 80, 20);
+
+    streamLayoutLabel->setBounds(190, getHeight() - OPTIONS_HEIGHT + 3, 65, 24);
+    streamLayoutSelection->setBounds(255, getHeight() - OPTIONS_HEIGHT + 5, 90, 20);
+
+    metricLabel->setBounds(365, getHeight() - OPTIONS_HEIGHT + 3, 55, 24);
+    metricSelection->setBounds(420, getHeight() - OPTIONS_HEIGHT + 5, 120, 20);
+
+    thresholdLabel->setBounds(560, getHeight() - OPTIONS_HEIGHT + 3, 75, 24);
+    thresholdSelection->setBounds(635, getHeight() - OPTIONS_HEIGHT + 5, 100, 20);
+
+    scalingLabel->setBounds(755, getHeight() - OPTIONS_HEIGHT + 3, 50, 24);
+    scalingSelection->setBounds(805, getHeight() - OPTIONS_HEIGHT + 5, 110, 20);
+
+    pauseButton->setBounds(10, getHeight() - 25, 70, 20);
+    scrubSlider->setBounds(90, getHeight() - 25, jmax(getWidth() - 260, 100), 20);
+    historySourceLabel->setBounds(jmax(getWidth() - 160, 200), getHeight() - 27, 150, 24);
+
+    profileButton->setBounds(935, getHeight() - OPTIONS_HEIGHT + 5, 60, 20);
+
+    const Rectangle<int> streamArea = getStreamArea();
+    profilerOverlay->setBounds(streamArea.getRight() - 230, streamArea.getY() + PANE_HEADER_HEIGHT + 10, 210, 140);
+
+}
+
+#pragma mark - FrameProfilerOverlay -
+
+FrameProfilerOverlay::FrameProfilerOverlay()
+{
+    // the grid underneath keeps its mouse handling
+    setInterceptsMouseClicks(false, false);
+}
+
+void FrameProfilerOverlay::setStats(const FrameStats& newStats)
+{
+    stats = newStats;
+
+    repaint();
+}
+
+void FrameProfilerOverlay::paint(Graphics& g)
+{
+    g.fillAll(Colours::black.withAlpha(0.7f));
+
+    g.setColour(Colours::white);
+    g.setFont(12.0f);
+
+    const int lineHeight = 15;
+    int y = 5;
+
+    auto drawLine = [&](const String& text)
+    {
+        g.drawText(text, 8, y, getWidth() - 16, lineHeight, Justification::centredLeft);
+        y += lineHeight;
+    };
+
+    if (stats.numFrames == 0)
+    {
+        drawLine("Profiling...");
+        return;
+    }
+
+    drawLine("Frame: " + String(stats.meanFrameMs, 2) + " ms mean, " + String(stats.maxFrameMs, 2) + " ms max");
+    drawLine(String(stats.framesPerSecond, 1) + " fps, " + String(stats.droppedFrames) + " dropped of "
+             + String(stats.numFrames + stats.droppedFrames));
+    drawLine("Grid Viewer share of GUI thread: " + String(stats.messageThreadShare * 100.0, 1) + "%");
+
+    y += 4;
 
+    for (int s = 0; s < numFrameStages; s++)
+        drawLine(String(getFrameStageName((FrameStage) s)) + ": " + String(stats.stageMs[s], 3) + " ms");
 }
 
 #pragma mark - GridViewerViewport -
 
-GridViewerViewport::GridViewerViewport(GridViewerCanvas *canvas)
-    : Viewport(), canvas(canvas)
+GridViewerViewport::GridViewerViewport(GridViewerCanvas *canvas, StreamDisplay& display_)
+    : Viewport(), canvas(canvas), display(display_)
 {
 }
 
@@ -203,5 +1207,5 @@ GridViewerViewport::~GridViewerViewport()
 
 void GridViewerViewport::visibleAreaChanged(const Rectangle<int> &newVisibleArea)
 {
-    canvas->repaint(getBoundsInParent());
+    canvas->visibleAreaChanged(display, newVisibleArea);
 }
@@ -26,19 +26,169 @@
 
 #include "VisualizerWindowHeaders.h"
 
+#include "ActivityPyramid.h"
+#include "ActivitySnapshot.h"
+#include "ColourMaps.h"
+#include "ColourScaler.h"
+#include "ElectrodeLayout.h"
+#include "FrameProfiler.h"
+#include "RawHistory.h"
+
 namespace GridViewer {
 
-class Electrode : public Component
+/**
+    Everything the canvas keeps for one input stream: the compiled electrode
+    layout, its pooled pyramid, its colour scale, and the view and viewport
+    that draw it.
+    Every stream has one for as long as it exists, so switching between
+    streams only shows and hides components.
+ */
+struct StreamDisplay
+{
+    StreamDisplay(class GridViewerCanvas* canvas,
+                  uint32 streamId,
+                  int numChannels,
+                  const std::vector<ChannelMapEntry>* channelMap);
+
+    ~StreamDisplay();
+
+    const uint32 streamId;
+    const int numChannels;
+    const ElectrodeLayout layout;
+
+    // built the first time the stream is zoomed out beyond one cell per pixel
+    std::unique_ptr<ActivityPyramid> pyramid;
+
+    std::unique_ptr<class HeatmapView> view;
+    std::unique_ptr<class GridViewerViewport> viewport;
+
+    ColourScaler scaler; // each stream has its own gain
+
+    // a copy of the live scaler taken when pausing, so scrubbing leaves the live one alone
+    ColourScaler historyScaler;
+
+    uint64 lastFrameDrawn;
+
+    // while paused: the newest history record at the moment of pausing, and the record being shown
+    uint64 pausedRecord;
+    ActivitySnapshot historyFrame;
+
+    // while paused: the 8-bit history frame is shown until its raw recompute is done
+    bool recomputePending;
+};
+
+/**
+    The electrode grid at the current zoom, as the content component of a
+    GridViewerViewport.
+
+    The component is as large as the whole grid, but only the part inside
+    the viewport is backed by an image: each frame colour-maps and draws just
+    the electrodes within the visible rectangle, so the cost of a frame
+    depends on the size of the window rather than on the channel count.
+
+    Zoom levels below one cell per pixel draw a level of the stream's
+    ActivityPyramid instead, one pooled cell per pixel.
+ */
+class HeatmapView : public Component
 {
 public:
-    Electrode() : c(Colours::grey) { }
+    HeatmapView(class GridViewerCanvas*, StreamDisplay&);
+
+    /** Called by the viewport whenever it scrolls or changes size */
+    void setVisibleArea(const Rectangle<int>& area);
+
+    /** Selects a zoom level, keeping the given point of the component still on screen */
+    void setZoomLevel(int level, Point<int> anchor);
+
+    int getZoomLevel() const { return zoomLevel; }
 
-    void setColour(Colour c);
+    /** Selects how zoomed-out views combine the electrodes under a pixel */
+    void setPooling(ActivityPyramid::Pooling pooling);
 
-    void paint(Graphics& g);
+    /**
+     *  Draws the visible electrodes for a frame of per-channel values spread
+     *  from minimum to maximum over the colour scale, repainting only the
+     *  cells that changed
+     */
+    void drawFrame(const float* values, int numValues, float minimum, float maximum, ColourSchemeId colourScheme);
+
+    /** Makes the next frame redraw every visible cell */
+    void invalidate() { needsFullRedraw = true; }
+
+    void paint(Graphics& g) override;
+
+    void mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel) override;
+    void mouseDown(const MouseEvent& event) override;
+    void mouseDrag(const MouseEvent& event) override;
 
 private:
-    Colour c;
+    /** Sets the component size to the whole grid at the current zoom */
+    void updateSize();
+
+    /** Recomputes which cells lie inside the visible area and resizes the image for it */
+    void updateVisibleCells();
+
+    /** Fills the part of a cell that lies inside the visible image */
+    void fillCell(Image::BitmapData& pixels, int cell, PixelARGB colour) const;
+
+    /** Returns the area one grid cell occupies within this component */
+    Rectangle<int> getCellBounds(int cell) const;
+
+    int getCellSize() const;
+    int getCellPitch() const;
+
+    /** Returns the lowest zoom level the stream allows */
+    int getMinZoomLevel() const;
+
+    class GridViewerCanvas* canvas;
+    StreamDisplay& display;
+
+    int zoomLevel;
+    ActivityPyramid::Pooling pooling;
+
+    // level of the pyramid drawn at the current zoom, and its size in cells (0 is the layout itself)
+    int pyramidLevel;
+    int gridColumns;
+    int gridRows;
+
+    Rectangle<int> visibleArea;
+
+    // grid columns and rows that overlap the visible area
+    Range<int> visibleColumns;
+    Range<int> visibleRows;
+
+    // covers visibleArea only
+    Image heatmap;
+
+    // per visible electrode; vectors keep their capacity, so scrolling back and forth does not allocate
+    std::vector<int> visibleCells;          // cell, in raster order
+    std::vector<int> visibleChannels;       // channel, at pyramid level 0
+    std::vector<float> electrodeValues;     // value gathered from the newest frame
+    std::vector<uint8> colourIndices;       // colour table index in the newest frame
+    std::vector<uint8> drawnColourIndices;  // colour table index currently drawn
+
+    bool needsFullRedraw;
+
+    Point<int> dragStartPosition;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HeatmapView);
+};
+
+/** Frame time, frame rate and per-stage breakdown, drawn over the grids */
+class FrameProfilerOverlay : public Component
+{
+public:
+    FrameProfilerOverlay();
+
+    /** Shows new statistics */
+    void setStats(const FrameStats& newStats);
+
+    void paint(Graphics& g) override;
+
+private:
+    FrameStats stats;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameProfilerOverlay);
 };
 
 class GridViewerCanvas : public Visualizer
@@ -81,17 +231,106 @@ public:
     void paint(Graphics& g) override;
     void resized() override;
 
+    /** Shows a stream; when all streams are tiled, only remembers the choice */
     void updateCanvasSubprocessor(uint32 subProcId);
 
+    /** Rebuilds the layout of a stream whose channel map changed */
+    void channelMapChanged(uint32 subProcId);
+
+    /** Called by a stream's viewport when it scrolls or changes size */
+    void visibleAreaChanged(StreamDisplay& streamDisplay, const Rectangle<int>& newVisibleArea);
+
+    /** Redraws a stream's newest frame, e.g. after the visible part of its grid changed */
+    void redrawLatestFrame(StreamDisplay& streamDisplay);
+
+    /** Times the stages of drawing a frame while the profiler overlay is shown */
+    FrameProfiler& getFrameProfiler() { return frameProfiler; }
+
 private:
     class GridViewerNode* node;
 
-    ScopedPointer<class GridViewerViewport> viewport;
-    OwnedArray<Electrode> electrodes;
+    std::unique_ptr<Label> poolingLabel;
+    std::unique_ptr<ComboBox> poolingSelection;
+
+    std::unique_ptr<Label> streamLayoutLabel;
+    std::unique_ptr<ComboBox> streamLayoutSelection;
+
+    std::unique_ptr<Label> metricLabel;
+    std::unique_ptr<ComboBox> metricSelection;
+
+    std::unique_ptr<Label> thresholdLabel;
+    std::unique_ptr<ComboBox> thresholdSelection;
+
+    std::unique_ptr<Label> scalingLabel;
+    std::unique_ptr<ComboBox> scalingSelection;
+
+    std::unique_ptr<TextButton> pauseButton;
+    std::unique_ptr<Slider> scrubSlider; // seconds before the moment of pausing
+    std::unique_ptr<Label> historySourceLabel; // whether the scrubbed frame is exact or quantized
+
+    std::unique_ptr<TextButton> profileButton;
+    std::unique_ptr<FrameProfilerOverlay> profilerOverlay;
+
+    FrameProfiler frameProfiler;
+    int framesSinceOverlayUpdate;
+
+    OwnedArray<StreamDisplay> streamDisplays; // one per input stream, in stream order
+
+    uint32 selectedStream;
+    bool showAllStreams;
+
+    ActivityMetric metric; // mapped to colour
+    ColourScaling colourScaling;
+
+    bool paused;
+
+    ColourSchemeId drawnColourScheme;
+
+    /** Asks for raw recomputes once the scrub position has rested, then picks them up */
+    class RecomputeTimer : public Timer
+    {
+    public:
+        explicit RecomputeTimer(GridViewerCanvas& canvas_) : canvas(canvas_) { }
+
+        void timerCallback() override { canvas.updateRecomputes(); }
+
+    private:
+        GridViewerCanvas& canvas;
+    };
+
+    RecomputeTimer recomputeTimer;
+
+    /** Creates the display, view and viewport for a stream */
+    StreamDisplay* createStreamDisplay(uint32 subProcId);
+
+    /** Freezes the view at the newest frame and lets the history be scrubbed, or returns to live frames */
+    void setPaused(bool shouldPause);
+
+    /** Draws the history frame the scrub position points to */
+    void drawHistoryFrame(StreamDisplay& streamDisplay);
+
+    /** Returns the raw history and the window to recompute the stream's history frame from, or nullptr if it cannot be */
+    RawHistory* getRawRequest(const StreamDisplay& streamDisplay, RawHistory::AnalysisRequest& request);
+
+    /** Replaces the stream's history frame with its raw recompute if that is ready */
+    RawHistory::AnalysisStatus takeRecompute(StreamDisplay& streamDisplay,
+                                             const RawHistory& raw,
+                                             const RawHistory::AnalysisRequest& request);
+
+    /** Asks for the raw recomputes history frames are waiting for, and draws those that are done */
+    void updateRecomputes();
+
+    /** Draws the selected metric of a published frame on the stream's colour scale */
+    void drawSnapshot(StreamDisplay& streamDisplay, const ActivitySnapshot& frame);
+
+    /** Returns true if a stream's grid is on screen */
+    bool isShown(const StreamDisplay& streamDisplay) const;
 
-    int numChannels;
+    /** Shows the selected stream, or tiles all of them side by side */
+    void layoutStreams();
 
-    void updateElectrodeGrid(int numColumns);
+    /** Returns the area of the canvas the stream grids share */
+    Rectangle<int> getStreamArea() const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GridViewerCanvas);
 };
@@ -99,13 +338,13 @@ private:
 class GridViewerViewport : public Viewport
 {
 public:
-    GridViewerViewport(GridViewerCanvas*);
+    GridViewerViewport(GridViewerCanvas*, StreamDisplay&);
     virtual ~GridViewerViewport() override;
-    void visibleAreaChanged(const Rectangle<int>& newVisibleArea);
+    void visibleAreaChanged(const Rectangle<int>& newVisibleArea) override;
 
 private:
     GridViewerCanvas* canvas;
-    class ChannelViewCanvas* channelsView;
+    StreamDisplay& display;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GridViewerViewport);
 };
@@ -25,16 +25,18 @@
 
 #include "GridViewerNode.h"
 #include "GridViewerCanvas.h"
+#include "TraceRecorder.h"
 
 using namespace GridViewer;
 
 GridViewerEditor::GridViewerEditor(GenericProcessor* parentNode, bool useDefaultParameterEditors=true)
-					: VisualizerEditor(parentNode, 180, useDefaultParameterEditors),
+					: VisualizerEditor(parentNode, 640, useDefaultParameterEditors),
+					  latencyTimer(*this),
 					  hasNoInputs(true)
 {
 
 	tabText = "Grid Viewer";
-	desiredWidth = 180;
+	desiredWidth = 640;
 
 	gridViewerNode = (GridViewerNode *)parentNode;
     
@@ -52,6 +54,113 @@ GridViewerEditor::GridViewerEditor(GenericProcessor* parentNode, bool useDefault
 	subprocessorSampleRateLabel->setJustificationType(Justification::centred);
     subprocessorSampleRateLabel->setBounds(10, 90, 160, 24);
     addAndMakeVisible(subprocessorSampleRateLabel.get());
+
+    channelMapLabel = std::make_unique<Label>("Channel Map Label", "Channel Map:");
+    channelMapLabel->setBounds(175, 30, 110, 24);
+    addAndMakeVisible(channelMapLabel.get());
+
+    channelMapLoadButton = std::make_unique<TextButton>("Load...");
+    channelMapLoadButton->setBounds(180, 60, 50, 20);
+    channelMapLoadButton->onClick = [this] { loadChannelMap(); };
+    addAndMakeVisible(channelMapLoadButton.get());
+
+    channelMapClearButton = std::make_unique<TextButton>("Clear");
+    channelMapClearButton->setBounds(235, 60, 45, 20);
+    channelMapClearButton->onClick = [this] { clearChannelMap(); };
+    addAndMakeVisible(channelMapClearButton.get());
+
+    channelMapFileLabel = std::make_unique<Label>("Channel Map File Label", "<channel order>");
+    channelMapFileLabel->setBounds(175, 90, 110, 24);
+    addAndMakeVisible(channelMapFileLabel.get());
+
+    workerThreadLabel = std::make_unique<Label>("Worker Thread Label", "Threads:");
+    workerThreadLabel->setBounds(285, 30, 80, 24);
+    addAndMakeVisible(workerThreadLabel.get());
+
+    // item IDs are the thread count plus one, since 0 is not a valid ID
+    workerThreadSelection = std::make_unique<ComboBox>("Worker Thread Selector");
+    workerThreadSelection->setBounds(290, 60, 70, 20);
+    workerThreadSelection->addItem("Off", 1);
+
+    const int maxThreads = jlimit(1, 16, SystemStats::getNumCpus() - 1);
+
+    for (int i = 1; i <= maxThreads; i++)
+        workerThreadSelection->addItem(String(i), i + 1);
+
+    workerThreadSelection->setSelectedId(1, dontSendNotification);
+    workerThreadSelection->addListener(this);
+    addAndMakeVisible(workerThreadSelection.get());
+
+    parallelThresholdLabel = std::make_unique<Label>("Parallel Threshold Label",
+                                                     ">= " + String(gridViewerNode->getParallelThreshold()) + " ch");
+    parallelThresholdLabel->setBounds(285, 90, 80, 24);
+    addAndMakeVisible(parallelThresholdLabel.get());
+
+    filterBandLabel = std::make_unique<Label>("Filter Band Label", "Band:");
+    filterBandLabel->setBounds(365, 30, 80, 24);
+    addAndMakeVisible(filterBandLabel.get());
+
+    // item IDs are the FilterBand value plus one
+    filterBandSelection = std::make_unique<ComboBox>("Filter Band Selector");
+    filterBandSelection->setBounds(370, 60, 80, 20);
+    filterBandSelection->addItem("Broadband", 1);
+    filterBandSelection->addItem("Spikes", 2);
+    filterBandSelection->addItem("LFP", 3);
+    filterBandSelection->setSelectedId(1, dontSendNotification);
+    filterBandSelection->addListener(this);
+    addAndMakeVisible(filterBandSelection.get());
+
+    filterBandRangeLabel = std::make_unique<Label>("Filter Band Range Label", "");
+    filterBandRangeLabel->setBounds(365, 90, 90, 24);
+    addAndMakeVisible(filterBandRangeLabel.get());
+
+    latencyLabel = std::make_unique<Label>("Latency Label", "Latency:");
+    latencyLabel->setBounds(455, 30, 70, 24);
+    addAndMakeVisible(latencyLabel.get());
+
+    latencyExportButton = std::make_unique<TextButton>("Save...");
+    latencyExportButton->setBounds(525, 33, 45, 18);
+    latencyExportButton->onClick = [this] { exportLatency(); };
+    addAndMakeVisible(latencyExportButton.get());
+
+    latencyPercentileLabel = std::make_unique<Label>("Latency Percentile Label", "");
+    latencyPercentileLabel->setBounds(455, 55, 120, 20);
+    addAndMakeVisible(latencyPercentileLabel.get());
+
+    latencyMaximumLabel = std::make_unique<Label>("Latency Maximum Label", "");
+    latencyMaximumLabel->setBounds(455, 75, 120, 20);
+    addAndMakeVisible(latencyMaximumLabel.get());
+
+    latencyBudgetLabel = std::make_unique<Label>("Latency Budget Label", "");
+    latencyBudgetLabel->setBounds(455, 95, 120, 20);
+    addAndMakeVisible(latencyBudgetLabel.get());
+
+    traceLabel = std::make_unique<Label>("Trace Label", "Trace:");
+    traceLabel->setBounds(575, 30, 60, 24);
+    addAndMakeVisible(traceLabel.get());
+
+    traceButton = std::make_unique<TextButton>("Record");
+    traceButton->setBounds(580, 60, 50, 20);
+    traceButton->setClickingTogglesState(true);
+    traceButton->onClick = [this] { toggleTrace(); };
+#if ! GRIDVIEWER_TRACING
+    traceButton->setEnabled(false);
+    traceButton->setTooltip("Built without GRIDVIEWER_ENABLE_TRACING");
+#endif
+    addAndMakeVisible(traceButton.get());
+
+    // off by default: raw history costs a compressor thread and up to its budget in memory
+    rawHistoryButton = std::make_unique<TextButton>("Raw");
+    rawHistoryButton->setBounds(580, 90, 50, 20);
+    rawHistoryButton->setClickingTogglesState(true);
+    rawHistoryButton->setTooltip("Keep the selected stream's raw samples (" + String(ActivityEngine::defaultRawHistoryMb)
+                                 + " MB), so scrubbed frames are recomputed exactly");
+    rawHistoryButton->onClick = [this]
+    {
+        const bool keep = rawHistoryButton->getToggleState();
+        gridViewerNode->setParameter(7, keep ? (float) ActivityEngine::defaultRawHistoryMb : 0.0f);
+    };
+    addAndMakeVisible(rawHistoryButton.get());
 }
 
 GridViewerEditor::~GridViewerEditor()
@@ -66,17 +175,39 @@ void GridViewerEditor::comboBoxChanged(ComboBox* cb)
 
 		setDrawableSubprocessor(selectedSubproc);
     }
+    else if (cb == workerThreadSelection.get())
+    {
+		gridViewerNode->setParameter(1, (float) (cb->getSelectedId() - 1));
+    }
+    else if (cb == filterBandSelection.get())
+    {
+		gridViewerNode->setParameter(4, (float) (cb->getSelectedId() - 1));
+
+		updateFilterBandSelection(gridViewerNode->getFilterBand());
+    }
 
 }
 
 Visualizer* GridViewerEditor::createNewCanvas()
 {
-    return new GridViewerCanvas(gridViewerNode);
+    GridViewerCanvas* c = new GridViewerCanvas(gridViewerNode);
+
+    c->update();
+
+    if (subprocessorSelection->getSelectedId() != 0)
+        c->updateCanvasSubprocessor(subprocessorSelection->getSelectedId());
+
+    return c;
 }
 
 void GridViewerEditor::updateSubprocessorSelectorOptions(juce::SortedSet<uint32> subprocessorIndices)
 {
 	std::cout << "Updating subprocessor selector!!!" << std::endl;
+
+	// the canvas keeps a display for every stream
+	if (canvas != nullptr)
+		canvas->update();
+
 	// clear out the old data
     subprocessorSelection->clear(dontSendNotification);
 
@@ -112,6 +243,41 @@ void GridViewerEditor::updateSampleRateLabel(String labelText)
 	subprocessorSampleRateLabel->setText(sampleRateLabelText, dontSendNotification);
 }
 
+void GridViewerEditor::updateWorkerThreadSelection(int numThreads)
+{
+	if (workerThreadSelection->indexOfItemId(numThreads + 1) < 0)
+		workerThreadSelection->addItem(String(numThreads), numThreads + 1);
+
+	workerThreadSelection->setSelectedId(numThreads + 1, dontSendNotification);
+
+	parallelThresholdLabel->setText(">= " + String(gridViewerNode->getParallelThreshold()) + " ch", dontSendNotification);
+}
+
+void GridViewerEditor::updateFilterBandSelection(FilterBand band)
+{
+	filterBandSelection->setSelectedId((int) band + 1, dontSendNotification);
+
+	switch (band)
+	{
+		case FilterBand::SPIKE:
+			filterBandRangeLabel->setText("300-6000 Hz", dontSendNotification);
+			break;
+
+		case FilterBand::LFP:
+			filterBandRangeLabel->setText("1-300 Hz", dontSendNotification);
+			break;
+
+		case FilterBand::BROADBAND:
+			filterBandRangeLabel->setText("", dontSendNotification);
+			break;
+	}
+}
+
+void GridViewerEditor::updateRawHistoryButton(bool keepsRawSamples)
+{
+	rawHistoryButton->setToggleState(keepsRawSamples, dontSendNotification);
+}
+
 void GridViewerEditor::setDrawableSubprocessor(uint32 subProcId)
 {
 
@@ -119,6 +285,8 @@ void GridViewerEditor::setDrawableSubprocessor(uint32 subProcId)
 
 	gridViewerNode->setParameter(0, subProcId);
 
+	updateChannelMapLabel();
+
 	if (canvas != nullptr)
 	{
 		GridViewerCanvas* c = (GridViewerCanvas*)canvas.get();
@@ -127,9 +295,119 @@ void GridViewerEditor::setDrawableSubprocessor(uint32 subProcId)
 		
 }
 
+void GridViewerEditor::loadChannelMap()
+{
+	const uint32 subProcId = subprocessorSelection->getSelectedId();
+
+	FileChooser chooser("Select a channel map", File(), "*.json;*.csv");
+
+	if (! chooser.browseForFileToOpen())
+		return;
+
+	const String error = gridViewerNode->loadChannelMap(subProcId, chooser.getResult());
+
+	if (error.isNotEmpty())
+	{
+		CoreServices::sendStatusMessage("Channel map not loaded: " + error);
+		return;
+	}
+
+	updateChannelMapLabel();
+
+	if (canvas != nullptr)
+	{
+		GridViewerCanvas* c = (GridViewerCanvas*)canvas.get();
+		c->channelMapChanged(subProcId);
+	}
+}
+
+void GridViewerEditor::clearChannelMap()
+{
+	const uint32 subProcId = subprocessorSelection->getSelectedId();
+
+	gridViewerNode->clearChannelMap(subProcId);
+
+	updateChannelMapLabel();
+
+	if (canvas != nullptr)
+	{
+		GridViewerCanvas* c = (GridViewerCanvas*)canvas.get();
+		c->channelMapChanged(subProcId);
+	}
+}
+
+void GridViewerEditor::updateChannelMapLabel()
+{
+	const File mapFile = gridViewerNode->getChannelMapFile(subprocessorSelection->getSelectedId());
+
+	if (mapFile == File())
+		channelMapFileLabel->setText("<channel order>", dontSendNotification);
+	else
+		channelMapFileLabel->setText(mapFile.getFileName(), dontSendNotification);
+}
+
+void GridViewerEditor::updateLatencyLabels()
+{
+	const LatencySummary latency = gridViewerNode->getProcessLatency().poll();
+
+	// nothing new since the last poll: keep showing the last blocks
+	if (latency.numBlocks == 0)
+		return;
+
+	latencyPercentileLabel->setText("p50 " + String(latency.p50, 0) + " / p99 " + String(latency.p99, 0) + " us",
+									dontSendNotification);
+	latencyMaximumLabel->setText("max " + String(latency.maximum, 0) + " us", dontSendNotification);
+	latencyBudgetLabel->setText(String(latency.budgetP50, 1) + "% / " + String(latency.budgetP99, 1) + "% of block",
+								dontSendNotification);
+}
+
+void GridViewerEditor::exportLatency()
+{
+	FileChooser chooser("Save process() latency", File(), "*.csv");
+
+	if (! chooser.browseForFileToSave(true))
+		return;
+
+	std::string error;
+
+	if (! gridViewerNode->getProcessLatency().writeCsv(chooser.getResult().getFullPathName().toStdString(), error))
+		CoreServices::sendStatusMessage("Latency not saved: " + String(error));
+}
+
+void GridViewerEditor::toggleTrace()
+{
+	TraceRecorder& recorder = TraceRecorder::getInstance();
+
+	if (traceButton->getToggleState())
+	{
+		recorder.start();
+		return;
+	}
+
+	recorder.stop();
+
+	FileChooser chooser("Save trace", File(), "*.json");
+
+	if (! chooser.browseForFileToSave(true))
+		return;
+
+	std::string error;
+
+	if (! recorder.writeJson(chooser.getResult().getFullPathName().toStdString(), error))
+		CoreServices::sendStatusMessage("Trace not saved: " + String(error));
+}
+
 void GridViewerEditor::startAcquisition()
 {
-	subprocessorSelection->setEnabled(false);
+	workerThreadSelection->setEnabled(false);
+	rawHistoryButton->setEnabled(false);
+
+	// the node clears its latency histograms as acquisition starts
+	latencyPercentileLabel->setText("", dontSendNotification);
+	latencyMaximumLabel->setText("", dontSendNotification);
+	latencyBudgetLabel->setText("", dontSendNotification);
+
+	latencyTimer.startTimer(500);
 
 	if (canvas != nullptr)
         canvas->beginAnimation();
@@ -137,7 +415,11 @@ void GridViewerEditor::startAcquisition()
 
 void GridViewerEditor::stopAcquisition()
 {
-	subprocessorSelection->setEnabled(true);
+	workerThreadSelection->setEnabled(true);
+	rawHistoryButton->setEnabled(true);
+
+	latencyTimer.stopTimer();
+	updateLatencyLabels();
 
 	if (canvas != nullptr)
         canvas->endAnimation();
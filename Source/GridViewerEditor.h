@@ -26,6 +26,8 @@
 
 #include "VisualizerEditorHeaders.h"
 
+#include "FilterBank.h"
+
 namespace GridViewer {
 
 class GridViewerEditor
@@ -56,13 +58,21 @@ public:
     /** Update sample rate label */
     void updateSampleRateLabel(String newText);
 
-    /** Disables stream selection*/
+    /** Shows the node's worker thread count */
+    void updateWorkerThreadSelection(int numThreads);
+
+    /** Shows the node's filter band */
+    void updateFilterBandSelection(FilterBand band);
+
+    /** Shows whether the node keeps raw samples */
+    void updateRawHistoryButton(bool keepsRawSamples);
+
+    /** Starts the canvas animation and locks the thread count; streams can still be switched */
 	void startAcquisition() override;
 
-    /** Enables stream selection */
+    /** Stops the canvas animation and unlocks the thread count */
 	void stopAcquisition() override;
 
-
 private:
     juce::SortedSet<uint32> inputSubprocessors;
 
@@ -73,11 +83,67 @@ private:
 
     std::unique_ptr<Label> subprocessorSampleRateLabel;
 
+    std::unique_ptr<Label> channelMapLabel;
+    std::unique_ptr<TextButton> channelMapLoadButton;
+    std::unique_ptr<TextButton> channelMapClearButton;
+    std::unique_ptr<Label> channelMapFileLabel;
+
+    std::unique_ptr<Label> workerThreadLabel;
+    std::unique_ptr<ComboBox> workerThreadSelection;
+    std::unique_ptr<Label> parallelThresholdLabel;
+
+    std::unique_ptr<Label> filterBandLabel;
+    std::unique_ptr<ComboBox> filterBandSelection;
+    std::unique_ptr<Label> filterBandRangeLabel;
+
+    std::unique_ptr<Label> latencyLabel;
+    std::unique_ptr<TextButton> latencyExportButton;
+    std::unique_ptr<Label> latencyPercentileLabel;
+    std::unique_ptr<Label> latencyMaximumLabel;
+    std::unique_ptr<Label> latencyBudgetLabel;
+
+    std::unique_ptr<Label> traceLabel;
+    std::unique_ptr<TextButton> traceButton;
+
+    std::unique_ptr<TextButton> rawHistoryButton;
+
+    /** Polls the node's process() latency twice a second during acquisition */
+    class LatencyTimer : public Timer
+    {
+    public:
+        explicit LatencyTimer(GridViewerEditor& editor_) : editor(editor_) { }
+
+        void timerCallback() override { editor.updateLatencyLabels(); }
+
+    private:
+        GridViewerEditor& editor;
+    };
+
+    LatencyTimer latencyTimer;
+
     bool hasNoInputs;
 
     /** Set drawable subproccesor for canvas*/
     void setDrawableSubprocessor(uint32 subProcId);
 
+    /** Asks for a channel map file for the selected stream */
+    void loadChannelMap();
+
+    /** Returns the selected stream to channel order */
+    void clearChannelMap();
+
+    /** Shows the selected stream's channel map file name */
+    void updateChannelMapLabel();
+
+    /** Shows the node's process() latency since the previous poll */
+    void updateLatencyLabels();
+
+    /** Asks for a file and writes the latency histograms since acquisition started */
+    void exportLatency();
+
+    /** Starts recording a trace, or stops and asks where to save it */
+    void toggleTrace();
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GridViewerEditor);
 };
 
@@ -26,74 +26,22 @@
 #include "GridViewerEditor.h"
 #include "GridViewerCanvas.h"
 
-using namespace GridViewer;
-
-ActivityView::ActivityView(int numChannels, int updateInterval_)
-{
-	for (int i = 0; i < numChannels; i++)
-		peakToPeakValues.add(0);
-
-	updateInterval = updateInterval_;
-
-	reset();
-}
-
-const float* ActivityView::getPeakToPeakValues() {
-
-	return peakToPeakValues.getRawDataPointer();
-}
-
-void ActivityView::addSample(float sample, int channel)
-{
-	if (channel == 0)
-	{
-		if (counter == updateInterval)
-			reset();
-
-		counter++;
-	}
-
-	//if (counter % 10 == 0)
-	//{
-	if (sample < minChannelValues[channel])
-	{
-		minChannelValues.set(channel, sample);
-		return;
-	}
-
-	if (sample > maxChannelValues[channel])
-	{
-		maxChannelValues.set(channel, sample);
-	}
-	//}
-
-}
-
-void ActivityView::reset()
-{
-
-	//std::cout << "Reset." << std::endl;
-
-	for (int i = 0; i < peakToPeakValues.size(); i++)
-	{
-
-		peakToPeakValues.set(i, maxChannelValues[i] - minChannelValues[i]);
-
-		minChannelValues.set(i, 999999.9f);
-		maxChannelValues.set(i, -999999.9f);
-	}
-
-	counter = 0;
+#include "ReductionKernels.h"
+#include "TraceRecorder.h"
 
-}
+using namespace GridViewer;
 
 GridViewerNode::GridViewerNode() 
 	: GenericProcessor ("Grid Viewer"),
-	  subprocessorToDraw(0)
+	  subprocessorToDraw(0),
+	  engine(50.0f) // frames published per second
 {
 
 	setProcessorType(PROCESSOR_TYPE_SINK);
 
+	std::cout << "Grid Viewer reduction kernels: "
+			  << CpuFeatures::getSimdLevelName(ReductionKernels::getActiveSimdLevel()) << std::endl;
+
 }
 
 GridViewerNode::~GridViewerNode()
@@ -107,71 +55,44 @@ AudioProcessorEditor* GridViewerNode::createEditor()
 
 void GridViewerNode::setParameter(int index, float value)
 {
+	const bool acquiring = CoreServices::getAcquisitionStatus();
+
+	if (! engine.setParameter(index, value, acquiring))
+	{
+		if (acquiring)
+			std::cout << "Grid Viewer: parameter " << index << " cannot change during acquisition" << std::endl;
+
+		return;
+	}
+
 	if (index == 0)
 	{
 
 		std::cout << "Node updating subprocessor to " << (uint32)value << std::endl;
 
+		// every stream is always reduced, so selecting one only changes what the editor shows
 		subprocessorToDraw = (uint32)value;
 
-		activityView.reset();
-
-		activityView = std::make_unique<ActivityView>(subprocessorChanCount[subprocessorToDraw], 10);
-
 		float sampleRate = inputSampleRates[subprocessorToDraw];
+
 		auto editor = (GridViewerEditor*) getEditor();
 		editor->updateSampleRateLabel(String(sampleRate));
-
-		skip = (int)(sampleRate / targetSampleRate);
-
-		if (skip < 1)
-			skip = 1;
+	}
+	else if (index == 1)
+	{
+		std::cout << "Grid Viewer worker threads: " << engine.getNumWorkerThreads() << std::endl;
 	}
 	
 }
 
 void GridViewerNode::process(AudioSampleBuffer& buffer)
 {
+	GRIDVIEWER_TRACE_THREAD("Audio");
+	GRIDVIEWER_TRACE_SCOPE("GridViewerNode::process");
 
-	const int nChannels = buffer.getNumChannels();
-
-
-	for (int ch = 0, localIndex = 0; ch < nChannels; ++ch)
-	{
-		if(getChannelSourceId(getDataChannel(ch)) == subprocessorToDraw)
-		{
-			const int nSamples = getNumSamples(ch);
-			const float *buffPtr = buffer.getReadPointer(ch);
-
-			for (int n = 0; n < nSamples; n += skip)
-			{
-				
-				activityView->addSample(*(buffPtr + n), localIndex);
-			}
-
-			localIndex++;
-		}
-	}
-
-	/*
-	uint32 numSamples = getNumSamplesInBlock(currentStream);
-
-	for (auto channel : continuousChannels)
-	{
-		if (channel->getStreamId() == currentStream)
-		{
-
-			int globalIndex = channel->getGlobalIndex();
-			int localIndex = channel->getLocalIndex();
-
-			for (int i = 0; i < numSamples; i += skip)
-			{
-				activityView->addSample(*b.getReadPointer(globalIndex, i), localIndex);
-			}
-		}
-	}
-	*/
-
+	engine.processBuffer(buffer.getArrayOfReadPointers(),
+						 [this] (int channel) { return getNumSamples(channel); },
+						 [this] (int channel) { return getTimestamp(channel); });
 }
 
 
@@ -185,10 +106,14 @@ void GridViewerNode::updateSettings()
 	subprocessorChanCount.clear();
 	subprocessorNames.clear();
 
+	std::vector<ActivityEngine::ChannelSource> bufferChannels;
+
 	for (int i = 0; i < getTotalDataChannels(); i++)
 	{
 		uint32 channelSubprocessor = getChannelSourceId(getDataChannel(i));
 
+		bufferChannels.push_back({ channelSubprocessor, getDataChannel(i)->getSampleRate() });
+
 		if (!inputSubprocessorIndices.contains(channelSubprocessor))
 		{
 			std::cout << "Adding subprocessor:  " << channelSubprocessor << std::endl;
@@ -205,6 +130,8 @@ void GridViewerNode::updateSettings()
 		}
 	}
 
+	engine.configure(bufferChannels);
+
 	// update the editor's subprocessor selection display, only if there's atleast one subprocessor
 	if (totalSubprocessors > 0)
 	{
@@ -215,6 +142,30 @@ void GridViewerNode::updateSettings()
 }
 
 
+Array<uint32> GridViewerNode::getStreamIds() const
+{
+	Array<uint32> ids;
+
+	for (int i = 0; i < engine.getNumStreams(); i++)
+		ids.add(engine.getStream(i).getStreamId());
+
+	return ids;
+}
+
+const ActivitySnapshot* GridViewerNode::getLatestSnapshot(uint32 subProcId)
+{
+	StreamActivity* stream = engine.findStream(subProcId);
+
+	return stream != nullptr ? &stream->getLatestFrame() : nullptr;
+}
+
+const FrameHistory* GridViewerNode::getFrameHistory(uint32 subProcId) const
+{
+	const StreamActivity* stream = engine.findStream(subProcId);
+
+	return stream != nullptr ? stream->getHistory() : nullptr;
+}
+
 uint32 GridViewerNode::getChannelSourceId(const InfoObjectCommon* chan)
 {
     return getProcessorFullId(chan->getSourceNodeID(), chan->getSubProcessorIdx());
@@ -253,10 +204,115 @@ String GridViewerNode::getSubprocessorName(int channel)
 }
 
 
+String GridViewerNode::loadChannelMap(uint32 subProcId, const File& file)
+{
+	std::vector<ChannelMapEntry> entries;
+	std::string error;
+
+	if (! ChannelMap::readFile(file.getFullPathName().toStdString(), entries, error))
+		return String(error);
+
+	std::cout << "Loaded channel map with " << entries.size() << " channels from " << file.getFullPathName() << std::endl;
+
+	channelMaps[subProcId] = entries;
+	channelMapFiles[subProcId] = file;
+
+	return String();
+}
+
+void GridViewerNode::clearChannelMap(uint32 subProcId)
+{
+	channelMaps.erase(subProcId);
+	channelMapFiles.erase(subProcId);
+}
+
+const std::vector<ChannelMapEntry>* GridViewerNode::getChannelMap(uint32 subProcId) const
+{
+	auto it = channelMaps.find(subProcId);
+
+	return it != channelMaps.end() ? &it->second : nullptr;
+}
+
+File GridViewerNode::getChannelMapFile(uint32 subProcId) const
+{
+	auto it = channelMapFiles.find(subProcId);
+
+	return it != channelMapFiles.end() ? it->second : File();
+}
+
+void GridViewerNode::saveCustomParametersToXml(XmlElement* parentElement)
+{
+	XmlElement* parallelXml = parentElement->createNewChildElement("PARALLEL");
+	parallelXml->setAttribute("threads", engine.getNumWorkerThreads());
+	parallelXml->setAttribute("threshold", engine.getParallelThreshold());
+
+	XmlElement* metricsXml = parentElement->createNewChildElement("METRICS");
+	metricsXml->setAttribute("crossing_threshold", engine.getCrossingThreshold());
+	metricsXml->setAttribute("band", (int) engine.getFilterBand());
+	metricsXml->setAttribute("threshold_multiplier", engine.getThresholdMultiplier());
+
+	XmlElement* historyXml = parentElement->createNewChildElement("HISTORY");
+	historyXml->setAttribute("budget_mb", engine.getHistoryBudget());
+	historyXml->setAttribute("raw_budget_mb", engine.getRawHistoryBudget());
+
+	for (auto& entry : channelMapFiles)
+	{
+		XmlElement* mapXml = parentElement->createNewChildElement("CHANNELMAP");
+		mapXml->setAttribute("stream", (int) entry.first);
+		mapXml->setAttribute("path", entry.second.getFullPathName());
+	}
+}
+
+void GridViewerNode::loadCustomParametersFromXml()
+{
+	if (parametersAsXml == nullptr)
+		return;
+
+	for (XmlElement* mapXml = parametersAsXml->getFirstChildElement(); mapXml != nullptr; mapXml = mapXml->getNextElement())
+	{
+		if (mapXml->hasTagName("PARALLEL"))
+		{
+			setParameter(2, (float) mapXml->getIntAttribute("threshold", engine.getParallelThreshold()));
+			setParameter(1, (float) mapXml->getIntAttribute("threads", 0));
+
+			((GridViewerEditor*) getEditor())->updateWorkerThreadSelection(engine.getNumWorkerThreads());
+			continue;
+		}
+
+		if (mapXml->hasTagName("METRICS"))
+		{
+			setParameter(3, (float) mapXml->getDoubleAttribute("crossing_threshold", engine.getCrossingThreshold()));
+			setParameter(4, (float) mapXml->getIntAttribute("band", (int) engine.getFilterBand()));
+			setParameter(5, (float) mapXml->getDoubleAttribute("threshold_multiplier", engine.getThresholdMultiplier()));
+
+			((GridViewerEditor*) getEditor())->updateFilterBandSelection(engine.getFilterBand());
+			continue;
+		}
+
+		if (mapXml->hasTagName("HISTORY"))
+		{
+			setParameter(6, (float) mapXml->getIntAttribute("budget_mb", engine.getHistoryBudget()));
+			setParameter(7, (float) mapXml->getIntAttribute("raw_budget_mb", engine.getRawHistoryBudget()));
+
+			((GridViewerEditor*) getEditor())->updateRawHistoryButton(engine.getRawHistoryBudget() > 0);
+			continue;
+		}
+
+		if (! mapXml->hasTagName("CHANNELMAP"))
+			continue;
+
+		const uint32 subProcId = (uint32) mapXml->getIntAttribute("stream");
+		const String error = loadChannelMap(subProcId, File(mapXml->getStringAttribute("path")));
+
+		if (error.isNotEmpty())
+			std::cout << "Could not restore channel map: " << error << std::endl;
+	}
+}
+
 bool GridViewerNode::enable()
 {
 
-	activityView->reset();
+	engine.reset();
 
     auto editor = (GridViewerEditor*) getEditor();
 
@@ -26,35 +26,13 @@
 
 #include "ProcessorHeaders.h"
 
+#include "ActivityEngine.h"
+#include "ElectrodeLayout.h"
 
-namespace GridViewer {
-
-class ActivityView
-{
-public:
-    /** Constructor */
-	ActivityView(int numChannels, int updateInterval);
-
-    /** Returns a pointer to the peak-to-peak values across channels*/
-	const float* getPeakToPeakValues();
-
-    /** Adds an incoming sample for a given channel */
-	void addSample(float sample, int channel);
+#include <map>
 
-    /** Reset min/max values*/
-    void reset();
-
-private:
-
-	Array<float, CriticalSection> minChannelValues;
-	Array<float, CriticalSection> maxChannelValues;
-	Array<float, CriticalSection> peakToPeakValues;
-
-	int counter;
-	int updateInterval;
-
-};
 
+namespace GridViewer {
 
 class GridViewerNode : public GenericProcessor
 {
@@ -82,11 +60,44 @@ public:
     /** Disables the editor*/
     bool disable();
 
-    /** Changes the selected stream */
+    /**
+     *  0: selects the stream shown in the editor
+     *  1: number of worker threads for the channel reduction (0 reduces on the audio thread only)
+     *  2: minimum channel count of a stream before its reduction is split across the workers
+     *  3: threshold in uV whose downward crossings give the crossing-rate metric
+     *  4: FilterBand the metrics are computed on
+     *  5: crossing threshold as a multiple of each channel's noise level (0 uses parameter 3)
+     *  6: memory in MB shared by the frame histories of all streams (0 keeps no history)
+     *  7: memory in MB for compressed raw samples of the selected stream (0, the default, keeps none)
+     *
+     *  Parameters 1 to 3, 6 and 7 are ignored during acquisition; the ranges and
+     *  rules live in ActivityEngine::setParameter, shared with the headless node.
+     */
     void setParameter(int index, float value) override;
 
-    /** Gets the latest peak-to-peak values*/
-    const float* getLatestValues() { return activityView->getPeakToPeakValues(); }
+    int getNumWorkerThreads() const { return engine.getNumWorkerThreads(); }
+    int getParallelThreshold() const { return engine.getParallelThreshold(); }
+    float getCrossingThreshold() const { return engine.getCrossingThreshold(); }
+    FilterBand getFilterBand() const { return engine.getFilterBand(); }
+    float getThresholdMultiplier() const { return engine.getThresholdMultiplier(); }
+    float getSnapshotRate() const { return engine.getSnapshotRate(); }
+    int getRawHistoryBudget() const { return engine.getRawHistoryBudget(); }
+
+    /** Gets the IDs of all input streams, in ascending order */
+    Array<uint32> getStreamIds() const;
+
+    /** Gets the newest published frame of a stream's activity metrics, or nullptr for an unknown stream (message thread only)*/
+    const ActivitySnapshot* getLatestSnapshot(uint32 subProcId);
+
+    /** Gets a stream's history of past frames, or nullptr if it keeps none (message thread only) */
+    const FrameHistory* getFrameHistory(uint32 subProcId) const;
+
+    /** Gets the compressed raw samples of the selected stream, or nullptr if none are kept */
+    const RawHistory* getRawHistory() const { return engine.getRawHistory(); }
+    RawHistory* getRawHistory() { return engine.getRawHistory(); }
+
+    /** Gets the time process() takes per block, cleared when acquisition starts */
+    ProcessLatency& getProcessLatency() { return engine.getProcessLatency(); }
     
     /** Gets the specified subprocessors' channel count*/
     int getSubprocessorChanCount(uint32 subProcId) { return subprocessorChanCount[subProcId]; }
@@ -94,6 +105,24 @@ public:
     /** Get subprocessor name for ID */
     String getSubprocessorNameForId(uint32 subProcId) { return subprocessorNames[subProcId]; }
 
+    /** Loads a stream's channel map; returns an error message, or an empty string on success */
+    String loadChannelMap(uint32 subProcId, const File& file);
+
+    /** Removes a stream's channel map */
+    void clearChannelMap(uint32 subProcId);
+
+    /** Gets a stream's channel map, or nullptr if it is drawn in channel order */
+    const std::vector<ChannelMapEntry>* getChannelMap(uint32 subProcId) const;
+
+    /** Gets the file a stream's channel map was loaded from */
+    File getChannelMapFile(uint32 subProcId) const;
+
+    /** Saves channel map locations and processing settings */
+    void saveCustomParametersToXml(XmlElement* parentElement) override;
+
+    /** Restores channel maps */
+    void loadCustomParametersFromXml() override;
+
 private:
 
     juce::HashMap<int, float> inputSampleRates; // hold the possible subprocessor sample rates
@@ -102,10 +131,10 @@ private:
 
     uint32 subprocessorToDraw;
 
-    std::unique_ptr<ActivityView> activityView;
+    std::map<uint32, std::vector<ChannelMapEntry>> channelMaps;
+    std::map<uint32, File> channelMapFiles;
 
-    int skip = 1;
-    const float targetSampleRate = 500;
+    ActivityEngine engine; // every input stream, rebuilt in updateSettings
 
     static uint32 getChannelSourceId(const InfoObjectCommon* chan);
 
@@ -0,0 +1,460 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "JsonReader.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace GridViewer {
+
+/** Recursive-descent parser filling in JsonValue */
+class JsonParser
+{
+public:
+    explicit JsonParser(const std::string& text_) : text(text_), pos(0) { }
+
+    bool parseDocument(JsonValue& result)
+    {
+        if (! parseValue(result, 0))
+            return false;
+
+        skipWhitespace();
+
+        if (pos != text.size())
+            return fail("unexpected characters after the document");
+
+        return true;
+    }
+
+    std::string error;
+
+private:
+    static constexpr int maxDepth = 256;
+
+    const std::string& text;
+    size_t pos;
+
+    bool fail(const std::string& message)
+    {
+        if (error.empty())
+            error = message + " at offset " + std::to_string(pos);
+
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (pos < text.size()
+               && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+            pos++;
+    }
+
+    bool matchLiteral(const char* literal)
+    {
+        size_t i = 0;
+
+        while (literal[i] != 0)
+        {
+            if (pos + i >= text.size() || text[pos + i] != literal[i])
+                return false;
+
+            i++;
+        }
+
+        pos += i;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth)
+    {
+        if (depth > maxDepth)
+            return fail("document nested too deeply");
+
+        skipWhitespace();
+
+        if (pos >= text.size())
+            return fail("unexpected end of document");
+
+        const char c = text[pos];
+
+        if (c == '{')
+            return parseObject(value, depth);
+
+        if (c == '[')
+            return parseArray(value, depth);
+
+        if (c == '"')
+        {
+            value.type = JsonValue::Type::STRING;
+            return parseString(value.text);
+        }
+
+        if (matchLiteral("true"))
+        {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.boolean = true;
+            return true;
+        }
+
+        if (matchLiteral("false"))
+        {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.boolean = false;
+            return true;
+        }
+
+        if (matchLiteral("null"))
+        {
+            value.type = JsonValue::Type::NUL;
+            return true;
+        }
+
+        return parseNumber(value);
+    }
+
+    bool parseNumber(JsonValue& value)
+    {
+        // JSON's number grammar, which is stricter than strtod's: no leading '+'
+        // or zeros, no bare '.', and no hex, inf or nan
+        size_t end = pos;
+
+        auto skipDigits = [this, &end]
+        {
+            const size_t first = end;
+
+            while (end < text.size() && text[end] >= '0' && text[end] <= '9')
+                end++;
+
+            return end > first;
+        };
+
+        if (end < text.size() && text[end] == '-')
+            end++;
+
+        if (end < text.size() && text[end] == '0')
+            end++;
+        else if (! skipDigits())
+            return fail("invalid value");
+
+        if (end < text.size() && text[end] == '.')
+        {
+            end++;
+
+            if (! skipDigits())
+                return fail("invalid number");
+        }
+
+        if (end < text.size() && (text[end] == 'e' || text[end] == 'E'))
+        {
+            end++;
+
+            if (end < text.size() && (text[end] == '+' || text[end] == '-'))
+                end++;
+
+            if (! skipDigits())
+                return fail("invalid number");
+        }
+
+        const double number = std::strtod(text.substr(pos, end - pos).c_str(), nullptr);
+
+        if (! std::isfinite(number))
+            return fail("number out of range");
+
+        value.type = JsonValue::Type::NUMBER;
+        value.number = number;
+        pos = end;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            out += (char) codePoint;
+        }
+        else if (codePoint < 0x800)
+        {
+            out += (char) (0xc0 | (codePoint >> 6));
+            out += (char) (0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out += (char) (0xe0 | (codePoint >> 12));
+            out += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+            out += (char) (0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+            out += (char) (0xf0 | (codePoint >> 18));
+            out += (char) (0x80 | ((codePoint >> 12) & 0x3f));
+            out += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+            out += (char) (0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    bool parseHex4(unsigned int& codePoint)
+    {
+        if (pos + 4 > text.size())
+            return fail("truncated unicode escape");
+
+        codePoint = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            const char h = text[pos++];
+            codePoint <<= 4;
+
+            if (h >= '0' && h <= '9')      codePoint |= (unsigned int) (h - '0');
+            else if (h >= 'a' && h <= 'f') codePoint |= (unsigned int) (h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') codePoint |= (unsigned int) (h - 'A' + 10);
+            else return fail("invalid unicode escape");
+        }
+
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        pos++; // opening quote
+
+        while (pos < text.size())
+        {
+            const char c = text[pos++];
+
+            if (c == '"')
+                return true;
+
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if (pos >= text.size())
+                break;
+
+            const char escape = text[pos++];
+
+            switch (escape)
+            {
+                case '"':  out += '"';  break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/';  break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+
+                case 'u':
+                {
+                    unsigned int codePoint = 0;
+
+                    if (! parseHex4(codePoint))
+                        return false;
+
+                    if (codePoint >= 0xdc00 && codePoint < 0xe000)
+                        return fail("unpaired low surrogate");
+
+                    // combine a UTF-16 surrogate pair
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00)
+                    {
+                        unsigned int low = 0;
+
+                        if (! matchLiteral("\\u"))
+                            return fail("unpaired high surrogate");
+
+                        if (! parseHex4(low))
+                            return false;
+
+                        if (low < 0xdc00 || low >= 0xe000)
+                            return fail("invalid low surrogate");
+
+                        codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    }
+
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+
+                default:
+                    return fail("invalid escape sequence");
+            }
+        }
+
+        return fail("unterminated string");
+    }
+
+    bool parseArray(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::Type::ARRAY;
+        pos++; // [
+
+        skipWhitespace();
+
+        if (pos < text.size() && text[pos] == ']')
+        {
+            pos++;
+            return true;
+        }
+
+        for (;;)
+        {
+            value.items.emplace_back();
+
+            if (! parseValue(value.items.back(), depth + 1))
+                return false;
+
+            skipWhitespace();
+
+            if (pos < text.size() && text[pos] == ',')
+            {
+                pos++;
+                continue;
+            }
+
+            if (pos < text.size() && text[pos] == ']')
+            {
+                pos++;
+                return true;
+            }
+
+            return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parseObject(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::Type::OBJECT;
+        pos++; // {
+
+        skipWhitespace();
+
+        if (pos < text.size() && text[pos] == '}')
+        {
+            pos++;
+            return true;
+        }
+
+        for (;;)
+        {
+            skipWhitespace();
+
+            if (pos >= text.size() || text[pos] != '"')
+                return fail("expected a property name");
+
+            value.keys.emplace_back();
+
+            if (! parseString(value.keys.back()))
+                return false;
+
+            skipWhitespace();
+
+            if (pos >= text.size() || text[pos] != ':')
+                return fail("expected ':'");
+
+            pos++;
+
+            value.items.emplace_back();
+
+            if (! parseValue(value.items.back(), depth + 1))
+                return false;
+
+            skipWhitespace();
+
+            if (pos < text.size() && text[pos] == ',')
+            {
+                pos++;
+                continue;
+            }
+
+            if (pos < text.size() && text[pos] == '}')
+            {
+                pos++;
+                return true;
+            }
+
+            return fail("expected ',' or '}'");
+        }
+    }
+};
+
+}
+
+using namespace GridViewer;
+
+namespace {
+    const JsonValue nullValue;
+}
+
+bool JsonValue::parse(const std::string& text, JsonValue& result, std::string& error)
+{
+    result = JsonValue();
+
+    JsonParser parser(text);
+
+    if (parser.parseDocument(result))
+        return true;
+
+    error = parser.error;
+    result = JsonValue();
+    return false;
+}
+
+bool JsonValue::getBool(bool fallback) const
+{
+    if (type == Type::BOOLEAN)
+        return boolean;
+
+    if (type == Type::NUMBER)
+        return number != 0.0;
+
+    return fallback;
+}
+
+const JsonValue& JsonValue::operator[](int index) const
+{
+    if (index < 0 || index >= (int) items.size())
+        return nullValue;
+
+    return items[(size_t) index];
+}
+
+const JsonValue& JsonValue::operator[](const std::string& name) const
+{
+    for (size_t i = 0; i < keys.size(); i++)
+        if (keys[i] == name)
+            return items[i];
+
+    return nullValue;
+}
+
+bool JsonValue::hasProperty(const std::string& name) const
+{
+    for (auto& key : keys)
+        if (key == name)
+            return true;
+
+    return false;
+}
@@ -0,0 +1,96 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __JSONREADER_H__
+#define __JSONREADER_H__
+
+#include <string>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    Minimal read-only JSON document, used for channel maps and recording
+    metadata in code that must not depend on JUCE.
+ */
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    JsonValue() = default;
+
+    /** Parses a document; returns false and fills error on malformed input */
+    static bool parse(const std::string& text, JsonValue& result, std::string& error);
+
+    Type getType() const { return type; }
+
+    bool isNumber() const { return type == Type::NUMBER; }
+    bool isString() const { return type == Type::STRING; }
+    bool isArray() const { return type == Type::ARRAY; }
+    bool isObject() const { return type == Type::OBJECT; }
+
+    /** Returns the value as a number, or the fallback if it is not a number */
+    double getNumber(double fallback = 0.0) const { return type == Type::NUMBER ? number : fallback; }
+
+    /** Returns the value as a boolean; numbers are true when non-zero */
+    bool getBool(bool fallback = false) const;
+
+    /** Returns the string value, or an empty string */
+    const std::string& getString() const { return text; }
+
+    /** Returns the number of array items or object properties */
+    int size() const { return (int) items.size(); }
+
+    /** Returns an array item or object property value; out of range gives a null value */
+    const JsonValue& operator[](int index) const;
+
+    /** Returns a property of an object, or a null value if it does not exist */
+    const JsonValue& operator[](const std::string& name) const;
+
+    /** Returns true if an object has a property */
+    bool hasProperty(const std::string& name) const;
+
+private:
+    friend class JsonParser;
+
+    Type type = Type::NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string text;
+
+    std::vector<JsonValue> items;   // array items, or object property values
+    std::vector<std::string> keys;  // object property names, parallel to items
+};
+
+}
+
+#endif /* __JSONREADER_H__ */
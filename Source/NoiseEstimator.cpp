@@ -0,0 +1,134 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "NoiseEstimator.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace GridViewer;
+
+namespace {
+
+// the bucket index is the float's exponent and top two mantissa bits, offset so 2^-4 is bucket 0
+const int MANTISSA_SHIFT = 21;
+const int BUCKET_OFFSET = (127 - 4) << 2;
+
+inline int getBucket(float amplitude)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &amplitude, sizeof(bits));
+
+    const int bucket = (int) (bits >> MANTISSA_SHIFT) - BUCKET_OFFSET;
+
+    return bucket < 0 ? 0 : (bucket >= NoiseEstimator::numBuckets ? NoiseEstimator::numBuckets - 1 : bucket);
+}
+
+/** Returns the smallest amplitude that falls in a bucket */
+inline float getBucketStart(int bucket)
+{
+    const uint32_t bits = (uint32_t) (bucket + BUCKET_OFFSET) << MANTISSA_SHIFT;
+
+    float amplitude;
+    std::memcpy(&amplitude, &bits, sizeof(amplitude));
+
+    return amplitude;
+}
+
+}
+
+NoiseEstimator::NoiseEstimator(int numChannels_, int stride_)
+    : numChannels(numChannels_ > 0 ? numChannels_ : 0),
+      stride(stride_ > 0 ? stride_ : 1),
+      counts((size_t) numChannels * numBuckets),
+      totals(numChannels),
+      skips(numChannels)
+{
+}
+
+void NoiseEstimator::addBlock(int channel, const float* samples, int numSamples, float centre)
+{
+    uint16_t* histogram = counts.get() + (size_t) channel * numBuckets;
+    uint32_t total = totals[channel];
+
+    int i = skips[channel];
+
+    for (; i < numSamples; i += stride)
+    {
+        histogram[getBucket(std::fabs(samples[i] - centre))]++;
+
+        if (++total >= maxCount)
+        {
+            total = 0;
+
+            for (int b = 0; b < numBuckets; b++)
+            {
+                histogram[b] = (uint16_t) (histogram[b] >> 1);
+                total += histogram[b];
+            }
+        }
+    }
+
+    totals[channel] = total;
+    skips[channel] = i - numSamples;
+}
+
+float NoiseEstimator::getNoise(int channel) const
+{
+    const uint32_t total = totals[channel];
+
+    if (total < minCount)
+        return 0.0f;
+
+    const uint16_t* histogram = counts.get() + (size_t) channel * numBuckets;
+    const float half = 0.5f * (float) total;
+
+    float below = 0.0f;
+
+    for (int b = 0; b < numBuckets; b++)
+    {
+        const float count = (float) histogram[b];
+
+        if (below + count >= half)
+        {
+            // interpolate linearly within the bucket
+            const float start = getBucketStart(b);
+            const float end = getBucketStart(b + 1);
+            const float median = start + (end - start) * (half - below) / count;
+
+            return median / 0.6745f;
+        }
+
+        below += count;
+    }
+
+    return getBucketStart(numBuckets) / 0.6745f;
+}
+
+void NoiseEstimator::reset()
+{
+    counts.fill(0);
+    totals.fill(0);
+    skips.fill(0);
+}
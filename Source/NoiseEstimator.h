@@ -0,0 +1,82 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __NOISEESTIMATOR_H__
+#define __NOISEESTIMATOR_H__
+
+#include "AlignedBuffer.h"
+
+#include <cstdint>
+
+namespace GridViewer {
+
+/**
+    Streaming per-channel noise level, from the median absolute deviation.
+
+    Every stride-th sample's distance from the channel's centre (its recent
+    mean) goes into a small histogram with four logarithmic buckets per
+    octave, so memory is fixed at numBuckets counters per channel and no
+    samples are stored. Once a channel's histogram holds maxCount samples
+    every bucket is halved, which makes old samples fade out exponentially
+    and lets the estimate follow slow changes.
+
+    The noise level is the median of the histogram divided by 0.6745, the
+    standard deviation of Gaussian noise with that MAD.
+ */
+class NoiseEstimator
+{
+public:
+    /** Buckets per channel; they cover 1/16 uV to 4096 uV */
+    static constexpr int numBuckets = 64;
+
+    /** Samples a channel's histogram holds before it is halved */
+    static constexpr uint32_t maxCount = 32768;
+
+    /** Samples needed before a channel has an estimate */
+    static constexpr uint32_t minCount = 256;
+
+    /** stride is the number of samples per sample kept */
+    NoiseEstimator(int numChannels, int stride);
+
+    /** Adds the samples of a channel's block; different channels may be added concurrently */
+    void addBlock(int channel, const float* samples, int numSamples, float centre);
+
+    /** Returns a channel's noise standard deviation estimate, or 0 if it has too few samples yet */
+    float getNoise(int channel) const;
+
+    /** Empties every histogram */
+    void reset();
+
+private:
+    int numChannels;
+    int stride;
+
+    AlignedBuffer<uint16_t> counts;     // numBuckets per channel
+    AlignedBuffer<uint32_t> totals;     // samples in each channel's histogram
+    AlignedBuffer<int32_t> skips;       // samples to skip before the channel's next kept sample
+};
+
+}
+
+#endif /* __NOISEESTIMATOR_H__ */
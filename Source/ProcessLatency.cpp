@@ -0,0 +1,205 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "ProcessLatency.h"
+
+#include <fstream>
+
+using namespace GridViewer;
+
+#pragma mark - LatencyHistogram -
+
+uint64_t LatencyHistogram::getBucketLowerBound(int bucket)
+{
+    if (bucket < numSubBuckets)
+        return (uint64_t) bucket;
+
+    const int shift = bucket / numSubBuckets - 1;
+
+    return (uint64_t) (numSubBuckets + bucket % numSubBuckets) << shift;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int bucket)
+{
+    if (bucket < numSubBuckets)
+        return (uint64_t) bucket;
+
+    const int shift = bucket / numSubBuckets - 1;
+
+    return getBucketLowerBound(bucket) + ((uint64_t) 1 << shift) - 1;
+}
+
+void LatencyHistogram::copyCounts(uint64_t* destination) const
+{
+    for (int i = 0; i < numBuckets; i++)
+        destination[i] = counts[i].load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::clear()
+{
+    for (auto& count : counts)
+        count.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getPercentile(const uint64_t* counts, double fraction)
+{
+    uint64_t total = 0;
+
+    for (int i = 0; i < numBuckets; i++)
+        total += counts[i];
+
+    if (total == 0)
+        return 0;
+
+    // the rank of the value the fraction reaches, counting from 1
+    uint64_t rank = (uint64_t) (fraction * (double) total + 0.5);
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+
+    uint64_t seen = 0;
+
+    for (int i = 0; i < numBuckets; i++)
+    {
+        seen += counts[i];
+
+        if (seen >= rank)
+            return getBucketUpperBound(i);
+    }
+
+    return getMaximum(counts);
+}
+
+uint64_t LatencyHistogram::getMaximum(const uint64_t* counts)
+{
+    for (int i = numBuckets - 1; i >= 0; i--)
+        if (counts[i] > 0)
+            return getBucketUpperBound(i);
+
+    return 0;
+}
+
+#pragma mark - ProcessLatency -
+
+ProcessLatency::ProcessLatency()
+{
+    clear();
+}
+
+LatencySummary ProcessLatency::poll()
+{
+    uint64_t nanosecondCounts[LatencyHistogram::numBuckets];
+    uint64_t budgetCounts[LatencyHistogram::numBuckets];
+
+    nanoseconds.copyCounts(nanosecondCounts);
+    budget.copyCounts(budgetCounts);
+
+    for (int i = 0; i < LatencyHistogram::numBuckets; i++)
+    {
+        const uint64_t n = nanosecondCounts[i];
+        const uint64_t b = budgetCounts[i];
+
+        nanosecondCounts[i] -= polledNanoseconds[i];
+        budgetCounts[i] -= polledBudget[i];
+
+        polledNanoseconds[i] = n;
+        polledBudget[i] = b;
+    }
+
+    return summarize(nanosecondCounts, budgetCounts);
+}
+
+LatencySummary ProcessLatency::getTotal() const
+{
+    uint64_t nanosecondCounts[LatencyHistogram::numBuckets];
+    uint64_t budgetCounts[LatencyHistogram::numBuckets];
+
+    nanoseconds.copyCounts(nanosecondCounts);
+    budget.copyCounts(budgetCounts);
+
+    return summarize(nanosecondCounts, budgetCounts);
+}
+
+void ProcessLatency::clear()
+{
+    nanoseconds.clear();
+    budget.clear();
+
+    for (int i = 0; i < LatencyHistogram::numBuckets; i++)
+    {
+        polledNanoseconds[i] = 0;
+        polledBudget[i] = 0;
+    }
+}
+
+LatencySummary ProcessLatency::summarize(const uint64_t* nanosecondCounts, const uint64_t* budgetCounts)
+{
+    LatencySummary summary;
+
+    for (int i = 0; i < LatencyHistogram::numBuckets; i++)
+        summary.numBlocks += nanosecondCounts[i];
+
+    summary.p50 = (double) LatencyHistogram::getPercentile(nanosecondCounts, 0.5) / 1000.0;
+    summary.p99 = (double) LatencyHistogram::getPercentile(nanosecondCounts, 0.99) / 1000.0;
+    summary.maximum = (double) LatencyHistogram::getMaximum(nanosecondCounts) / 1000.0;
+    summary.budgetP50 = (double) LatencyHistogram::getPercentile(budgetCounts, 0.5) / 100.0;
+    summary.budgetP99 = (double) LatencyHistogram::getPercentile(budgetCounts, 0.99) / 100.0;
+
+    return summary;
+}
+
+bool ProcessLatency::writeCsv(const std::string& path, std::string& error) const
+{
+    std::ofstream file(path);
+
+    if (! file)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    uint64_t counts[LatencyHistogram::numBuckets];
+
+    file << "histogram,lower,upper,count\n";
+
+    nanoseconds.copyCounts(counts);
+
+    for (int i = 0; i < LatencyHistogram::numBuckets; i++)
+        if (counts[i] > 0)
+            file << "latency_ns," << LatencyHistogram::getBucketLowerBound(i) << ","
+                 << LatencyHistogram::getBucketUpperBound(i) << "," << counts[i] << "\n";
+
+    budget.copyCounts(counts);
+
+    for (int i = 0; i < LatencyHistogram::numBuckets; i++)
+        if (counts[i] > 0)
+            file << "budget_percent," << (double) LatencyHistogram::getBucketLowerBound(i) / 100.0 << ","
+                 << (double) LatencyHistogram::getBucketUpperBound(i) / 100.0 << "," << counts[i] << "\n";
+
+    if (! file)
+    {
+        error = "could not write " + path;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,183 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __PROCESSLATENCY_H__
+#define __PROCESSLATENCY_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace GridViewer {
+
+/**
+    Counts of values in logarithmic buckets, in the style of HdrHistogram.
+
+    Values below 16 have a bucket each; above that every power of two is
+    split into 16 linear sub-buckets, so a bucket is never wider than about
+    6% of its values across the whole 64-bit range. There is one writer,
+    which only loads and stores its own counters and never waits; readers
+    may copy the counts at any time.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int subBucketBits = 4;
+    static constexpr int numSubBuckets = 1 << subBucketBits;
+    static constexpr int numBuckets = (64 - subBucketBits + 1) * numSubBuckets;
+
+    /** Returns the bucket holding a value */
+    static int getBucket(uint64_t value)
+    {
+        if (value < (uint64_t) numSubBuckets)
+            return (int) value;
+
+        const int exponent = 63 - countLeadingZeros(value);
+        const int shift = exponent - subBucketBits;
+
+        return (shift + 1) * numSubBuckets + (int) ((value >> shift) & (numSubBuckets - 1));
+    }
+
+    /** Returns the smallest value in a bucket */
+    static uint64_t getBucketLowerBound(int bucket);
+
+    /** Returns the largest value in a bucket */
+    static uint64_t getBucketUpperBound(int bucket);
+
+    /** Adds a value (writer side) */
+    void record(uint64_t value)
+    {
+        std::atomic<uint64_t>& count = counts[getBucket(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /** Copies all counts into an array of numBuckets (reader side) */
+    void copyCounts(uint64_t* destination) const;
+
+    /** Clears all counts (only while nothing is recorded) */
+    void clear();
+
+    /** Returns the upper bound of the bucket a fraction of the counted values reach, or 0 if there are none */
+    static uint64_t getPercentile(const uint64_t* counts, double fraction);
+
+    /** Returns the upper bound of the highest non-empty bucket, or 0 if there are none */
+    static uint64_t getMaximum(const uint64_t* counts);
+
+private:
+    std::atomic<uint64_t> counts[numBuckets] {};
+
+    static int countLeadingZeros(uint64_t value)
+    {
+#if defined(_MSC_VER)
+        int n = 0;
+
+        while ((value & (1ull << 63)) == 0)
+        {
+            value <<= 1;
+            n++;
+        }
+
+        return n;
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+};
+
+/** Latency of the recent blocks, in microseconds and percent of the block's duration */
+struct LatencySummary
+{
+    uint64_t numBlocks = 0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double maximum = 0.0;
+    double budgetP50 = 0.0;
+    double budgetP99 = 0.0;
+};
+
+/**
+    Time spent in GridViewerNode::process per block.
+
+    The audio thread takes a timestamp on entry and exit and records the
+    difference, plus the same time as a share of the block's duration (the
+    deadline the next callback sets). Recording is two clock reads and two
+    counter increments, far below the cost of even a small block. The
+    message thread polls for the blocks since its previous poll and can
+    write everything since the last clear() to a file.
+ */
+class ProcessLatency
+{
+public:
+    ProcessLatency();
+
+    /** Monotonic clock in nanoseconds */
+    static uint64_t now()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Records one block that took from start to end and covers budgetNanoseconds of signal (audio thread) */
+    void record(uint64_t start, uint64_t end, double budgetNanoseconds)
+    {
+        const uint64_t elapsed = end > start ? end - start : 0;
+
+        nanoseconds.record(elapsed);
+
+        // in hundredths of a percent, to share the histogram's integer buckets
+        if (budgetNanoseconds > 0.0)
+            budget.record((uint64_t) ((double) elapsed * 10000.0 / budgetNanoseconds));
+    }
+
+    /** Summarizes the blocks recorded since the previous poll (message thread) */
+    LatencySummary poll();
+
+    /** Summarizes every block since the last clear() (message thread) */
+    LatencySummary getTotal() const;
+
+    /** Discards everything recorded (only while acquisition is stopped) */
+    void clear();
+
+    /**
+     *  Writes the non-empty buckets of both histograms since the last clear()
+     *  as CSV: histogram, lower bound, upper bound, count. Latency bounds are
+     *  in ns and budget bounds in percent.
+     */
+    bool writeCsv(const std::string& path, std::string& error) const;
+
+private:
+    LatencyHistogram nanoseconds;
+    LatencyHistogram budget;
+
+    // counts at the previous poll, so each poll covers only the blocks since then
+    uint64_t polledNanoseconds[LatencyHistogram::numBuckets];
+    uint64_t polledBudget[LatencyHistogram::numBuckets];
+
+    static LatencySummary summarize(const uint64_t* nanosecondCounts, const uint64_t* budgetCounts);
+};
+
+}
+
+#endif /* __PROCESSLATENCY_H__ */
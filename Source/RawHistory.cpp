@@ -0,0 +1,540 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "RawHistory.h"
+
+#include "ChannelSpan.h"
+#include "StreamActivity.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace GridViewer;
+
+namespace {
+
+// bounds how long a missed wake-up can leave queued blocks uncompressed
+const auto SLEEP_TIMEOUT = std::chrono::milliseconds(100);
+
+// the queue slots take at most this share of the memory budget
+const size_t QUEUE_BUDGET_DIVISOR = 4;
+
+/** Samples per channel each queue slot holds, within its share of the budget */
+int getSamplesPerSlot(int maxChannels, size_t budgetBytes)
+{
+    if (maxChannels <= 0)
+        return RawHistory::slotSamples;
+
+    const size_t slotValues = budgetBytes / QUEUE_BUDGET_DIVISOR / RawHistory::numSlots / sizeof(int16_t);
+
+    return (int) std::max<size_t>(1, std::min<size_t>(RawHistory::slotSamples, slotValues / (size_t) maxChannels));
+}
+
+inline uint32_t zigzag(int32_t delta)
+{
+    return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+inline int32_t unzigzag(uint32_t code)
+{
+    return (int32_t) (code >> 1) ^ -(int32_t) (code & 1);
+}
+
+/** Appends one channel: bit width, first sample, then bit-packed zigzag deltas */
+void encodeChannel(const int16_t* x, int numSamples, std::vector<uint8_t>& bytes)
+{
+    uint32_t largest = 0;
+
+    for (int i = 1; i < numSamples; i++)
+        largest |= zigzag((int32_t) x[i] - (int32_t) x[i - 1]);
+
+    int width = 0;
+
+    while (width < 32 && (largest >> width) != 0)
+        width++;
+
+    bytes.push_back((uint8_t) width);
+    bytes.push_back((uint8_t) ((uint16_t) x[0] & 0xff));
+    bytes.push_back((uint8_t) ((uint16_t) x[0] >> 8));
+
+    uint64_t pending = 0;
+    int numPending = 0;
+
+    for (int i = 1; i < numSamples; i++)
+    {
+        pending |= (uint64_t) zigzag((int32_t) x[i] - (int32_t) x[i - 1]) << numPending;
+        numPending += width;
+
+        while (numPending >= 8)
+        {
+            bytes.push_back((uint8_t) pending);
+            pending >>= 8;
+            numPending -= 8;
+        }
+    }
+
+    if (numPending > 0)
+        bytes.push_back((uint8_t) pending);
+}
+
+/** Copies every metric and the timing of a frame */
+void copyFrame(const ActivitySnapshot& frame, ActivitySnapshot& result)
+{
+    if (result.numChannels != frame.numChannels)
+        result.allocate(frame.numChannels);
+
+    for (int m = 0; m < numActivityMetrics; m++)
+        std::copy(frame.getValues((ActivityMetric) m),
+                  frame.getValues((ActivityMetric) m) + frame.numChannels,
+                  result.getValues((ActivityMetric) m));
+
+    result.frameCounter = frame.frameCounter;
+    result.sampleTimestamp = frame.sampleTimestamp;
+    result.numSamples = frame.numSamples;
+}
+
+}
+
+RawHistory::RawHistory(int maxChannels_, size_t budgetBytes_, float microvoltsPerBit_)
+    : maxChannels(maxChannels_ > 0 ? maxChannels_ : 0),
+      samplesPerSlot(getSamplesPerSlot(maxChannels, budgetBytes_)),
+      budgetBytes(budgetBytes_),
+      blockBudgetBytes(budgetBytes - std::min(budgetBytes, (size_t) numSlots * maxChannels * samplesPerSlot * sizeof(int16_t))),
+      microvoltsPerBit(microvoltsPerBit_),
+      requestedStream(0),
+      head(0),
+      tail(0),
+      numDroppedBlocks(0),
+      stopping(false),
+      storedBytes(0),
+      storedStream(0),
+      storedChannels(0),
+      storedSampleRate(0.0f),
+      scratchWindow(0),
+      requestNumber(0),
+      analysedNumber(0),
+      analysisStatus(AnalysisStatus::UNAVAILABLE)
+{
+    for (auto& slot : slots)
+        slot.samples.reset(new int16_t[(size_t) maxChannels * samplesPerSlot]);
+
+    compressor = std::thread([this] { compressorLoop(); });
+    analyser = std::thread([this] { analysisLoop(); });
+}
+
+RawHistory::~RawHistory()
+{
+    {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        std::lock_guard<std::mutex> analysisGuard(analysisLock);
+        stopping.store(true);
+    }
+
+    wakeCondition.notify_all();
+    analysisCondition.notify_all();
+
+    compressor.join();
+    analyser.join();
+}
+
+bool RawHistory::push(uint32_t streamId,
+                      float sampleRate,
+                      const float* const* bufferChannels,
+                      const int* channelIndices,
+                      int numChannels,
+                      int numSamples,
+                      int64_t firstSample)
+{
+    if (numChannels > maxChannels)
+        return false;
+
+    const float scale = 1.0f / microvoltsPerBit;
+
+    for (int offset = 0; offset < numSamples; offset += samplesPerSlot)
+    {
+        const uint32_t slotIndex = head.load(std::memory_order_relaxed);
+
+        if (slotIndex - tail.load(std::memory_order_acquire) >= (uint32_t) numSlots)
+        {
+            numDroppedBlocks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Slot& slot = slots[slotIndex % numSlots];
+        const int n = std::min(samplesPerSlot, numSamples - offset);
+
+        slot.streamId = streamId;
+        slot.sampleRate = sampleRate;
+        slot.numChannels = numChannels;
+        slot.numSamples = n;
+        slot.firstSample = firstSample + offset;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            const float* x = bufferChannels[channelIndices[c]] + offset;
+            int16_t* q = slot.samples.get() + (size_t) c * samplesPerSlot;
+
+            for (int i = 0; i < n; i++)
+            {
+                const float v = x[i] * scale;
+                const float clamped = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+                q[i] = (int16_t) (clamped + (clamped >= 0.0f ? 0.5f : -0.5f));
+            }
+        }
+
+        head.store(slotIndex + 1, std::memory_order_release);
+    }
+
+    wakeCondition.notify_one();
+
+    return true;
+}
+
+void RawHistory::compressorLoop()
+{
+    GRIDVIEWER_TRACE_THREAD("Grid Viewer raw history");
+
+    while (! stopping.load(std::memory_order_relaxed))
+    {
+        const uint32_t slotIndex = tail.load(std::memory_order_relaxed);
+
+        if (slotIndex == head.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wakeCondition.wait_for(guard, SLEEP_TIMEOUT, [&] { return head.load(std::memory_order_acquire) != slotIndex || stopping.load(); });
+            continue;
+        }
+
+        store(slots[slotIndex % numSlots]);
+
+        tail.store(slotIndex + 1, std::memory_order_release);
+    }
+}
+
+void RawHistory::store(const Slot& slot)
+{
+    GRIDVIEWER_TRACE_SCOPE("RawHistory::store");
+
+    auto block = std::make_shared<Block>();
+    block->firstSample = slot.firstSample;
+    block->numSamples = slot.numSamples;
+    block->bytes.reserve((size_t) slot.numChannels * ((size_t) slot.numSamples * 2 + 3));
+
+    for (int c = 0; c < slot.numChannels; c++)
+        encodeChannel(slot.samples.get() + (size_t) c * samplesPerSlot, slot.numSamples, block->bytes);
+
+    block->bytes.shrink_to_fit();
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    const bool sameStream = slot.streamId == storedStream
+                            && slot.numChannels == storedChannels
+                            && slot.sampleRate == storedSampleRate;
+
+    // a gap only splits the stored range; going back means acquisition started again
+    const bool goesBack = ! blocks.empty()
+                          && slot.firstSample < blocks.back()->firstSample + blocks.back()->numSamples;
+
+    if (! sameStream || goesBack)
+    {
+        blocks.clear();
+        storedBytes = 0;
+        storedStream = slot.streamId;
+        storedChannels = slot.numChannels;
+        storedSampleRate = slot.sampleRate;
+    }
+
+    storedBytes += block->bytes.size();
+    blocks.push_back(std::move(block));
+
+    while (storedBytes > blockBudgetBytes && blocks.size() > 1)
+    {
+        storedBytes -= blocks.front()->bytes.size();
+        blocks.pop_front();
+    }
+}
+
+const uint8_t* RawHistory::decodeChannel(const uint8_t* bytes, int numSamples, float microvoltsPerBit, float* out)
+{
+    const int width = bytes[0];
+    int32_t previous = (int16_t) (uint16_t) (bytes[1] | (bytes[2] << 8));
+    bytes += 3;
+
+    out[0] = (float) previous * microvoltsPerBit;
+
+    const uint64_t mask = width > 0 ? (~(uint64_t) 0 >> (64 - width)) : 0;
+    uint64_t pending = 0;
+    int numPending = 0;
+
+    for (int i = 1; i < numSamples; i++)
+    {
+        while (numPending < width)
+        {
+            pending |= (uint64_t) *bytes++ << numPending;
+            numPending += 8;
+        }
+
+        previous += unzigzag((uint32_t) (pending & mask));
+        pending >>= width;
+        numPending -= width;
+
+        out[i] = (float) previous * microvoltsPerBit;
+    }
+
+    return bytes;
+}
+
+uint32_t RawHistory::getStreamId() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return storedStream;
+}
+
+int RawHistory::getNumChannels() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return storedChannels;
+}
+
+float RawHistory::getSampleRate() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return storedSampleRate;
+}
+
+void RawHistory::getStoredRange(int64_t& firstSample, int64_t& endSample) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (blocks.empty())
+    {
+        firstSample = endSample = 0;
+        return;
+    }
+
+    firstSample = blocks.front()->firstSample;
+    endSample = blocks.back()->firstSample + blocks.back()->numSamples;
+}
+
+size_t RawHistory::getCompressedBytes() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return storedBytes;
+}
+
+bool RawHistory::analyse(int64_t start, int64_t end, FilterBand band, float threshold, ActivitySnapshot& result) const
+{
+    return analyseWindow(start, end, band, threshold, result, 0);
+}
+
+void RawHistory::requestAnalysis(const AnalysisRequest& request)
+{
+    {
+        std::lock_guard<std::mutex> guard(analysisLock);
+
+        const bool finished = analysedNumber == requestNumber.load(std::memory_order_relaxed);
+
+        if (requestNumber.load(std::memory_order_relaxed) != 0 && request == analysisRequest
+            && ! (finished && analysisStatus == AnalysisStatus::UNAVAILABLE))
+            return;
+
+        analysisRequest = request;
+        requestNumber.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    analysisCondition.notify_one();
+}
+
+RawHistory::AnalysisStatus RawHistory::getAnalysis(const AnalysisRequest& request, ActivitySnapshot& result) const
+{
+    std::lock_guard<std::mutex> guard(analysisLock);
+
+    if (! (request == analysisRequest) || analysedNumber != requestNumber.load(std::memory_order_relaxed))
+        return AnalysisStatus::PENDING;
+
+    if (analysisStatus == AnalysisStatus::READY)
+        copyFrame(analysisResult, result);
+
+    return analysisStatus;
+}
+
+void RawHistory::analysisLoop()
+{
+    GRIDVIEWER_TRACE_THREAD("Grid Viewer raw analysis");
+
+    std::unique_lock<std::mutex> guard(analysisLock);
+
+    while (true)
+    {
+        analysisCondition.wait(guard, [this] { return stopping.load() || analysedNumber != requestNumber.load(std::memory_order_relaxed); });
+
+        if (stopping.load())
+            return;
+
+        const AnalysisRequest request = analysisRequest;
+        const uint64_t number = requestNumber.load(std::memory_order_relaxed);
+
+        guard.unlock();
+
+        const bool analysed = analyseWindow(request.start, request.end, request.band, request.threshold, analysisFrame, number);
+
+        guard.lock();
+
+        // a newer request is picked up on the next pass
+        if (number != requestNumber.load(std::memory_order_relaxed))
+            continue;
+
+        if (analysed)
+            copyFrame(analysisFrame, analysisResult);
+
+        analysisStatus = analysed ? AnalysisStatus::READY : AnalysisStatus::UNAVAILABLE;
+        analysedNumber = number;
+    }
+}
+
+bool RawHistory::analyseWindow(int64_t start,
+                               int64_t end,
+                               FilterBand band,
+                               float threshold,
+                               ActivitySnapshot& result,
+                               uint64_t number) const
+{
+    GRIDVIEWER_TRACE_SCOPE("RawHistory::analyseWindow");
+
+    std::vector<std::shared_ptr<const Block>> window;
+    uint32_t streamId;
+    int numChannels;
+    float sampleRate;
+    int64_t settleFrom;
+
+    {
+        // copy the block list, so decoding does not hold up the compressor
+        std::lock_guard<std::mutex> guard(lock);
+
+        // the filters run over the samples before the window until they have settled
+        settleFrom = start - FilterBank::getSettlingSamples(band, storedSampleRate);
+
+        if (blocks.empty() || end <= start
+            || settleFrom < blocks.front()->firstSample
+            || end > blocks.back()->firstSample + blocks.back()->numSamples)
+            return false;
+
+        for (auto& block : blocks)
+            if (block->firstSample < end && block->firstSample + block->numSamples > settleFrom)
+                window.push_back(block);
+
+        // the window and its settling samples have to be one contiguous range
+        if (window.empty() || window.front()->firstSample > settleFrom
+            || window.back()->firstSample + window.back()->numSamples < end)
+            return false;
+
+        for (size_t i = 1; i < window.size(); i++)
+            if (window[i]->firstSample != window[i - 1]->firstSample + window[i - 1]->numSamples)
+                return false;
+
+        streamId = storedStream;
+        numChannels = storedChannels;
+        sampleRate = storedSampleRate;
+    }
+
+    std::lock_guard<std::mutex> scratchGuard(scratchLock);
+
+    if (scratchStream == nullptr
+        || scratchStream->getStreamId() != streamId
+        || scratchStream->getNumChannels() != numChannels
+        || scratchStream->getSampleRate() != sampleRate
+        || scratchWindow != end - start)
+    {
+        std::vector<int> channels((size_t) numChannels);
+
+        for (int c = 0; c < numChannels; c++)
+            channels[(size_t) c] = c;
+
+        // one frame covering exactly the window; the half sample keeps the interval from rounding down
+        scratchStream = std::make_unique<StreamActivity>(streamId,
+                                                         numChannels,
+                                                         sampleRate,
+                                                         sampleRate / ((float) (end - start) + 0.5f),
+                                                         ChannelSpan::fromBufferChannels(channels));
+        scratchWindow = end - start;
+
+        scratchSamples.resize((size_t) numChannels * slotSamples);
+        scratchPointers.resize((size_t) numChannels);
+    }
+
+    StreamActivity& stream = *scratchStream;
+
+    // starts from rest, as a new one would
+    stream.reset();
+    stream.setFilterBand(band);
+    stream.setThreshold(threshold);
+
+    const uint64_t previousFrame = stream.getLatestFrame().frameCounter;
+    float* decoded = scratchSamples.data();
+
+    // feeds samples [first, last) of the decoded block starting at blockFirst
+    auto feed = [&] (int64_t blockFirst, int64_t first, int64_t last)
+    {
+        if (last <= first)
+            return;
+
+        for (int c = 0; c < numChannels; c++)
+            scratchPointers[(size_t) c] = decoded + (size_t) c * slotSamples + (first - blockFirst);
+
+        stream.processBlock(scratchPointers.data(), (int) (last - first), first);
+    };
+
+    for (auto& block : window)
+    {
+        // a newer request has replaced this one, or the history is going away
+        if (number != 0 && (number != requestNumber.load(std::memory_order_relaxed) || stopping.load(std::memory_order_relaxed)))
+            return false;
+
+        const uint8_t* bytes = block->bytes.data();
+
+        for (int c = 0; c < numChannels; c++)
+            bytes = decodeChannel(bytes, block->numSamples, microvoltsPerBit, decoded + (size_t) c * slotSamples);
+
+        const int64_t first = std::max(settleFrom, block->firstSample);
+        const int64_t last = std::min(end, block->firstSample + block->numSamples);
+
+        feed(block->firstSample, first, std::min(last, start));
+
+        // whatever the settling samples added is not part of the window
+        if (first <= start && start < last)
+            stream.discardInterval();
+
+        feed(block->firstSample, std::max(first, start), last);
+    }
+
+    const ActivitySnapshot& frame = stream.getLatestFrame();
+
+    if (frame.frameCounter == previousFrame || frame.sampleTimestamp != end)
+        return false;
+
+    copyFrame(frame, result);
+
+    return true;
+}
@@ -0,0 +1,239 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __RAWHISTORY_H__
+#define __RAWHISTORY_H__
+
+#include "ActivitySnapshot.h"
+#include "FilterBank.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GridViewer {
+
+class StreamActivity;
+
+/**
+    The last few seconds of one stream's raw samples, compressed in memory,
+    so past activity can be recomputed exactly without touching disk.
+
+    The audio thread quantizes each block to int16 and copies it into a
+    fixed ring of slots shared with a background thread, using only an
+    atomic head and tail: a full queue drops the block rather than wait.
+    It then signals a condition variable, without its mutex, that the
+    background thread sleeps on while the queue is empty. That thread
+    stores each channel of a block as its first sample followed by
+    zigzag-encoded deltas bit-packed at the smallest width that holds
+    them all, and discards the oldest blocks to stay within the memory
+    budget. The queue's slots count against that budget too: with too many
+    channels for a quarter of it, each slot holds fewer samples. A gap in
+    timestamps, such as a block the full queue dropped, splits the stored
+    blocks into separate contiguous ranges; a change of stream, channel
+    count or sample rate, or timestamps going back, starts them again.
+
+    Windows are recomputed either in the calling thread, or on a third
+    thread that works on the newest request only and gives up on one a
+    newer request has replaced. Both reuse one StreamActivity and its
+    decoding buffers while the stream and the window length stay the same.
+ */
+class RawHistory
+{
+public:
+    /** A window to recompute, with the band and crossing threshold to recompute it with */
+    struct AnalysisRequest
+    {
+        int64_t start = 0;
+        int64_t end = 0;
+        FilterBand band = FilterBand::BROADBAND;
+        float threshold = 0.0f;
+
+        bool operator==(const AnalysisRequest& other) const
+        {
+            return start == other.start && end == other.end && band == other.band && threshold == other.threshold;
+        }
+    };
+
+    enum class AnalysisStatus
+    {
+        PENDING,        // not finished, or not the newest request
+        READY,
+        UNAVAILABLE     // the window or its settling time is not stored
+    };
+
+    /** Samples per channel a queue slot holds at most; longer blocks take several slots */
+    static constexpr int slotSamples = 1024;
+
+    /** Number of queue slots between the audio thread and the compressor */
+    static constexpr int numSlots = 8;
+
+    /** Starts the compressor and analysis threads. maxChannels bounds the channel count of any stream pushed. */
+    RawHistory(int maxChannels, size_t budgetBytes, float microvoltsPerBit = 0.195f);
+
+    /** Stops the compressor and analysis threads */
+    ~RawHistory();
+
+    /** Selects the stream to keep; the stored data starts again from its next block (any thread) */
+    void setStream(uint32_t streamId) { requestedStream.store(streamId, std::memory_order_relaxed); }
+
+    /** Returns the stream the audio thread should push */
+    uint32_t getRequestedStream() const { return requestedStream.load(std::memory_order_relaxed); }
+
+    /**
+     *  Queues one block of a stream's channels, given the buffer and the
+     *  buffer index of each channel in stream order. Never blocks or
+     *  allocates; returns false if the queue was full and the block dropped
+     *  (audio thread only).
+     */
+    bool push(uint32_t streamId,
+              float sampleRate,
+              const float* const* bufferChannels,
+              const int* channelIndices,
+              int numChannels,
+              int numSamples,
+              int64_t firstSample);
+
+    /** Stream, channel count and sample rate of the stored data */
+    uint32_t getStreamId() const;
+    int getNumChannels() const;
+    float getSampleRate() const;
+
+    /** First and end sample of the stored blocks, which may have gaps between them; empty if nothing is stored */
+    void getStoredRange(int64_t& firstSample, int64_t& endSample) const;
+
+    /** Returns the bytes used by compressed blocks */
+    size_t getCompressedBytes() const;
+
+    /** Returns the number of blocks dropped because the queue was full */
+    uint64_t getNumDroppedBlocks() const { return numDroppedBlocks.load(std::memory_order_relaxed); }
+
+    /**
+     *  Recomputes every metric over samples [start, end) of the stored
+     *  stream, filtered to a band and with a fixed crossing threshold. The
+     *  filters first run over the band's settling time before the window,
+     *  so they are in the state live processing left them in. Returns false
+     *  if the window and its settling time are not one contiguous stored
+     *  range (any thread but the audio thread).
+     */
+    bool analyse(int64_t start, int64_t end, FilterBand band, float threshold, ActivitySnapshot& result) const;
+
+    /**
+     *  Has the analysis thread recompute a window as analyse() does,
+     *  replacing any request it has not finished. Asking again for the
+     *  newest request does nothing unless it was unavailable (message thread).
+     */
+    void requestAnalysis(const AnalysisRequest& request);
+
+    /** Copies the metrics recomputed for a request into result once they are ready (message thread) */
+    AnalysisStatus getAnalysis(const AnalysisRequest& request, ActivitySnapshot& result) const;
+
+private:
+    struct Slot
+    {
+        uint32_t streamId;
+        float sampleRate;
+        int numChannels;
+        int numSamples;
+        int64_t firstSample;
+        std::unique_ptr<int16_t[]> samples;     // channel-major, samplesPerSlot per channel
+    };
+
+    struct Block
+    {
+        int64_t firstSample;
+        int numSamples;
+        std::vector<uint8_t> bytes;
+    };
+
+    void compressorLoop();
+
+    void analysisLoop();
+
+    /** Does the work of analyse(); gives up once request number requestNumber is replaced, unless it is 0 */
+    bool analyseWindow(int64_t start, int64_t end, FilterBand band, float threshold, ActivitySnapshot& result, uint64_t requestNumber) const;
+
+    /** Compresses a slot and appends it to the stored blocks */
+    void store(const Slot& slot);
+
+    /** Unpacks one channel of a block into floats */
+    static const uint8_t* decodeChannel(const uint8_t* bytes, int numSamples, float microvoltsPerBit, float* out);
+
+    const int maxChannels;
+    const int samplesPerSlot;
+    const size_t budgetBytes;
+    const size_t blockBudgetBytes;      // what the queue slots leave of budgetBytes
+    const float microvoltsPerBit;
+
+    std::atomic<uint32_t> requestedStream;
+
+    Slot slots[numSlots];
+    std::atomic<uint32_t> head;     // next slot the audio thread fills
+    std::atomic<uint32_t> tail;     // next slot the compressor empties
+    std::atomic<uint64_t> numDroppedBlocks;
+
+    std::atomic<bool> stopping;
+    std::thread compressor;
+
+    // the audio thread notifies without taking wakeLock; a missed wake-up only delays compression
+    std::mutex wakeLock;
+    std::condition_variable wakeCondition;
+
+    // everything below is guarded by lock; blocks are immutable once stored
+    mutable std::mutex lock;
+    std::deque<std::shared_ptr<const Block>> blocks;
+    size_t storedBytes;
+    uint32_t storedStream;
+    int storedChannels;
+    float storedSampleRate;
+
+    // reused by every analysis while the stream and window length stay the same; held for a whole analysis
+    mutable std::mutex scratchLock;
+    mutable std::unique_ptr<StreamActivity> scratchStream;
+    mutable int64_t scratchWindow;
+    mutable std::vector<float> scratchSamples;
+    mutable std::vector<const float*> scratchPointers;
+
+    std::thread analyser;
+
+    // the newest request and what the analysis thread made of it, guarded by analysisLock
+    mutable std::mutex analysisLock;
+    std::condition_variable analysisCondition;
+    AnalysisRequest analysisRequest;
+    std::atomic<uint64_t> requestNumber;    // a running analysis gives up when this moves on
+    uint64_t analysedNumber;
+    AnalysisStatus analysisStatus;
+    ActivitySnapshot analysisResult;
+    ActivitySnapshot analysisFrame;         // written by the analysis thread without the lock
+};
+
+}
+
+#endif /* __RAWHISTORY_H__ */
@@ -0,0 +1,420 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ReductionKernels.h"
+
+#include <cmath>
+
+#if GRIDVIEWER_X86
+ #include <immintrin.h>
+#endif
+
+using namespace GridViewer;
+
+namespace {
+
+typedef void (*MinMaxFunction)(const float*, int, float&, float&);
+typedef void (*StatisticsFunction)(const float*, int, float, ChannelStatistics&);
+
+void minMaxScalar(const float* x, int n, float& minValue, float& maxValue)
+{
+    float lo = minValue;
+    float hi = maxValue;
+
+    for (int i = 0; i < n; i++)
+    {
+        lo = x[i] < lo ? x[i] : lo;
+        hi = x[i] > hi ? x[i] : hi;
+    }
+
+    minValue = lo;
+    maxValue = hi;
+}
+
+/** Folds samples [begin, end), where x[begin - 1] (or the carried sample) is previous */
+void accumulateStatistics(const float* x, int begin, int end, float previous, float threshold, ChannelStatistics& stats)
+{
+    ChannelStatistics s = stats;
+
+    for (int i = begin; i < end; i++)
+    {
+        const float v = x[i];
+
+        s.minimum = v < s.minimum ? v : s.minimum;
+        s.maximum = v > s.maximum ? v : s.maximum;
+        s.sum += v;
+        s.sumOfSquares += v * v;
+        s.lineLength += std::fabs(v - previous);
+        s.crossings += (previous >= threshold && v < threshold) ? 1 : 0;
+
+        previous = v;
+    }
+
+    s.lastSample = previous;
+    s.hasLastSample = 1;
+    stats = s;
+}
+
+void statisticsScalar(const float* x, int n, float threshold, ChannelStatistics& stats)
+{
+    if (n <= 0)
+        return;
+
+    accumulateStatistics(x, 0, n, stats.hasLastSample ? stats.lastSample : x[0], threshold, stats);
+}
+
+#if GRIDVIEWER_X86
+
+float horizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+float horizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+void minMaxSse2(const float* x, int n, float& minValue, float& maxValue)
+{
+    // two independent accumulators per bound hide the min/max latency
+    __m128 lo0 = _mm_set1_ps(minValue), lo1 = lo0;
+    __m128 hi0 = _mm_set1_ps(maxValue), hi1 = hi0;
+
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128 a = _mm_loadu_ps(x + i);
+        const __m128 b = _mm_loadu_ps(x + i + 4);
+        lo0 = _mm_min_ps(lo0, a);
+        lo1 = _mm_min_ps(lo1, b);
+        hi0 = _mm_max_ps(hi0, a);
+        hi1 = _mm_max_ps(hi1, b);
+    }
+
+    minValue = horizontalMin(_mm_min_ps(lo0, lo1));
+    maxValue = horizontalMax(_mm_max_ps(hi0, hi1));
+
+    minMaxScalar(x + i, n - i, minValue, maxValue);
+}
+
+GRIDVIEWER_TARGET("avx2")
+void minMaxAvx2(const float* x, int n, float& minValue, float& maxValue)
+{
+    __m256 lo0 = _mm256_set1_ps(minValue), lo1 = lo0;
+    __m256 hi0 = _mm256_set1_ps(maxValue), hi1 = hi0;
+
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256 a = _mm256_loadu_ps(x + i);
+        const __m256 b = _mm256_loadu_ps(x + i + 8);
+        lo0 = _mm256_min_ps(lo0, a);
+        lo1 = _mm256_min_ps(lo1, b);
+        hi0 = _mm256_max_ps(hi0, a);
+        hi1 = _mm256_max_ps(hi1, b);
+    }
+
+    const __m256 lo = _mm256_min_ps(lo0, lo1);
+    const __m256 hi = _mm256_max_ps(hi0, hi1);
+
+    minValue = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1)));
+    maxValue = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1)));
+
+    minMaxScalar(x + i, n - i, minValue, maxValue);
+}
+
+// GCC's _mm512_castps512_ps256 is an unmasked extract as well
+GRIDVIEWER_TARGET("avx512f")
+__m256 halfAvx512(__m512 v, int half)
+{
+    const __m256d zero = _mm256_setzero_pd();
+
+    return _mm256_castpd_ps(half == 0 ? _mm512_mask_extractf64x4_pd(zero, 0xff, _mm512_castps_pd(v), 0)
+                                      : _mm512_mask_extractf64x4_pd(zero, 0xff, _mm512_castps_pd(v), 1));
+}
+
+GRIDVIEWER_TARGET("avx512f")
+void minMaxAvx512(const float* x, int n, float& minValue, float& maxValue)
+{
+    // GCC's unmasked min/max/extract pass _mm512_undefined_ps() as the merge
+    // source, which it then reports as uninitialized; an all-lanes mask with an
+    // explicit source is the same instruction without the warning
+    const __mmask16 all = (__mmask16) 0xffff;
+
+    __m512 lo0 = _mm512_set1_ps(minValue), lo1 = lo0;
+    __m512 hi0 = _mm512_set1_ps(maxValue), hi1 = hi0;
+
+    int i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        const __m512 a = _mm512_loadu_ps(x + i);
+        const __m512 b = _mm512_loadu_ps(x + i + 16);
+        lo0 = _mm512_mask_min_ps(lo0, all, lo0, a);
+        lo1 = _mm512_mask_min_ps(lo1, all, lo1, b);
+        hi0 = _mm512_mask_max_ps(hi0, all, hi0, a);
+        hi1 = _mm512_mask_max_ps(hi1, all, hi1, b);
+    }
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m512 a = _mm512_loadu_ps(x + i);
+        lo0 = _mm512_mask_min_ps(lo0, all, lo0, a);
+        hi0 = _mm512_mask_max_ps(hi0, all, hi0, a);
+    }
+
+    // the tail is a masked load; masked-off lanes keep the running bound
+    if (i < n)
+    {
+        const __mmask16 mask = (__mmask16) ((1u << (n - i)) - 1u);
+        const __m512 a = _mm512_maskz_loadu_ps(mask, x + i);
+        lo1 = _mm512_mask_min_ps(lo1, mask, lo1, a);
+        hi1 = _mm512_mask_max_ps(hi1, mask, hi1, a);
+    }
+
+    lo0 = _mm512_mask_min_ps(lo0, all, lo0, lo1);
+    hi0 = _mm512_mask_max_ps(hi0, all, hi0, hi1);
+
+    // folded to 128 bits by hand rather than with _mm512_reduce_*, which has the same problem
+    const __m256 lo = _mm256_min_ps(halfAvx512(lo0, 0), halfAvx512(lo0, 1));
+    const __m256 hi = _mm256_max_ps(halfAvx512(hi0, 0), halfAvx512(hi0, 1));
+
+    minValue = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1)));
+    maxValue = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1)));
+}
+
+float horizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+int horizontalSum(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+/*
+    The vector statistics kernels handle the first sample of a block on the
+    scalar path, since its predecessor is the carried sample; every later
+    sample's predecessor is a plain unaligned load one element back. A
+    crossing mask is all ones (-1), so subtracting it counts crossings.
+ */
+
+void statisticsSse2(const float* x, int n, float threshold, ChannelStatistics& stats)
+{
+    if (n <= 0)
+        return;
+
+    accumulateStatistics(x, 0, 1, stats.hasLastSample ? stats.lastSample : x[0], threshold, stats);
+
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 thr = _mm_set1_ps(threshold);
+
+    __m128 lo = _mm_set1_ps(stats.minimum);
+    __m128 hi = _mm_set1_ps(stats.maximum);
+    __m128 sum = _mm_setzero_ps();
+    __m128 sumSq = _mm_setzero_ps();
+    __m128 length = _mm_setzero_ps();
+    __m128i crossings = _mm_setzero_si128();
+
+    int i = 1;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 v = _mm_loadu_ps(x + i);
+        const __m128 p = _mm_loadu_ps(x + i - 1);
+
+        lo = _mm_min_ps(lo, v);
+        hi = _mm_max_ps(hi, v);
+        sum = _mm_add_ps(sum, v);
+        sumSq = _mm_add_ps(sumSq, _mm_mul_ps(v, v));
+        length = _mm_add_ps(length, _mm_and_ps(_mm_sub_ps(v, p), absMask));
+
+        const __m128 crossed = _mm_and_ps(_mm_cmpge_ps(p, thr), _mm_cmplt_ps(v, thr));
+        crossings = _mm_sub_epi32(crossings, _mm_castps_si128(crossed));
+    }
+
+    if (i > 1)
+    {
+        stats.minimum = horizontalMin(lo);
+        stats.maximum = horizontalMax(hi);
+        stats.sum += horizontalSum(sum);
+        stats.sumOfSquares += horizontalSum(sumSq);
+        stats.lineLength += horizontalSum(length);
+        stats.crossings += horizontalSum(crossings);
+    }
+
+    accumulateStatistics(x, i, n, x[i - 1], threshold, stats);
+}
+
+GRIDVIEWER_TARGET("avx2")
+void statisticsAvx2(const float* x, int n, float threshold, ChannelStatistics& stats)
+{
+    if (n <= 0)
+        return;
+
+    accumulateStatistics(x, 0, 1, stats.hasLastSample ? stats.lastSample : x[0], threshold, stats);
+
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 thr = _mm256_set1_ps(threshold);
+
+    __m256 lo = _mm256_set1_ps(stats.minimum);
+    __m256 hi = _mm256_set1_ps(stats.maximum);
+    __m256 sum = _mm256_setzero_ps();
+    __m256 sumSq = _mm256_setzero_ps();
+    __m256 length = _mm256_setzero_ps();
+    __m256i crossings = _mm256_setzero_si256();
+
+    int i = 1;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        const __m256 p = _mm256_loadu_ps(x + i - 1);
+
+        lo = _mm256_min_ps(lo, v);
+        hi = _mm256_max_ps(hi, v);
+        sum = _mm256_add_ps(sum, v);
+        sumSq = _mm256_add_ps(sumSq, _mm256_mul_ps(v, v));
+        length = _mm256_add_ps(length, _mm256_and_ps(_mm256_sub_ps(v, p), absMask));
+
+        const __m256 crossed = _mm256_and_ps(_mm256_cmp_ps(p, thr, _CMP_GE_OQ), _mm256_cmp_ps(v, thr, _CMP_LT_OQ));
+        crossings = _mm256_sub_epi32(crossings, _mm256_castps_si256(crossed));
+    }
+
+    if (i > 1)
+    {
+        stats.minimum = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1)));
+        stats.maximum = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1)));
+        stats.sum += horizontalSum(_mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+        stats.sumOfSquares += horizontalSum(_mm_add_ps(_mm256_castps256_ps128(sumSq), _mm256_extractf128_ps(sumSq, 1)));
+        stats.lineLength += horizontalSum(_mm_add_ps(_mm256_castps256_ps128(length), _mm256_extractf128_ps(length, 1)));
+        stats.crossings += horizontalSum(_mm_add_epi32(_mm256_castsi256_si128(crossings), _mm256_extracti128_si256(crossings, 1)));
+    }
+
+    accumulateStatistics(x, i, n, x[i - 1], threshold, stats);
+}
+
+#endif
+
+StatisticsFunction selectStatistics(SimdLevel level)
+{
+#if GRIDVIEWER_X86
+    switch (level)
+    {
+        // six accumulators already saturate the AVX2 ports; AVX-512 would only
+        // halve the loop count on blocks that are a few hundred samples long
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            return statisticsAvx2;
+
+        case SimdLevel::SSE2:
+            return statisticsSse2;
+
+        case SimdLevel::SCALAR:
+            break;
+    }
+#endif
+
+    return statisticsScalar;
+}
+
+MinMaxFunction selectMinMax(SimdLevel level)
+{
+#if GRIDVIEWER_X86
+    switch (level)
+    {
+        case SimdLevel::AVX512:
+            return minMaxAvx512;
+
+        case SimdLevel::AVX2:
+            return minMaxAvx2;
+
+        case SimdLevel::SSE2:
+            return minMaxSse2;
+
+        case SimdLevel::SCALAR:
+            break;
+    }
+#endif
+
+    return minMaxScalar;
+}
+
+struct Dispatch
+{
+    Dispatch() { select(CpuFeatures::getSimdLevel()); }
+
+    void select(SimdLevel requested)
+    {
+        const SimdLevel supported = CpuFeatures::getSimdLevel();
+
+        level = (int) requested < (int) supported ? requested : supported;
+        minMax = selectMinMax(level);
+        statistics = selectStatistics(level);
+    }
+
+    SimdLevel level;
+    MinMaxFunction minMax;
+    StatisticsFunction statistics;
+};
+
+Dispatch& getDispatch()
+{
+    static Dispatch dispatch;
+
+    return dispatch;
+}
+
+}
+
+void ReductionKernels::minMax(const float* samples, int numSamples, float& minValue, float& maxValue)
+{
+    getDispatch().minMax(samples, numSamples, minValue, maxValue);
+}
+
+void ReductionKernels::statistics(const float* samples, int numSamples, float threshold, ChannelStatistics& stats)
+{
+    getDispatch().statistics(samples, numSamples, threshold, stats);
+}
+
+SimdLevel ReductionKernels::getActiveSimdLevel()
+{
+    return getDispatch().level;
+}
+
+void ReductionKernels::setSimdLevel(SimdLevel level)
+{
+    getDispatch().select(level);
+}
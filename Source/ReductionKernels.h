@@ -0,0 +1,86 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __REDUCTIONKERNELS_H__
+#define __REDUCTIONKERNELS_H__
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+
+namespace GridViewer {
+
+/**
+    Running per-channel statistics gathered by ReductionKernels::statistics().
+
+    The previous sample is carried along so that line length and threshold
+    crossings are continuous across block boundaries. Exactly 32 bytes, so
+    two channels share a cache line and never straddle one.
+ */
+struct ChannelStatistics
+{
+    float minimum;
+    float maximum;
+    float sum;
+    float sumOfSquares;
+    float lineLength;           // sum of |x[i] - x[i-1]|
+    int32_t crossings;          // samples where the signal fell below the threshold
+    float lastSample;
+    int32_t hasLastSample;
+};
+
+/**
+    Per-channel block reductions used by the accumulators.
+
+    minMax exists in scalar, SSE2, AVX2 and AVX-512 versions, statistics in
+    scalar, SSE2 and AVX2 versions (it keeps AVX2 on AVX-512 CPUs). The widest
+    one the CPU supports is chosen the first time the kernels are used.
+ */
+namespace ReductionKernels
+{
+    /**
+     *  Folds every sample of a block into a running minimum and maximum.
+     *  The current values of minValue and maxValue are part of the reduction.
+     */
+    void minMax(const float* samples, int numSamples, float& minValue, float& maxValue);
+
+    /**
+     *  Folds every sample of a block into a channel's running statistics in a
+     *  single pass: min, max, sum, sum of squares, line length and the number
+     *  of downward crossings of a (usually negative) threshold.
+     */
+    void statistics(const float* samples, int numSamples, float threshold, ChannelStatistics& stats);
+
+    /** Returns the instruction set the dispatched kernels use */
+    SimdLevel getActiveSimdLevel();
+
+    /**
+     *  Forces the kernels to a particular instruction set, clamped to what the CPU
+     *  supports. Intended for benchmarks and comparisons; not thread-safe.
+     */
+    void setSimdLevel(SimdLevel level);
+}
+
+}
+
+#endif /* __REDUCTIONKERNELS_H__ */
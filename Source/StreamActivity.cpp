@@ -0,0 +1,214 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "StreamActivity.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+using namespace GridViewer;
+
+namespace {
+    // channels per chunk claimed by a pool participant; large enough to amortise the atomic claim
+    const int CHANNELS_PER_CHUNK = 32;
+
+    // frames per second kept in the history
+    const float HISTORY_RATE = 25.0f;
+
+    static_assert(CHANNELS_PER_CHUNK % FilterBank::channelsPerGroup == 0,
+                  "chunks must not split a filter group between threads");
+}
+
+StreamActivity::StreamActivity(uint32_t streamId_,
+                               int numChannels_,
+                               float sampleRate_,
+                               float snapshotRate_,
+                               const std::vector<ChannelSpan>& channelSpans_)
+    : streamId(streamId_),
+      numChannels(numChannels_),
+      sampleRate(sampleRate_),
+      snapshotRate(snapshotRate_),
+      channelSpans(channelSpans_),
+      filters(numChannels_, sampleRate_),
+      accumulator(numChannels_, sampleRate_, (int) (sampleRate_ / snapshotRate)),
+      requestedMultiplier(0.0f),
+      currentBuffer(nullptr),
+      currentNumSamples(0)
+{
+    snapshots.prepare(numChannels);
+
+    bufferChannelIndices.resize((size_t) numChannels);
+
+    for (const ChannelSpan& span : channelSpans)
+        for (int i = 0; i < span.numChannels; i++)
+            bufferChannelIndices[(size_t) (span.firstLocalChannel + i)] = span.firstBufferChannel + i;
+}
+
+void StreamActivity::processBlock(const float* const* bufferChannels,
+                                  int numSamples,
+                                  int64_t blockTimestamp,
+                                  WorkerPool* pool)
+{
+    GRIDVIEWER_TRACE_SCOPE("StreamActivity::processBlock");
+
+    const bool filtering = filters.beginBlock();
+
+    const float multiplier = requestedMultiplier.load(std::memory_order_relaxed);
+
+    if (multiplier != accumulator.getThresholdMultiplier())
+        accumulator.setThresholdMultiplier(multiplier);
+
+    currentBuffer = bufferChannels;
+    currentNumSamples = numSamples;
+
+    if (pool != nullptr)
+    {
+        pool->run(filtering ? filterChannels : reduceChannels, this, numChannels, CHANNELS_PER_CHUNK);
+    }
+    else if (filtering)
+    {
+        filterChannels(this, 0, numChannels);
+    }
+    else
+    {
+        for (const ChannelSpan& span : channelSpans)
+        {
+            accumulator.addBlocks(span.firstLocalChannel,
+                                  bufferChannels + span.firstBufferChannel,
+                                  span.numChannels,
+                                  numSamples);
+        }
+    }
+
+    if (accumulator.endBlock(numSamples))
+    {
+        ActivitySnapshot& frame = snapshots.getWriteFrame();
+        accumulator.writeSnapshot(frame);
+
+        if (history != nullptr)
+            history->write(frame, snapshots.getNextFrameCounter(), blockTimestamp + numSamples);
+
+        snapshots.publish(blockTimestamp + numSamples);
+
+        GRIDVIEWER_TRACE_INSTANT("Publish frame");
+    }
+}
+
+void StreamActivity::reduceChannels(void* context, int begin, int end)
+{
+    StreamActivity& stream = *static_cast<StreamActivity*>(context);
+
+    // each channel has its own statistics slot, so ranges never share state
+    for (int channel = begin; channel < end; channel++)
+    {
+        stream.accumulator.addBlock(channel,
+                                    stream.currentBuffer[stream.bufferChannelIndices[(size_t) channel]],
+                                    stream.currentNumSamples);
+    }
+}
+
+void StreamActivity::filterChannels(void* context, int begin, int end)
+{
+    StreamActivity& stream = *static_cast<StreamActivity*>(context);
+
+    const int groupSize = FilterBank::channelsPerGroup;
+    const int blockSize = FilterBank::maxBlockSize;
+
+    // a group's filtered samples stay in L1 between the filter and the reduction
+    alignas(64) float filtered[groupSize * blockSize];
+
+    const float* inputs[groupSize];
+    float* outputs[groupSize];
+
+    for (int group = begin; group < end; group += groupSize)
+    {
+        const int count = std::min(groupSize, end - group);
+
+        for (int offset = 0; offset < stream.currentNumSamples; offset += blockSize)
+        {
+            const int length = std::min(blockSize, stream.currentNumSamples - offset);
+
+            for (int i = 0; i < count; i++)
+            {
+                inputs[i] = stream.currentBuffer[stream.bufferChannelIndices[(size_t) (group + i)]] + offset;
+                outputs[i] = filtered + i * blockSize;
+            }
+
+            stream.filters.process(group, inputs, outputs, count, length);
+            stream.accumulator.addBlocks(group, outputs, count, length);
+        }
+    }
+}
+
+void StreamActivity::primeFilters(const float* const* bufferChannels, int numSamples)
+{
+    if (! filters.beginBlock() || numSamples <= 0)
+        return;
+
+    float values[FilterBank::channelsPerGroup];
+
+    for (int group = 0; group < numChannels; group += FilterBank::channelsPerGroup)
+    {
+        const int count = std::min(FilterBank::channelsPerGroup, numChannels - group);
+
+        // the mean rather than the first sample, which is off the offset by a sample of noise
+        for (int i = 0; i < count; i++)
+        {
+            const float* x = bufferChannels[bufferChannelIndices[(size_t) (group + i)]];
+            double sum = 0.0;
+
+            for (int t = 0; t < numSamples; t++)
+                sum += x[t];
+
+            values[i] = (float) (sum / numSamples);
+        }
+
+        filters.prime(group, values, count);
+    }
+}
+
+void StreamActivity::setThreshold(float threshold)
+{
+    accumulator.setThreshold(threshold);
+}
+
+void StreamActivity::prepareHistory(size_t budgetBytes)
+{
+    history.reset();
+
+    const int capacity = FrameHistory::getCapacityForBudget(numChannels, budgetBytes);
+
+    if (capacity < 2)
+        return;
+
+    const int decimation = snapshotRate > HISTORY_RATE ? (int) (snapshotRate / HISTORY_RATE + 0.5f) : 1;
+
+    history = std::make_unique<FrameHistory>(numChannels, capacity, decimation, snapshotRate / (float) decimation);
+}
+
+void StreamActivity::reset()
+{
+    filters.reset();
+    accumulator.reset();
+}
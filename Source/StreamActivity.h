@@ -0,0 +1,140 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __STREAMACTIVITY_H__
+#define __STREAMACTIVITY_H__
+
+#include "ActivityAccumulator.h"
+#include "ChannelSpan.h"
+#include "FilterBank.h"
+#include "FrameHistory.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    Everything the node keeps for one input stream: where its channels sit in
+    the buffer, the filters and accumulator reducing them, and the snapshots
+    and history of frames published from it.
+
+    Created for every stream when the settings change, so all streams are
+    reduced in each block and the view can switch between them at any time.
+ */
+class StreamActivity
+{
+public:
+    /** snapshotRate is the number of frames published per second */
+    StreamActivity(uint32_t streamId,
+                   int numChannels,
+                   float sampleRate,
+                   float snapshotRate,
+                   const std::vector<ChannelSpan>& channelSpans);
+
+    uint32_t getStreamId() const { return streamId; }
+    int getNumChannels() const { return numChannels; }
+    float getSampleRate() const { return sampleRate; }
+
+    /** Returns the buffer index of the stream's first channel */
+    int getFirstBufferChannel() const { return channelSpans.front().firstBufferChannel; }
+
+    /** Returns the buffer index of each of the stream's channels, in stream order */
+    const int* getBufferChannelIndices() const { return bufferChannelIndices.data(); }
+
+    /**
+     *  Reduces one block of the stream's channels, publishing a frame whenever
+     *  an interval completes (audio thread). With a pool, channel ranges are
+     *  reduced in parallel; the call still returns only when all are done.
+     */
+    void processBlock(const float* const* bufferChannels,
+                      int numSamples,
+                      int64_t blockTimestamp,
+                      WorkerPool* pool = nullptr);
+
+    /** Selects the band the metrics are computed on; takes effect at the next block (any thread) */
+    void setFilterBand(FilterBand band) { filters.setBand(band); }
+
+    FilterBand getFilterBand() const { return filters.getBand(); }
+
+    /** Sets the crossing threshold in uV (only while acquisition is stopped) */
+    void setThreshold(float threshold);
+
+    /** Selects adaptive thresholds of multiplier times each channel's noise, or 0 for the fixed one; takes effect at the next block (any thread) */
+    void setThresholdMultiplier(float multiplier) { requestedMultiplier.store(multiplier, std::memory_order_relaxed); }
+
+    /** Discards the interval in progress (audio thread, or while acquisition is stopped) */
+    void reset();
+
+    /** Discards the interval in progress but keeps the filter state, so the next interval starts on settled filters */
+    void discardInterval() { accumulator.clearInterval(); }
+
+    /**
+     *  Settles the filters as if each channel had held its mean over a block
+     *  forever, so processing from that block on does not start with a step
+     *  from rest onto the channel's DC offset (not during processBlock).
+     */
+    void primeFilters(const float* const* bufferChannels, int numSamples);
+
+    /** Returns the newest published frame (message thread only) */
+    const ActivitySnapshot& getLatestFrame() { return snapshots.getLatestFrame(); }
+
+    /** Replaces the frame history with one that fits a memory budget, or removes it for 0 (only while acquisition is stopped) */
+    void prepareHistory(size_t budgetBytes);
+
+    /** Returns the frame history, or nullptr if there is none (message thread only) */
+    const FrameHistory* getHistory() const { return history.get(); }
+
+private:
+    const uint32_t streamId;
+    const int numChannels;
+    const float sampleRate;
+    const float snapshotRate;
+
+    const std::vector<ChannelSpan> channelSpans;
+    std::vector<int> bufferChannelIndices; // buffer index of each channel, for splitting into ranges
+
+    FilterBank filters;
+    ActivityAccumulator accumulator;
+    SnapshotBuffer snapshots;
+    std::unique_ptr<FrameHistory> history;
+
+    std::atomic<float> requestedMultiplier;
+
+    /** WorkerPool task reducing a range of the stream's channels */
+    static void reduceChannels(void* context, int begin, int end);
+
+    /** WorkerPool task filtering and reducing a range of whole filter groups */
+    static void filterChannels(void* context, int begin, int end);
+
+    // valid during a processBlock call, for the reduction tasks
+    const float* const* currentBuffer;
+    int currentNumSamples;
+};
+
+}
+
+#endif /* __STREAMACTIVITY_H__ */
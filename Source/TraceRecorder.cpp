@@ -0,0 +1,320 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TraceRecorder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace GridViewer {
+
+/** The calling thread's buffer, handed back when the thread exits */
+struct ThreadHandle
+{
+    TraceRecorder::ThreadBuffer* buffer = nullptr;
+    const char* name = nullptr;
+
+    ~ThreadHandle()
+    {
+        if (buffer != nullptr)
+            TraceRecorder::getInstance().releaseBuffer(buffer);
+    }
+};
+
+}
+
+using namespace GridViewer;
+
+namespace {
+    thread_local ThreadHandle threadHandle;
+
+    void writeEscaped(std::ostream& out, const char* text)
+    {
+        for (const char* c = text; *c != 0; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                out << '\\' << *c;
+            else if ((unsigned char) *c >= 0x20)
+                out << *c;
+        }
+    }
+}
+
+TraceRecorder& TraceRecorder::getInstance()
+{
+    static TraceRecorder instance;
+    return instance;
+}
+
+TraceRecorder::TraceRecorder()
+    : recording(false),
+      startTime(0),
+      nextThreadId(1)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    for (auto& buffer : buffers)
+        delete[] buffer.events.load();
+}
+
+uint64_t TraceRecorder::now()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceRecorder::start()
+{
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+
+        // every thread named so far gets its ring now, so none allocates while recording
+        int numSpare = 0;
+
+        for (auto& buffer : buffers)
+        {
+            const bool hasEvents = buffer.events.load(std::memory_order_relaxed) != nullptr;
+
+            if (buffer.claimed.load(std::memory_order_acquire) && ! hasEvents)
+                buffer.events.store(new Event[eventsPerThread], std::memory_order_release);
+            else if (! buffer.claimed.load(std::memory_order_relaxed) && hasEvents)
+                numSpare++;
+        }
+
+        for (auto& buffer : buffers)
+        {
+            if (numSpare >= spareRings)
+                break;
+
+            if (! buffer.claimed.load(std::memory_order_relaxed) && buffer.events.load(std::memory_order_relaxed) == nullptr)
+            {
+                buffer.events.store(new Event[eventsPerThread], std::memory_order_release);
+                numSpare++;
+            }
+        }
+    }
+
+    startTime.store(now(), std::memory_order_relaxed);
+    recording.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::stop()
+{
+    recording.store(false, std::memory_order_release);
+}
+
+void TraceRecorder::setThreadName(const char* name)
+{
+    threadHandle.name = name;
+
+    if (threadHandle.buffer == nullptr)
+        threadHandle.buffer = getInstance().claimBuffer(name, false);
+
+    if (threadHandle.buffer != nullptr)
+        threadHandle.buffer->threadName.store(name, std::memory_order_relaxed);
+}
+
+void TraceRecorder::record(const char* name, Phase phase)
+{
+    ThreadBuffer* buffer = threadHandle.buffer;
+    Event* events = buffer != nullptr ? buffer->events.load(std::memory_order_acquire) : nullptr;
+
+    // a thread that was never named, or named after start(), moves to a spare ring
+    if (events == nullptr)
+    {
+        ThreadBuffer* spare = claimBuffer(threadHandle.name, true);
+
+        if (spare == nullptr)
+            return;
+
+        if (buffer != nullptr)
+            releaseBuffer(buffer);
+
+        threadHandle.buffer = buffer = spare;
+        events = buffer->events.load(std::memory_order_acquire);
+    }
+
+    const uint64_t index = buffer->numWritten.load(std::memory_order_relaxed);
+    Event& event = events[index % eventsPerThread];
+
+    event.name.store(name, std::memory_order_relaxed);
+    event.timeAndPhase.store(now() << 2 | phase, std::memory_order_relaxed);
+
+    buffer->numWritten.store(index + 1, std::memory_order_release);
+}
+
+TraceRecorder::ThreadBuffer* TraceRecorder::claimBuffer(const char* threadName, bool needsEvents)
+{
+    // rings with events first, so a named thread does not leave an allocated one idle
+    for (int pass = 0; pass < (needsEvents ? 1 : 2); pass++)
+    {
+        for (auto& buffer : buffers)
+        {
+            if (pass == 0 && buffer.events.load(std::memory_order_acquire) == nullptr)
+                continue;
+
+            if (buffer.claimed.load(std::memory_order_relaxed) || buffer.claimed.exchange(true, std::memory_order_acquire))
+                continue;
+
+            // a new ID, so the trace does not join the previous thread's events to this one's
+            buffer.numWritten.store(0, std::memory_order_relaxed);
+            buffer.threadName.store(threadName, std::memory_order_relaxed);
+            buffer.threadId.store(nextThreadId.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+
+            return &buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+void TraceRecorder::releaseBuffer(ThreadBuffer* buffer)
+{
+    buffer->claimed.store(false, std::memory_order_release);
+}
+
+bool TraceRecorder::writeJson(const std::string& path, std::string& error) const
+{
+    struct ThreadEvents
+    {
+        int threadId;
+        const char* threadName;
+        std::vector<const char*> names;
+        std::vector<uint64_t> times;
+    };
+
+    std::vector<ThreadEvents> threads;
+    const uint64_t origin = startTime.load(std::memory_order_relaxed);
+
+    {
+        // only the copy holds the lock; the file is written after it
+        std::lock_guard<std::mutex> guard(registryLock);
+
+        for (auto& buffer : buffers)
+        {
+            const Event* events = buffer.events.load(std::memory_order_acquire);
+            const int threadId = buffer.threadId.load(std::memory_order_acquire);
+
+            if (events == nullptr || threadId == 0)
+                continue;
+
+            const uint64_t numWritten = buffer.numWritten.load(std::memory_order_acquire);
+            const uint64_t oldest = numWritten > (uint64_t) eventsPerThread ? numWritten - eventsPerThread : 0;
+
+            ThreadEvents thread { threadId, buffer.threadName.load(std::memory_order_relaxed), {}, {} };
+
+            for (uint64_t i = oldest; i < numWritten; i++)
+            {
+                const Event& event = events[i % eventsPerThread];
+
+                thread.names.push_back(event.name.load(std::memory_order_relaxed));
+                thread.times.push_back(event.timeAndPhase.load(std::memory_order_relaxed));
+            }
+
+            // a ring handed to a new thread mid-copy holds a mix of both
+            if (buffer.threadId.load(std::memory_order_acquire) != threadId)
+                continue;
+
+            // events the thread overwrote while they were being copied are dropped
+            const uint64_t numWrittenAfter = buffer.numWritten.load(std::memory_order_acquire);
+            const uint64_t firstIntact = numWrittenAfter > (uint64_t) eventsPerThread ? numWrittenAfter - eventsPerThread : 0;
+
+            for (uint64_t i = oldest; i < firstIntact && i < numWritten; i++)
+                thread.names[(size_t) (i - oldest)] = nullptr;
+
+            threads.push_back(std::move(thread));
+        }
+    }
+
+    std::ofstream file(path);
+
+    if (! file)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+
+    auto separator = [&]()
+    {
+        file << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const ThreadEvents& thread : threads)
+    {
+        separator();
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadId << ",\"args\":{\"name\":\"";
+        writeEscaped(file, thread.threadName != nullptr ? thread.threadName : "Thread");
+        file << "\"}}";
+
+        // an end whose begin was overwritten or came before start() would close nothing
+        int depth = 0;
+
+        for (size_t i = 0; i < thread.names.size(); i++)
+        {
+            const uint64_t time = thread.times[i] >> 2;
+            const Phase phase = (Phase) (thread.times[i] & 3);
+
+            if (time < origin || thread.names[i] == nullptr)
+                continue;
+
+            if (phase == END && depth == 0)
+                continue;
+
+            depth += phase == BEGIN ? 1 : (phase == END ? -1 : 0);
+
+            char timestamp[32];
+            std::snprintf(timestamp, sizeof(timestamp), "%.3f", (double) (time - origin) / 1000.0);
+
+            separator();
+            file << "{\"name\":\"";
+            writeEscaped(file, thread.names[i]);
+            file << "\",\"ph\":\"" << (phase == BEGIN ? "B" : (phase == END ? "E" : "i"))
+                 << "\",\"ts\":" << timestamp << ",\"pid\":1,\"tid\":" << thread.threadId;
+
+            if (phase == INSTANT)
+                file << ",\"s\":\"t\"";
+
+            file << "}";
+        }
+    }
+
+    file << "\n]}\n";
+
+    if (! file)
+    {
+        error = "could not write " + path;
+        return false;
+    }
+
+    return true;
+}
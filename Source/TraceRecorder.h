@@ -0,0 +1,169 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __TRACERECORDER_H__
+#define __TRACERECORDER_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// set to 0 to compile every trace point out
+#ifndef GRIDVIEWER_TRACING
+ #define GRIDVIEWER_TRACING 1
+#endif
+
+namespace GridViewer {
+
+/**
+    Records begin, end and instant events from any thread, for viewing as a
+    Chrome trace (chrome://tracing or Perfetto).
+
+    Each thread writes to its own ring of events, from a fixed table of
+    rings. A thread claims its ring with an atomic exchange when it is named
+    or first records, and hands it on to a later thread once it exits. The
+    events themselves are allocated by start(), for every claimed ring plus
+    a few spares, so recording never locks or allocates: writing is a few
+    relaxed stores and one release store, and while not recording a trace
+    point costs one atomic load. A thread that finds no ring drops its
+    events. The rings keep the most recent events of each thread, so a long
+    recording keeps its end.
+
+    Event names must be string literals, as only the pointer is stored.
+ */
+class TraceRecorder
+{
+public:
+    /** Events kept per thread */
+    static constexpr int eventsPerThread = 1 << 16;
+
+    /** Threads that can hold a ring at once */
+    static constexpr int maxThreads = 128;
+
+    /** Rings start() allocates beyond the claimed ones, for threads that record without being named */
+    static constexpr int spareRings = 4;
+
+    static TraceRecorder& getInstance();
+
+    /** Starts recording; events from before this are left out of the next write */
+    void start();
+
+    /** Stops recording; what was recorded can still be written */
+    void stop();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    void begin(const char* name) { if (isRecording()) record(name, BEGIN); }
+    void end(const char* name) { record(name, END); }
+    void instant(const char* name) { if (isRecording()) record(name, INSTANT); }
+
+    /** Names the calling thread in the trace and claims its ring (never locks or allocates) */
+    static void setThreadName(const char* name);
+
+    /** Writes the events since the last start() as Chrome trace_event JSON; the file is written after copying the events */
+    bool writeJson(const std::string& path, std::string& error) const;
+
+    /** Records a begin event now and the matching end event when it goes out of scope */
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name_)
+            : name(getInstance().isRecording() ? name_ : nullptr)
+        {
+            if (name != nullptr)
+                getInstance().begin(name);
+        }
+
+        ~Scope()
+        {
+            // ends what it began even if recording has stopped since
+            if (name != nullptr)
+                getInstance().end(name);
+        }
+
+    private:
+        const char* const name;
+    };
+
+private:
+    enum Phase : uint64_t
+    {
+        BEGIN = 0,
+        END = 1,
+        INSTANT = 2
+    };
+
+    struct Event
+    {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<uint64_t> timeAndPhase { 0 }; // nanoseconds << 2 | phase
+    };
+
+    struct ThreadBuffer
+    {
+        std::atomic<bool> claimed { false };
+        std::atomic<int> threadId { 0 };        // 0 until first claimed
+        std::atomic<const char*> threadName { nullptr };
+        std::atomic<Event*> events { nullptr }; // allocated once by start(), kept for later threads
+        std::atomic<uint64_t> numWritten { 0 };
+    };
+
+    friend struct ThreadHandle;
+
+    TraceRecorder();
+    ~TraceRecorder();
+
+    void record(const char* name, Phase phase);
+
+    /** Claims a free ring, preferring one whose events are allocated; nullptr if none is free (lock-free) */
+    ThreadBuffer* claimBuffer(const char* threadName, bool needsEvents);
+    void releaseBuffer(ThreadBuffer* buffer);
+
+    static uint64_t now();
+
+    std::atomic<bool> recording;
+    std::atomic<uint64_t> startTime;
+    std::atomic<int> nextThreadId;
+
+    ThreadBuffer buffers[maxThreads];
+
+    mutable std::mutex registryLock; // serialises start() and writeJson(); never taken by recording threads
+};
+
+}
+
+#if GRIDVIEWER_TRACING
+ #define GRIDVIEWER_TRACE_JOIN2(a, b) a##b
+ #define GRIDVIEWER_TRACE_JOIN(a, b) GRIDVIEWER_TRACE_JOIN2(a, b)
+ #define GRIDVIEWER_TRACE_SCOPE(name) GridViewer::TraceRecorder::Scope GRIDVIEWER_TRACE_JOIN(traceScope, __LINE__)(name)
+ #define GRIDVIEWER_TRACE_INSTANT(name) GridViewer::TraceRecorder::getInstance().instant(name)
+ #define GRIDVIEWER_TRACE_THREAD(name) GridViewer::TraceRecorder::setThreadName(name)
+#else
+ #define GRIDVIEWER_TRACE_SCOPE(name) ((void) 0)
+ #define GRIDVIEWER_TRACE_INSTANT(name) ((void) 0)
+ #define GRIDVIEWER_TRACE_THREAD(name) ((void) 0)
+#endif
+
+#endif /* __TRACERECORDER_H__ */
@@ -0,0 +1,207 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "WorkerPool.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+ #include <immintrin.h>
+ #define GRIDVIEWER_PAUSE() _mm_pause()
+#else
+ #define GRIDVIEWER_PAUSE() std::this_thread::yield()
+#endif
+
+using namespace GridViewer;
+
+namespace {
+    // spins before a worker goes back to sleep, so back-to-back blocks find it awake
+    const int SPIN_ITERATIONS = 20000;
+}
+
+WorkerPool::WorkerPool(int numThreads)
+    : numSegments(std::max(numThreads, 0) + 1),
+      task(nullptr),
+      context(nullptr),
+      chunkSize(1),
+      busy(false),
+      jobOpen(false),
+      generation(0),
+      itemsRemaining(0),
+      activeWorkers(0),
+      numSleeping(0),
+      stopping(false),
+      numInlineRuns(0)
+{
+    segments.reset(new Segment[(size_t) numSegments]);
+
+    for (int i = 0; i < numSegments; i++)
+    {
+        segments[(size_t) i].next.store(0);
+        segments[(size_t) i].end = 0;
+    }
+
+    for (int i = 0; i < numThreads; i++)
+        threads.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        stopping = true;
+    }
+
+    wakeCondition.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void WorkerPool::run(TaskFunction newTask, void* newContext, int numItems, int newChunkSize)
+{
+    if (numItems <= 0)
+        return;
+
+    if (threads.empty() || busy.exchange(true, std::memory_order_acquire))
+    {
+        numInlineRuns.fetch_add(1, std::memory_order_relaxed);
+        newTask(newContext, 0, numItems);
+        return;
+    }
+
+    task = newTask;
+    context = newContext;
+    chunkSize = std::max(newChunkSize, 1);
+
+    // contiguous segments keep each participant on neighbouring items; starting
+    // segments on chunk boundaries keeps every chunk the same as in a serial sweep
+    const int numChunks = (numItems + chunkSize - 1) / chunkSize;
+
+    for (int i = 0; i < numSegments; i++)
+    {
+        const int firstChunk = (int) ((int64_t) numChunks * i / numSegments);
+        const int endChunk = (int) ((int64_t) numChunks * (i + 1) / numSegments);
+
+        segments[(size_t) i].next.store(firstChunk * chunkSize, std::memory_order_relaxed);
+        segments[(size_t) i].end = std::min(endChunk * chunkSize, numItems);
+    }
+
+    itemsRemaining.store(numItems);
+    generation.fetch_add(1);
+    jobOpen.store(true);
+
+    // a worker counts itself as sleeping before it checks the generation under
+    // the lock, so either it sees the new job or this sees it sleeping; taking
+    // the lock then means it is waiting before it is notified. Spinning workers
+    // need neither, so the audio thread only locks when one has gone to sleep
+    if (numSleeping.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+        }
+
+        wakeCondition.notify_all();
+    }
+
+    participate(numSegments - 1);
+
+    // only chunks that workers have already claimed can still be running
+    while (itemsRemaining.load(std::memory_order_acquire) > 0)
+        GRIDVIEWER_PAUSE();
+
+    // late workers must leave before the next job rewrites the segments
+    jobOpen.store(false);
+
+    while (activeWorkers.load() > 0)
+        GRIDVIEWER_PAUSE();
+
+    busy.store(false, std::memory_order_release);
+}
+
+void WorkerPool::participate(int index)
+{
+    GRIDVIEWER_TRACE_SCOPE("WorkerPool::participate");
+
+    for (int offset = 0; offset < numSegments; offset++)
+    {
+        Segment& segment = segments[(size_t) ((index + offset) % numSegments)];
+
+        for (;;)
+        {
+            const int begin = segment.next.fetch_add(chunkSize, std::memory_order_relaxed);
+
+            if (begin >= segment.end)
+                break;
+
+            const int end = std::min(begin + chunkSize, segment.end);
+
+            task(context, begin, end);
+
+            itemsRemaining.fetch_sub(end - begin, std::memory_order_release);
+        }
+    }
+}
+
+void WorkerPool::workerLoop(int index)
+{
+    GRIDVIEWER_TRACE_THREAD("Grid Viewer worker");
+
+    uint64_t lastGeneration = 0;
+
+    for (;;)
+    {
+        int spins = 0;
+
+        while (generation.load() == lastGeneration && ! stopping.load())
+        {
+            if (spins < SPIN_ITERATIONS)
+            {
+                spins++;
+                GRIDVIEWER_PAUSE();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(wakeLock);
+
+            numSleeping.fetch_add(1);
+            wakeCondition.wait(lock, [&] { return generation.load() != lastGeneration || stopping.load(); });
+            numSleeping.fetch_sub(1);
+        }
+
+        if (stopping.load())
+            return;
+
+        lastGeneration = generation.load();
+
+        // register before checking the job, so run() cannot rewrite it underneath us
+        activeWorkers.fetch_add(1);
+
+        if (jobOpen.load() && generation.load() == lastGeneration)
+            participate(index);
+
+        activeWorkers.fetch_sub(1);
+    }
+}
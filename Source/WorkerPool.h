@@ -0,0 +1,104 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    Persistent threads that share the per-channel reduction with the audio
+    thread.
+
+    run() splits a range of items into one segment per participant (the
+    workers plus the calling thread). Each participant claims chunks from its
+    own segment with an atomic increment and steals from the other segments
+    once its own is empty. The calling thread always takes part, so a job
+    completes even if no worker wakes up in time: the caller only ever waits
+    for chunks a worker has already started. If the pool is already running
+    a job, run() executes everything on the calling thread instead.
+ */
+class WorkerPool
+{
+public:
+    /** Processes items [begin, end) */
+    typedef void (*TaskFunction)(void* context, int begin, int end);
+
+    /** Starts numThreads workers */
+    explicit WorkerPool(int numThreads);
+
+    /** Stops and joins the workers */
+    ~WorkerPool();
+
+    int getNumThreads() const { return (int) threads.size(); }
+
+    /** Runs task over items [0, numItems) in chunks of chunkSize and returns once all are done */
+    void run(TaskFunction task, void* context, int numItems, int chunkSize);
+
+    /** Returns the number of run() calls that fell back to the calling thread */
+    uint64_t getNumInlineRuns() const { return numInlineRuns.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Segment
+    {
+        std::atomic<int> next;
+        int end;
+    };
+
+    void workerLoop(int index);
+
+    /** Claims and processes chunks, starting with the participant's own segment */
+    void participate(int index);
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Segment[]> segments; // one per worker, plus one for the calling thread
+    int numSegments;
+
+    // the job; written only while no participant is active
+    TaskFunction task;
+    void* context;
+    int chunkSize;
+
+    std::atomic<bool> busy;
+    std::atomic<bool> jobOpen;
+    std::atomic<uint64_t> generation;
+    std::atomic<int> itemsRemaining;
+    std::atomic<int> activeWorkers;
+    std::atomic<int> numSleeping;   // workers waiting on wakeCondition
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> numInlineRuns;
+
+    std::mutex wakeLock;
+    std::condition_variable wakeCondition;
+};
+
+}
+
+#endif /* __WORKERPOOL_H__ */
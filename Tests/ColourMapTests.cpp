@@ -0,0 +1,184 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "BaselineColourSchemes.h"
+#include "ColourMaps.h"
+#include "ColourScaler.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    The lookup tables against the colours the original ColourScheme returned,
+    and the colour scale's smoothing.
+ */
+
+namespace {
+
+struct Scheme
+{
+    ColourSchemeId id;
+    const BaselineColourSchemes::Entry* baseline;
+};
+
+const Scheme SCHEMES[] =
+{
+    { ColourSchemeId::INFERNO, BaselineColourSchemes::inferno },
+    { ColourSchemeId::VIRIDIS, BaselineColourSchemes::viridis },
+    { ColourSchemeId::PLASMA, BaselineColourSchemes::plasma },
+    { ColourSchemeId::MAGMA, BaselineColourSchemes::magma },
+    { ColourSchemeId::JET, BaselineColourSchemes::jet }
+};
+
+/** The entry the original if-chain returned for a value */
+const BaselineColourSchemes::Entry& lookUpBaseline(const BaselineColourSchemes::Entry* baseline, float val)
+{
+    int k = 0;
+
+    while (k < ColourMaps::tableSize - 1 && ! (val <= baseline[k].upperBound))
+        k++;
+
+    return baseline[k];
+}
+
+/** True if a packed colour is opaque and each component is within one code of the float colour */
+bool matches(uint32_t colour, const BaselineColourSchemes::Entry& entry)
+{
+    // JUCE versions differ in whether fromFloatRGBA rounds or truncates
+    auto close = [] (uint32_t code, double component)
+    {
+        return std::abs((double) code - component * 255.0) <= 1.0;
+    };
+
+    return (colour >> 24) == 0xff
+        && close((colour >> 16) & 0xff, entry.r)
+        && close((colour >> 8) & 0xff, entry.g)
+        && close(colour & 0xff, entry.b);
+}
+
+}
+
+GRIDVIEWER_TEST(colours, TablesMatchBaselineAtEveryEntry)
+{
+    for (const Scheme& scheme : SCHEMES)
+    {
+        const uint32_t* table = ColourMaps::getTable(scheme.id);
+
+        for (int k = 0; k < ColourMaps::tableSize; k++)
+            EXPECT(matches(table[k], scheme.baseline[k]));
+    }
+}
+
+GRIDVIEWER_TEST(colours, LookupMatchesBaselineAcrossTheRange)
+{
+    // the if-chain bounds are k/256 rounded to six digits, so values right at a
+    // bound may pick the neighbouring entry; sample away from the bounds
+    for (const Scheme& scheme : SCHEMES)
+    {
+        const uint32_t* table = ColourMaps::getTable(scheme.id);
+
+        for (int i = 0; i < 4096; i++)
+        {
+            const float val = ((float) i + 0.5f) / 4096.0f;
+
+            if (std::abs(val * 256.0f - (float) (int) (val * 256.0f + 0.5f)) < 0.01f)
+                continue;
+
+            const uint32_t colour = table[ColourMaps::getIndexForNormalizedValue(val)];
+            EXPECT(matches(colour, lookUpBaseline(scheme.baseline, val)));
+        }
+
+        // out of range values clip to the end entries, as the if-chain did
+        const float outside[] = { -1.0f, -1.0e-6f, 0.0f, 1.0f, 1.5f, 1.0e9f };
+
+        for (float val : outside)
+            EXPECT(matches(table[ColourMaps::getIndexForNormalizedValue(val)], lookUpBaseline(scheme.baseline, val)));
+    }
+}
+
+namespace {
+
+/** The top of the PERCENTILE scale after a frame of 1s followed by a second of frames of 2s */
+float getMaximumAfterOneSecond(float framesPerSecond)
+{
+    ColourScaler scaler;
+    scaler.setMode(ColourScaling::PERCENTILE);
+    scaler.setUpdateRate(framesPerSecond);
+
+    std::vector<float> values(64, 1.0f);
+    uint64_t frameCounter = 1;
+
+    scaler.process(values.data(), (int) values.size(), 0.0f, 1.0f, frameCounter++);
+
+    values.assign(values.size(), 2.0f);
+
+    for (int i = 0; i < (int) framesPerSecond; i++)
+        scaler.process(values.data(), (int) values.size(), 0.0f, 1.0f, frameCounter++);
+
+    return scaler.getMaximum();
+}
+
+}
+
+GRIDVIEWER_TEST(colours, ScaleFollowsAChangeAtTheSamePaceAtAnyFrameRate)
+{
+    const float atSnapshotRate = getMaximumAfterOneSecond(50.0f);
+
+    // 1 - e^(-1 / 0.4) of the way from 1 to 2
+    EXPECT_NEAR(atSnapshotRate, 1.918f, 0.001f);
+    EXPECT_NEAR(getMaximumAfterOneSecond(30.0f), atSnapshotRate, 0.001f);
+    EXPECT_NEAR(getMaximumAfterOneSecond(10.0f), atSnapshotRate, 0.001f);
+}
+
+GRIDVIEWER_TEST(colours, HeldBaselinesAreNotUpdated)
+{
+    ColourScaler scaler;
+    scaler.setMode(ColourScaling::BASELINE);
+
+    std::vector<float> values(16, 1.0f);
+    uint64_t frameCounter = 1;
+
+    scaler.process(values.data(), (int) values.size(), 0.0f, 1.0f, frameCounter++);
+
+    // a copy that is held, as the canvas keeps for scrubbing through the history
+    ColourScaler held = scaler;
+    held.setBaselinesHeld(true);
+
+    values.assign(values.size(), 3.0f);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        const float* differences = held.process(values.data(), (int) values.size(), 0.0f, 1.0f, frameCounter++);
+        EXPECT_EQ(differences[0], 2.0f);
+    }
+
+    // the live scaler never saw those frames
+    const float* differences = scaler.process(values.data(), (int) values.size(), 0.0f, 1.0f, frameCounter++);
+    EXPECT_NEAR(differences[0], 2.0f * (1.0f - 1.0f / (20.0f * 50.0f)), 1.0e-4f);
+}
@@ -0,0 +1,223 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "CpuFeatures.h"
+#include "FilterBank.h"
+#include "ReductionKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    FilterBank frequency responses, measured on sines after the filters
+    settle, against the analytic response of the Butterworth sections.
+ */
+
+namespace {
+
+const double SAMPLE_RATE = 30000.0;
+const double PI = 3.141592653589793;
+
+/** Magnitude of a second-order Butterworth section at a frequency */
+double sectionGain(bool highPass, double cutoff, double frequency)
+{
+    const double w0 = 2.0 * PI * cutoff / SAMPLE_RATE;
+    const double alpha = std::sin(w0) / std::sqrt(2.0);
+    const double cosW0 = std::cos(w0);
+
+    const double b1 = highPass ? -(1.0 + cosW0) : 1.0 - cosW0;
+    const double b0 = highPass ? -b1 / 2.0 : b1 / 2.0;
+
+    const std::complex<double> z = std::polar(1.0, -2.0 * PI * frequency / SAMPLE_RATE);
+    const std::complex<double> numerator = b0 + b1 * z + b0 * z * z;
+    const std::complex<double> denominator = (1.0 + alpha) - 2.0 * cosW0 * z + (1.0 - alpha) * z * z;
+
+    return std::abs(numerator / denominator);
+}
+
+double bandGain(FilterBand band, double frequency)
+{
+    if (band == FilterBand::SPIKE)
+        return sectionGain(true, 300.0, frequency) * sectionGain(false, 6000.0, frequency);
+
+    return sectionGain(true, 1.0, frequency) * sectionGain(false, 300.0, frequency);
+}
+
+/**
+    Filters a cosine of the given amplitude (on a DC offset) through eight
+    channels for a few seconds, in blocks, and returns the amplitude of the
+    output over the last half second.
+ */
+double measureAmplitude(FilterBand band, double frequency, double amplitude, double offset)
+{
+    const int numChannels = FilterBank::channelsPerGroup;
+    const int blockSize = FilterBank::maxBlockSize;
+    const int numSamples = (int) (SAMPLE_RATE * 6.0) / blockSize * blockSize;
+    const int measureFrom = numSamples - (int) (SAMPLE_RATE / 2.0);
+
+    FilterBank filters(numChannels, (float) SAMPLE_RATE);
+    filters.setBand(band);
+
+    std::vector<std::vector<float>> in((size_t) numChannels, std::vector<float>((size_t) blockSize));
+    std::vector<std::vector<float>> out((size_t) numChannels, std::vector<float>((size_t) blockSize));
+    std::vector<const float*> inputs;
+    std::vector<float*> outputs;
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        inputs.push_back(in[(size_t) c].data());
+        outputs.push_back(out[(size_t) c].data());
+    }
+
+    double sumOfSquares = 0.0;
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        filters.beginBlock();
+
+        for (int c = 0; c < numChannels; c++)
+            for (int i = 0; i < blockSize; i++)
+                in[(size_t) c][(size_t) i] = (float) (offset + amplitude * std::cos(2.0 * PI * frequency * (start + i) / SAMPLE_RATE));
+
+        filters.process(0, inputs.data(), outputs.data(), numChannels, blockSize);
+
+        for (int i = 0; i < blockSize; i++)
+            if (start + i >= measureFrom)
+                for (int c = 0; c < numChannels; c++)
+                    sumOfSquares += (double) out[(size_t) c][(size_t) i] * out[(size_t) c][(size_t) i];
+    }
+
+    // rms of a sine times root two
+    return std::sqrt(2.0 * sumOfSquares / ((double) (numSamples - measureFrom) * numChannels));
+}
+
+void checkResponse(FilterBand band, double offset)
+{
+    const double frequencies[] = { 10.0, 100.0, 1000.0, 3000.0, 10000.0 };
+    const double amplitude = 100.0;
+
+    for (double frequency : frequencies)
+    {
+        const double expected = amplitude * bandGain(band, frequency);
+        const double measured = measureAmplitude(band, frequency, amplitude, offset);
+
+        // 2% in the pass band; in the stop band, within 1 uV of the expected few tenths
+        EXPECT_NEAR(measured, expected, std::max(0.02 * expected, 1.0));
+
+        if (! (std::abs(measured - expected) <= std::max(0.02 * expected, 1.0)))
+            std::cout << "    at " << frequency << " Hz on " << offset << " uV" << std::endl;
+    }
+}
+
+}
+
+GRIDVIEWER_TEST(filters, SpikeBandResponse)
+{
+    checkResponse(FilterBand::SPIKE, 0.0);
+}
+
+GRIDVIEWER_TEST(filters, LfpBandResponse)
+{
+    checkResponse(FilterBand::LFP, 0.0);
+}
+
+GRIDVIEWER_TEST(filters, SpikeBandResponseOnDcOffset)
+{
+    // electrode offsets of several mV are common and must not leak into the band
+    checkResponse(FilterBand::SPIKE, 5000.0);
+}
+
+GRIDVIEWER_TEST(filters, LfpBandResponseOnDcOffset)
+{
+    // the double precision high-pass has its own kernels, so check every one of them
+    const SimdLevel previous = ReductionKernels::getActiveSimdLevel();
+
+    for (int level = (int) SimdLevel::SCALAR; level <= (int) CpuFeatures::getSimdLevel(); level++)
+    {
+        ReductionKernels::setSimdLevel((SimdLevel) level);
+        checkResponse(FilterBand::LFP, 5000.0);
+    }
+
+    ReductionKernels::setSimdLevel(previous);
+}
+
+GRIDVIEWER_TEST(filters, BroadbandIsUntouched)
+{
+    EXPECT_NEAR(measureAmplitude(FilterBand::BROADBAND, 1000.0, 100.0, 0.0), 100.0, 0.01);
+}
+
+GRIDVIEWER_TEST(filters, PrimedFiltersDoNotRingOnAnOffset)
+{
+    const int numChannels = FilterBank::channelsPerGroup;
+    const int blockSize = FilterBank::maxBlockSize;
+
+    for (FilterBand band : { FilterBand::SPIKE, FilterBand::LFP })
+    {
+        FilterBank filters(numChannels, (float) SAMPLE_RATE);
+        filters.setBand(band);
+        filters.beginBlock();
+
+        // a channel sitting at the int16 rail, and ordinary electrode offsets
+        std::vector<float> offsets((size_t) numChannels);
+
+        for (int c = 0; c < numChannels; c++)
+            offsets[(size_t) c] = c == 0 ? 32767.0f * 0.195f : 5000.0f - 1000.0f * c;
+
+        filters.prime(0, offsets.data(), numChannels);
+
+        std::vector<std::vector<float>> in((size_t) numChannels, std::vector<float>((size_t) blockSize));
+        std::vector<std::vector<float>> out((size_t) numChannels, std::vector<float>((size_t) blockSize));
+        std::vector<const float*> inputs;
+        std::vector<float*> outputs;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            std::fill(in[(size_t) c].begin(), in[(size_t) c].end(), offsets[(size_t) c]);
+            inputs.push_back(in[(size_t) c].data());
+            outputs.push_back(out[(size_t) c].data());
+        }
+
+        float largest = 0.0f;
+
+        for (int block = 0; block < 20; block++)
+        {
+            filters.beginBlock();
+            filters.process(0, inputs.data(), outputs.data(), numChannels, blockSize);
+
+            for (int c = 0; c < numChannels; c++)
+                for (float y : out[(size_t) c])
+                    largest = std::max(largest, std::abs(y));
+        }
+
+        // from rest, the step onto these offsets rings at hundreds of uV
+        EXPECT(largest < 0.1f);
+    }
+}
@@ -0,0 +1,372 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ActivitySnapshot.h"
+#include "FrameHistory.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace GridViewer;
+
+/*
+    The audio-to-message thread handoffs under contention: a writer thread
+    publishing as fast as it can while the test thread reads, checking that
+    every frame read is whole (its values all belong to its frame counter)
+    and that counters never go backwards. Also the audio-to-worker handoff:
+    every item of a pooled job runs exactly once.
+ */
+
+namespace {
+
+const int NUM_CHANNELS = 384;
+const uint64_t NUM_FRAMES = 200000;
+
+/** The value channel i of metric m holds in frame f; two levels, so quantized frames keep it exact-ish */
+float getFrameValue(uint64_t frameCounter, int m, int i)
+{
+    return (float) (frameCounter % 100000) * 8.0f + (float) m + (i % 2 == 0 ? 0.0f : 4.0f);
+}
+
+void fillFrame(ActivitySnapshot& frame, uint64_t frameCounter)
+{
+    for (int m = 0; m < numActivityMetrics; m++)
+    {
+        float* values = frame.getValues((ActivityMetric) m);
+
+        for (int i = 0; i < frame.numChannels; i++)
+            values[i] = getFrameValue(frameCounter, m, i);
+    }
+}
+
+/** Returns true if every value of a frame is the one its counter implies */
+bool isWhole(const ActivitySnapshot& frame, float tolerance)
+{
+    for (int m = 0; m < numActivityMetrics; m++)
+    {
+        const float* values = frame.getValues((ActivityMetric) m);
+
+        for (int i = 0; i < frame.numChannels; i++)
+        {
+            const float expected = getFrameValue(frame.frameCounter, m, i);
+
+            if (! (values[i] >= expected - tolerance && values[i] <= expected + tolerance))
+                return false;
+        }
+    }
+
+    return frame.sampleTimestamp == (int64_t) frame.frameCounter * 100;
+}
+
+/** Counts how often each item of a WorkerPool job was processed */
+struct ItemCounts
+{
+    explicit ItemCounts(int numItems) : counts(new std::atomic<int>[(size_t) numItems]), numItems(numItems) { clear(); }
+
+    void clear()
+    {
+        for (int i = 0; i < numItems; i++)
+            counts[(size_t) i].store(0);
+    }
+
+    /** Returns true if each of the first n items was processed exactly once */
+    bool eachOnce(int n) const
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (counts[(size_t) i].load() != 1)
+                return false;
+        }
+
+        return true;
+    }
+
+    static void count(void* context, int begin, int end)
+    {
+        auto* self = static_cast<ItemCounts*>(context);
+
+        for (int i = begin; i < end; i++)
+            self->counts[(size_t) i].fetch_add(1);
+    }
+
+    std::unique_ptr<std::atomic<int>[]> counts;
+    const int numItems;
+};
+
+}
+
+GRIDVIEWER_TEST(handoff, TripleBufferNeverTearsOrGoesBack)
+{
+    SnapshotBuffer buffer;
+    buffer.prepare(NUM_CHANNELS);
+
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]
+    {
+        for (uint64_t f = 0; f < NUM_FRAMES; f++)
+        {
+            ActivitySnapshot& frame = buffer.getWriteFrame();
+            const uint64_t counter = buffer.getNextFrameCounter();
+
+            fillFrame(frame, counter);
+            buffer.publish((int64_t) counter * 100);
+        }
+
+        done.store(true);
+    });
+
+    uint64_t lastCounter = 0;
+    int numTorn = 0;
+    int numBackwards = 0;
+    int numRead = 0;
+
+    while (! done.load())
+    {
+        const ActivitySnapshot& frame = buffer.getLatestFrame();
+
+        if (frame.frameCounter == 0)
+            continue;
+
+        numTorn += isWhole(frame, 0.0f) ? 0 : 1;
+        numBackwards += frame.frameCounter < lastCounter ? 1 : 0;
+        lastCounter = frame.frameCounter;
+        numRead++;
+    }
+
+    writer.join();
+
+    EXPECT_EQ(numTorn, 0);
+    EXPECT_EQ(numBackwards, 0);
+    EXPECT(numRead > 0);
+
+    // the last frame published is the one the reader ends up with
+    EXPECT_EQ(buffer.getLatestFrame().frameCounter, NUM_FRAMES);
+}
+
+GRIDVIEWER_TEST(handoff, FrameHistoryReadsAreWholeOrRejected)
+{
+    // a small ring, so the writer laps the reader constantly
+    FrameHistory history(NUM_CHANNELS, 16, 1, 50.0f);
+
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]
+    {
+        ActivitySnapshot frame;
+        frame.allocate(NUM_CHANNELS);
+
+        for (uint64_t counter = 1; counter <= NUM_FRAMES; counter++)
+        {
+            fillFrame(frame, counter);
+            history.write(frame, counter, (int64_t) counter * 100);
+        }
+
+        done.store(true);
+    });
+
+    ActivitySnapshot frame;
+    frame.allocate(NUM_CHANNELS);
+
+    int numTorn = 0;
+    int numRead = 0;
+    int numRejected = 0;
+
+    while (! done.load())
+    {
+        const uint64_t newest = history.getNewestRecord();
+
+        if (newest == 0)
+            continue;
+
+        const uint64_t oldest = history.getOldestRecord();
+
+        for (uint64_t record = oldest; record <= newest; record++)
+        {
+            if (! history.read(record, frame))
+            {
+                numRejected++;
+                continue;
+            }
+
+            // decimation is 1, so record r holds frame r
+            numTorn += frame.frameCounter == record && isWhole(frame, 0.5f) ? 0 : 1;
+            numRead++;
+        }
+    }
+
+    writer.join();
+
+    EXPECT_EQ(numTorn, 0);
+    EXPECT(numRead > 0);
+
+    // once the writer is done, everything still in the ring reads back
+    for (uint64_t record = history.getOldestRecord(); record <= history.getNewestRecord(); record++)
+    {
+        EXPECT(history.read(record, frame));
+        EXPECT(isWhole(frame, 0.5f));
+    }
+
+    EXPECT(! history.read(history.getNewestRecord() + 1, frame));
+    EXPECT(! history.read(1, frame));
+
+    std::cout << "    " << numRead << " records read, " << numRejected << " rejected as overwritten" << std::endl;
+}
+
+GRIDVIEWER_TEST(handoff, FrameHistoryOutliersKeepTheRestResolved)
+{
+    // all channels go into the percentiles, and a strided sample of them
+    for (int numChannels : { NUM_CHANNELS, 8192 })
+    {
+        FrameHistory history(numChannels, 4, 1, 50.0f);
+
+        // channels spread over 0 - 100 uV, with two saturated ones far above
+        ActivitySnapshot frame;
+        frame.allocate(numChannels);
+
+        for (int m = 0; m < numActivityMetrics; m++)
+        {
+            float* values = frame.getValues((ActivityMetric) m);
+
+            for (int i = 0; i < numChannels; i++)
+                values[i] = 100.0f * (float) i / (float) numChannels;
+
+            values[10] = 60000.0f;
+            values[200] = 65000.0f;
+        }
+
+        history.write(frame, 1, 100);
+
+        ActivitySnapshot result;
+        result.allocate(numChannels);
+
+        EXPECT(history.read(1, result));
+
+        // the outermost percent of channels is clamped to the range; a sampled percentile may reach a little further
+        const bool sampled = numChannels > NUM_CHANNELS;
+        const int clamped = sampled ? numChannels / 50 : numChannels / 100 + 1;
+        const float clampedError = sampled ? 2.5f : 1.5f;
+        const float top = sampled ? 97.0f : 98.0f;
+
+        for (int m = 0; m < numActivityMetrics; m++)
+        {
+            const float* values = frame.getValues((ActivityMetric) m);
+            const float* decoded = result.getValues((ActivityMetric) m);
+
+            int numOff = 0;
+
+            // within one code of a 0 - 100 uV range
+            for (int i = 0; i < numChannels; i++)
+            {
+                if (i == 10 || i == 200)
+                    continue;
+
+                const bool outer = i < clamped || i >= numChannels - clamped;
+                numOff += std::abs(decoded[i] - values[i]) <= (outer ? clampedError : 100.0f / 255.0f) ? 0 : 1;
+            }
+
+            EXPECT_EQ(numOff, 0);
+
+            // outliers are clamped to the top of the range
+            EXPECT(decoded[10] >= top);
+            EXPECT(decoded[200] >= top);
+        }
+    }
+}
+
+GRIDVIEWER_TEST(handoff, WorkerPoolRunsEveryItemOnce)
+{
+    const int MAX_ITEMS = 5000;
+
+    WorkerPool pool(3);
+    ItemCounts items(MAX_ITEMS);
+    std::mt19937 random(7);
+
+    int numWrong = 0;
+
+    for (int job = 0; job < 3000; job++)
+    {
+        // uneven chunks, including ones larger than the job and a last chunk cut short
+        const int numItems = 1 + (int) (random() % MAX_ITEMS);
+        const int chunkSize = 1 + (int) (random() % 97);
+
+        items.clear();
+        pool.run(&ItemCounts::count, &items, numItems, chunkSize);
+        numWrong += items.eachOnce(numItems) ? 0 : 1;
+
+        // now and then long enough for the workers to stop spinning and sleep
+        if (job % 100 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    EXPECT_EQ(numWrong, 0);
+    EXPECT_EQ(pool.getNumInlineRuns(), (uint64_t) 0);
+}
+
+GRIDVIEWER_TEST(handoff, WorkerPoolFallsBackInlineWhenBusy)
+{
+    const int NUM_ITEMS = 4096;
+
+    // two callers share the pool, so one of them often finds it busy
+    WorkerPool pool(2);
+    ItemCounts first(NUM_ITEMS);
+    ItemCounts second(NUM_ITEMS);
+
+    std::atomic<int> numWrong(0);
+
+    auto caller = [&pool, &numWrong] (ItemCounts& items, int chunkSize)
+    {
+        for (int job = 0; job < 2000; job++)
+        {
+            items.clear();
+            pool.run(&ItemCounts::count, &items, NUM_ITEMS, chunkSize);
+            numWrong += items.eachOnce(NUM_ITEMS) ? 0 : 1;
+        }
+    };
+
+    std::thread other([&] { caller(second, 33); });
+    caller(first, 64);
+    other.join();
+
+    EXPECT_EQ(numWrong.load(), 0);
+    EXPECT(pool.getNumInlineRuns() > 0);
+
+    // a pool without workers runs everything on the caller
+    WorkerPool empty(0);
+
+    first.clear();
+    empty.run(&ItemCounts::count, &first, NUM_ITEMS, 16);
+
+    EXPECT(first.eachOnce(NUM_ITEMS));
+    EXPECT_EQ(empty.getNumInlineRuns(), (uint64_t) 1);
+}
@@ -0,0 +1,259 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ColourMaps.h"
+#include "CpuFeatures.h"
+#include "FilterBank.h"
+#include "ReductionKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    Every SIMD kernel against its scalar version, at every instruction set
+    this CPU supports, on lengths that exercise the vector tails.
+ */
+
+namespace {
+
+const int LENGTHS[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 33, 63, 64, 100, 255, 256, 1000, 1031 };
+
+std::vector<float> makeSignal(int numSamples, unsigned int seed)
+{
+    std::mt19937 random(seed);
+    std::normal_distribution<float> noise(0.0f, 40.0f);
+
+    std::vector<float> x((size_t) numSamples);
+
+    for (auto& v : x)
+        v = noise(random) - 20.0f;
+
+    return x;
+}
+
+/** Runs a check once per instruction set up to what the CPU supports, then restores the dispatch */
+template <typename Check>
+void forEachSimdLevel(Check check)
+{
+    const SimdLevel previous = ReductionKernels::getActiveSimdLevel();
+
+    for (int level = (int) SimdLevel::SSE2; level <= (int) CpuFeatures::getSimdLevel(); level++)
+    {
+        ReductionKernels::setSimdLevel((SimdLevel) level);
+        check((SimdLevel) level);
+    }
+
+    ReductionKernels::setSimdLevel(previous);
+}
+
+ChannelStatistics emptyStatistics()
+{
+    ChannelStatistics stats;
+    stats.minimum = std::numeric_limits<float>::max();
+    stats.maximum = std::numeric_limits<float>::lowest();
+    stats.sum = 0.0f;
+    stats.sumOfSquares = 0.0f;
+    stats.lineLength = 0.0f;
+    stats.crossings = 0;
+    stats.lastSample = 0.0f;
+    stats.hasLastSample = 0;
+    return stats;
+}
+
+}
+
+GRIDVIEWER_TEST(kernels, MinMaxMatchesScalar)
+{
+    for (int n : LENGTHS)
+    {
+        const std::vector<float> x = makeSignal(n, 1000u + (unsigned int) n);
+
+        ReductionKernels::setSimdLevel(SimdLevel::SCALAR);
+        float expectedMin = 1.0e9f, expectedMax = -1.0e9f;
+        ReductionKernels::minMax(x.data(), n, expectedMin, expectedMax);
+
+        forEachSimdLevel([&] (SimdLevel)
+        {
+            float minimum = 1.0e9f, maximum = -1.0e9f;
+            ReductionKernels::minMax(x.data(), n, minimum, maximum);
+
+            EXPECT_EQ(minimum, expectedMin);
+            EXPECT_EQ(maximum, expectedMax);
+        });
+    }
+}
+
+GRIDVIEWER_TEST(kernels, StatisticsMatchScalar)
+{
+    for (int n : LENGTHS)
+    {
+        const std::vector<float> x = makeSignal(n, 2000u + (unsigned int) n);
+
+        double sumOfMagnitudes = 0.0;
+
+        for (float v : x)
+            sumOfMagnitudes += std::abs(v);
+
+        // once from an empty channel, once continuing a previous block
+        for (int continuing = 0; continuing < 2; continuing++)
+        {
+            ChannelStatistics initial = emptyStatistics();
+
+            if (continuing)
+            {
+                initial.lastSample = 35.0f;
+                initial.hasLastSample = 1;
+            }
+
+            ReductionKernels::setSimdLevel(SimdLevel::SCALAR);
+            ChannelStatistics expected = initial;
+            ReductionKernels::statistics(x.data(), n, -50.0f, expected);
+
+            forEachSimdLevel([&] (SimdLevel)
+            {
+                ChannelStatistics stats = initial;
+                ReductionKernels::statistics(x.data(), n, -50.0f, stats);
+
+                EXPECT_EQ(stats.minimum, expected.minimum);
+                EXPECT_EQ(stats.maximum, expected.maximum);
+                EXPECT_EQ(stats.crossings, expected.crossings);
+                EXPECT_EQ(stats.lastSample, expected.lastSample);
+                EXPECT_EQ(stats.hasLastSample, expected.hasLastSample);
+
+                // the vector kernels sum in a different order
+                EXPECT_NEAR(stats.sum, expected.sum, 1.0e-5 * sumOfMagnitudes + 1.0e-3);
+                EXPECT_NEAR(stats.sumOfSquares, expected.sumOfSquares, 1.0e-5 * expected.sumOfSquares + 1.0e-3);
+                EXPECT_NEAR(stats.lineLength, expected.lineLength, 1.0e-5 * expected.lineLength + 1.0e-3);
+            });
+        }
+    }
+}
+
+GRIDVIEWER_TEST(kernels, FilterGroupsMatchScalar)
+{
+    const int numChannels = 13;     // one whole group and one partial
+    const int blockSizes[] = { 37, 256, 5, 128, 1, 200 };
+
+    for (int band = 1; band < numFilterBands; band++)
+    {
+        // every block of every channel, filtered by the kernels the dispatch selects
+        auto run = [&] ()
+        {
+            FilterBank filters(numChannels, 30000.0f);
+            filters.setBand((FilterBand) band);
+
+            std::vector<std::vector<float>> outputs((size_t) numChannels);
+            int64_t offset = 0;
+
+            for (int blockSize : blockSizes)
+            {
+                filters.beginBlock();
+
+                std::vector<std::vector<float>> in((size_t) numChannels), out((size_t) numChannels);
+                std::vector<const float*> inputs;
+                std::vector<float*> outs;
+
+                for (int c = 0; c < numChannels; c++)
+                {
+                    in[(size_t) c] = makeSignal(blockSize, (unsigned int) (offset * 31 + c));
+                    out[(size_t) c].assign((size_t) blockSize, 0.0f);
+                }
+
+                for (int c = 0; c < numChannels; c++)
+                {
+                    inputs.push_back(in[(size_t) c].data());
+                    outs.push_back(out[(size_t) c].data());
+                }
+
+                for (int first = 0; first < numChannels; first += FilterBank::channelsPerGroup)
+                    filters.process(first, inputs.data() + first, outs.data() + first,
+                                    std::min(FilterBank::channelsPerGroup, numChannels - first), blockSize);
+
+                for (int c = 0; c < numChannels; c++)
+                    outputs[(size_t) c].insert(outputs[(size_t) c].end(), out[(size_t) c].begin(), out[(size_t) c].end());
+
+                offset += blockSize;
+            }
+
+            return outputs;
+        };
+
+        ReductionKernels::setSimdLevel(SimdLevel::SCALAR);
+        const auto expected = run();
+
+        forEachSimdLevel([&] (SimdLevel)
+        {
+            const auto actual = run();
+
+            for (int c = 0; c < numChannels; c++)
+                for (size_t i = 0; i < expected[(size_t) c].size(); i++)
+                    EXPECT_NEAR(actual[(size_t) c][i], expected[(size_t) c][i], 1.0e-3);
+        });
+    }
+}
+
+GRIDVIEWER_TEST(kernels, ColourMappingMatchesPerValueLookup)
+{
+    std::vector<float> values = makeSignal(1031, 3000u);
+
+    for (auto& v : values)
+        v = v / 80.0f + 0.5f;   // mostly inside [0, 1), some either side
+
+    values[3] = std::numeric_limits<float>::quiet_NaN();
+    values[10] = std::numeric_limits<float>::infinity();
+    values[11] = -std::numeric_limits<float>::infinity();
+    values[12] = 1.0f;
+    values[13] = 0.0f;
+
+    const float scale = 0.9f;
+    const float offset = 0.05f;
+
+    std::vector<uint32_t> colours(values.size());
+    std::vector<uint8_t> indices(values.size());
+
+    const uint32_t* table = ColourMaps::getTable(ColourSchemeId::VIRIDIS);
+
+    for (int n : LENGTHS)
+    {
+        ColourMaps::mapValues(values.data(), colours.data(), n, ColourSchemeId::VIRIDIS, scale);
+        ColourMaps::mapIndices(values.data(), indices.data(), n, scale, offset);
+
+        for (int i = 0; i < n; i++)
+        {
+            const float tableScale = scale * (float) ColourMaps::tableSize;
+            const float tableOffset = offset * (float) ColourMaps::tableSize;
+
+            EXPECT_EQ(colours[(size_t) i], table[ColourMaps::getIndexForTablePosition(values[(size_t) i] * tableScale)]);
+            EXPECT_EQ((int) indices[(size_t) i], ColourMaps::getIndexForTablePosition(values[(size_t) i] * tableScale + tableOffset));
+        }
+    }
+}
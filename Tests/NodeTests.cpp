@@ -0,0 +1,150 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "HeadlessNode.h"
+
+#include <cstdint>
+#include <limits>
+
+using namespace GridViewer;
+
+/*
+    The node's parameter rules and per-block work, through the headless
+    node that shares them with the plugin.
+ */
+
+GRIDVIEWER_TEST(node, ParametersAreClampedAndGuardedDuringAcquisition)
+{
+    HeadlessNode node;
+    node.addStream(100, 0, 16, 30000.0f);
+
+    ActivityEngine& engine = node.getEngine();
+
+    // raw history is opt-in: no compressor thread or slots until it is asked for
+    EXPECT_EQ(engine.getRawHistoryBudget(), 0);
+    EXPECT(engine.getRawHistory() == nullptr);
+
+    EXPECT(node.setParameter(1, 100.0f));
+    EXPECT_EQ(engine.getNumWorkerThreads(), 64);
+    EXPECT(node.setParameter(1, 2.0f));
+    EXPECT(node.setParameter(2, -5.0f));
+    EXPECT_EQ(engine.getParallelThreshold(), 1);
+    EXPECT(node.setParameter(3, -40.0f));
+    EXPECT(node.setParameter(7, 1.0e9f));
+    EXPECT_EQ(engine.getRawHistoryBudget(), 65536);
+    EXPECT(node.setParameter(7, 0.0f));
+
+    // out-of-range and NaN values are clamped before they are cast
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    EXPECT(node.setParameter(7, 1.0e10f));
+    EXPECT_EQ(engine.getRawHistoryBudget(), 65536);
+    EXPECT(node.setParameter(7, nan));
+    EXPECT_EQ(engine.getRawHistoryBudget(), 0);
+    EXPECT(node.setParameter(6, nan));
+    EXPECT_EQ(engine.getHistoryBudget(), 0);
+    EXPECT(node.setParameter(2, -1.0e10f));
+    EXPECT_EQ(engine.getParallelThreshold(), 1);
+    EXPECT(node.setParameter(1, nan));
+    EXPECT_EQ(engine.getNumWorkerThreads(), 0);
+    EXPECT(node.setParameter(4, nan));
+    EXPECT(engine.getFilterBand() == FilterBand::BROADBAND);
+    EXPECT(node.setParameter(1, 2.0f));
+    EXPECT(node.setParameter(6, 1.0f));
+    EXPECT(! node.setParameter(99, 1.0f));
+
+    node.enable();
+
+    // pool, thresholds and histories are left alone while acquiring
+    EXPECT(! node.setParameter(1, 4.0f));
+    EXPECT(! node.setParameter(2, 100.0f));
+    EXPECT(! node.setParameter(3, -80.0f));
+    EXPECT(! node.setParameter(6, 8.0f));
+    EXPECT(! node.setParameter(7, 8.0f));
+
+    EXPECT_EQ(engine.getNumWorkerThreads(), 2);
+    EXPECT_EQ(engine.getParallelThreshold(), 1);
+    EXPECT_EQ(engine.getCrossingThreshold(), -40.0f);
+    EXPECT_EQ(engine.getHistoryBudget(), 1);
+
+    // the band, multiplier and selected stream may change at any time
+    EXPECT(node.setParameter(4, 9.0f));
+    EXPECT(engine.getFilterBand() == FilterBand::LFP);
+    EXPECT(node.setParameter(5, 50.0f));
+    EXPECT_EQ(engine.getThresholdMultiplier(), 20.0f);
+    EXPECT(node.setParameter(0, (float) Mock::GenericProcessor::getProcessorFullId(100, 0)));
+
+    node.disable();
+
+    EXPECT(node.setParameter(1, 0.0f));
+    EXPECT_EQ(engine.getNumWorkerThreads(), 0);
+}
+
+GRIDVIEWER_TEST(node, EveryStreamIsReducedAtItsOwnRate)
+{
+    HeadlessNode node;
+    node.addStream(100, 0, 32, 30000.0f);
+    node.addStream(101, 0, 8, 2500.0f);
+    node.setParameter(1, 2.0f);
+    node.setParameter(2, 16.0f);
+    node.enable();
+
+    const double blockSeconds = 1024.0 / 30000.0;
+    const int numBlocks = 60;
+
+    for (int b = 0; b < numBlocks; b++)
+    {
+        node.generateBlock(blockSeconds);
+        node.processBlock();
+    }
+
+    ActivityEngine& engine = node.getEngine();
+    EXPECT_EQ(engine.getNumStreams(), 2);
+
+    const float sampleRates[] = { 30000.0f, 2500.0f };
+
+    for (int s = 0; s < engine.getNumStreams(); s++)
+    {
+        StreamActivity& stream = engine.getStream(s);
+        EXPECT_EQ(stream.getSampleRate(), sampleRates[s]);
+
+        const ActivitySnapshot& frame = stream.getLatestFrame();
+
+        // 50 frames a second, but at most one per block
+        EXPECT_EQ(frame.frameCounter, (uint64_t) numBlocks);
+        EXPECT(frame.sampleTimestamp > 0 && frame.sampleTimestamp <= (int64_t) (numBlocks * blockSeconds * sampleRates[s]) + 1);
+
+        for (int c = 0; c < frame.numChannels; c++)
+        {
+            EXPECT(frame.getValues(ActivityMetric::PEAK_TO_PEAK)[c] > 20.0f);
+            EXPECT_NEAR(frame.getValues(ActivityMetric::RMS)[c], 10.0f, 4.0f);
+        }
+    }
+
+    const LatencySummary latency = node.getProcessLatency().poll();
+    EXPECT_EQ(latency.numBlocks, (uint64_t) numBlocks);
+    EXPECT(latency.maximum > 0.0);
+}
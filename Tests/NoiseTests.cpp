@@ -0,0 +1,209 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ActivityAccumulator.h"
+#include "ActivitySnapshot.h"
+#include "NoiseEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    The MAD noise estimate on Gaussian noise of known standard deviation, and
+    the adaptive k x sigma thresholds against a scalar count of crossings.
+ */
+
+namespace {
+
+// four logarithmic buckets per octave; the interpolated median is well inside one bucket
+const float BUCKET_RESOLUTION = 0.19f;
+
+std::vector<float> makeNoise(int numSamples, float sigma, float mean, std::mt19937& random)
+{
+    std::normal_distribution<float> noise(mean, sigma);
+
+    std::vector<float> x((size_t) numSamples);
+
+    for (auto& v : x)
+        v = noise(random);
+
+    return x;
+}
+
+}
+
+GRIDVIEWER_TEST(noise, EstimateMatchesGaussianSigma)
+{
+    const float SIGMAS[] = { 0.5f, 3.0f, 10.0f, 80.0f, 600.0f };
+    const int numChannels = 5;
+
+    std::mt19937 random(3);
+    NoiseEstimator estimator(numChannels, 1);
+
+    // far more than maxCount samples, so every histogram is halved many times
+    for (int block = 0; block < 200; block++)
+    {
+        for (int c = 0; c < numChannels; c++)
+        {
+            const std::vector<float> x = makeNoise(1000, SIGMAS[c], 25.0f, random);
+            estimator.addBlock(c, x.data(), (int) x.size(), 25.0f);
+        }
+    }
+
+    for (int c = 0; c < numChannels; c++)
+        EXPECT_NEAR(estimator.getNoise(c) / SIGMAS[c], 1.0f, BUCKET_RESOLUTION);
+
+    estimator.reset();
+
+    for (int c = 0; c < numChannels; c++)
+        EXPECT_EQ(estimator.getNoise(c), 0.0f);
+}
+
+GRIDVIEWER_TEST(noise, HalvingFollowsAChangeOfNoiseLevel)
+{
+    std::mt19937 random(5);
+    NoiseEstimator estimator(1, 1);
+
+    for (int block = 0; block < 100; block++)
+    {
+        const std::vector<float> x = makeNoise(1000, 10.0f, 0.0f, random);
+        estimator.addBlock(0, x.data(), (int) x.size(), 0.0f);
+    }
+
+    EXPECT_NEAR(estimator.getNoise(0) / 10.0f, 1.0f, BUCKET_RESOLUTION);
+
+    // old samples lose half their weight every maxCount samples, so a few of those are enough
+    for (int block = 0; block < 400; block++)
+    {
+        const std::vector<float> x = makeNoise(1000, 40.0f, 0.0f, random);
+        estimator.addBlock(0, x.data(), (int) x.size(), 0.0f);
+    }
+
+    EXPECT_NEAR(estimator.getNoise(0) / 40.0f, 1.0f, BUCKET_RESOLUTION);
+}
+
+GRIDVIEWER_TEST(noise, StrideCarriesAcrossBlocks)
+{
+    const int stride = 30;
+
+    std::mt19937 random(9);
+    NoiseEstimator estimator(1, stride);
+
+    // blocks of 7 samples: one sample in every 30 is kept, wherever the blocks split them
+    const std::vector<float> x = makeNoise((int) (NoiseEstimator::minCount - 1) * stride, 10.0f, 0.0f, random);
+
+    for (size_t i = 0; i < x.size(); i += 7)
+        estimator.addBlock(0, x.data() + i, (int) std::min<size_t>(7, x.size() - i), 0.0f);
+
+    EXPECT_EQ(estimator.getNoise(0), 0.0f);
+
+    const float one = 1.0f;
+    estimator.addBlock(0, &one, 1, 0.0f);
+
+    EXPECT(estimator.getNoise(0) > 0.0f);
+}
+
+GRIDVIEWER_TEST(noise, AdaptiveCrossingsMatchAScalarCount)
+{
+    const float sampleRate = 30000.0f;
+    const int interval = 600;
+    const float multiplier = 4.5f;
+    const float sigma = 10.0f;
+    const float fixedThreshold = -50.0f;
+
+    ActivityAccumulator accumulator(1, sampleRate, interval);
+    accumulator.setThreshold(fixedThreshold);
+    accumulator.setThresholdMultiplier(multiplier);
+
+    ActivitySnapshot frame;
+    frame.allocate(1);
+
+    // the scalar reference: the same estimator, centre and threshold rule, and a plain crossing count
+    NoiseEstimator reference(1, (int) (sampleRate / 1000.0f));
+    float centre = 0.0f;
+    float threshold = fixedThreshold;
+    float previous = 0.0f;
+    bool hasPrevious = false;
+
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> spikeAmplitude(-90.0f, -20.0f);
+
+    int numMismatched = 0;
+    int numIntervals = 0;
+    int numCrossings = 0;
+
+    for (int i = 0; i < 200; i++)
+    {
+        // noise on a DC offset with spikes of random depth, some above the threshold and some below
+        std::vector<float> x = makeNoise(interval, sigma, 12.0f, random);
+
+        for (int s = 50; s + 3 < interval; s += 150)
+            for (int k = 0; k < 3; k++)
+                x[(size_t) (s + k)] += spikeAmplitude(random);
+
+        int count = 0;
+
+        for (float v : x)
+        {
+            count += (hasPrevious && previous >= threshold && v < threshold) ? 1 : 0;
+            previous = v;
+            hasPrevious = true;
+        }
+
+        reference.addBlock(0, x.data(), interval, centre);
+
+        // two blocks per interval, as the node delivers them
+        accumulator.addBlock(0, x.data(), interval / 2);
+        accumulator.endBlock(interval / 2);
+        accumulator.addBlock(0, x.data() + interval / 2, interval / 2);
+
+        if (! accumulator.endBlock(interval / 2))
+            continue;
+
+        accumulator.writeSnapshot(frame);
+
+        const float rate = frame.getValues(ActivityMetric::CROSSING_RATE)[0];
+        numMismatched += std::lround(rate * (float) interval / sampleRate) == count ? 0 : 1;
+        numIntervals++;
+        numCrossings += count;
+
+        centre = frame.getValues(ActivityMetric::MEAN)[0];
+
+        const float noise = reference.getNoise(0);
+        threshold = noise > 0.0f ? centre - multiplier * noise : fixedThreshold;
+    }
+
+    EXPECT_EQ(numIntervals, 200);
+    EXPECT_EQ(numMismatched, 0);
+    EXPECT(numCrossings > 0);
+
+    // spikes inflate the MAD a little, but the threshold stays near 4.5 sigma below the offset
+    EXPECT_NEAR((centre - threshold) / (multiplier * sigma), 1.0f, BUCKET_RESOLUTION);
+}
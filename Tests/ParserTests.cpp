@@ -0,0 +1,318 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ElectrodeLayout.h"
+#include "JsonReader.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    JsonReader and the channel map readers on well-formed documents, on a
+    list of known malformed ones, and on many randomly mutated channel maps:
+    whatever the input, parsing either fails with an error or yields entries
+    an ElectrodeLayout can be built from.
+ */
+
+namespace {
+
+const char* VALID_JSON_MAP =
+    "{ \"name\": \"probe \\u00b5m \\ud83d\\ude00\", \"channels\": [\n"
+    "  { \"channel\": 0, \"x\": 0, \"y\": 0 },\n"
+    "  { \"channel\": 1, \"x\": 20.5, \"y\": -1.5e1, \"enabled\": false },\n"
+    "  { \"channel\": 2, \"x\": 41, \"y\": 0, \"enabled\": true },\n"
+    "  { \"channel\": 3, \"x\": 0, \"y\": 20, \"enabled\": 1 }\n"
+    "] }";
+
+const char* VALID_CSV_MAP =
+    "# channel map\n"
+    "channel, x, y, enabled\n"
+    "0, 0, 0\n"
+    "1, 20, 0, 0\n"
+    "2; 40; 0; yes\n"
+    "3\t0\t20\n"
+    "4 20 20\n";
+
+/** Checks the invariants the canvas relies on */
+void checkLayout(const ElectrodeLayout& layout, int numChannels)
+{
+    EXPECT(layout.getNumColumns() >= 1);
+    EXPECT(layout.getNumRows() >= 1);
+
+    const int numCells = layout.getNumColumns() * layout.getNumRows();
+
+    for (int i = 0; i < layout.getNumElectrodes(); i++)
+    {
+        EXPECT(layout.getElectrodeCells()[i] >= 0 && layout.getElectrodeCells()[i] < numCells);
+        EXPECT(layout.getElectrodeChannels()[i] >= 0 && layout.getElectrodeChannels()[i] < numChannels);
+    }
+}
+
+/** Applies one random edit: change, insert, delete or duplicate a few bytes, or truncate */
+void mutate(std::string& text, std::mt19937& random)
+{
+    static const char interesting[] = "{}[]\",:\\u0123456789-+.eE \n\t#;abcdfnrtlsx\xc3\xff";
+
+    auto pick = [&] (size_t n) { return (size_t) std::uniform_int_distribution<size_t>(0, n > 0 ? n - 1 : 0)(random); };
+    auto character = [&] { return interesting[pick(sizeof(interesting) - 1)]; };
+
+    if (text.empty())
+    {
+        text += character();
+        return;
+    }
+
+    const size_t at = pick(text.size());
+
+    switch (pick(5))
+    {
+        case 0: text[at] = character(); break;
+        case 1: text.insert(at, 1, character()); break;
+        case 2: text.erase(at, 1 + pick(8)); break;
+        case 3: text.insert(at, text.substr(pick(text.size()), 1 + pick(16))); break;
+        default: text.resize(at); break;
+    }
+}
+
+}
+
+GRIDVIEWER_TEST(parsers, JsonReadsValidDocuments)
+{
+    JsonValue document;
+    std::string error;
+
+    EXPECT(JsonValue::parse(VALID_JSON_MAP, document, error));
+    EXPECT(error.empty());
+
+    EXPECT(document.isObject());
+    EXPECT_EQ(document["name"].getString(), std::string("probe \xc2\xb5m \xf0\x9f\x98\x80"));
+    EXPECT_EQ(document["channels"].size(), 4);
+    EXPECT_EQ(document["channels"][1]["y"].getNumber(), -15.0);
+    EXPECT(! document["channels"][1]["enabled"].getBool(true));
+    EXPECT(document["missing"].getType() == JsonValue::Type::NUL);
+    EXPECT(document["channels"][99].getType() == JsonValue::Type::NUL);
+
+    EXPECT(JsonValue::parse(" [ 0, -0.5, 1e3, 2E-2, true, false, null, \"\\\"\\\\\\/\\b\\f\\n\\r\\t\" ] ", document, error));
+    EXPECT_EQ(document.size(), 8);
+    EXPECT_EQ(document[2].getNumber(), 1000.0);
+    EXPECT_EQ(document[7].getString(), std::string("\"\\/\b\f\n\r\t"));
+}
+
+GRIDVIEWER_TEST(parsers, JsonRejectsMalformedDocuments)
+{
+    const char* malformed[] =
+    {
+        "", " ", "{", "}", "[", "[1,", "[1 2]", "[1,]", "{\"a\" 1}", "{\"a\":}", "{a:1}", "{\"a\":1,}",
+        "\"abc", "\"\\x\"", "\"\\u12\"", "\"\\u12g4\"", "tru", "nul", "[] []",
+        "nan", "inf", "[-inf]", "+1", "01", "1.", ".5", "1e", "-", "0x10", "1e999",
+        "\"\\ud83d\\u0041\"",   // high surrogate followed by something other than a low one
+        "\"\\ude00\""           // lone low surrogate
+    };
+
+    for (const char* text : malformed)
+    {
+        JsonValue document;
+        std::string error;
+
+        const bool parsed = JsonValue::parse(text, document, error);
+
+        if (parsed)
+            std::cout << "    accepted malformed document: " << text << std::endl;
+
+        EXPECT(! parsed);
+        EXPECT(! error.empty());
+    }
+
+    // nesting beyond the depth limit is refused rather than recursed into
+    JsonValue document;
+    std::string error;
+
+    EXPECT(! JsonValue::parse(std::string(100000, '['), document, error));
+    EXPECT(JsonValue::parse(std::string(100, '[') + std::string(100, ']'), document, error));
+}
+
+GRIDVIEWER_TEST(parsers, ChannelMapsReadBothFormats)
+{
+    std::vector<ChannelMapEntry> entries;
+    std::string error;
+
+    EXPECT(ChannelMap::parseJson(VALID_JSON_MAP, entries, error));
+    EXPECT_EQ(entries.size(), (size_t) 4);
+
+    if (entries.size() == 4)
+    {
+        EXPECT_EQ(entries[1].x, 20.5f);
+        EXPECT(! entries[1].enabled);
+        EXPECT(entries[3].enabled);
+    }
+
+    EXPECT(ChannelMap::parseCsv(VALID_CSV_MAP, entries, error));
+    EXPECT_EQ(entries.size(), (size_t) 5);
+
+    if (entries.size() == 5)
+    {
+        EXPECT(! entries[1].enabled);
+        EXPECT_EQ(entries[2].x, 40.0f);
+        EXPECT_EQ(entries[4].y, 20.0f);
+    }
+
+    const ElectrodeLayout layout(5, entries);
+    checkLayout(layout, 5);
+    EXPECT_EQ(layout.getNumColumns(), 3);
+    EXPECT_EQ(layout.getNumRows(), 2);
+    EXPECT_EQ(layout.getNumElectrodes(), 4);
+}
+
+GRIDVIEWER_TEST(parsers, ChannelMapsRejectUnusablePositions)
+{
+    const char* csv[] = { "0, nan, 0\n", "0, 0, inf\n", "0, 1e39, 0\n", "1e20, 0, 0\n", "0, 0\n", "0, 0, 0\nx, 1, 1\n" };
+
+    for (const char* text : csv)
+    {
+        std::vector<ChannelMapEntry> entries;
+        std::string error;
+
+        EXPECT(! ChannelMap::parseCsv(text, entries, error));
+        EXPECT(! error.empty());
+    }
+
+    const char* json[] =
+    {
+        "[{\"channel\": 0, \"x\": 0}]",
+        "[{\"channel\": 1e20, \"x\": 0, \"y\": 0}]",
+        "[{\"channel\": 0, \"x\": 1e39, \"y\": 0}]",
+        "{\"channels\": 5}",
+        "[]"
+    };
+
+    for (const char* text : json)
+    {
+        std::vector<ChannelMapEntry> entries;
+        std::string error;
+
+        EXPECT(! ChannelMap::parseJson(text, entries, error));
+        EXPECT(! error.empty());
+    }
+
+    // extreme but finite positions still make a usable layout
+    std::vector<ChannelMapEntry> entries;
+    std::string error;
+
+    EXPECT(ChannelMap::parseCsv("0, -3e38, 0\n1, 3e38, 1e-30\n2, 0, -3e38\n3, 1, 1\n", entries, error));
+
+    const ElectrodeLayout layout(4, entries);
+    checkLayout(layout, 4);
+    EXPECT_EQ(layout.getNumElectrodes(), 4);
+}
+
+GRIDVIEWER_TEST(parsers, MutatedChannelMapsNeverBreakTheLayout)
+{
+    std::mt19937 random(12345);
+
+    int numParsed = 0;
+
+    for (int iteration = 0; iteration < 20000; iteration++)
+    {
+        const bool json = iteration % 2 == 0;
+        std::string text = json ? VALID_JSON_MAP : VALID_CSV_MAP;
+
+        const int numEdits = 1 + (int) (random() % 6);
+
+        for (int e = 0; e < numEdits; e++)
+            mutate(text, random);
+
+        std::vector<ChannelMapEntry> entries;
+        std::string error;
+
+        const bool parsed = json ? ChannelMap::parseJson(text, entries, error)
+                                 : ChannelMap::parseCsv(text, entries, error);
+
+        if (! parsed)
+        {
+            EXPECT(! error.empty());
+            continue;
+        }
+
+        numParsed++;
+
+        for (auto& entry : entries)
+            EXPECT(std::isfinite(entry.x) && std::isfinite(entry.y));
+
+        checkLayout(ElectrodeLayout(64, entries), 64);
+    }
+
+    // the mutations should leave plenty of maps readable, or the test checks little
+    EXPECT(numParsed > 1000);
+
+    // large maps whose positions would snap to billions of cells: jittered, and on a diagonal
+    const int numLarge = 65536;
+
+    for (int shape = 0; shape < 2; shape++)
+    {
+        std::vector<ChannelMapEntry> entries;
+        std::uniform_real_distribution<float> jitter(-3.0f, 3.0f);
+
+        for (int i = 0; i < numLarge; i++)
+        {
+            const float x = shape == 0 ? (float) (i % 256) * 20.0f + jitter(random) : (float) i * 1.5f;
+            const float y = shape == 0 ? (float) (i / 256) * 20.0f + jitter(random) : (float) i * 0.75f;
+
+            entries.push_back({ i, x, y, true });
+        }
+
+        const ElectrodeLayout layout(numLarge, entries);
+
+        checkLayout(layout, numLarge);
+        EXPECT((size_t) layout.getNumColumns() * (size_t) layout.getNumRows() <= (size_t) numLarge * 16);
+
+        // positions are all distinct, so every channel keeps a cell of its own
+        EXPECT_EQ(layout.getNumElectrodes(), numLarge);
+    }
+}
+
+GRIDVIEWER_TEST(parsers, RandomBytesAreRejectedCleanly)
+{
+    std::mt19937 random(54321);
+
+    for (int iteration = 0; iteration < 20000; iteration++)
+    {
+        std::string text((size_t) (random() % 64), ' ');
+
+        for (auto& c : text)
+            c = (char) (random() & 0xff);
+
+        JsonValue document;
+        std::string error;
+
+        if (! JsonValue::parse(text, document, error))
+            EXPECT(! error.empty());
+    }
+}
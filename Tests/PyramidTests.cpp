@@ -0,0 +1,194 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ActivityPyramid.h"
+#include "ElectrodeLayout.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    The pyramid's incremental tile rebuilds against a pyramid built from
+    scratch and against pooling every level straight from level 0, over
+    random partial updates.
+ */
+
+namespace {
+
+/** Returns true if two pyramids over the same layout hold the same cells at every level */
+bool samePyramids(const ActivityPyramid& a, const ActivityPyramid& b)
+{
+    for (int l = 0; l < a.getNumLevels(); l++)
+    {
+        const size_t numCells = (size_t) a.getNumColumns(l) * (size_t) a.getNumRows(l);
+
+        for (auto pooling : { ActivityPyramid::Pooling::MAX, ActivityPyramid::Pooling::MEAN })
+        {
+            if (! std::equal(a.getColourIndices(l, pooling), a.getColourIndices(l, pooling) + numCells,
+                             b.getColourIndices(l, pooling)))
+                return false;
+        }
+
+        if (! std::equal(a.getCellStates(l), a.getCellStates(l) + numCells, b.getCellStates(l)))
+            return false;
+    }
+
+    return true;
+}
+
+/** Returns true if every level pools the level-0 electrodes it covers, as a single sweep would */
+bool poolsLevelZero(const ActivityPyramid& pyramid, const ElectrodeLayout& layout)
+{
+    const uint8_t* base = pyramid.getColourIndices(0, ActivityPyramid::Pooling::MAX);
+    const int* cellChannels = layout.getCellChannels();
+
+    for (int l = 1; l < pyramid.getNumLevels(); l++)
+    {
+        const int numColumns = pyramid.getNumColumns(l);
+        const uint8_t* maxIndices = pyramid.getColourIndices(l, ActivityPyramid::Pooling::MAX);
+        const uint8_t* meanIndices = pyramid.getColourIndices(l, ActivityPyramid::Pooling::MEAN);
+
+        for (int row = 0; row < pyramid.getNumRows(l); row++)
+        {
+            for (int column = 0; column < numColumns; column++)
+            {
+                uint8_t maxIndex = 0;
+                uint32_t sum = 0;
+                uint32_t count = 0;
+
+                for (int r = row << l; r < std::min((row + 1) << l, layout.getNumRows()); r++)
+                {
+                    for (int c = column << l; c < std::min((column + 1) << l, layout.getNumColumns()); c++)
+                    {
+                        const size_t cell = (size_t) r * (size_t) layout.getNumColumns() + (size_t) c;
+
+                        if (cellChannels[cell] < 0)
+                            continue;
+
+                        maxIndex = std::max(maxIndex, base[cell]);
+                        sum += base[cell];
+                        count++;
+                    }
+                }
+
+                const size_t cell = (size_t) row * (size_t) numColumns + (size_t) column;
+                const uint8_t meanIndex = count > 0 ? (uint8_t) ((sum + count / 2) / count) : 0;
+
+                if (maxIndices[cell] != maxIndex || meanIndices[cell] != meanIndex)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/** Updates a pyramid with random changes to a few channels at a time and checks it after every update */
+void checkIncrementalUpdates(const ElectrodeLayout& layout, unsigned int seed)
+{
+    const int numChannels = layout.getNumChannels();
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> value(-0.1f, 1.1f);
+
+    std::vector<float> values((size_t) numChannels);
+
+    for (auto& v : values)
+        v = value(random);
+
+    ActivityPyramid pyramid(layout);
+    pyramid.update(values.data(), numChannels, 1.0f);
+
+    int numMismatched = 0;
+    int numUnpooled = 0;
+
+    for (int step = 0; step < 200; step++)
+    {
+        // mostly a handful of channels, sometimes none or all of them
+        const int numChanged = step % 50 == 0 ? numChannels : (int) (random() % 8);
+
+        for (int i = 0; i < numChanged; i++)
+            values[random() % (size_t) numChannels] = value(random);
+
+        pyramid.update(values.data(), numChannels, 1.0f);
+
+        ActivityPyramid fresh(layout);
+        fresh.update(values.data(), numChannels, 1.0f);
+
+        numMismatched += samePyramids(pyramid, fresh) ? 0 : 1;
+        numUnpooled += poolsLevelZero(pyramid, layout) ? 0 : 1;
+    }
+
+    EXPECT_EQ(numMismatched, 0);
+    EXPECT_EQ(numUnpooled, 0);
+}
+
+}
+
+GRIDVIEWER_TEST(pyramid, IncrementalUpdatesMatchAFullRebuild)
+{
+    // square, ragged last row, and grids whose sides are not powers of two or tile multiples
+    const int CHANNEL_COUNTS[] = { 1, 2, 37, 100, 385, 1000, 4099 };
+
+    for (int numChannels : CHANNEL_COUNTS)
+        checkIncrementalUpdates(ElectrodeLayout(numChannels), (unsigned int) numChannels);
+}
+
+GRIDVIEWER_TEST(pyramid, IncrementalUpdatesMatchAFullRebuildOnChannelMaps)
+{
+    std::mt19937 random(11);
+
+    // sparse shanks with empty columns between them, disabled and unmapped channels
+    for (int numChannels : { 64, 384, 960 })
+    {
+        std::vector<ChannelMapEntry> entries;
+
+        for (int i = 0; i < numChannels; i++)
+        {
+            // channel 5 is missing from the map, every seventh one is disabled
+            if (i == 5)
+                continue;
+
+            const int shank = i % 4;
+            const int depth = i / 4;
+
+            entries.push_back({ i, (float) (shank * 250 + (depth % 2) * 16), (float) (depth * 20), i % 7 != 3 });
+        }
+
+        std::shuffle(entries.begin(), entries.end(), random);
+
+        const ElectrodeLayout layout(numChannels, entries);
+
+        EXPECT(layout.isFromChannelMap());
+        EXPECT(layout.getNumElectrodes() < numChannels);
+
+        checkIncrementalUpdates(layout, (unsigned int) numChannels);
+    }
+}
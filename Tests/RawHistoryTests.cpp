@@ -0,0 +1,428 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "TestFramework.h"
+
+#include "ChannelSpan.h"
+#include "RawHistory.h"
+#include "StreamActivity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace GridViewer;
+
+/*
+    Raw history compression round trip: blocks pushed on one side come back
+    from analyse() with exactly the statistics of their int16-quantized
+    samples, whatever the delta widths, and a gap only splits the stored
+    range in two. Filtered windows are recomputed with the filters
+    settled, as live processing computed them.
+ */
+
+namespace {
+
+const float MICROVOLTS_PER_BIT = 0.195f;
+const float SAMPLE_RATE = 30000.0f;
+
+/** Waits for the compressor to store everything up to endSample */
+bool waitForStored(const RawHistory& history, int64_t endSample)
+{
+    for (int i = 0; i < 5000; i++)
+    {
+        int64_t first, end;
+        history.getStoredRange(first, end);
+
+        if (end == endSample)
+            return true;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return false;
+}
+
+/** What push() stores for a sample */
+float quantize(float v)
+{
+    const float code = std::max(-32768.0f, std::min(v * (1.0f / MICROVOLTS_PER_BIT), 32767.0f));
+    return (float) (int) (code + (code >= 0.0f ? 0.5f : -0.5f)) * MICROVOLTS_PER_BIT;
+}
+
+/** Channels that need every delta width from 0 to 17 bits */
+std::vector<std::vector<float>> makeChannels(int numSamples)
+{
+    std::mt19937 random(7);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+
+    const int numChannels = 6;
+    std::vector<std::vector<float>> x((size_t) numChannels, std::vector<float>((size_t) numSamples));
+
+    float walk = 0.0f;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        walk += noise(random);
+
+        x[0][(size_t) i] = 1234.5f;                                  // constant: zero-width deltas
+        x[1][(size_t) i] = walk;                                     // small deltas
+        x[2][(size_t) i] = noise(random) * 20.0f;                    // typical noise
+        x[3][(size_t) i] = noise(random) * 3000.0f;                  // wide noise, partly clipped
+        x[4][(size_t) i] = i % 2 == 0 ? 7000.0f : -7000.0f;          // alternating rails: 17-bit deltas
+        x[5][(size_t) i] = -6389.0f + (float) (i % 50) * 0.01f;      // near the negative rail
+    }
+
+    return x;
+}
+
+}
+
+GRIDVIEWER_TEST(rawhistory, RoundTripKeepsQuantizedSamples)
+{
+    const int numSamples = 5000;
+    const auto x = makeChannels(numSamples);
+    const int numChannels = (int) x.size();
+
+    RawHistory history(numChannels, 64 << 20, MICROVOLTS_PER_BIT);
+    history.setStream(7);
+
+    std::vector<const float*> buffer((size_t) numChannels);
+    std::vector<int> indices((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        indices[(size_t) c] = c;
+
+    // blocks shorter and longer than a queue slot, pushed at a rate the queue keeps up with
+    const int blockSizes[] = { 100, 1500, 1, 1023, 1024, 1352 };
+    int64_t position = 0;
+
+    for (int blockSize : blockSizes)
+    {
+        for (int c = 0; c < numChannels; c++)
+            buffer[(size_t) c] = x[(size_t) c].data() + position;
+
+        EXPECT(history.push(7, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, blockSize, position));
+        EXPECT(waitForStored(history, position + blockSize));
+
+        position += blockSize;
+    }
+
+    EXPECT_EQ(position, (int64_t) numSamples);
+    EXPECT_EQ(history.getStreamId(), 7u);
+    EXPECT_EQ(history.getNumChannels(), numChannels);
+    EXPECT(history.getCompressedBytes() < (size_t) numSamples * numChannels * sizeof(int16_t));
+
+    // windows inside one block, across blocks, and the whole range
+    const int64_t windows[][2] = { { 0, 100 }, { 50, 1700 }, { 1601, 2624 }, { 2000, 4999 }, { 0, numSamples } };
+
+    for (auto& window : windows)
+    {
+        ActivitySnapshot result;
+        EXPECT(history.analyse(window[0], window[1], FilterBand::BROADBAND, -50.0f, result));
+
+        if (result.numChannels != numChannels)
+            continue;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            float lo = 1.0e9f, hi = -1.0e9f;
+            double sum = 0.0, sumOfMagnitudes = 0.0, sumOfSquares = 0.0;
+
+            for (int64_t i = window[0]; i < window[1]; i++)
+            {
+                const float q = quantize(x[(size_t) c][(size_t) i]);
+                lo = std::min(lo, q);
+                hi = std::max(hi, q);
+                sum += q;
+                sumOfMagnitudes += std::abs(q);
+                sumOfSquares += (double) q * q;
+            }
+
+            const double n = (double) (window[1] - window[0]);
+
+            EXPECT_EQ(result.getValues(ActivityMetric::PEAK_TO_PEAK)[c], hi - lo);
+            // the accumulator sums in float
+            EXPECT_NEAR(result.getValues(ActivityMetric::MEAN)[c], sum / n, 1.0e-6 * sumOfMagnitudes / n + 1.0e-3);
+            EXPECT_NEAR(result.getValues(ActivityMetric::RMS)[c], std::sqrt(sumOfSquares / n), 1.0e-4 * std::sqrt(sumOfSquares / n) + 1.0e-3);
+        }
+    }
+
+    // outside the stored range
+    ActivitySnapshot result;
+    EXPECT(! history.analyse(-10, 100, FilterBand::BROADBAND, -50.0f, result));
+    EXPECT(! history.analyse(4000, numSamples + 1, FilterBand::BROADBAND, -50.0f, result));
+}
+
+GRIDVIEWER_TEST(rawhistory, GapSplitsTheStoredRange)
+{
+    const auto x = makeChannels(2048);
+    const int numChannels = (int) x.size();
+
+    RawHistory history(numChannels, 64 << 20, MICROVOLTS_PER_BIT);
+
+    std::vector<const float*> buffer((size_t) numChannels);
+    std::vector<int> indices((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        buffer[(size_t) c] = x[(size_t) c].data();
+        indices[(size_t) c] = c;
+    }
+
+    EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, 1024, 0));
+    EXPECT(waitForStored(history, 1024));
+
+    // 10 samples missing
+    EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, 1024, 1034));
+    EXPECT(waitForStored(history, 2058));
+
+    int64_t first, end;
+    history.getStoredRange(first, end);
+
+    EXPECT_EQ(first, (int64_t) 0);
+    EXPECT_EQ(end, (int64_t) 2058);
+
+    // windows on either side of the gap, but not across it
+    ActivitySnapshot result;
+    EXPECT(history.analyse(0, 1024, FilterBand::BROADBAND, -50.0f, result));
+    EXPECT(history.analyse(1034, 2058, FilterBand::BROADBAND, -50.0f, result));
+    EXPECT(! history.analyse(1000, 1100, FilterBand::BROADBAND, -50.0f, result));
+    EXPECT(! history.analyse(1024, 1034, FilterBand::BROADBAND, -50.0f, result));
+
+    // timestamps going back start the stored range again
+    EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, 512, 0));
+    EXPECT(waitForStored(history, 512));
+
+    history.getStoredRange(first, end);
+
+    EXPECT_EQ(first, (int64_t) 0);
+    EXPECT_EQ(end, (int64_t) 512);
+}
+
+GRIDVIEWER_TEST(rawhistory, BudgetDropsTheOldestBlocks)
+{
+    const auto x = makeChannels(1024);
+    const int numChannels = (int) x.size();
+
+    // room for a few blocks of this noise, after the queue's quarter: 128 samples per slot
+    const size_t budget = 96 << 10;
+    RawHistory history(numChannels, budget, MICROVOLTS_PER_BIT);
+
+    std::vector<const float*> buffer((size_t) numChannels);
+    std::vector<int> indices((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        buffer[(size_t) c] = x[(size_t) c].data();
+        indices[(size_t) c] = c;
+    }
+
+    for (int64_t block = 0; block < 20; block++)
+    {
+        EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, 1024, block * 1024));
+        EXPECT(waitForStored(history, (block + 1) * 1024));
+    }
+
+    int64_t first, end;
+    history.getStoredRange(first, end);
+
+    EXPECT_EQ(end, (int64_t) 20 * 1024);
+    EXPECT(first > 0);
+    EXPECT(history.getCompressedBytes() <= budget - 8 * numChannels * 128 * sizeof(int16_t));
+}
+
+GRIDVIEWER_TEST(rawhistory, FilteredWindowsMatchLiveFrames)
+{
+    const int numChannels = 8;
+    const int blockSize = 1024;
+    const int numBlocks = (int) (SAMPLE_RATE * 4.0f) / blockSize;
+    const double pi = 3.141592653589793;
+
+    // spikes and LFP riding on the few mV of DC offset electrodes carry
+    std::mt19937 random(11);
+    std::normal_distribution<float> noise(0.0f, 10.0f);
+
+    std::vector<std::vector<float>> x((size_t) numChannels, std::vector<float>((size_t) numBlocks * blockSize));
+
+    for (int c = 0; c < numChannels; c++)
+        for (size_t i = 0; i < x[(size_t) c].size(); i++)
+            x[(size_t) c][i] = quantize((float) (5000.0 - 400.0 * c
+                                                 + 100.0 * std::sin(2.0 * pi * 1000.0 * (double) i / SAMPLE_RATE)
+                                                 + 80.0 * std::sin(2.0 * pi * 40.0 * (double) i / SAMPLE_RATE))
+                                        + noise(random));
+
+    std::vector<int> indices((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        indices[(size_t) c] = c;
+
+    for (FilterBand band : { FilterBand::SPIKE, FilterBand::LFP })
+    {
+        RawHistory history(numChannels, 64 << 20, MICROVOLTS_PER_BIT);
+
+        // frames are due every 600 samples, but only complete at the end of a 1024 sample block
+        StreamActivity live(0, numChannels, SAMPLE_RATE, 50.0f, ChannelSpan::fromBufferChannels(indices));
+        live.setFilterBand(band);
+        live.setThreshold(-50.0f);
+
+        std::vector<const float*> buffer((size_t) numChannels);
+        ActivitySnapshot first, last;
+
+        for (int block = 0; block < numBlocks; block++)
+        {
+            const int64_t position = (int64_t) block * blockSize;
+
+            for (int c = 0; c < numChannels; c++)
+                buffer[(size_t) c] = x[(size_t) c].data() + position;
+
+            EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, blockSize, position));
+            EXPECT(waitForStored(history, position + blockSize));
+
+            live.processBlock(buffer.data(), blockSize, position);
+
+            const ActivitySnapshot& frame = live.getLatestFrame();
+            ActivitySnapshot& copy = block == 0 ? first : last;
+
+            copy.allocate(numChannels);
+            copy.sampleTimestamp = frame.sampleTimestamp;
+            copy.numSamples = frame.numSamples;
+
+            for (int m = 0; m < numActivityMetrics; m++)
+                std::copy(frame.getValues((ActivityMetric) m),
+                          frame.getValues((ActivityMetric) m) + numChannels,
+                          copy.getValues((ActivityMetric) m));
+        }
+
+        EXPECT_EQ(last.numSamples, blockSize);
+
+        ActivitySnapshot result;
+
+        // the first frame has nothing before it to settle the filters on
+        EXPECT(! history.analyse(first.sampleTimestamp - first.numSamples, first.sampleTimestamp, band, -50.0f, result));
+
+        EXPECT(history.analyse(last.sampleTimestamp - last.numSamples, last.sampleTimestamp, band, -50.0f, result));
+
+        if (result.numChannels != numChannels)
+            continue;
+
+        EXPECT_EQ(result.numSamples, last.numSamples);
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            for (ActivityMetric metric : { ActivityMetric::PEAK_TO_PEAK, ActivityMetric::RMS })
+            {
+                const float expected = last.getValues(metric)[c];
+                EXPECT_NEAR(result.getValues(metric)[c], expected, 0.01f * expected);
+            }
+        }
+    }
+}
+
+GRIDVIEWER_TEST(rawhistory, BackgroundAnalysisMatchesAnalyse)
+{
+    const int numSamples = 4096;
+    const auto x = makeChannels(numSamples);
+    const int numChannels = (int) x.size();
+
+    RawHistory history(numChannels, 64 << 20, MICROVOLTS_PER_BIT);
+
+    std::vector<const float*> buffer((size_t) numChannels);
+    std::vector<int> indices((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        indices[(size_t) c] = c;
+
+    for (int64_t position = 0; position < numSamples; position += 1024)
+    {
+        for (int c = 0; c < numChannels; c++)
+            buffer[(size_t) c] = x[(size_t) c].data() + position;
+
+        EXPECT(history.push(0, SAMPLE_RATE, buffer.data(), indices.data(), numChannels, 1024, position));
+        EXPECT(waitForStored(history, position + 1024));
+    }
+
+    // waits for the analysis thread to finish a request
+    auto waitForAnalysis = [&] (const RawHistory::AnalysisRequest& request, ActivitySnapshot& result)
+    {
+        RawHistory::AnalysisStatus status = RawHistory::AnalysisStatus::PENDING;
+
+        for (int i = 0; i < 5000 && status == RawHistory::AnalysisStatus::PENDING; i++)
+        {
+            status = history.getAnalysis(request, result);
+
+            if (status == RawHistory::AnalysisStatus::PENDING)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return status;
+    };
+
+    auto sameMetrics = [&] (const ActivitySnapshot& a, const ActivitySnapshot& b)
+    {
+        if (a.numChannels != numChannels || b.numChannels != numChannels || a.sampleTimestamp != b.sampleTimestamp)
+            return false;
+
+        for (int m = 0; m < numActivityMetrics; m++)
+            if (! std::equal(a.getValues((ActivityMetric) m), a.getValues((ActivityMetric) m) + numChannels, b.getValues((ActivityMetric) m)))
+                return false;
+
+        return true;
+    };
+
+    // the reused stream starts from rest, whatever band the previous analysis used
+    ActivitySnapshot expected, other;
+    EXPECT(history.analyse(1000, 2000, FilterBand::BROADBAND, -50.0f, expected));
+    EXPECT(history.analyse(1000, 2000, FilterBand::SPIKE, -50.0f, other));
+
+    ActivitySnapshot again;
+    EXPECT(history.analyse(1000, 2000, FilterBand::BROADBAND, -50.0f, again));
+    EXPECT(sameMetrics(expected, again));
+
+    // a request replaced before it finishes is never reported
+    RawHistory::AnalysisRequest replaced { 0, 1000, FilterBand::BROADBAND, -50.0f };
+    RawHistory::AnalysisRequest request { 1000, 2000, FilterBand::BROADBAND, -50.0f };
+
+    history.requestAnalysis(replaced);
+    history.requestAnalysis(request);
+
+    ActivitySnapshot result;
+    EXPECT(waitForAnalysis(request, result) == RawHistory::AnalysisStatus::READY);
+    EXPECT(sameMetrics(expected, result));
+    EXPECT(history.getAnalysis(replaced, result) == RawHistory::AnalysisStatus::PENDING);
+
+    // asking again for a finished request keeps its result
+    history.requestAnalysis(request);
+    EXPECT(history.getAnalysis(request, result) == RawHistory::AnalysisStatus::READY);
+
+    // outside the stored range
+    RawHistory::AnalysisRequest missing { 4000, 5000, FilterBand::BROADBAND, -50.0f };
+
+    history.requestAnalysis(missing);
+    EXPECT(waitForAnalysis(missing, result) == RawHistory::AnalysisStatus::UNAVAILABLE);
+}
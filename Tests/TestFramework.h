@@ -0,0 +1,86 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __TESTFRAMEWORK_H__
+#define __TESTFRAMEWORK_H__
+
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace GridViewer {
+namespace Test {
+
+typedef void (*TestFunction)();
+
+/** Adds a test to the list grid-viewer-tests runs; used through GRIDVIEWER_TEST */
+struct Registration
+{
+    Registration(const char* suite, const char* name, TestFunction function);
+};
+
+/** Records a failed check of the running test; the test carries on */
+void reportFailure(const char* file, int line, const std::string& message);
+
+}
+}
+
+/** Defines a test; suite is the name ctest selects it by */
+#define GRIDVIEWER_TEST(suite, name) \
+    static void suite##_##name(); \
+    static const GridViewer::Test::Registration suite##_##name##_registration(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define EXPECT(condition) \
+    do { \
+        if (! (condition)) \
+            GridViewer::Test::reportFailure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define EXPECT_EQ(actual, expected) \
+    do { \
+        const auto actualValue_ = (actual); \
+        const auto expectedValue_ = (expected); \
+        if (! (actualValue_ == expectedValue_)) \
+        { \
+            std::ostringstream message_; \
+            message_ << #actual << " == " << #expected << " (" << actualValue_ << " vs " << expectedValue_ << ")"; \
+            GridViewer::Test::reportFailure(__FILE__, __LINE__, message_.str()); \
+        } \
+    } while (0)
+
+#define EXPECT_NEAR(actual, expected, tolerance) \
+    do { \
+        const double actualValue_ = (double) (actual); \
+        const double expectedValue_ = (double) (expected); \
+        if (! (std::abs(actualValue_ - expectedValue_) <= (double) (tolerance))) \
+        { \
+            std::ostringstream message_; \
+            message_ << #actual << " ~ " << #expected << " (" << actualValue_ << " vs " << expectedValue_ \
+                     << ", tolerance " << (tolerance) << ")"; \
+            GridViewer::Test::reportFailure(__FILE__, __LINE__, message_.str()); \
+        } \
+    } while (0)
+
+#endif /* __TESTFRAMEWORK_H__ */
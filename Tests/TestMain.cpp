@@ -0,0 +1,109 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+/*
+    grid-viewer-tests: runs the tests of one suite (or all of them) and
+    exits non-zero if any check failed. ctest runs each suite separately.
+ */
+
+#include "TestFramework.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace GridViewer;
+
+namespace {
+
+struct TestCase
+{
+    const char* suite;
+    const char* name;
+    Test::TestFunction function;
+};
+
+std::vector<TestCase>& getTestCases()
+{
+    static std::vector<TestCase> testCases;
+
+    return testCases;
+}
+
+int numFailures = 0;
+
+}
+
+Test::Registration::Registration(const char* suite, const char* name, TestFunction function)
+{
+    getTestCases().push_back({ suite, name, function });
+}
+
+void Test::reportFailure(const char* file, int line, const std::string& message)
+{
+    std::cout << "    " << file << ":" << line << ": check failed: " << message << std::endl;
+    numFailures++;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "--list") == 0)
+    {
+        for (auto& test : getTestCases())
+            std::cout << test.suite << "." << test.name << std::endl;
+
+        return 0;
+    }
+
+    const char* suite = argc > 1 ? argv[1] : nullptr;
+
+    int numRun = 0;
+    int numFailed = 0;
+
+    for (auto& test : getTestCases())
+    {
+        if (suite != nullptr && std::strcmp(suite, test.suite) != 0)
+            continue;
+
+        const int failuresBefore = numFailures;
+
+        std::cout << "[ RUN  ] " << test.suite << "." << test.name << std::endl;
+        test.function();
+        std::cout << (numFailures == failuresBefore ? "[  OK  ] " : "[ FAIL ] ")
+                  << test.suite << "." << test.name << std::endl;
+
+        numRun++;
+        numFailed += numFailures != failuresBefore ? 1 : 0;
+    }
+
+    if (numRun == 0)
+    {
+        std::cout << "No tests in suite " << (suite != nullptr ? suite : "(all)") << std::endl;
+        return 1;
+    }
+
+    std::cout << numRun - numFailed << " of " << numRun << " tests passed" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "BinaryRecording.h"
+
+#include "JsonReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+ #define WIN32_LEAN_AND_MEAN
+ #define NOMINMAX
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+using namespace GridViewer;
+
+#pragma mark - BinaryFormat -
+namespace {
+
+// samples per tile of the deinterleaving copy; a tile of one chunk of channels stays in L1
+const int DEINTERLEAVE_TILE = 256;
+
+bool isSeparator(char c)
+{
+    return c == '/' || c == '\\';
+}
+
+std::string stripTrailingSeparators(std::string path)
+{
+    while (path.size() > 1 && isSeparator(path.back()))
+        path.pop_back();
+
+    return path;
+}
+
+std::string getParent(const std::string& path)
+{
+    const std::string stripped = stripTrailingSeparators(path);
+    const size_t separator = stripped.find_last_of("/\\");
+
+    if (separator == std::string::npos)
+        return ".";
+
+    return separator == 0 ? stripped.substr(0, 1) : stripped.substr(0, separator);
+}
+
+std::string getName(const std::string& path)
+{
+    const std::string stripped = stripTrailingSeparators(path);
+    const size_t separator = stripped.find_last_of("/\\");
+
+    return separator == std::string::npos ? stripped : stripped.substr(separator + 1);
+}
+
+std::string join(const std::string& directory, const std::string& name)
+{
+    if (directory.empty() || isSeparator(directory.back()))
+        return directory + name;
+
+    return directory + "/" + name;
+}
+
+bool fileExists(const std::string& path)
+{
+    return std::ifstream(path, std::ios::binary).good();
+}
+
+}
+
+bool BinaryFormat::readStructure(const std::string& path, std::vector<BinaryStreamInfo>& streams, std::string& error)
+{
+    streams.clear();
+
+    std::ifstream file(path, std::ios::binary);
+
+    if (! file)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    JsonValue document;
+
+    if (! JsonValue::parse(contents.str(), document, error))
+    {
+        error = path + ": " + error;
+        return false;
+    }
+
+    const JsonValue& continuous = document["continuous"];
+
+    if (! continuous.isArray() || continuous.size() == 0)
+    {
+        error = path + " lists no continuous streams";
+        return false;
+    }
+
+    for (int i = 0; i < continuous.size(); i++)
+    {
+        const JsonValue& item = continuous[i];
+
+        BinaryStreamInfo stream;
+        stream.folderName = stripTrailingSeparators(item["folder_name"].getString());
+        stream.sampleRate = (float) item["sample_rate"].getNumber();
+        stream.numChannels = (int) item["num_channels"].getNumber();
+
+        // 0.6 recordings name the stream; 0.5 recordings only the processor
+        stream.name = item["stream_name"].isString() ? item["stream_name"].getString()
+                                                     : item["source_processor_name"].getString();
+
+        if (stream.folderName.empty() || stream.sampleRate <= 0.0f || stream.numChannels <= 0)
+        {
+            error = path + ": continuous stream " + std::to_string(i) + " needs folder_name, sample_rate and num_channels";
+            return false;
+        }
+
+        const JsonValue& channels = item["channels"];
+
+        for (int c = 0; c < stream.numChannels; c++)
+            stream.bitVolts.push_back((float) channels[c]["bit_volts"].getNumber(0.195));
+
+        streams.push_back(stream);
+    }
+
+    return true;
+}
+
+bool BinaryFormat::locateStream(const std::string& input,
+                                int streamIndex,
+                                BinaryStreamInfo& stream,
+                                std::string& datPath,
+                                std::string& error)
+{
+    std::vector<BinaryStreamInfo> streams;
+
+    const bool isDatFile = getName(input) == "continuous.dat";
+
+    // a recording directory holds structure.oebin and continuous/<stream folder>/continuous.dat
+    const std::string recordingDirectory = isDatFile ? getParent(getParent(getParent(input))) : input;
+
+    if (! readStructure(join(recordingDirectory, "structure.oebin"), streams, error))
+        return false;
+
+    if (isDatFile)
+    {
+        const std::string folder = getName(getParent(input));
+
+        auto match = std::find_if(streams.begin(), streams.end(),
+                                  [&folder](const BinaryStreamInfo& s) { return s.folderName == folder; });
+
+        if (match == streams.end())
+        {
+            error = "structure.oebin does not list a stream in " + folder;
+            return false;
+        }
+
+        stream = *match;
+        datPath = input;
+        return true;
+    }
+
+    if (streamIndex < 0 || streamIndex >= (int) streams.size())
+    {
+        error = "the recording has " + std::to_string(streams.size()) + " continuous streams; stream "
+                + std::to_string(streamIndex) + " does not exist";
+        return false;
+    }
+
+    stream = streams[(size_t) streamIndex];
+    datPath = join(join(join(recordingDirectory, "continuous"), stream.folderName), "continuous.dat");
+
+    if (! fileExists(datPath))
+    {
+        error = "could not find " + datPath;
+        return false;
+    }
+
+    return true;
+}
+
+#pragma mark - MappedRecording -
+MappedRecording::MappedRecording()
+    : data(nullptr),
+      size(0),
+      numChannels(0),
+      numSamples(0),
+#ifdef _WIN32
+      fileHandle(INVALID_HANDLE_VALUE),
+      mappingHandle(nullptr)
+#else
+      fileDescriptor(-1)
+#endif
+{
+}
+
+MappedRecording::~MappedRecording()
+{
+    close();
+}
+
+bool MappedRecording::open(const std::string& path, int numChannels_, std::string& error)
+{
+    close();
+
+    if (numChannels_ <= 0)
+    {
+        error = "a recording needs at least one channel";
+        return false;
+    }
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    LARGE_INTEGER fileSize;
+
+    if (fileHandle == INVALID_HANDLE_VALUE || ! GetFileSizeEx(fileHandle, &fileSize))
+    {
+        error = "could not open " + path;
+        close();
+        return false;
+    }
+
+    size = (size_t) fileSize.QuadPart;
+
+    if (size > 0)
+    {
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data = mappingHandle != nullptr
+                   ? static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0))
+                   : nullptr;
+    }
+#else
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+
+    struct stat status;
+
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0)
+    {
+        error = "could not open " + path;
+        close();
+        return false;
+    }
+
+    size = (size_t) status.st_size;
+
+    if (size > 0)
+    {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+        data = mapped != MAP_FAILED ? static_cast<const uint8_t*>(mapped) : nullptr;
+
+        if (data != nullptr)
+            madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (size > 0 && data == nullptr)
+    {
+        error = "could not map " + path;
+        close();
+        return false;
+    }
+
+    numChannels = numChannels_;
+    numSamples = (int64_t) (size / (sizeof(int16_t) * (size_t) numChannels));
+
+    return true;
+}
+
+void MappedRecording::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    if (data != nullptr)
+        munmap(const_cast<uint8_t*>(data), size);
+
+    if (fileDescriptor >= 0)
+        ::close(fileDescriptor);
+
+    fileDescriptor = -1;
+#endif
+
+    data = nullptr;
+    size = 0;
+    numChannels = 0;
+    numSamples = 0;
+}
+
+void MappedRecording::prefetch(int64_t firstSample, int64_t count) const
+{
+    if (data == nullptr)
+        return;
+
+    firstSample = std::max<int64_t>(0, std::min(firstSample, numSamples));
+    count = std::max<int64_t>(0, std::min(count, numSamples - firstSample));
+
+    const size_t rowBytes = sizeof(int16_t) * (size_t) numChannels;
+    const size_t pageSize = 4096;
+
+    // madvise needs a page-aligned start
+    const size_t begin = ((size_t) firstSample * rowBytes) & ~(pageSize - 1);
+    const size_t end = (size_t) (firstSample + count) * rowBytes;
+
+    if (end <= begin)
+        return;
+
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(data + begin);
+    range.NumberOfBytes = end - begin;
+
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(const_cast<uint8_t*>(data + begin), end - begin, MADV_WILLNEED);
+#endif
+}
+
+#pragma mark - deinterleave -
+void GridViewer::deinterleave(const int16_t* interleaved,
+                              int numChannels,
+                              int firstChannel,
+                              int endChannel,
+                              int numSamples,
+                              const float* bitVolts,
+                              float* const* outputs)
+{
+    for (int tile = 0; tile < numSamples; tile += DEINTERLEAVE_TILE)
+    {
+        const int tileEnd = std::min(numSamples, tile + DEINTERLEAVE_TILE);
+
+        for (int channel = firstChannel; channel < endChannel; channel++)
+        {
+            const int16_t* in = interleaved + channel;
+            float* out = outputs[channel];
+            const float scale = bitVolts[channel];
+
+            for (int i = tile; i < tileEnd; i++)
+                out[i] = (float) in[(size_t) i * (size_t) numChannels] * scale;
+        }
+    }
+}
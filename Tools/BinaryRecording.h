@@ -0,0 +1,126 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __BINARYRECORDING_H__
+#define __BINARYRECORDING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GridViewer {
+
+/** One continuous stream of an Open Ephys binary recording, as listed in structure.oebin */
+struct BinaryStreamInfo
+{
+    std::string folderName;     // directory under continuous/, without a trailing slash
+    std::string name;
+    float sampleRate = 0.0f;
+    int numChannels = 0;
+    std::vector<float> bitVolts; // uV per bit of each channel
+};
+
+namespace BinaryFormat
+{
+    /** Reads the continuous streams listed in a structure.oebin file */
+    bool readStructure(const std::string& path, std::vector<BinaryStreamInfo>& streams, std::string& error);
+
+    /**
+     *  Finds the structure.oebin and the continuous.dat of one stream, given
+     *  either a recording directory or a continuous.dat inside one. If the
+     *  input is a continuous.dat, its stream is the one whose folder holds it
+     *  and streamIndex is ignored.
+     */
+    bool locateStream(const std::string& input,
+                      int streamIndex,
+                      BinaryStreamInfo& stream,
+                      std::string& datPath,
+                      std::string& error);
+}
+
+/**
+    Read-only memory map of a continuous.dat file: int16 samples interleaved
+    numChannels at a time. Nothing is copied; pages are read in by the OS as
+    they are touched, and prefetch() lets the next chunk arrive while the
+    current one is processed.
+ */
+class MappedRecording
+{
+public:
+    MappedRecording();
+    ~MappedRecording();
+
+    bool open(const std::string& path, int numChannels, std::string& error);
+    void close();
+
+    int getNumChannels() const { return numChannels; }
+
+    /** Returns the number of complete samples of all channels */
+    int64_t getNumSamples() const { return numSamples; }
+
+    /** Returns the interleaved samples starting at a sample index */
+    const int16_t* getSamples(int64_t firstSample) const
+    {
+        return reinterpret_cast<const int16_t*>(data) + firstSample * numChannels;
+    }
+
+    /** Asks the OS to start reading a range of samples ahead of use */
+    void prefetch(int64_t firstSample, int64_t count) const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    int numChannels;
+    int64_t numSamples;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+
+    MappedRecording(const MappedRecording&) = delete;
+    MappedRecording& operator=(const MappedRecording&) = delete;
+};
+
+/**
+ *  Converts samples [0, numSamples) of channels [firstChannel, endChannel)
+ *  from interleaved int16 to the float arrays outputs[channel], each
+ *  scaled by its channel's uV per bit. The copy walks tiles of a few hundred samples,
+ *  so every interleaved cache line it reads is used for all its channels
+ *  before it is evicted.
+ */
+void deinterleave(const int16_t* interleaved,
+                  int numChannels,
+                  int firstChannel,
+                  int endChannel,
+                  int numSamples,
+                  const float* bitVolts,
+                  float* const* outputs);
+
+}
+
+#endif /* __BINARYRECORDING_H__ */
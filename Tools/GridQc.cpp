@@ -0,0 +1,635 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+/*
+    grid-qc: per-channel array-health summaries for every recording under
+    one or more directories, computed with the plugin's metric engine.
+ */
+
+#include "BinaryRecording.h"
+#include "HeatmapImage.h"
+#include "ImageWriter.h"
+#include "NpyWriter.h"
+
+#include "ActivitySnapshot.h"
+#include "AlignedBuffer.h"
+#include "ColourScaler.h"
+#include "ElectrodeLayout.h"
+#include "FilterBank.h"
+#include "StreamActivity.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GridViewer;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// samples per block handed to the metric engine; with the prefetch, a job's memory is bounded by these
+const int BLOCK_SAMPLES = 1024;
+const size_t PREFETCH_BYTES = 32 * 1024 * 1024;
+
+// per-frame peak-to-peak histogram: 8 buckets per octave from LOWEST_VALUE up, for the median
+const int BUCKETS_PER_OCTAVE = 8;
+const int NUM_BUCKETS = 20 * BUCKETS_PER_OCTAVE + 1;
+const float LOWEST_VALUE = 0.05f; // uV
+
+// bits of the per-channel flags
+const uint8_t DEAD_FLAG = 1;
+const uint8_t SATURATED_FLAG = 2;
+
+const char* USAGE =
+    "usage: grid-qc [options] <directory>... <output directory>\n"
+    "\n"
+    "Finds every structure.oebin under the directories and writes, for each continuous\n"
+    "stream, per-channel maps to <output>/<recording>/<stream>/ and a line to summary.csv.\n"
+    "\n"
+    "  --jobs N             streams processed at once (default: one per core)\n"
+    "  --band B             broadband, spike or lfp (default spike)\n"
+    "  --threshold UV       spike-rate crossing threshold in uV (default -50)\n"
+    "  --mad K              spike-rate threshold of K times each channel's noise instead\n"
+    "  --frame S            seconds per frame the medians are taken over (default 1)\n"
+    "  --dead-rms UV        channels with a lower RMS are flagged dead (default 1)\n"
+    "  --saturation F       channels with more than this fraction of samples at the int16\n"
+    "                       limits are flagged saturated (default 0.001)\n"
+    "  --map FILE           channel map (.csv or .json) for the PNG heatmaps\n"
+    "  --cell N             pixels per electrode in the heatmaps (default 8)\n"
+    "  --scheme S           inferno, viridis, plasma, magma or jet (default inferno)\n";
+
+struct Options
+{
+    std::vector<std::string> roots;
+    std::string output;
+    int numJobs = 0;
+    FilterBand band = FilterBand::SPIKE;
+    float threshold = -50.0f;
+    float multiplier = 0.0f;
+    float frameSeconds = 1.0f;
+    float deadRms = 1.0f;
+    float saturation = 0.001f;
+    std::string channelMap;
+    int cellSize = 8;
+    ColourSchemeId scheme = ColourSchemeId::INFERNO;
+};
+
+/** One continuous stream of one recording */
+struct Job
+{
+    fs::path recording;
+    std::string relativeName;
+    int streamIndex;
+
+    // filled in by the job
+    bool ok = false;
+    std::string error;
+    BinaryStreamInfo info;
+    double duration = 0.0;
+    double bytesRead = 0.0;
+    double seconds = 0.0;
+    int numDead = 0;
+    int numSaturated = 0;
+    float medianPeakToPeak = 0.0f;
+    float medianRms = 0.0f;
+    float meanSpikeRate = 0.0f;
+};
+
+template <typename T>
+bool lookUp(const std::string& name, const char* const* names, int numNames, T& value)
+{
+    for (int i = 0; i < numNames; i++)
+    {
+        if (name == names[i])
+        {
+            value = (T) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parseArguments(int argc, char** argv, Options& options, std::string& error)
+{
+    static const char* const bands[] = { "broadband", "spike", "lfp" };
+    static const char* const schemes[] = { "inferno", "viridis", "plasma", "magma", "jet" };
+
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+
+        if (argument.size() < 3 || argument.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(argument);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            error = argument + " needs a value";
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        bool valid = true;
+
+        if (argument == "--jobs")
+            valid = (options.numJobs = std::atoi(value.c_str())) > 0;
+        else if (argument == "--band")
+            valid = lookUp(value, bands, numFilterBands, options.band);
+        else if (argument == "--threshold")
+            options.threshold = (float) std::atof(value.c_str());
+        else if (argument == "--mad")
+            valid = (options.multiplier = (float) std::atof(value.c_str())) > 0.0f;
+        else if (argument == "--frame")
+            valid = (options.frameSeconds = (float) std::atof(value.c_str())) > 0.0f;
+        else if (argument == "--dead-rms")
+            valid = (options.deadRms = (float) std::atof(value.c_str())) >= 0.0f;
+        else if (argument == "--saturation")
+            valid = (options.saturation = (float) std::atof(value.c_str())) >= 0.0f;
+        else if (argument == "--map")
+            options.channelMap = value;
+        else if (argument == "--cell")
+            valid = (options.cellSize = std::atoi(value.c_str())) > 0;
+        else if (argument == "--scheme")
+            valid = lookUp(value, schemes, 5, options.scheme);
+        else
+        {
+            error = "unknown option " + argument;
+            return false;
+        }
+
+        if (! valid)
+        {
+            error = "invalid value for " + argument + ": " + value;
+            return false;
+        }
+    }
+
+    if (positional.size() < 2)
+    {
+        error = "expected at least one directory and an output directory";
+        return false;
+    }
+
+    options.output = positional.back();
+    options.roots.assign(positional.begin(), positional.end() - 1);
+
+    if (options.numJobs == 0)
+        options.numJobs = (int) std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+/** Finds every recording under the roots, with one job per continuous stream */
+std::vector<Job> findJobs(const Options& options)
+{
+    std::vector<Job> jobs;
+
+    for (const std::string& root : options.roots)
+    {
+        std::error_code error;
+
+        for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error), end;
+             it != end;
+             it.increment(error))
+        {
+            if (error || it->path().filename() != "structure.oebin")
+                continue;
+
+            std::vector<BinaryStreamInfo> streams;
+            std::string readError;
+
+            if (! BinaryFormat::readStructure(it->path().string(), streams, readError))
+            {
+                std::cerr << "grid-qc: skipping " << readError << std::endl;
+                continue;
+            }
+
+            const fs::path recording = it->path().parent_path();
+            const fs::path relative = recording.lexically_relative(fs::path(root).parent_path());
+
+            for (int s = 0; s < (int) streams.size(); s++)
+            {
+                Job job;
+                job.recording = recording;
+                job.relativeName = (relative / streams[(size_t) s].folderName).generic_string();
+                job.streamIndex = s;
+                jobs.push_back(job);
+            }
+        }
+    }
+
+    return jobs;
+}
+
+/** Streaming median of positive values per channel, from a log-spaced histogram */
+class MedianHistogram
+{
+public:
+    explicit MedianHistogram(int numChannels_)
+        : numChannels(numChannels_),
+          counts((size_t) numChannels_ * NUM_BUCKETS, 0)
+    {
+    }
+
+    void add(const float* values)
+    {
+        for (int c = 0; c < numChannels; c++)
+            counts[(size_t) c * NUM_BUCKETS + (size_t) getBucket(values[c])]++;
+    }
+
+    float getMedian(int channel) const
+    {
+        const uint32_t* bucket = counts.data() + (size_t) channel * NUM_BUCKETS;
+
+        uint64_t total = 0;
+
+        for (int b = 0; b < NUM_BUCKETS; b++)
+            total += bucket[b];
+
+        if (total == 0)
+            return 0.0f;
+
+        const double half = 0.5 * (double) total;
+        double below = 0.0;
+
+        for (int b = 0; b < NUM_BUCKETS; b++)
+        {
+            if (below + bucket[b] >= half)
+            {
+                // geometric interpolation inside the bucket; the bottom one starts at 0
+                const double fraction = (half - below) / (double) std::max(bucket[b], 1u);
+                const double upper = getLowerBound(b + 1);
+
+                if (b == 0)
+                    return (float) (fraction * upper);
+
+                const double lower = getLowerBound(b);
+                return (float) (lower * std::pow(upper / lower, fraction));
+            }
+
+            below += bucket[b];
+        }
+
+        return (float) getLowerBound(NUM_BUCKETS);
+    }
+
+private:
+    static int getBucket(float value)
+    {
+        if (! (value >= LOWEST_VALUE))
+            return 0;
+
+        const int bucket = 1 + (int) (std::log2(value / LOWEST_VALUE) * BUCKETS_PER_OCTAVE);
+        return std::min(bucket, NUM_BUCKETS - 1);
+    }
+
+    static double getLowerBound(int bucket)
+    {
+        return bucket == 0 ? 0.0 : LOWEST_VALUE * std::exp2((double) (bucket - 1) / BUCKETS_PER_OCTAVE);
+    }
+
+    const int numChannels;
+    std::vector<uint32_t> counts;
+};
+
+/** Deinterleaves one block like grid-render, counting samples at the int16 limits on the way */
+void deinterleaveCountingRails(const int16_t* interleaved,
+                               int numChannels,
+                               int numSamples,
+                               const float* bitVolts,
+                               float* const* outputs,
+                               uint64_t* railCounts)
+{
+    deinterleave(interleaved, numChannels, 0, numChannels, numSamples, bitVolts, outputs);
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        const int16_t* row = interleaved + (size_t) i * (size_t) numChannels;
+
+        for (int c = 0; c < numChannels; c++)
+            railCounts[c] += (row[c] == INT16_MAX) | (row[c] == INT16_MIN);
+    }
+}
+
+float getMedian(std::vector<float> values)
+{
+    if (values.empty())
+        return 0.0f;
+
+    auto middle = values.begin() + (ptrdiff_t) (values.size() / 2);
+    std::nth_element(values.begin(), middle, values.end());
+
+    return *middle;
+}
+
+bool writeHeatmap(const std::string& path,
+                  const ElectrodeLayout& layout,
+                  const Options& options,
+                  const std::vector<float>& values,
+                  bool scaleToPercentiles,
+                  float minimum,
+                  float maximum,
+                  std::string& error)
+{
+    ColourScaler scaler;
+
+    if (scaleToPercentiles)
+    {
+        scaler.setMode(ColourScaling::PERCENTILE);
+        scaler.process(values.data(), (int) values.size(), minimum, maximum, 1);
+
+        minimum = scaler.getMinimum();
+        maximum = scaler.getMaximum();
+    }
+
+    HeatmapImage image(layout, options.cellSize);
+    image.draw(values.data(), (int) values.size(), minimum, maximum, options.scheme);
+
+    std::vector<uint8_t> png;
+    ImageWriter::encodePng(image.getPixels(), image.getWidth(), image.getHeight(), png);
+
+    return ImageWriter::writeFile(path, png, error);
+}
+
+void runJob(Job& job, const Options& options, const std::vector<ChannelMapEntry>& channelMap)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+
+    std::string datPath;
+    MappedRecording recording;
+
+    if (! BinaryFormat::locateStream(job.recording.string(), job.streamIndex, job.info, datPath, job.error)
+        || ! recording.open(datPath, job.info.numChannels, job.error))
+        return;
+
+    const int numChannels = job.info.numChannels;
+    const int interval = std::max(1, (int) (job.info.sampleRate * options.frameSeconds));
+
+    // frames start once the filters have settled on the start of the recording
+    const int64_t settlingSamples = std::min<int64_t>(FilterBank::getSettlingSamples(options.band, job.info.sampleRate),
+                                                      recording.getNumSamples());
+    const int64_t numFrames = (recording.getNumSamples() - settlingSamples) / interval;
+
+    if (numFrames == 0)
+    {
+        job.error = "shorter than the filters' settling time and one frame";
+        return;
+    }
+
+    std::vector<int> channels((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        channels[(size_t) c] = c;
+
+    StreamActivity stream(0, numChannels, job.info.sampleRate, job.info.sampleRate / (float) interval,
+                          ChannelSpan::fromBufferChannels(channels));
+    stream.setFilterBand(options.band);
+    stream.setThreshold(options.threshold);
+    stream.setThresholdMultiplier(options.multiplier);
+
+    AlignedBuffer<float> block((size_t) numChannels * BLOCK_SAMPLES);
+    std::vector<float*> outputs((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        outputs[(size_t) c] = block.get() + (size_t) c * BLOCK_SAMPLES;
+
+    std::vector<uint64_t> railCounts((size_t) numChannels, 0);
+    std::vector<double> sumOfSquaredRms((size_t) numChannels, 0.0);
+    std::vector<double> sumOfRates((size_t) numChannels, 0.0);
+    MedianHistogram peakToPeak(numChannels);
+
+    const int64_t prefetchSamples = std::max<int64_t>(BLOCK_SAMPLES, (int64_t) (PREFETCH_BYTES / (sizeof(int16_t) * (size_t) numChannels)));
+    int64_t prefetchedUntil = 0;
+
+    // reads, counts and reduces one block; a block never straddles a frame
+    auto processBlock = [&] (int64_t firstSample, int numSamples)
+    {
+        if (firstSample + numSamples > prefetchedUntil - prefetchSamples / 2)
+        {
+            recording.prefetch(prefetchedUntil, prefetchSamples);
+            prefetchedUntil += prefetchSamples;
+        }
+
+        deinterleaveCountingRails(recording.getSamples(firstSample), numChannels, numSamples,
+                                  job.info.bitVolts.data(), outputs.data(), railCounts.data());
+
+        if (firstSample == 0)
+            stream.primeFilters(outputs.data(), numSamples);
+
+        stream.processBlock(outputs.data(), numSamples, firstSample);
+    };
+
+    // primed on the first block, the filters start close to settled; the rest of the settling time is not measured
+    for (int64_t firstSample = 0; firstSample < settlingSamples; firstSample += BLOCK_SAMPLES)
+        processBlock(firstSample, (int) std::min<int64_t>(BLOCK_SAMPLES, settlingSamples - firstSample));
+
+    stream.discardInterval();
+
+    for (int64_t frame = 0; frame < numFrames; frame++)
+    {
+        for (int offset = 0; offset < interval; offset += BLOCK_SAMPLES)
+            processBlock(settlingSamples + frame * interval + offset, std::min(BLOCK_SAMPLES, interval - offset));
+
+        const ActivitySnapshot& snapshot = stream.getLatestFrame();
+        const float* rms = snapshot.getValues(ActivityMetric::RMS);
+        const float* rate = snapshot.getValues(ActivityMetric::CROSSING_RATE);
+
+        peakToPeak.add(snapshot.getValues(ActivityMetric::PEAK_TO_PEAK));
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            sumOfSquaredRms[(size_t) c] += (double) rms[c] * rms[c];
+            sumOfRates[(size_t) c] += rate[c];
+        }
+    }
+
+    std::vector<float> medianPeakToPeak((size_t) numChannels);
+    std::vector<float> rms((size_t) numChannels);
+    std::vector<float> spikeRate((size_t) numChannels);
+    std::vector<uint8_t> flags((size_t) numChannels);
+    std::vector<float> flagValues((size_t) numChannels);
+
+    const double numSamples = (double) (settlingSamples + numFrames * interval);
+
+    for (int c = 0; c < numChannels; c++)
+    {
+        const size_t i = (size_t) c;
+
+        medianPeakToPeak[i] = peakToPeak.getMedian(c);
+        rms[i] = (float) std::sqrt(sumOfSquaredRms[i] / (double) numFrames);
+        spikeRate[i] = (float) (sumOfRates[i] / (double) numFrames);
+
+        flags[i] = (uint8_t) ((rms[i] < options.deadRms || medianPeakToPeak[i] == 0.0f ? DEAD_FLAG : 0)
+                              | ((double) railCounts[i] > options.saturation * numSamples ? SATURATED_FLAG : 0));
+
+        flagValues[i] = (float) flags[i];
+        job.numDead += (flags[i] & DEAD_FLAG) != 0;
+        job.numSaturated += (flags[i] & SATURATED_FLAG) != 0;
+    }
+
+    const fs::path directory = fs::path(options.output) / job.relativeName;
+    std::error_code createError;
+    fs::create_directories(directory, createError);
+
+    if (createError)
+    {
+        job.error = "could not create " + directory.string();
+        return;
+    }
+
+    const ElectrodeLayout layout = channelMap.empty() ? ElectrodeLayout(numChannels)
+                                                      : ElectrodeLayout(numChannels, channelMap);
+
+    const bool written =
+        NpyWriter::write((directory / "median_p2p.npy").string(), medianPeakToPeak.data(), medianPeakToPeak.size(), job.error)
+        && NpyWriter::write((directory / "rms.npy").string(), rms.data(), rms.size(), job.error)
+        && NpyWriter::write((directory / "spike_rate.npy").string(), spikeRate.data(), spikeRate.size(), job.error)
+        && NpyWriter::write((directory / "flags.npy").string(), flags.data(), flags.size(), job.error)
+        && writeHeatmap((directory / "median_p2p.png").string(), layout, options, medianPeakToPeak, true, 0.0f, 1.0f, job.error)
+        && writeHeatmap((directory / "rms.png").string(), layout, options, rms, true, 0.0f, 1.0f, job.error)
+        && writeHeatmap((directory / "spike_rate.png").string(), layout, options, spikeRate, true, 0.0f, 1.0f, job.error)
+        && writeHeatmap((directory / "flags.png").string(), layout, options, flagValues, false, 0.0f, 4.0f, job.error);
+
+    if (! written)
+        return;
+
+    job.duration = numSamples / job.info.sampleRate;
+    job.bytesRead = numSamples * (double) numChannels * sizeof(int16_t);
+    job.medianPeakToPeak = getMedian(medianPeakToPeak);
+    job.medianRms = getMedian(rms);
+    job.meanSpikeRate = spikeRate.empty() ? 0.0f : (float) (std::accumulate(spikeRate.begin(), spikeRate.end(), 0.0) / (double) spikeRate.size());
+    job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    job.ok = true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string error;
+
+    if (! parseArguments(argc, argv, options, error))
+    {
+        std::cerr << "grid-qc: " << error << "\n\n" << USAGE;
+        return 2;
+    }
+
+    std::vector<ChannelMapEntry> channelMap;
+
+    if (! options.channelMap.empty() && ! ChannelMap::readFile(options.channelMap, channelMap, error))
+    {
+        std::cerr << "grid-qc: " << options.channelMap << ": " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<Job> jobs = findJobs(options);
+
+    if (jobs.empty())
+    {
+        std::cerr << "grid-qc: no recordings found" << std::endl;
+        return 1;
+    }
+
+    std::error_code createError;
+    fs::create_directories(options.output, createError);
+
+    const int numThreads = std::min(options.numJobs, (int) jobs.size());
+
+    std::cerr << "grid-qc: " << jobs.size() << " streams, " << numThreads << " at a time" << std::endl;
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // each thread takes the next job until none are left; one stream is processed by one thread
+    std::atomic<size_t> nextJob(0);
+    std::mutex reportLock;
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&]
+        {
+            for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+            {
+                runJob(jobs[i], options, channelMap);
+
+                std::lock_guard<std::mutex> guard(reportLock);
+
+                if (jobs[i].ok)
+                    std::cerr << "  " << jobs[i].relativeName << ": " << jobs[i].numDead << " dead, "
+                              << jobs[i].numSaturated << " saturated of " << jobs[i].info.numChannels
+                              << " channels (" << jobs[i].bytesRead / 1.0e6 / std::max(jobs[i].seconds, 1.0e-6) << " MB/s)" << std::endl;
+                else
+                    std::cerr << "  " << jobs[i].relativeName << ": " << jobs[i].error << std::endl;
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    std::ofstream summary(fs::path(options.output) / "summary.csv");
+    summary << "stream,channels,sample_rate,duration_s,dead,saturated,median_p2p_uv,median_rms_uv,mean_spike_rate_hz,error\n";
+
+    double totalBytes = 0.0;
+    int numFailed = 0;
+
+    for (const Job& job : jobs)
+    {
+        summary << '"' << job.relativeName << "\"," << job.info.numChannels << ',' << job.info.sampleRate << ','
+                << job.duration << ',' << job.numDead << ',' << job.numSaturated << ',' << job.medianPeakToPeak << ','
+                << job.medianRms << ',' << job.meanSpikeRate << ",\"" << job.error << "\"\n";
+
+        totalBytes += job.bytesRead;
+        numFailed += ! job.ok;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    std::cerr << "grid-qc: " << totalBytes / 1.0e9 << " GB in " << elapsed << " s ("
+              << totalBytes / 1.0e6 / std::max(elapsed, 1.0e-6) << " MB/s)";
+
+    if (numFailed > 0)
+        std::cerr << ", " << numFailed << " streams failed";
+
+    std::cerr << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
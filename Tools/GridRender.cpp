@@ -0,0 +1,433 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+/*
+    grid-render: renders a heatmap movie of one stream of an Open Ephys
+    binary recording, with the plugin's filters, reduction and colour maps
+    but without the GUI.
+ */
+
+#include "BinaryRecording.h"
+#include "HeatmapImage.h"
+#include "ImageWriter.h"
+
+#include "ActivitySnapshot.h"
+#include "ColourScaler.h"
+#include "CpuFeatures.h"
+#include "ElectrodeLayout.h"
+#include "FilterBank.h"
+#include "ReductionKernels.h"
+#include "StreamActivity.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GridViewer;
+
+namespace {
+
+// the recording is prefetched this far ahead of the frame being reduced
+const size_t PREFETCH_BYTES = 64 * 1024 * 1024;
+
+// channels per deinterleaving task; the same granularity as the reduction
+const int DEINTERLEAVE_CHUNK = 32;
+
+const char* USAGE =
+    "usage: grid-render [options] <recording directory | continuous.dat> <output>\n"
+    "\n"
+    "  output               movie.y4m, movie.rgb, frames/heat_%06d.png, or - for standard output\n"
+    "  --format F           y4m, rgb or png (default: from the output's extension)\n"
+    "  --stream N           continuous stream in structure.oebin (default 0)\n"
+    "  --metric M           p2p, rms, mean, line-length or spike-rate (default p2p)\n"
+    "  --band B             broadband, spike or lfp (default broadband)\n"
+    "  --threshold UV       spike-rate crossing threshold in uV (default -50)\n"
+    "  --mad K              spike-rate threshold of K times each channel's noise instead\n"
+    "  --fps N              frames per second of recording (default 50)\n"
+    "  --scale S            fixed, auto or baseline (default fixed)\n"
+    "  --range MIN MAX      colour range for fixed scaling (default: the metric's)\n"
+    "  --scheme S           inferno, viridis, plasma, magma or jet (default inferno)\n"
+    "  --map FILE           channel map (.csv or .json)\n"
+    "  --cell N             pixels per electrode (default 8)\n"
+    "  --start S            first second of the recording to render (default 0)\n"
+    "  --duration S         seconds to render (default: to the end)\n"
+    "  --threads N          worker threads (default: one per core)\n";
+
+struct Options
+{
+    std::string input;
+    std::string output;
+    bool hasFormat = false;
+    FrameFormat format = FrameFormat::Y4M;
+    int stream = 0;
+    ActivityMetric metric = ActivityMetric::PEAK_TO_PEAK;
+    FilterBand band = FilterBand::BROADBAND;
+    float threshold = -50.0f;
+    float multiplier = 0.0f;
+    float frameRate = 50.0f;
+    ColourScaling scaling = ColourScaling::FIXED;
+    bool hasRange = false;
+    float minimum = 0.0f;
+    float maximum = 1.0f;
+    ColourSchemeId scheme = ColourSchemeId::INFERNO;
+    std::string channelMap;
+    int cellSize = 8;
+    double start = 0.0;
+    double duration = -1.0;
+    int numThreads = -1;
+};
+
+template <typename T>
+bool lookUp(const std::string& name, const char* const* names, int numNames, T& value)
+{
+    for (int i = 0; i < numNames; i++)
+    {
+        if (name == names[i])
+        {
+            value = (T) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool parseArguments(int argc, char** argv, Options& options, std::string& error)
+{
+    static const char* const metrics[] = { "p2p", "rms", "mean", "line-length", "spike-rate" };
+    static const char* const bands[] = { "broadband", "spike", "lfp" };
+    static const char* const scalings[] = { "fixed", "auto", "baseline" };
+    static const char* const schemes[] = { "inferno", "viridis", "plasma", "magma", "jet" };
+    static const char* const formats[] = { "rgb", "y4m", "png" };
+
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+
+        if (argument.size() < 3 || argument.compare(0, 2, "--") != 0)
+        {
+            positional.push_back(argument);
+            continue;
+        }
+
+        const int numValues = argument == "--range" ? 2 : 1;
+
+        if (i + numValues >= argc)
+        {
+            error = argument + " needs a value";
+            return false;
+        }
+
+        const std::string value = argv[++i];
+        bool valid = true;
+
+        if (argument == "--format")
+            valid = options.hasFormat = lookUp(value, formats, 3, options.format);
+        else if (argument == "--stream")
+            options.stream = std::atoi(value.c_str());
+        else if (argument == "--metric")
+            valid = lookUp(value, metrics, numActivityMetrics, options.metric);
+        else if (argument == "--band")
+            valid = lookUp(value, bands, numFilterBands, options.band);
+        else if (argument == "--threshold")
+            options.threshold = (float) std::atof(value.c_str());
+        else if (argument == "--mad")
+            valid = (options.multiplier = (float) std::atof(value.c_str())) > 0.0f;
+        else if (argument == "--fps")
+            valid = (options.frameRate = (float) std::atof(value.c_str())) > 0.0f;
+        else if (argument == "--scale")
+            valid = lookUp(value, scalings, 3, options.scaling);
+        else if (argument == "--range")
+        {
+            options.hasRange = true;
+            options.minimum = (float) std::atof(value.c_str());
+            options.maximum = (float) std::atof(argv[++i]);
+            valid = options.maximum > options.minimum;
+        }
+        else if (argument == "--scheme")
+            valid = lookUp(value, schemes, 5, options.scheme);
+        else if (argument == "--map")
+            options.channelMap = value;
+        else if (argument == "--cell")
+            valid = (options.cellSize = std::atoi(value.c_str())) > 0;
+        else if (argument == "--start")
+            valid = (options.start = std::atof(value.c_str())) >= 0.0;
+        else if (argument == "--duration")
+            valid = (options.duration = std::atof(value.c_str())) > 0.0;
+        else if (argument == "--threads")
+            valid = (options.numThreads = std::atoi(value.c_str())) >= 0;
+        else
+        {
+            error = "unknown option " + argument;
+            return false;
+        }
+
+        if (! valid)
+        {
+            error = "invalid value for " + argument + ": " + value;
+            return false;
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        error = "expected a recording and an output";
+        return false;
+    }
+
+    options.input = positional[0];
+    options.output = positional[1];
+
+    if (! options.hasFormat && ! FrameSequenceWriter::getFormatForPath(options.output, options.format))
+    {
+        if (options.output != "-")
+        {
+            error = "cannot tell the format of " + options.output + "; use --format";
+            return false;
+        }
+
+        options.format = FrameFormat::Y4M;
+    }
+
+    return true;
+}
+
+/** Everything the deinterleaving tasks of one frame read */
+struct DeinterleaveJob
+{
+    const int16_t* interleaved;
+    int numChannels;
+    int numSamples;
+    const float* bitVolts;
+    float* const* outputs;
+};
+
+void deinterleaveChannels(void* context, int begin, int end)
+{
+    const DeinterleaveJob& job = *static_cast<const DeinterleaveJob*>(context);
+
+    deinterleave(job.interleaved, job.numChannels, begin, end, job.numSamples, job.bitVolts, job.outputs);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string error;
+
+    if (! parseArguments(argc, argv, options, error))
+    {
+        std::cerr << "grid-render: " << error << "\n\n" << USAGE;
+        return 2;
+    }
+
+    BinaryStreamInfo info;
+    std::string datPath;
+    MappedRecording recording;
+
+    if (! BinaryFormat::locateStream(options.input, options.stream, info, datPath, error)
+        || ! recording.open(datPath, info.numChannels, error))
+    {
+        std::cerr << "grid-render: " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<ChannelMapEntry> channelMap;
+
+    if (! options.channelMap.empty() && ! ChannelMap::readFile(options.channelMap, channelMap, error))
+    {
+        std::cerr << "grid-render: " << options.channelMap << ": " << error << std::endl;
+        return 1;
+    }
+
+    const int numChannels = info.numChannels;
+    const int interval = (int) (info.sampleRate / options.frameRate);
+
+    if (interval < 1)
+    {
+        std::cerr << "grid-render: --fps must be below the sample rate" << std::endl;
+        return 2;
+    }
+
+    const int64_t firstFrame = (int64_t) (options.start * info.sampleRate) / interval;
+    int64_t endFrame = recording.getNumSamples() / interval;
+
+    if (options.duration > 0.0)
+        endFrame = std::min(endFrame, firstFrame + (int64_t) std::ceil(options.duration * options.frameRate));
+
+    if (endFrame <= firstFrame)
+    {
+        std::cerr << "grid-render: nothing to render in " << datPath << std::endl;
+        return 1;
+    }
+
+    const ElectrodeLayout layout = channelMap.empty() ? ElectrodeLayout(numChannels)
+                                                      : ElectrodeLayout(numChannels, channelMap);
+
+    HeatmapImage image(layout, options.cellSize);
+    FrameSequenceWriter writer(options.format, options.output, image.getWidth(), image.getHeight(), options.frameRate);
+
+    if (! writer.open(error))
+    {
+        std::cerr << "grid-render: " << error << std::endl;
+        return 1;
+    }
+
+    const int numThreads = options.numThreads >= 0 ? options.numThreads
+                                                   : (int) std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    std::unique_ptr<WorkerPool> pool;
+
+    if (numThreads > 0)
+        pool = std::make_unique<WorkerPool>(numThreads);
+
+    std::vector<int> channels((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        channels[(size_t) c] = c;
+
+    StreamActivity stream(0, numChannels, info.sampleRate, options.frameRate, ChannelSpan::fromBufferChannels(channels));
+    stream.setFilterBand(options.band);
+    stream.setThreshold(options.threshold);
+    stream.setThresholdMultiplier(options.multiplier);
+
+    ColourScaler scaler;
+    scaler.setMode(options.scaling);
+    scaler.setUpdateRate(options.frameRate);
+
+    const MetricRange& range = getMetricRange(options.metric);
+    const float fixedMinimum = options.hasRange ? options.minimum : range.minimum;
+    const float fixedMaximum = options.hasRange ? options.maximum : range.maximum;
+
+    // one frame's samples, channel-major, refilled from the map for every frame
+    AlignedBuffer<float> samples((size_t) numChannels * (size_t) interval);
+    std::vector<float*> outputs((size_t) numChannels);
+
+    for (int c = 0; c < numChannels; c++)
+        outputs[(size_t) c] = samples.get() + (size_t) c * (size_t) interval;
+
+    DeinterleaveJob job { nullptr, numChannels, interval, info.bitVolts.data(), outputs.data() };
+
+    const int64_t prefetchSamples = std::max<int64_t>(interval, (int64_t) (PREFETCH_BYTES / (sizeof(int16_t) * (size_t) numChannels)));
+    int64_t prefetchedUntil = firstFrame * interval;
+
+    std::cerr << "grid-render: " << info.name << ", " << numChannels << " channels at " << info.sampleRate << " Hz, "
+              << (endFrame - firstFrame) << " frames of " << image.getWidth() << "x" << image.getHeight()
+              << " (" << CpuFeatures::getSimdLevelName(ReductionKernels::getActiveSimdLevel()) << ", "
+              << numThreads << " worker threads)" << std::endl;
+
+    const auto startTime = std::chrono::steady_clock::now();
+    auto lastReport = startTime;
+
+    // the filters settle on the samples before --start, primed on the first frame of them
+    const int64_t settleFrom = std::max<int64_t>(0, firstFrame * interval - FilterBank::getSettlingSamples(options.band, info.sampleRate));
+
+    for (int64_t firstSample = settleFrom; firstSample < firstFrame * interval; firstSample += interval)
+    {
+        job.interleaved = recording.getSamples(firstSample);
+        job.numSamples = (int) std::min<int64_t>(interval, firstFrame * interval - firstSample);
+
+        if (pool != nullptr)
+            pool->run(deinterleaveChannels, &job, numChannels, DEINTERLEAVE_CHUNK);
+        else
+            deinterleaveChannels(&job, 0, numChannels);
+
+        if (firstSample == settleFrom)
+            stream.primeFilters(outputs.data(), job.numSamples);
+
+        stream.processBlock(outputs.data(), job.numSamples, firstSample, pool.get());
+    }
+
+    job.numSamples = interval;
+    stream.discardInterval();
+
+    for (int64_t frame = firstFrame; frame < endFrame; frame++)
+    {
+        const int64_t firstSample = frame * interval;
+
+        // keep the OS reading a chunk ahead, so the reduction rarely waits on a page fault
+        if (firstSample + interval > prefetchedUntil - prefetchSamples / 2)
+        {
+            recording.prefetch(prefetchedUntil, prefetchSamples);
+            prefetchedUntil += prefetchSamples;
+        }
+
+        job.interleaved = recording.getSamples(firstSample);
+
+        if (pool != nullptr)
+            pool->run(deinterleaveChannels, &job, numChannels, DEINTERLEAVE_CHUNK);
+        else
+            deinterleaveChannels(&job, 0, numChannels);
+
+        // at the very start of the recording there is nothing to settle on but the first frame
+        if (firstSample == 0)
+            stream.primeFilters(outputs.data(), interval);
+
+        stream.processBlock(outputs.data(), interval, firstSample, pool.get());
+
+        const ActivitySnapshot& snapshot = stream.getLatestFrame();
+        const float* values = scaler.process(snapshot.getValues(options.metric), numChannels,
+                                             fixedMinimum, fixedMaximum, snapshot.frameCounter);
+
+        image.draw(values, numChannels, scaler.getMinimum(), scaler.getMaximum(), options.scheme);
+
+        if (! writer.write(image.getPixels(), error))
+        {
+            std::cerr << "grid-render: " << error << std::endl;
+            return 1;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+
+        if (now - lastReport > std::chrono::seconds(2) || frame + 1 == endFrame)
+        {
+            const double elapsed = std::chrono::duration<double>(now - startTime).count();
+            const double rendered = (double) (frame + 1 - firstFrame) / options.frameRate;
+
+            std::cerr << "  " << (frame + 1 - firstFrame) << " / " << (endFrame - firstFrame) << " frames, "
+                      << rendered / std::max(elapsed, 1.0e-6) << "x real time" << std::endl;
+
+            lastReport = now;
+        }
+    }
+
+    if (! writer.close(error))
+    {
+        std::cerr << "grid-render: " << error << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
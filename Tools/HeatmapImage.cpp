@@ -0,0 +1,90 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "HeatmapImage.h"
+
+#include <algorithm>
+
+using namespace GridViewer;
+
+namespace {
+    const uint32_t EMPTY_COLOUR = 0xff000000;
+    const uint32_t DISABLED_COLOUR = 0xff808080;
+}
+
+HeatmapImage::HeatmapImage(const ElectrodeLayout& layout_, int cellSize_)
+    : layout(layout_),
+      cellSize(std::max(cellSize_, 1)),
+      width(layout_.getNumColumns() * std::max(cellSize_, 1)),
+      height(layout_.getNumRows() * std::max(cellSize_, 1)),
+      electrodeValues((size_t) layout_.getNumElectrodes()),
+      colourIndices((size_t) layout_.getNumElectrodes()),
+      pixels((size_t) width * (size_t) height * 3)
+{
+    const int* cellChannels = layout.getCellChannels();
+
+    // only electrode cells change between frames
+    for (int cell = 0; cell < layout.getNumColumns() * layout.getNumRows(); cell++)
+        fillCell(cell, cellChannels[cell] == ElectrodeLayout::disabledCell ? DISABLED_COLOUR : EMPTY_COLOUR);
+}
+
+void HeatmapImage::draw(const float* values, int numValues, float minimum, float maximum, ColourSchemeId colourScheme)
+{
+    const int numElectrodes = layout.getNumElectrodes();
+    const int* channels = layout.getElectrodeChannels();
+    const int* cells = layout.getElectrodeCells();
+
+    for (int i = 0; i < numElectrodes; i++)
+        electrodeValues[(size_t) i] = channels[i] < numValues ? values[channels[i]] : 0.0f;
+
+    const float scale = 1.0f / (maximum - minimum);
+    ColourMaps::mapIndices(electrodeValues.data(), colourIndices.data(), numElectrodes, scale, -minimum * scale);
+
+    const uint32_t* table = ColourMaps::getTable(colourScheme);
+
+    for (int i = 0; i < numElectrodes; i++)
+        fillCell(cells[i], table[colourIndices[(size_t) i]]);
+}
+
+void HeatmapImage::fillCell(int cell, uint32_t argb)
+{
+    const int column = cell % layout.getNumColumns();
+    const int row = cell / layout.getNumColumns();
+
+    const uint8_t r = (uint8_t) (argb >> 16);
+    const uint8_t g = (uint8_t) (argb >> 8);
+    const uint8_t b = (uint8_t) argb;
+
+    for (int y = row * cellSize; y < (row + 1) * cellSize; y++)
+    {
+        uint8_t* p = pixels.data() + ((size_t) y * (size_t) width + (size_t) (column * cellSize)) * 3;
+
+        for (int x = 0; x < cellSize; x++, p += 3)
+        {
+            p[0] = r;
+            p[1] = g;
+            p[2] = b;
+        }
+    }
+}
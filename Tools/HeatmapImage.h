@@ -0,0 +1,70 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __HEATMAPIMAGE_H__
+#define __HEATMAPIMAGE_H__
+
+#include "ColourMaps.h"
+#include "ElectrodeLayout.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace GridViewer {
+
+/**
+    An electrode layout drawn as an RGB image with square cells, coloured
+    with the same tables and index mapping as the canvas. Cells without a
+    channel are black, and channels disabled in a channel map are grey.
+ */
+class HeatmapImage
+{
+public:
+    HeatmapImage(const ElectrodeLayout& layout, int cellSize);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    /** Colours every electrode by its value, minimum to maximum spread over the scheme */
+    void draw(const float* values, int numValues, float minimum, float maximum, ColourSchemeId colourScheme);
+
+    /** Returns the RGB pixels, rows top to bottom */
+    const uint8_t* getPixels() const { return pixels.data(); }
+
+private:
+    const ElectrodeLayout& layout;
+    const int cellSize;
+    const int width;
+    const int height;
+
+    std::vector<float> electrodeValues;
+    std::vector<uint8_t> colourIndices;
+    std::vector<uint8_t> pixels;
+
+    void fillCell(int cell, uint32_t argb);
+};
+
+}
+
+#endif /* __HEATMAPIMAGE_H__ */
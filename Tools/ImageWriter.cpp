@@ -0,0 +1,492 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+ #include <fcntl.h>
+ #include <io.h>
+#endif
+
+using namespace GridViewer;
+
+#pragma mark - PNG encoding -
+namespace {
+
+const int WINDOW_SIZE = 32768;
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+const int MAX_CHAIN = 16; // candidates tried per position; heatmaps match on the first or second
+const int HASH_BITS = 15;
+
+const int LENGTH_BASES[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int LENGTH_EXTRA_BITS[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+const int DISTANCE_BASES[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                 8193, 12289, 16385, 24577 };
+const int DISTANCE_EXTRA_BITS[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/** Deflate bit stream: values least significant bit first, Huffman codes most significant bit first */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out_) : out(out_), pending(0), numPending(0) { }
+
+    void put(uint32_t value, int numBits)
+    {
+        pending |= (uint64_t) value << numPending;
+        numPending += numBits;
+
+        while (numPending >= 8)
+        {
+            out.push_back((uint8_t) pending);
+            pending >>= 8;
+            numPending -= 8;
+        }
+    }
+
+    void putCode(uint32_t code, int numBits)
+    {
+        uint32_t reversed = 0;
+
+        for (int i = 0; i < numBits; i++)
+            reversed |= ((code >> i) & 1u) << (numBits - 1 - i);
+
+        put(reversed, numBits);
+    }
+
+    void flush()
+    {
+        if (numPending > 0)
+            out.push_back((uint8_t) pending);
+
+        pending = 0;
+        numPending = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t pending;
+    int numPending;
+};
+
+/** Writes a literal/length symbol with the fixed Huffman code of RFC 1951 section 3.2.6 */
+void putSymbol(BitWriter& bits, int symbol)
+{
+    if (symbol < 144)
+        bits.putCode(0x30u + (uint32_t) symbol, 8);
+    else if (symbol < 256)
+        bits.putCode(0x190u + (uint32_t) (symbol - 144), 9);
+    else if (symbol < 280)
+        bits.putCode((uint32_t) (symbol - 256), 7);
+    else
+        bits.putCode(0xc0u + (uint32_t) (symbol - 280), 8);
+}
+
+void putMatch(BitWriter& bits, int length, int distance)
+{
+    int lengthCode = 28;
+
+    while (LENGTH_BASES[lengthCode] > length)
+        lengthCode--;
+
+    putSymbol(bits, 257 + lengthCode);
+    bits.put((uint32_t) (length - LENGTH_BASES[lengthCode]), LENGTH_EXTRA_BITS[lengthCode]);
+
+    int distanceCode = 29;
+
+    while (DISTANCE_BASES[distanceCode] > distance)
+        distanceCode--;
+
+    bits.putCode((uint32_t) distanceCode, 5);
+    bits.put((uint32_t) (distance - DISTANCE_BASES[distanceCode]), DISTANCE_EXTRA_BITS[distanceCode]);
+}
+
+inline uint32_t hashAt(const uint8_t* p)
+{
+    const uint32_t key = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16);
+    return (key * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/** Compresses data as a zlib stream holding one fixed-code deflate block */
+void deflateFixed(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+    out.push_back(0x78); // deflate, 32K window
+    out.push_back(0x01);
+
+    BitWriter bits(out);
+    bits.put(1, 1); // final block
+    bits.put(1, 2); // fixed codes
+
+    const uint8_t* input = data.data();
+    const int size = (int) data.size();
+
+    std::vector<int> head((size_t) 1 << HASH_BITS, -1);
+    std::vector<int> previous((size_t) WINDOW_SIZE, -1);
+
+    auto insert = [&](int position)
+    {
+        const uint32_t hash = hashAt(input + position);
+        previous[(size_t) (position & (WINDOW_SIZE - 1))] = head[hash];
+        head[hash] = position;
+    };
+
+    int position = 0;
+
+    while (position < size)
+    {
+        int bestLength = 0;
+        int bestDistance = 0;
+
+        if (position + MIN_MATCH <= size)
+        {
+            const int maxLength = std::min(MAX_MATCH, size - position);
+            int candidate = head[hashAt(input + position)];
+
+            for (int chain = 0; chain < MAX_CHAIN && candidate >= 0 && position - candidate <= WINDOW_SIZE; chain++)
+            {
+                int length = 0;
+
+                while (length < maxLength && input[candidate + length] == input[position + length])
+                    length++;
+
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = position - candidate;
+
+                    if (length == maxLength)
+                        break;
+                }
+
+                candidate = previous[(size_t) (candidate & (WINDOW_SIZE - 1))];
+            }
+        }
+
+        if (bestLength >= MIN_MATCH)
+        {
+            putMatch(bits, bestLength, bestDistance);
+
+            for (int i = 0; i < bestLength; i++, position++)
+                if (position + MIN_MATCH <= size)
+                    insert(position);
+        }
+        else
+        {
+            putSymbol(bits, input[position]);
+
+            if (position + MIN_MATCH <= size)
+                insert(position);
+
+            position++;
+        }
+    }
+
+    putSymbol(bits, 256); // end of block
+    bits.flush();
+
+    uint32_t a = 1, b = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        a = (a + input[i]) % 65521u;
+        b = (b + a) % 65521u;
+    }
+
+    const uint32_t adler = (b << 16) | a;
+
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((uint8_t) (adler >> shift));
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool tableReady = false;
+
+    if (! tableReady)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+            table[n] = c;
+        }
+
+        tableReady = true;
+    }
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((uint8_t) (value >> shift));
+}
+
+void putChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& payload)
+{
+    putBigEndian(png, (uint32_t) payload.size());
+
+    const size_t typeStart = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), payload.begin(), payload.end());
+
+    putBigEndian(png, crc32(png.data() + typeStart, png.size() - typeStart));
+}
+
+}
+
+void ImageWriter::encodePng(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& png)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    png.assign(signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, (uint32_t) width);
+    putBigEndian(header, (uint32_t) height);
+    header.push_back(8); // bits per channel
+    header.push_back(2); // RGB
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+
+    putChunk(png, "IHDR", header);
+
+    // every scanline is unfiltered; the match search already finds repeated pixels and rows
+    const size_t rowBytes = (size_t) width * 3;
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((rowBytes + 1) * (size_t) height);
+
+    for (int y = 0; y < height; y++)
+    {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), rgb + (size_t) y * rowBytes, rgb + (size_t) (y + 1) * rowBytes);
+    }
+
+    std::vector<uint8_t> compressed;
+    deflateFixed(scanlines, compressed);
+
+    putChunk(png, "IDAT", compressed);
+    putChunk(png, "IEND", std::vector<uint8_t>());
+}
+
+bool ImageWriter::writeFile(const std::string& path, const std::vector<uint8_t>& bytes, std::string& error)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        error = "could not create " + path;
+        return false;
+    }
+
+    const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+    if (std::fclose(file) != 0 || ! written)
+    {
+        error = "could not write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+#pragma mark - FrameSequenceWriter -
+FrameSequenceWriter::FrameSequenceWriter(FrameFormat format_, const std::string& path_, int width_, int height_, float frameRate_)
+    : format(format_),
+      path(path_),
+      width(width_),
+      height(height_),
+      frameRate(frameRate_),
+      file(nullptr),
+      numFramesWritten(0)
+{
+}
+
+FrameSequenceWriter::~FrameSequenceWriter()
+{
+    std::string ignored;
+    close(ignored);
+}
+
+bool FrameSequenceWriter::getFormatForPath(const std::string& path, FrameFormat& format)
+{
+    std::string extension;
+    const size_t dot = path.find_last_of('.');
+
+    if (dot != std::string::npos)
+        for (char c : path.substr(dot + 1))
+            extension += (char) std::tolower((unsigned char) c);
+
+    if (extension == "rgb" || extension == "raw")
+        format = FrameFormat::RGB;
+    else if (extension == "y4m")
+        format = FrameFormat::Y4M;
+    else if (extension == "png")
+        format = FrameFormat::PNG;
+    else
+        return false;
+
+    return true;
+}
+
+bool FrameSequenceWriter::open(std::string& error)
+{
+    if (format == FrameFormat::PNG)
+    {
+        if (path.find('%') == std::string::npos)
+        {
+            error = "a PNG sequence needs a numbered path such as frames/heat_%06d.png";
+            return false;
+        }
+
+        return true;
+    }
+
+    if (path == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        file = stdout;
+    }
+    else
+    {
+        file = std::fopen(path.c_str(), "wb");
+    }
+
+    if (file == nullptr)
+    {
+        error = "could not create " + path;
+        return false;
+    }
+
+    if (format == FrameFormat::Y4M)
+    {
+        // frame rates are written as a fraction with millisecond precision
+        int numerator = (int) std::lround(frameRate * 1000.0f);
+        int denominator = 1000;
+
+        for (int divisor = 1000; divisor > 1; divisor--)
+        {
+            if (numerator % divisor == 0 && denominator % divisor == 0)
+            {
+                numerator /= divisor;
+                denominator /= divisor;
+                break;
+            }
+        }
+
+        std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n", width, height, numerator, denominator);
+    }
+
+    return true;
+}
+
+bool FrameSequenceWriter::write(const uint8_t* rgb, std::string& error)
+{
+    const size_t numPixels = (size_t) width * (size_t) height;
+
+    if (format == FrameFormat::PNG)
+    {
+        std::vector<char> name(path.size() + 32);
+        std::snprintf(name.data(), name.size(), path.c_str(), numFramesWritten);
+
+        ImageWriter::encodePng(rgb, width, height, encoded);
+
+        if (! ImageWriter::writeFile(name.data(), encoded, error))
+            return false;
+    }
+    else if (format == FrameFormat::RGB)
+    {
+        if (std::fwrite(rgb, 3, numPixels, file) != numPixels)
+        {
+            error = "could not write " + path;
+            return false;
+        }
+    }
+    else
+    {
+        // BT.601 studio-swing Y'CbCr, one full-resolution plane each
+        encoded.resize(numPixels * 3);
+
+        uint8_t* y = encoded.data();
+        uint8_t* cb = y + numPixels;
+        uint8_t* cr = cb + numPixels;
+
+        for (size_t i = 0; i < numPixels; i++)
+        {
+            const int r = rgb[i * 3];
+            const int g = rgb[i * 3 + 1];
+            const int b = rgb[i * 3 + 2];
+
+            y[i] = (uint8_t) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            cb[i] = (uint8_t) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            cr[i] = (uint8_t) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+
+        if (std::fputs("FRAME\n", file) < 0 || std::fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size())
+        {
+            error = "could not write " + path;
+            return false;
+        }
+    }
+
+    numFramesWritten++;
+    return true;
+}
+
+bool FrameSequenceWriter::close(std::string& error)
+{
+    if (file == nullptr)
+        return true;
+
+    const bool ok = file == stdout ? std::fflush(file) == 0 : std::fclose(file) == 0;
+    file = nullptr;
+
+    if (! ok)
+        error = "could not write " + path;
+
+    return ok;
+}
@@ -0,0 +1,94 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __IMAGEWRITER_H__
+#define __IMAGEWRITER_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace GridViewer {
+
+namespace ImageWriter
+{
+    /**
+     *  Encodes 8-bit RGB pixels, rows top to bottom, as a PNG file image.
+     *  The data is compressed with fixed-code deflate and a greedy match
+     *  search, which suits heatmaps: a cell's pixels repeat along the row and
+     *  its rows repeat down the image.
+     */
+    void encodePng(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& png);
+
+    /** Writes bytes to a file */
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& bytes, std::string& error);
+}
+
+/** Container a heatmap movie is written in */
+enum class FrameFormat
+{
+    RGB,    // headerless RGB24 frames, one after another
+    Y4M,    // YUV4MPEG2 with 4:4:4 chroma, readable by ffmpeg and most players
+    PNG     // one PNG file per frame
+};
+
+/**
+    Writes RGB frames of a fixed size as a movie, or as numbered PNG files.
+
+    For RGB and Y4M the path may be "-" for standard output. For PNG it is
+    a printf pattern with one integer field, e.g. "frames/heat_%06d.png".
+ */
+class FrameSequenceWriter
+{
+public:
+    FrameSequenceWriter(FrameFormat format, const std::string& path, int width, int height, float frameRate);
+    ~FrameSequenceWriter();
+
+    /** Picks a format from a path's extension; returns false if it has none of the known ones */
+    static bool getFormatForPath(const std::string& path, FrameFormat& format);
+
+    bool open(std::string& error);
+
+    /** Appends one frame of width * height RGB pixels */
+    bool write(const uint8_t* rgb, std::string& error);
+
+    bool close(std::string& error);
+
+private:
+    const FrameFormat format;
+    const std::string path;
+    const int width;
+    const int height;
+    const float frameRate;
+
+    FILE* file;
+    int numFramesWritten;
+
+    std::vector<uint8_t> encoded; // scratch for Y4M planes or PNG files
+};
+
+}
+
+#endif /* __IMAGEWRITER_H__ */
@@ -0,0 +1,93 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "NpyWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace GridViewer;
+
+namespace {
+
+bool isLittleEndian()
+{
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+
+    return first == 1;
+}
+
+bool writeArray(const std::string& path, const char* descriptor, const void* data, size_t count, size_t itemSize, std::string& error)
+{
+    if (itemSize > 1 && ! isLittleEndian())
+    {
+        error = "NPY output is only written on little-endian machines";
+        return false;
+    }
+
+    std::string header = "{'descr': '" + std::string(descriptor) + "', 'fortran_order': False, 'shape': ("
+                         + std::to_string(count) + ",), }";
+
+    // magic, version and length take 10 bytes; the header is padded so the data starts 64-byte aligned
+    const size_t unpadded = 10 + header.size() + 1;
+    header.append((64 - unpadded % 64) % 64, ' ');
+    header += '\n';
+
+    const uint16_t headerLength = (uint16_t) header.size();
+    const uint8_t preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+                                   (uint8_t) (headerLength & 0xff), (uint8_t) (headerLength >> 8) };
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        error = "could not create " + path;
+        return false;
+    }
+
+    bool ok = std::fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble)
+              && std::fwrite(header.data(), 1, header.size(), file) == header.size()
+              && std::fwrite(data, itemSize, count, file) == count;
+
+    ok = std::fclose(file) == 0 && ok;
+
+    if (! ok)
+        error = "could not write " + path;
+
+    return ok;
+}
+
+}
+
+bool NpyWriter::write(const std::string& path, const float* values, size_t count, std::string& error)
+{
+    return writeArray(path, "<f4", values, count, sizeof(float), error);
+}
+
+bool NpyWriter::write(const std::string& path, const uint8_t* values, size_t count, std::string& error)
+{
+    return writeArray(path, "|u1", values, count, 1, error);
+}
@@ -0,0 +1,44 @@
+/*
+ ------------------------------------------------------------------
+
+ This file is part of the Open Ephys GUI
+ Copyright (C) 2013 Open Ephys
+
+ ------------------------------------------------------------------
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#ifndef __NPYWRITER_H__
+#define __NPYWRITER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GridViewer {
+
+/** Writes one-dimensional arrays in NumPy's .npy format (version 1.0, little-endian) */
+namespace NpyWriter
+{
+    bool write(const std::string& path, const float* values, size_t count, std::string& error);
+
+    bool write(const std::string& path, const uint8_t* values, size_t count, std::string& error);
+}
+
+}
+
+#endif /* __NPYWRITER_H__ */